@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <thread>
 #include <deque>
 #include <condition_variable>
@@ -8,6 +9,30 @@
 
 namespace ip
 {
+	/* Set while a thread runs a Parallel body, the worker threads and the calling one. The Parallel calls made there
+	* run on that thread only: a worker adding tasks to the queues would wait for the queue_sync held by a caller
+	* completing its own tasks, so the nested calls could deadlock */
+	thread_local bool inside_parallel = false;
+
+	class ParallelScope
+	{
+		bool previous;
+
+	public:
+		ParallelScope()
+			: previous(inside_parallel)
+		{
+			inside_parallel = true;
+		}
+
+		~ParallelScope()
+		{
+			inside_parallel = previous;
+		}
+	};
+
+	// ======================================================================================================
+
 	struct ParallelThreadTask
 	{
 		std::function<void()> *func;
@@ -121,7 +146,10 @@ namespace ip
 
 			if (current->func != nullptr)
 			{
-				current->func->operator()();
+				{
+					ParallelScope scope;
+					current->func->operator()();
+				}
 
 				// printf("[Worker %d]: Mark task as completed 0x%x (func = 0x%x)\n", index, current, current->func);
 				current->func = nullptr;
@@ -140,11 +168,21 @@ namespace ip
 
 	// ======================================================================================================
 
+	// Set by Parallel::SetThreadCount, 0 for all threads
+	std::atomic_int thread_limit(0);
+
 	class ParallelHost
 	{
 		std::vector<std::unique_ptr<ParallelThread>> threads;
 
 	public:
+		// The worker threads a call is shared with, the calling thread is not counted
+		int ActiveWorkers() const
+		{
+			int limit = thread_limit;
+			return limit > 0 ? (std::min)(limit - 1, (int)threads.size()) : (int)threads.size();
+		}
+
 		ParallelHost()
 		{
 			unsigned int proc_count = std::thread::hardware_concurrency();
@@ -162,15 +200,25 @@ namespace ip
 
 		void Do(std::function<void()> func)
 		{
+			if (inside_parallel)
+			{
+				func();
+				return;
+			}
+
 			std::vector<ParallelThreadTask*> tasks;
-			tasks.reserve(threads.size());
+			int workers = ActiveWorkers();
+			tasks.reserve(workers);
 
-			for (auto &thr : threads)
+			for (int i = 0; i < workers; i++)
 			{
-				tasks.push_back(thr->AddTask(func));
+				tasks.push_back(threads[i]->AddTask(func));
 			}
 
-			func();
+			{
+				ParallelScope scope;
+				func();
+			}
 
 			for (int i = (int)tasks.size() - 1; i >= 0; i--)
 			{
@@ -189,10 +237,17 @@ namespace ip
 
 		void Aggregate(std::function<void(void* state)> func, std::function<void(void* accumulator, void* state)> aggregator, void* target, size_t state_size)
 		{
-			std::vector<AggregateData> tasks(threads.size());
-			std::vector<char> buffer(state_size * threads.size());
+			if (inside_parallel)
+			{
+				func(target);
+				return;
+			}
+
+			size_t workers = ActiveWorkers();
+			std::vector<AggregateData> tasks(workers);
+			std::vector<char> buffer(state_size * workers);
 
-			for (size_t i = 0; i < threads.size(); i++)
+			for (size_t i = 0; i < workers; i++)
 			{
 				auto &task = tasks[i];
 
@@ -208,9 +263,12 @@ namespace ip
 				task.task = threads[i]->AddTask(task.func);
 			}
 
-			func(target);
+			{
+				ParallelScope scope;
+				func(target);
+			}
 
-			for (size_t i = 0; i < threads.size(); i++)
+			for (size_t i = 0; i < workers; i++)
 			{
 				auto& task = tasks[i];
 
@@ -292,6 +350,21 @@ namespace ip
 		}
 	}
 
+	void Parallel::SetThreadCount(int count)
+	{
+		thread_limit = (std::max)(count, 0);
+	}
+
+	bool Parallel::Nested()
+	{
+		return inside_parallel;
+	}
+
+	int Parallel::ThreadCount()
+	{
+		return GetParallelHost().ActiveWorkers() + 1;
+	}
+
 	void Parallel::Aggregate(std::function<void(void* state)> func, std::function<void(void* accumulator, void* state)> aggregator, void* target, size_t state_size)
 	{
 		GetParallelHost().Aggregate(func, aggregator, target, state_size);
@@ -24,6 +24,13 @@ namespace ip
 		static void For(int beginInclusive, int endExclusive, std::function<void(int y)> func);
 		static void Reset();
 
+		// Limits the threads used by the following calls including the calling one, 0 uses all processors
+		static void SetThreadCount(int count);
+		static int ThreadCount();
+
+		// True inside a Parallel body, the Parallel calls made there run serially on the calling thread
+		static bool Nested();
+
 	public:
 		template <typename T>
 		static T Do(std::function<T()> func, std::function<void(T&, const T&)> aggregator);
@@ -65,7 +72,7 @@ namespace ip
 	{
 		std::atomic_int counter;
 		counter.store(initial);
-		return Do([&counter, &func] { return func(counter); }, aggregator);
+		return Do<T>([&counter, &func] { return func(counter); }, aggregator);
 	}
 
 	template <typename T>
@@ -6,6 +6,7 @@
 
 #include "imagebasefwd.h"
 
+#include "../ops/rowoperation.h"
 #include "../ops/imageunaryoperation.h"
 #include "../ops/convert.h"
 
@@ -32,6 +33,13 @@ namespace ip
 		PixelReader GetPixelReadIterator(int x, int y) const;
 		VectorReader GetVectorReadIterator(int x, int y) const;
 
+		// Pixels [x, x + n) of row y, n <= internal::RowChunk. Either fills buf or returns the address of the image memory
+		const PixelType* GetRow(int x, int y, int n, PixelType *buf) const;
+		void ReadRow(int y, PixelType *dst) const;
+
+		// Default for the images without the row access, evaluates pixel by pixel
+		const PixelType* row(int x, int y, int n, PixelType *buf) const;
+
 		// ----------------------------------------------------------------------------------------------
 
 		template <typename DestinationPixelType>
@@ -43,6 +51,7 @@ namespace ip
 		}
 
 
+		// Evaluates the image by rows, in parallel for the large images (see ImageReadable)
 		template <class OtherImageType>
 		void CopyTo(ImageWritable<PixelType, OtherImageType> &dst) const;
 	};
@@ -75,6 +84,23 @@ namespace ip
 		return static_cast<const ImageType*>(this)->pixel(x, y);
 	}
 
+	template <typename PixelType, class ImageType>
+	const PixelType* ImageBase<PixelType, ImageType>::GetRow(int x, int y, int n, PixelType *buf) const
+	{
+		return static_cast<const ImageType*>(this)->row(x, y, n, buf);
+	}
+
+	template <typename PixelType, class ImageType>
+	const PixelType* ImageBase<PixelType, ImageType>::row(int x, int y, int n, PixelType *buf) const
+	{
+		const ImageType &img = static_cast<const ImageType&>(*this);
+
+		for (int i = 0; i < n; i++)
+			buf[i] = img.pixel(x + i, y);
+
+		return buf;
+	}
+
 	// ==================================================================================================
 	//                              ImageBase : general image processing operations               
 	// ==================================================================================================
@@ -92,21 +118,40 @@ namespace ip
 		return VectorReadIterator<PixelType, ImageType>(static_cast<const ImageType&>(*this), x, y);
 	}
 
+	template <typename PixelType, class ImageType>
+	void ImageBase<PixelType, ImageType>::ReadRow(int y, PixelType *dst) const
+	{
+		for (int x = 0; x < Width(); x += internal::RowChunk)
+		{
+			int n = (std::min)(internal::RowChunk, Width() - x);
+			const PixelType *src = GetRow(x, y, n, dst + x);
+
+			if (src != dst + x)
+				std::copy(src, src + n, dst + x);
+		}
+	}
+
 	template <typename PixelType, class ImageType>
 	template <class OtherImageType>
 	void ImageBase<PixelType, ImageType>::CopyTo(ImageWritable<PixelType, OtherImageType> &dst) const
 	{
-		for (int j = 0; j < Height(); j++)
+		dbgcheck(dst.Width() >= Width() && dst.Height() >= Height());
+
+		internal::ForEachRowChunk(Width(), Height(), [this, &dst](int x, int y, int n)
 		{
-			PixelReader reader = GetPixelReadIterator(0, j);
-			typename ImageWritable<PixelType, OtherImageType>::PixelWriter writer = dst.GetPixelWriteIterator(0, j);
+			PixelType buf[internal::RowChunk];
+			PixelType *out = dst.GetRowAddress(x, y);
+			const PixelType *src = GetRow(x, y, n, out != nullptr ? out : buf);
 
-			for (int i = 0; i < Width(); i++)
+			if (out == nullptr)
 			{
-				writer.set(reader.get());
-				reader.advance(1);
-				writer.advance(1);
+				for (int i = 0; i < n; i++)
+					dst.pixel(x + i, y) = src[i];
 			}
-		}
+			else if (src != out)
+			{
+				std::copy(src, src + n, out);
+			}
+		});
 	}
 }
\ No newline at end of file
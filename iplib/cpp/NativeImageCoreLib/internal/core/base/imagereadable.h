@@ -12,6 +12,9 @@ namespace ip
 	//                                   Interface               
 	// ==================================================================================================
 
+	/* The pixels of a readable image may be requested in any order and from several threads at once: CopyTo and the
+	* Image constructor evaluate the large images by bands over Parallel. So pixel() / row() of an image, and the
+	* operations of the expressions (PixelTransform), must be free of side effects and safe to call concurrently */
 	template <typename PixelType, class ImageType, typename Enable>
 	class ImageReadable
 		: public ImageBase < PixelType , ImageType >
@@ -29,6 +29,10 @@ namespace ip
 
 		PixelType pixel(int x, int y) const;
 		PixelType operator()(int x, int y) const;
+
+		// Address of pixel (x, y) if the pixels of the row follow it in memory, nullptr otherwise
+		PixelType* GetRowAddress(int x, int y);
+		PixelType* rowaddr(int x, int y);
 	};
 
 	// ==================================================================================================
@@ -72,4 +76,16 @@ namespace ip
 	{
 		return (static_cast<const ImageType*>(this))->pixel(x, y);
 	}
+
+	template <typename PixelType, class ImageType>
+	PixelType* ImageWritable<PixelType, ImageType>::GetRowAddress(int x, int y)
+	{
+		return (static_cast<ImageType*>(this))->rowaddr(x, y);
+	}
+
+	template <typename PixelType, class ImageType>
+	PixelType* ImageWritable<PixelType, ImageType>::rowaddr(int x, int y)
+	{
+		return nullptr;
+	}
 }
\ No newline at end of file
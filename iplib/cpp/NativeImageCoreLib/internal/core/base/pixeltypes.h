@@ -4,6 +4,14 @@
 #error This file should not be included directly
 #endif
 
+#include <string.h>
+
+/* The F16C intrinsics can be compiled (always with MSVC), the row conversions use them after a run-time check of the
+* processor. The scalar PixelHalf conversions are always done in software, so they are the same in every translation unit */
+#if defined(_MSC_VER) || defined(__F16C__)
+#define IPLIB_F16C
+#endif
+
 namespace ip
 {
 	byte i2b(int x);
@@ -48,6 +56,12 @@ namespace ip
 	// inner type: float, 64 bpp
 	class PixelFloat256x2;
 
+	// inner type: IEEE half, 2 bpp
+	class PixelHalf;
+
+	// inner type: IEEE half, 8 bpp
+	class PixelHalfRGBA;
+
 	template <class T>
 	class PixelVector;
 
@@ -324,6 +338,38 @@ namespace ip
 		PixelFloat256 x, y;
 	};
 
+	// ==================================================================================================
+	//                                     PixelHalf, PixelHalfRGBA
+	// ==================================================================================================
+
+	/* IEEE 754 half-precision storage for the bandwidth-bound intermediate planes. Converts implicitly from and to
+	* float, rounding to nearest even; the arithmetic is done in float. The implicit conversion is a software one and
+	* is slow in the per-pixel loops: PixelHalf only saves memory, the hot loops convert by rows (internal::ConvertRow,
+	* Convert) or by vectors (the F16C helpers in misc/simd.h) */
+	class PixelHalf
+	{
+	public:
+		unsigned short bits;
+
+		PixelHalf() = default;
+		PixelHalf(const PixelHalf&) = default;
+
+		inline PixelHalf(float value);
+		inline operator float() const;
+	};
+
+	class PixelHalfRGBA
+	{
+	public:
+		PixelHalf b, g, r, a;
+
+		PixelHalfRGBA() = default;
+		PixelHalfRGBA(const PixelHalfRGBA&) = default;
+
+		inline PixelHalfRGBA(const PixelFloatRGBA &other);
+		inline operator PixelFloatRGBA() const;
+	};
+
 	//////////////////////////////////////////////////////////////////////////
 
 	inline PixelFloatRGBA::PixelFloatRGBA(float c)
@@ -338,6 +384,82 @@ namespace ip
 	inline PixelFloatRGBA::PixelFloatRGBA(const PixelByteRGB& other)
 		: PixelFloatRGB(other), a(0.0f) {}
 
+	inline PixelHalf::PixelHalf(float value)
+	{
+		unsigned int x;
+		memcpy(&x, &value, sizeof(x));
+
+		unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+		unsigned int abs = x & 0x7FFFFFFF;
+
+		if (abs >= 0x7F800000)
+		{
+			// Infinity or NaN, NaN is quieted and keeps the upper bits of the payload
+			bits = sign | 0x7C00 | (abs > 0x7F800000 ? (0x0200 | ((abs >> 13) & 0x3FF)) : 0);
+		}
+		else if (abs >= 0x477FF000)
+		{
+			// Rounds to 65520 or more
+			bits = sign | 0x7C00;
+		}
+		else if (abs >= 0x38800000)
+		{
+			// Normal: rebias the exponent, round the 13 dropped bits to nearest even
+			unsigned int h = (abs - 0x38000000) >> 13;
+			unsigned int rem = abs & 0x1FFF;
+			h += (rem > 0x1000 || (rem == 0x1000 && (h & 1))) ? 1 : 0;
+			bits = sign | (unsigned short)h;
+		}
+		else if (abs >= 0x33000000)
+		{
+			// Subnormal: the units of 2^-24
+			unsigned int e = abs >> 23;
+			unsigned int m = (abs & 0x7FFFFF) | 0x800000;
+			unsigned int shift = 126 - e;
+			unsigned int h = m >> shift;
+			unsigned int rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+			h += (rem > half || (rem == half && (h & 1))) ? 1 : 0;
+			bits = sign | (unsigned short)h;
+		}
+		else
+		{
+			bits = sign;
+		}
+	}
+
+	inline PixelHalf::operator float() const
+	{
+		unsigned int sign = (unsigned int)(bits & 0x8000) << 16;
+		unsigned int e = (bits >> 10) & 0x1F, m = bits & 0x3FF;
+		unsigned int x;
+
+		if (e == 0x1F)
+		{
+			// Infinity or NaN, NaN is quieted as by F16C
+			x = sign | 0x7F800000 | (m << 13) | (m != 0 ? 0x00400000 : 0);
+		}
+		else if (e != 0)
+			x = sign | ((e + 112) << 23) | (m << 13);
+		else
+		{
+			float f = (float)m * 5.9604644775390625e-8f;		// 2^-24
+			memcpy(&x, &f, sizeof(x));
+			x |= sign;
+		}
+
+		float res;
+		memcpy(&res, &x, sizeof(res));
+		return res;
+	}
+
+	inline PixelHalfRGBA::PixelHalfRGBA(const PixelFloatRGBA &other)
+		: b(other.b), g(other.g), r(other.r), a(other.a) {}
+
+	inline PixelHalfRGBA::operator PixelFloatRGBA() const
+	{
+		return PixelFloatRGBA(r, g, b, a);
+	}
+
 #pragma pack(pop)
 
 }
\ No newline at end of file
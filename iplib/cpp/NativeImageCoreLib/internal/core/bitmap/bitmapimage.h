@@ -66,5 +66,15 @@ namespace ip
 		{
 			return *pixeladdr(x, y);
 		}
+
+		const PixelType* row(int x, int y, int n, PixelType *buf) const
+		{
+			return pixeladdr(x, y);
+		}
+
+		PixelType* rowaddr(int x, int y)
+		{
+			return pixeladdr(x, y);
+		}
 	};
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #endif
 
 #include "bitmapimage.h"
+#include "imagepool.h"
 #include "../base/pixeltypes.h"
 
 namespace ip
@@ -18,7 +19,10 @@ namespace ip
 			BitmapData(int Width, int Height, int PixelSize);
 			virtual ~BitmapData();
 
-			static const int Alignment = 32;
+			static const int Alignment = 64;
+
+		private:
+			size_t capacity;
 		};
 	}
 
@@ -53,13 +57,7 @@ namespace ip
 		Image(const ImageReadable<PixelType, ImageType> &copy_from)
 			: Image(copy_from.Width(), copy_from.Height())
 		{
-			for (int j = 0; j < this->Height(); j++)
-			{
-				for (int i = 0; i < this->Width(); i++)
-				{
-					this->pixel(i, j) = copy_from.pixel(i, j);
-				}
-			}
+			copy_from.CopyTo(*this);
 		}
 
 		void SetSize(int newWidth, int newHeight)
@@ -104,6 +102,8 @@ namespace ip
 	typedef Image<PixelFloatRGBA> ImageFloatColor;
 	typedef Image<PixelFloatRGBA> ImageFloatRGBA;
 	typedef Image<PixelFloatComplex> ImageComplex;
+	typedef Image<PixelHalf> ImageHalf;
+	typedef Image<PixelHalfRGBA> ImageHalfRGBA;
 
 	typedef Image<PixelFloatVector> ImageVectorFloat;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #endif
 
 #include "bitmapimage3d.h"
+#include "imagepool.h"
 #include "../base/pixeltypes.h"
 
 namespace ip
@@ -18,7 +19,10 @@ namespace ip
 			BitmapData3D(int SizeX, int SizeY, int SizeZ, int PixelSize);
 			virtual ~BitmapData3D();
 
-			static const int Alignment = 32;
+			static const int Alignment = 64;
+
+		private:
+			size_t capacity;
 		};
 	}
 
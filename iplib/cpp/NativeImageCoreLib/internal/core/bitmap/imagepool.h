@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef IPLIB_INCLUDE_BASE_H
+#error This file should not be included directly
+#endif
+
+#include <stddef.h>
+
+namespace ip
+{
+	struct ImagePoolStatistics
+	{
+		size_t hits;				// Allocations served from a cached buffer
+		size_t misses;				// Allocations that went to the OS
+		size_t bytes_in_use;		// Buffers currently owned by images
+		size_t bytes_cached;		// Free buffers kept by the pool
+		size_t peak_bytes;			// Maximum of bytes_in_use + bytes_cached
+		size_t large_pages;			// OS allocations backed by large pages
+	};
+
+	/* While at least one ImagePool object exists (on any thread), the pixel buffers of Image and Image3D are not returned
+	* to the OS but kept in size classes of 1/4 octave and reused by the next allocation of the same class.
+	* Buffers up to ThreadCacheLimit are cached per thread, larger planes are shared between the threads.
+	* Planes of LargePlaneSize and more are allocated with VirtualAlloc, using large pages when the process
+	* holds SeLockMemoryPrivilege. Destroying the last ImagePool releases all cached buffers.
+	*
+	*     ImagePool pool;
+	*     for (...) ProcessFrame(...);	// no OS allocations after the first frame */
+	class ImagePool
+	{
+	public:
+		ImagePool();
+		~ImagePool();
+
+		ImagePool(const ImagePool&) = delete;
+		ImagePool &operator =(const ImagePool&) = delete;
+
+		static bool Active();
+
+		// Returns the cached buffers to the OS, the pool stays active
+		static void Trim();
+
+		static ImagePoolStatistics Statistics();
+		static void ResetStatistics();
+
+		static const size_t ThreadCacheLimit = 1 << 20;
+		static const size_t LargePlaneSize = 2 << 20;
+	};
+
+	namespace internal
+	{
+		// Returns memory aligned by 64 bytes, capacity receives the size class
+		void *PoolAllocate(size_t size, size_t &capacity);
+		void PoolFree(void *data, size_t capacity);
+	}
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#ifndef IPLIB_INCLUDE_BASE_H
+#error This file should not be included directly
+#endif
+
+#include "image.h"
+#include "../base/pixeltypes.h"
+#include "../ops/rowoperation.h"
+
+namespace ip
+{
+	// ==================================================================================================
+	//                                   PlanarPixel - interleaved counterpart
+	// ==================================================================================================
+
+	template <typename T, int Channels>
+	struct PlanarPixel;
+
+	template <> struct PlanarPixel<byte, 3> { typedef PixelByteRGB type; };
+	template <> struct PlanarPixel<byte, 4> { typedef PixelByteRGBA type; };
+	template <> struct PlanarPixel<float, 3> { typedef PixelFloatRGB type; };
+	template <> struct PlanarPixel<float, 4> { typedef PixelFloatRGBA type; };
+
+	namespace internal
+	{
+		inline void ConvertChannel(byte src, byte &dst) { dst = src; }
+		inline void ConvertChannel(byte src, float &dst) { dst = (float)src; }
+		inline void ConvertChannel(float src, byte &dst) { dst = f2b(src); }
+		inline void ConvertChannel(float src, float &dst) { dst = src; }
+
+		// The pixel types without the alpha channel read as 0 and ignore the stored value
+		template <typename PixelType, typename T>
+		void LoadAlpha(const PixelType &src, T &dst) { dst = T(); }
+		template <typename T>
+		void LoadAlpha(const PixelByteRGBA &src, T &dst) { ConvertChannel(src.a, dst); }
+		template <typename T>
+		void LoadAlpha(const PixelFloatRGBA &src, T &dst) { ConvertChannel(src.a, dst); }
+
+		template <typename PixelType, typename T>
+		void StoreAlpha(T src, PixelType &dst) {}
+		template <typename T>
+		void StoreAlpha(T src, PixelByteRGBA &dst) { ConvertChannel(src, dst.a); }
+		template <typename T>
+		void StoreAlpha(T src, PixelFloatRGBA &dst) { ConvertChannel(src, dst.a); }
+
+		/* Row converters between the interleaved pixels and the planes in the memory order B, G, R(, A).
+		* The templates are the generic versions, the overloads are vectorized (core_cpp.hpp) */
+		template <typename PixelType, typename T>
+		void DeinterleaveRow(const PixelType *src, T *const *planes, int channels, int n)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				ConvertChannel(src[i].b, planes[0][i]);
+				ConvertChannel(src[i].g, planes[1][i]);
+				ConvertChannel(src[i].r, planes[2][i]);
+
+				if (channels == 4)
+					LoadAlpha(src[i], planes[3][i]);
+			}
+		}
+
+		template <typename T, typename PixelType>
+		void InterleaveRow(const T *const *planes, int channels, PixelType *dst, int n)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				ConvertChannel(planes[0][i], dst[i].b);
+				ConvertChannel(planes[1][i], dst[i].g);
+				ConvertChannel(planes[2][i], dst[i].r);
+				StoreAlpha(channels == 4 ? planes[3][i] : T(), dst[i]);
+			}
+		}
+
+		void DeinterleaveRow(const PixelFloatRGBA *src, float *const *planes, int channels, int n);
+		void DeinterleaveRow(const PixelByteRGBA *src, float *const *planes, int channels, int n);
+		void InterleaveRow(const float *const *planes, int channels, PixelFloatRGBA *dst, int n);
+		void InterleaveRow(const float *const *planes, int channels, PixelByteRGBA *dst, int n);
+	}
+
+	// ==================================================================================================
+	//                                           PlanarImage
+	// ==================================================================================================
+
+	/* Colour image stored as one aligned Image<T> per channel (B, G, R, A), so the grayscale kernels process
+	* each channel at the full vector width. Reads as the interleaved PlanarPixel<T, Channels>::type, so
+	* the templates over ImageReadable accept it; Split and Merge convert from and to the interleaved images */
+	template <typename T, int Channels>
+	class PlanarImage
+		: public ImageReadable<typename PlanarPixel<T, Channels>::type, PlanarImage<T, Channels>>
+	{
+		static_assert(Channels == 3 || Channels == 4, "PlanarImage supports 3 or 4 channels");
+
+		Image<T> planes[Channels];
+
+	public:
+		typedef typename PlanarPixel<T, Channels>::type PixelType;
+
+		PlanarImage() {}
+
+		PlanarImage(int Width, int Height)
+		{
+			for (int c = 0; c < Channels; c++)
+			{
+				Image<T> plane(Width, Height);
+				planes[c].swap(plane);
+			}
+		}
+
+		PlanarImage(PlanarImage<T, Channels> &&move_from)
+		{
+			for (int c = 0; c < Channels; c++)
+				planes[c].swap(move_from.planes[c]);
+		}
+
+		template <typename SourcePixelType, class SourceImageType>
+		explicit PlanarImage(const ImageReadable<SourcePixelType, SourceImageType> &copy_from)
+			: PlanarImage(copy_from.Width(), copy_from.Height())
+		{
+			Split(copy_from, *this);
+		}
+
+		void swap(PlanarImage<T, Channels> &other)
+		{
+			for (int c = 0; c < Channels; c++)
+				planes[c].swap(other.planes[c]);
+		}
+
+		operator bool() const
+		{
+			return planes[0];
+		}
+
+		int Width() const
+		{
+			return planes[0].Width();
+		}
+
+		int Height() const
+		{
+			return planes[0].Height();
+		}
+
+		Image<T>& Plane(int c)
+		{
+			dbgcheck(c >= 0 && c < Channels);
+			return planes[c];
+		}
+
+		const Image<T>& Plane(int c) const
+		{
+			dbgcheck(c >= 0 && c < Channels);
+			return planes[c];
+		}
+
+		PixelType pixel(int x, int y) const
+		{
+			const T *src[Channels];
+			for (int c = 0; c < Channels; c++)
+				src[c] = planes[c].pixeladdr(x, y);
+
+			PixelType res;
+			internal::InterleaveRow<T, PixelType>(src, Channels, &res, 1);
+			return res;
+		}
+
+		const PixelType* row(int x, int y, int n, PixelType *buf) const
+		{
+			const T *src[Channels];
+			for (int c = 0; c < Channels; c++)
+				src[c] = planes[c].pixeladdr(x, y);
+
+			internal::InterleaveRow(src, Channels, buf, n);
+			return buf;
+		}
+	};
+
+	// ==================================================================================================
+	//                                          Split / Merge
+	// ==================================================================================================
+
+	// Splits the interleaved image into the planes, the channels missing in the source are set to 0
+	template <typename SourcePixelType, class SourceImageType, typename T, int Channels>
+	void Split(const ImageReadable<SourcePixelType, SourceImageType> &src, PlanarImage<T, Channels> &dst)
+	{
+		check(dst.Width() >= src.Width() && dst.Height() >= src.Height());
+
+		internal::ForEachRowChunk(src.Width(), src.Height(), [&src, &dst](int x, int y, int n)
+		{
+			SourcePixelType buf[internal::RowChunk];
+			const SourcePixelType *in = src.GetRow(x, y, n, buf);
+
+			T *out[Channels];
+			for (int c = 0; c < Channels; c++)
+				out[c] = dst.Plane(c).pixeladdr(x, y);
+
+			internal::DeinterleaveRow(in, out, Channels, n);
+		});
+	}
+
+	// Interleaves the planes into any writable image with B, G, R(, A) pixels
+	template <typename T, int Channels, typename DestinationPixelType, class DestinationImageType>
+	void Merge(const PlanarImage<T, Channels> &src, ImageWritable<DestinationPixelType, DestinationImageType> &dst)
+	{
+		check(dst.Width() >= src.Width() && dst.Height() >= src.Height());
+
+		internal::ForEachRowChunk(src.Width(), src.Height(), [&src, &dst](int x, int y, int n)
+		{
+			const T *in[Channels];
+			for (int c = 0; c < Channels; c++)
+				in[c] = src.Plane(c).pixeladdr(x, y);
+
+			DestinationPixelType *out = dst.GetRowAddress(x, y);
+
+			if (out)
+			{
+				internal::InterleaveRow(in, Channels, out, n);
+			}
+			else
+			{
+				DestinationPixelType buf[internal::RowChunk];
+				internal::InterleaveRow(in, Channels, buf, n);
+
+				for (int i = 0; i < n; i++)
+					dst(x + i, y) = buf[i];
+			}
+		});
+	}
+}
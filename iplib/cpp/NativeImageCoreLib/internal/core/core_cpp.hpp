@@ -1,4 +1,10 @@
 #include <malloc.h>
+#include <intrin.h>
+#include <immintrin.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <Windows.h>
 
 #include "../../iplib/common.h"
 #include "../../iplib/image/core.h"
@@ -16,7 +22,8 @@ namespace ip
 	{
 		check(Width >= 0 && Height >= 0);
 
-		ptrdiff_t diff = (size_t)data - (size_t)img.data;
+		// img is a view of this bitmap (or the bitmap itself), the offsets are relative to the bitmap
+		ptrdiff_t diff = (size_t)img.data - (size_t)data;
 		ptrdiff_t ofsy = diff / stride;
 		ptrdiff_t ofsx = diff - ofsy * stride;
 
@@ -39,7 +46,7 @@ namespace ip
 	{
 		check(SizeX >= 0 && SizeY >= 0 && SizeZ >= 0);
 
-		ptrdiff_t diff = (size_t)data - (size_t)img.data;
+		ptrdiff_t diff = (size_t)img.data - (size_t)data;
 		ptrdiff_t ofsz = diff / stride_z;
 		ptrdiff_t ofsy = (diff - ofsz * stride_z) / stride_y;
 		ptrdiff_t ofsx = diff - ofsz * stride_z - ofsy * stride_y;
@@ -64,6 +71,356 @@ namespace ip
 	}
 }
 
+// ==================================================================================================
+//                                          ImagePool               
+// ==================================================================================================
+
+// #include "bitmap/imagepool.h"
+
+namespace ip
+{
+	namespace internal
+	{
+		static const size_t PoolMinCapacity = 4096;
+		static const int PoolClassCount = 1 + 4 * 48;	// Up to 2^60 bytes
+		static const size_t ThreadCacheDepth = 8;
+
+		// Four classes per octave, the capacity exceeds the request by 25% at most
+		static int PoolClass(size_t size, size_t &capacity)
+		{
+			if (size <= PoolMinCapacity)
+			{
+				capacity = PoolMinCapacity;
+				return 0;
+			}
+
+			unsigned long e;
+#ifdef ENV64BIT
+			_BitScanReverse64(&e, (unsigned long long)(size - 1));
+#else
+			// size_t has 32 bits, _BitScanReverse64 is x64 only
+			_BitScanReverse(&e, (unsigned long)(size - 1));
+#endif
+
+			size_t step = (size_t)1 << (e - 2);
+			capacity = (size + step - 1) & ~(step - 1);
+
+			return 1 + (int)(e - 12) * 4 + (int)(capacity >> (e - 2)) - 5;
+		}
+
+		static size_t PoolClassCapacity(int index)
+		{
+			if (index == 0)
+				return PoolMinCapacity;
+
+			int e = 12 + (index - 1) / 4;
+			return (size_t)(5 + (index - 1) % 4) << (e - 2);
+		}
+
+		// Zero if the large pages are not available
+		static size_t LargePageSize()
+		{
+			static const size_t size = []() -> size_t
+			{
+				HANDLE token;
+
+				if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+					return 0;
+
+				TOKEN_PRIVILEGES tp;
+				tp.PrivilegeCount = 1;
+				tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+				// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED when the privilege is not held
+				bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+					AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+
+				CloseHandle(token);
+				return enabled ? GetLargePageMinimum() : 0;
+			}();
+
+			return size;
+		}
+
+		// ---------------------------------------------------------------------
+
+		class ThreadCache;
+
+		struct SharedPool
+		{
+			std::mutex lock;
+			std::vector<void*> blocks[PoolClassCount];
+			std::vector<ThreadCache*> threads;
+
+			std::atomic_int scopes{ 0 };
+
+			std::atomic<size_t> hits{ 0 }, misses{ 0 }, large_pages{ 0 };
+			std::atomic<size_t> in_use{ 0 }, cached{ 0 }, peak{ 0 };
+		};
+
+		// Never destroyed, the thread caches may outlive the static objects
+		static SharedPool &Pool()
+		{
+			static SharedPool *pool = new SharedPool();
+			return *pool;
+		}
+
+		static void *OSAllocate(size_t capacity)
+		{
+			SharedPool &pool = Pool();
+
+			if (capacity < ImagePool::LargePlaneSize)
+				return _aligned_malloc(capacity, BitmapData::Alignment);
+
+			size_t page = LargePageSize();
+
+			if (page != 0)
+			{
+				void *data = VirtualAlloc(nullptr, (capacity + page - 1) / page * page, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+				if (data != nullptr)
+				{
+					pool.large_pages++;
+					return data;
+				}
+			}
+
+			return VirtualAlloc(nullptr, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		}
+
+		static void OSFree(void *data, size_t capacity)
+		{
+			if (capacity < ImagePool::LargePlaneSize)
+				_aligned_free(data);
+			else
+				VirtualFree(data, 0, MEM_RELEASE);
+		}
+
+		static void OSFree(std::vector<void*> (&blocks)[PoolClassCount])
+		{
+			for (int i = 0; i < PoolClassCount; i++)
+			{
+				size_t capacity = PoolClassCapacity(i);
+
+				for (void *data : blocks[i])
+				{
+					OSFree(data, capacity);
+					Pool().cached -= capacity;
+				}
+
+				blocks[i].clear();
+			}
+		}
+
+		// ---------------------------------------------------------------------
+
+		/* The buffers up to ImagePool::ThreadCacheLimit freed by the thread. The lock is only contended by ImagePool::Trim,
+		* which releases the blocks of all threads */
+		class ThreadCache
+		{
+		public:
+			ThreadCache()
+			{
+				SharedPool &pool = Pool();
+				std::lock_guard<std::mutex> guard(pool.lock);
+				pool.threads.push_back(this);
+			}
+
+			~ThreadCache()
+			{
+				SharedPool &pool = Pool();
+				std::lock_guard<std::mutex> guard(pool.lock);
+
+				for (size_t i = 0; i < pool.threads.size(); i++)
+				{
+					if (pool.threads[i] == this)
+					{
+						pool.threads.erase(pool.threads.begin() + i);
+						break;
+					}
+				}
+
+				// Keep the blocks for the other threads while the pool is active
+				if (pool.scopes > 0)
+				{
+					for (int i = 0; i < PoolClassCount; i++)
+						pool.blocks[i].insert(pool.blocks[i].end(), blocks[i].begin(), blocks[i].end());
+				}
+				else
+				{
+					OSFree(blocks);
+				}
+			}
+
+			void *Pop(int index)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				std::vector<void*> &list = blocks[index];
+
+				if (list.empty())
+					return nullptr;
+
+				void *data = list.back();
+				list.pop_back();
+				return data;
+			}
+
+			bool Push(int index, void *data)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				std::vector<void*> &list = blocks[index];
+
+				if (Pool().scopes == 0 || list.size() >= ThreadCacheDepth)
+					return false;
+
+				list.push_back(data);
+				return true;
+			}
+
+			std::mutex lock;
+			std::vector<void*> blocks[PoolClassCount];
+		};
+
+		static ThreadCache &LocalCache()
+		{
+			thread_local ThreadCache cache;
+			return cache;
+		}
+
+		// ---------------------------------------------------------------------
+
+		void *PoolAllocate(size_t size, size_t &capacity)
+		{
+			SharedPool &pool = Pool();
+			int index = PoolClass(size, capacity);
+			void *data = nullptr;
+
+			if (pool.scopes > 0)
+			{
+				if (capacity <= ImagePool::ThreadCacheLimit)
+					data = LocalCache().Pop(index);
+
+				if (data == nullptr)
+				{
+					std::lock_guard<std::mutex> guard(pool.lock);
+					std::vector<void*> &list = pool.blocks[index];
+
+					if (!list.empty())
+					{
+						data = list.back();
+						list.pop_back();
+					}
+				}
+			}
+
+			if (data != nullptr)
+			{
+				pool.hits++;
+				pool.cached -= capacity;
+				pool.in_use += capacity;
+				return data;
+			}
+
+			data = OSAllocate(capacity);
+			check(data != nullptr);
+
+			pool.misses++;
+			size_t total = (pool.in_use += capacity) + pool.cached;
+			size_t peak = pool.peak;
+
+			while (total > peak && !pool.peak.compare_exchange_weak(peak, total));
+
+			return data;
+		}
+
+		void PoolFree(void *data, size_t capacity)
+		{
+			SharedPool &pool = Pool();
+			int index = PoolClass(capacity, capacity);
+
+			pool.in_use -= capacity;
+
+			if (pool.scopes > 0)
+			{
+				pool.cached += capacity;
+
+				if (capacity <= ImagePool::ThreadCacheLimit && LocalCache().Push(index, data))
+					return;
+
+				std::lock_guard<std::mutex> guard(pool.lock);
+
+				// Checked under the lock, so Trim either releases the block or the pool rejects it
+				if (pool.scopes > 0)
+				{
+					pool.blocks[index].push_back(data);
+					return;
+				}
+
+				pool.cached -= capacity;
+			}
+
+			OSFree(data, capacity);
+		}
+	}
+
+	// ---------------------------------------------------------------------
+
+	ImagePool::ImagePool()
+	{
+		internal::Pool().scopes++;
+	}
+
+	ImagePool::~ImagePool()
+	{
+		if (--internal::Pool().scopes == 0)
+			Trim();
+	}
+
+	bool ImagePool::Active()
+	{
+		return internal::Pool().scopes > 0;
+	}
+
+	void ImagePool::Trim()
+	{
+		internal::SharedPool &pool = internal::Pool();
+		std::lock_guard<std::mutex> guard(pool.lock);
+
+		for (internal::ThreadCache *cache : pool.threads)
+		{
+			std::lock_guard<std::mutex> cache_guard(cache->lock);
+			internal::OSFree(cache->blocks);
+		}
+
+		internal::OSFree(pool.blocks);
+	}
+
+	ImagePoolStatistics ImagePool::Statistics()
+	{
+		internal::SharedPool &pool = internal::Pool();
+
+		ImagePoolStatistics res;
+		res.hits = pool.hits;
+		res.misses = pool.misses;
+		res.bytes_in_use = pool.in_use;
+		res.bytes_cached = pool.cached;
+		res.peak_bytes = pool.peak;
+		res.large_pages = pool.large_pages;
+
+		return res;
+	}
+
+	void ImagePool::ResetStatistics()
+	{
+		internal::SharedPool &pool = internal::Pool();
+
+		pool.hits = 0;
+		pool.misses = 0;
+		pool.large_pages = 0;
+		pool.peak = pool.in_use + pool.cached;
+	}
+}
+
 // ==================================================================================================
 //                                           Image               
 // ==================================================================================================
@@ -85,7 +442,7 @@ namespace ip
 
 			size_t AllocSize = stride * Height;
 
-			data = _aligned_malloc(AllocSize, Alignment);
+			data = PoolAllocate(AllocSize, capacity);
 
 			check(data != nullptr);
 		}
@@ -93,7 +450,7 @@ namespace ip
 		BitmapData::~BitmapData()
 		{
 			check(data != nullptr);
-			_aligned_free(data);
+			PoolFree(data, capacity);
 		}
 
 		// ---------------------------------------------------------------------
@@ -111,7 +468,7 @@ namespace ip
 
 			size_t AllocSize = stride_z * SizeZ;
 
-			data = _aligned_malloc(AllocSize, Alignment);
+			data = PoolAllocate(AllocSize, capacity);
 
 			check(data != nullptr);
 		}
@@ -119,7 +476,7 @@ namespace ip
 		BitmapData3D::~BitmapData3D()
 		{
 			check(data != nullptr);
-			_aligned_free(data);
+			PoolFree(data, capacity);
 		}
 	}
 }
@@ -443,6 +800,571 @@ namespace ip
 	}
 }
 
+// ==================================================================================================
+//                                         PlanarImage               
+// ==================================================================================================
+
+// #include "bitmap/planarimage.h"
+
+namespace ip
+{
+	namespace internal
+	{
+		// 8 pixels: [p0 p1] [p2 p3] [p4 p5] [p6 p7] -> b0..b7, g0..g7, r0..r7, a0..a7
+		static void Transpose8x4(__m256 m0, __m256 m1, __m256 m2, __m256 m3, __m256 &b, __m256 &g, __m256 &r, __m256 &a)
+		{
+			__m256 t0 = _mm256_permute2f128_ps(m0, m2, 0x20);		// p0 p4
+			__m256 t1 = _mm256_permute2f128_ps(m0, m2, 0x31);		// p1 p5
+			__m256 t2 = _mm256_permute2f128_ps(m1, m3, 0x20);		// p2 p6
+			__m256 t3 = _mm256_permute2f128_ps(m1, m3, 0x31);		// p3 p7
+
+			__m256 bg01 = _mm256_unpacklo_ps(t0, t1);
+			__m256 ra01 = _mm256_unpackhi_ps(t0, t1);
+			__m256 bg23 = _mm256_unpacklo_ps(t2, t3);
+			__m256 ra23 = _mm256_unpackhi_ps(t2, t3);
+
+			b = _mm256_shuffle_ps(bg01, bg23, 0x44);
+			g = _mm256_shuffle_ps(bg01, bg23, 0xEE);
+			r = _mm256_shuffle_ps(ra01, ra23, 0x44);
+			a = _mm256_shuffle_ps(ra01, ra23, 0xEE);
+		}
+
+		// The inverse of Transpose8x4
+		static void Transpose4x8(__m256 b, __m256 g, __m256 r, __m256 a, __m256 &m0, __m256 &m1, __m256 &m2, __m256 &m3)
+		{
+			__m256 bg01 = _mm256_unpacklo_ps(b, g);
+			__m256 bg23 = _mm256_unpackhi_ps(b, g);
+			__m256 ra01 = _mm256_unpacklo_ps(r, a);
+			__m256 ra23 = _mm256_unpackhi_ps(r, a);
+
+			__m256 t0 = _mm256_shuffle_ps(bg01, ra01, 0x44);		// p0 p4
+			__m256 t1 = _mm256_shuffle_ps(bg01, ra01, 0xEE);		// p1 p5
+			__m256 t2 = _mm256_shuffle_ps(bg23, ra23, 0x44);		// p2 p6
+			__m256 t3 = _mm256_shuffle_ps(bg23, ra23, 0xEE);		// p3 p7
+
+			m0 = _mm256_permute2f128_ps(t0, t1, 0x20);
+			m1 = _mm256_permute2f128_ps(t2, t3, 0x20);
+			m2 = _mm256_permute2f128_ps(t0, t1, 0x31);
+			m3 = _mm256_permute2f128_ps(t2, t3, 0x31);
+		}
+
+		// bgra0 bgra1 bgra2 bgra3 <-> b0123 g0123 r0123 a0123
+		static const __m128i ByteTranspose4x4 = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+		static __m256 BytesToFloat(__m128i lo, __m128i hi)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(lo))), _mm_cvtepi32_ps(_mm_cvtepu8_epi32(hi)), 1);
+		}
+
+		// Same rounding as f2b: clamp to [0, 255], then truncate x + 0.5
+		static __m128i RoundToByte(__m128 x)
+		{
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+		}
+
+		void DeinterleaveRow(const PixelFloatRGBA *src, float *const *planes, int channels, int n)
+		{
+			const float *p = (const float*)src;
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8, p += 32)
+			{
+				__m256 b, g, r, a;
+				Transpose8x4(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _mm256_loadu_ps(p + 16), _mm256_loadu_ps(p + 24), b, g, r, a);
+
+				_mm256_storeu_ps(planes[0] + i, b);
+				_mm256_storeu_ps(planes[1] + i, g);
+				_mm256_storeu_ps(planes[2] + i, r);
+
+				if (channels == 4)
+					_mm256_storeu_ps(planes[3] + i, a);
+			}
+
+			float *tail[4];
+			for (int c = 0; c < channels; c++)
+				tail[c] = planes[c] + i;
+
+			DeinterleaveRow<PixelFloatRGBA, float>(src + i, tail, channels, n - i);
+		}
+
+		void DeinterleaveRow(const PixelByteRGBA *src, float *const *planes, int channels, int n)
+		{
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8)
+			{
+				__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), ByteTranspose4x4);
+				__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i + 4)), ByteTranspose4x4);
+
+				_mm256_storeu_ps(planes[0] + i, BytesToFloat(lo, hi));
+				_mm256_storeu_ps(planes[1] + i, BytesToFloat(_mm_srli_si128(lo, 4), _mm_srli_si128(hi, 4)));
+				_mm256_storeu_ps(planes[2] + i, BytesToFloat(_mm_srli_si128(lo, 8), _mm_srli_si128(hi, 8)));
+
+				if (channels == 4)
+					_mm256_storeu_ps(planes[3] + i, BytesToFloat(_mm_srli_si128(lo, 12), _mm_srli_si128(hi, 12)));
+			}
+
+			float *tail[4];
+			for (int c = 0; c < channels; c++)
+				tail[c] = planes[c] + i;
+
+			DeinterleaveRow<PixelByteRGBA, float>(src + i, tail, channels, n - i);
+		}
+
+		void InterleaveRow(const float *const *planes, int channels, PixelFloatRGBA *dst, int n)
+		{
+			float *p = (float*)dst;
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8, p += 32)
+			{
+				__m256 a = (channels == 4) ? _mm256_loadu_ps(planes[3] + i) : _mm256_setzero_ps();
+
+				__m256 m0, m1, m2, m3;
+				Transpose4x8(_mm256_loadu_ps(planes[0] + i), _mm256_loadu_ps(planes[1] + i), _mm256_loadu_ps(planes[2] + i), a, m0, m1, m2, m3);
+
+				_mm256_storeu_ps(p, m0);
+				_mm256_storeu_ps(p + 8, m1);
+				_mm256_storeu_ps(p + 16, m2);
+				_mm256_storeu_ps(p + 24, m3);
+			}
+
+			const float *tail[4];
+			for (int c = 0; c < channels; c++)
+				tail[c] = planes[c] + i;
+
+			InterleaveRow<float, PixelFloatRGBA>(tail, channels, dst + i, n - i);
+		}
+
+		void InterleaveRow(const float *const *planes, int channels, PixelByteRGBA *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i b = RoundToByte(_mm_loadu_ps(planes[0] + i));
+				__m128i g = RoundToByte(_mm_loadu_ps(planes[1] + i));
+				__m128i r = RoundToByte(_mm_loadu_ps(planes[2] + i));
+				__m128i a = (channels == 4) ? RoundToByte(_mm_loadu_ps(planes[3] + i)) : _mm_setzero_si128();
+
+				__m128i bgra = _mm_packus_epi16(_mm_packs_epi32(b, g), _mm_packs_epi32(r, a));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(bgra, ByteTranspose4x4));
+			}
+
+			const float *tail[4];
+			for (int c = 0; c < channels; c++)
+				tail[c] = planes[c] + i;
+
+			InterleaveRow<float, PixelByteRGBA>(tail, channels, dst + i, n - i);
+		}
+	}
+}
+
+// ==================================================================================================
+//                                         Row conversions               
+// ==================================================================================================
+
+// #include "ops/convert.h"
+
+namespace ip
+{
+	namespace internal
+	{
+		// bgr0 bgr1 bgr2 bgr3 -> b0123 g0123 r0123
+		static const __m128i RGBTranspose4x4 = _mm_setr_epi8(0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1);
+
+		// bgr0 bgr1 bgr2 bgr3 <-> bgr0 0 bgr1 0 bgr2 0 bgr3 0
+		static const __m128i RGBToRGBA = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		static const __m128i RGBAToRGB = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		// The order of operations of PixelByteRGB::operator float, so the results are bitwise equal
+		static __m256 Luma(__m256 b, __m256 g, __m256 r)
+		{
+			return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(qRed)), _mm256_mul_ps(g, _mm256_set1_ps(qGreen))), _mm256_mul_ps(b, _mm256_set1_ps(qBlue)));
+		}
+
+		// Truncates 16 floats like the (byte) cast, the values out of range saturate
+		static __m128i TruncateToBytes(const float *src)
+		{
+			__m128i lo = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(src)), _mm_cvttps_epi32(_mm_loadu_ps(src + 4)));
+			__m128i hi = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(src + 8)), _mm_cvttps_epi32(_mm_loadu_ps(src + 12)));
+			return _mm_packus_epi16(lo, hi);
+		}
+
+		// 8 pixels to 8 bytes with f2b
+		static void StoreRounded(byte *dst, __m256 v)
+		{
+			__m128i w = _mm_packs_epi32(RoundToByte(_mm256_castps256_ps128(v)), RoundToByte(_mm256_extractf128_ps(v, 1)));
+			_mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(w, w));
+		}
+
+		// 16 gray bytes to 16 PixelByteRGB
+		static void StoreGray(PixelByteRGB *dst, __m128i v)
+		{
+			byte *p = (byte*)dst;
+			_mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(v, _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5)));
+			_mm_storeu_si128((__m128i*)(p + 16), _mm_shuffle_epi8(v, _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10)));
+			_mm_storeu_si128((__m128i*)(p + 32), _mm_shuffle_epi8(v, _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15)));
+		}
+
+		// 4 PixelFloatRGBA to 16 bytes with f2b
+		static __m128i RoundPixels(const PixelFloatRGBA *src)
+		{
+			const float *p = (const float*)src;
+			__m128i lo = _mm_packs_epi32(RoundToByte(_mm_loadu_ps(p)), RoundToByte(_mm_loadu_ps(p + 4)));
+			__m128i hi = _mm_packs_epi32(RoundToByte(_mm_loadu_ps(p + 8)), RoundToByte(_mm_loadu_ps(p + 12)));
+			return _mm_packus_epi16(lo, hi);
+		}
+
+		/* The 3-byte pixels are loaded and stored by 16 bytes, so the loops over them keep a margin of 2 pixels
+		* at the end of the row and leave the rest to the generic versions */
+
+		// ---------------------------------------------------------------------------------------------
+
+		void ConvertRow(const byte *src, float *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm256_storeu_ps(dst + i, BytesToFloat(v, _mm_srli_si128(v, 4)));
+				_mm256_storeu_ps(dst + i + 8, BytesToFloat(_mm_srli_si128(v, 8), _mm_srli_si128(v, 12)));
+			}
+
+			ConvertRow<byte, float>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const float *src, byte *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 16 <= n; i += 16)
+				_mm_storeu_si128((__m128i*)(dst + i), TruncateToBytes(src + i));
+
+			ConvertRow<float, byte>(src + i, dst + i, n - i);
+		}
+
+#ifdef IPLIB_F16C
+		// The library is built for AVX, so only the F16C bit itself is checked
+		static bool HasF16C()
+		{
+			static const bool res = []()
+			{
+				int info[4];
+				__cpuid(info, 1);
+				return (info[2] & (1 << 29)) != 0;
+			}();
+
+			return res;
+		}
+#endif
+
+		void ConvertRow(const float *src, PixelHalf *dst, int n)
+		{
+			int i = 0;
+
+#ifdef IPLIB_F16C
+			if (HasF16C())
+				for (; i + 8 <= n; i += 8)
+					_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+
+			ConvertRow<float, PixelHalf>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelHalf *src, float *dst, int n)
+		{
+			int i = 0;
+
+#ifdef IPLIB_F16C
+			if (HasF16C())
+				for (; i + 8 <= n; i += 8)
+					_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+
+			ConvertRow<PixelHalf, float>(src + i, dst + i, n - i);
+		}
+
+		// ---------------------------------------------------------------------------------------------
+
+		static __m256 LoadLuma(const PixelByteRGB *src)
+		{
+			__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), RGBTranspose4x4);
+			__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 4)), RGBTranspose4x4);
+			return Luma(BytesToFloat(lo, hi), BytesToFloat(_mm_srli_si128(lo, 4), _mm_srli_si128(hi, 4)), BytesToFloat(_mm_srli_si128(lo, 8), _mm_srli_si128(hi, 8)));
+		}
+
+		static __m256 LoadLuma(const PixelByteRGBA *src)
+		{
+			__m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), ByteTranspose4x4);
+			__m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 4)), ByteTranspose4x4);
+			return Luma(BytesToFloat(lo, hi), BytesToFloat(_mm_srli_si128(lo, 4), _mm_srli_si128(hi, 4)), BytesToFloat(_mm_srli_si128(lo, 8), _mm_srli_si128(hi, 8)));
+		}
+
+		void ConvertRow(const PixelByteRGB *src, float *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 8 + 2 <= n; i += 8)
+				_mm256_storeu_ps(dst + i, LoadLuma(src + i));
+
+			ConvertRow<PixelByteRGB, float>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGB *src, byte *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 8 + 2 <= n; i += 8)
+				StoreRounded(dst + i, LoadLuma(src + i));
+
+			ConvertRow<PixelByteRGB, byte>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGBA *src, float *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8)
+				_mm256_storeu_ps(dst + i, LoadLuma(src + i));
+
+			ConvertRow<PixelByteRGBA, float>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGBA *src, byte *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8)
+				StoreRounded(dst + i, LoadLuma(src + i));
+
+			ConvertRow<PixelByteRGBA, byte>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGBA *src, float *dst, int n)
+		{
+			const float *p = (const float*)src;
+			int i = 0;
+
+			for (; i + 8 <= n; i += 8, p += 32)
+			{
+				__m256 b, g, r, a;
+				Transpose8x4(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _mm256_loadu_ps(p + 16), _mm256_loadu_ps(p + 24), b, g, r, a);
+				_mm256_storeu_ps(dst + i, Luma(b, g, r));
+			}
+
+			ConvertRow<PixelFloatRGBA, float>(src + i, dst + i, n - i);
+		}
+
+		// ---------------------------------------------------------------------------------------------
+
+		void ConvertRow(const byte *src, PixelByteRGB *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 16 <= n; i += 16)
+				StoreGray(dst + i, _mm_loadu_si128((const __m128i*)(src + i)));
+
+			ConvertRow<byte, PixelByteRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const float *src, PixelByteRGB *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 16 <= n; i += 16)
+				StoreGray(dst + i, TruncateToBytes(src + i));
+
+			ConvertRow<float, PixelByteRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const byte *src, PixelByteRGBA *dst, int n)
+		{
+			const __m128i GRAY = _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1);
+			int i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, GRAY));
+				_mm_storeu_si128((__m128i*)(dst + i + 4), _mm_shuffle_epi8(_mm_srli_si128(v, 4), GRAY));
+				_mm_storeu_si128((__m128i*)(dst + i + 8), _mm_shuffle_epi8(_mm_srli_si128(v, 8), GRAY));
+				_mm_storeu_si128((__m128i*)(dst + i + 12), _mm_shuffle_epi8(_mm_srli_si128(v, 12), GRAY));
+			}
+
+			ConvertRow<byte, PixelByteRGBA>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const float *src, PixelFloatRGBA *dst, int n)
+		{
+			float *p = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4, p += 16)
+			{
+				__m128 v = _mm_loadu_ps(src + i);
+				_mm_storeu_ps(p, _mm_blend_ps(_mm_shuffle_ps(v, v, 0x00), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(p + 4, _mm_blend_ps(_mm_shuffle_ps(v, v, 0x55), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(p + 8, _mm_blend_ps(_mm_shuffle_ps(v, v, 0xAA), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(p + 12, _mm_blend_ps(_mm_shuffle_ps(v, v, 0xFF), _mm_setzero_ps(), 8));
+			}
+
+			ConvertRow<float, PixelFloatRGBA>(src + i, dst + i, n - i);
+		}
+
+		// ---------------------------------------------------------------------------------------------
+
+		void ConvertRow(const PixelByteRGB *src, PixelByteRGBA *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4)
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), RGBToRGBA));
+
+			ConvertRow<PixelByteRGB, PixelByteRGBA>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGBA *src, PixelByteRGB *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4)
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), RGBAToRGB));
+
+			ConvertRow<PixelByteRGBA, PixelByteRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGB *src, PixelFloatRGBA *dst, int n)
+		{
+			const float *p = (const float*)src;
+			float *q = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4, p += 12, q += 16)
+			{
+				__m128i m0 = _mm_castps_si128(_mm_loadu_ps(p));			// b0 g0 r0 b1
+				__m128i m1 = _mm_castps_si128(_mm_loadu_ps(p + 4));		// g1 r1 b2 g2
+				__m128i m2 = _mm_castps_si128(_mm_loadu_ps(p + 8));		// r2 b3 g3 r3
+
+				_mm_storeu_ps(q, _mm_blend_ps(_mm_castsi128_ps(m0), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(q + 4, _mm_blend_ps(_mm_castsi128_ps(_mm_alignr_epi8(m1, m0, 12)), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(q + 8, _mm_blend_ps(_mm_castsi128_ps(_mm_alignr_epi8(m2, m1, 8)), _mm_setzero_ps(), 8));
+				_mm_storeu_ps(q + 12, _mm_castsi128_ps(_mm_srli_si128(m2, 4)));
+			}
+
+			ConvertRow<PixelFloatRGB, PixelFloatRGBA>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGBA *src, PixelFloatRGB *dst, int n)
+		{
+			const float *p = (const float*)src;
+			float *q = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4, p += 16, q += 12)
+			{
+				__m128 p0 = _mm_loadu_ps(p);
+				__m128 p1 = _mm_loadu_ps(p + 4);
+				__m128 p2 = _mm_loadu_ps(p + 8);
+				__m128 p3 = _mm_loadu_ps(p + 12);
+
+				_mm_storeu_ps(q, _mm_blend_ps(p0, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(p1), 12)), 8));
+				_mm_storeu_ps(q + 4, _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 0, 2, 1)));
+				_mm_storeu_ps(q + 8, _mm_blend_ps(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(p3), 4)), _mm_shuffle_ps(p2, p2, 0xAA), 1));
+			}
+
+			ConvertRow<PixelFloatRGBA, PixelFloatRGB>(src + i, dst + i, n - i);
+		}
+
+		// ---------------------------------------------------------------------------------------------
+
+		void ConvertRow(const PixelByteRGB *src, PixelFloatRGB *dst, int n)
+		{
+			float *q = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4, q += 12)
+			{
+				// The 12 bytes are already in the memory order of the 12 floats
+				__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_ps(q, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)));
+				_mm_storeu_ps(q + 4, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))));
+				_mm_storeu_ps(q + 8, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+			}
+
+			ConvertRow<PixelByteRGB, PixelFloatRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGB *src, PixelFloatRGBA *dst, int n)
+		{
+			float *q = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4, q += 16)
+			{
+				__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), RGBToRGBA);
+				_mm256_storeu_ps(q, BytesToFloat(v, _mm_srli_si128(v, 4)));
+				_mm256_storeu_ps(q + 8, BytesToFloat(_mm_srli_si128(v, 8), _mm_srli_si128(v, 12)));
+			}
+
+			ConvertRow<PixelByteRGB, PixelFloatRGBA>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelByteRGBA *src, PixelFloatRGBA *dst, int n)
+		{
+			// The conversion goes through PixelByteRGB, so the alpha is dropped
+			const __m128i RGB = _mm_set1_epi32(0x00FFFFFF);
+			float *q = (float*)dst;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4, q += 16)
+			{
+				__m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + i)), RGB);
+				_mm256_storeu_ps(q, BytesToFloat(v, _mm_srli_si128(v, 4)));
+				_mm256_storeu_ps(q + 8, BytesToFloat(_mm_srli_si128(v, 8), _mm_srli_si128(v, 12)));
+			}
+
+			ConvertRow<PixelByteRGBA, PixelFloatRGBA>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGB *src, PixelByteRGB *dst, int n)
+		{
+			const float *p = (const float*)src;
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4, p += 12)
+			{
+				__m128i lo = _mm_packs_epi32(RoundToByte(_mm_loadu_ps(p)), RoundToByte(_mm_loadu_ps(p + 4)));
+				__m128i hi = _mm_packs_epi32(RoundToByte(_mm_loadu_ps(p + 8)), _mm_setzero_si128());
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+			}
+
+			ConvertRow<PixelFloatRGB, PixelByteRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGBA *src, PixelByteRGB *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 4 + 2 <= n; i += 4)
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(RoundPixels(src + i), RGBAToRGB));
+
+			ConvertRow<PixelFloatRGBA, PixelByteRGB>(src + i, dst + i, n - i);
+		}
+
+		void ConvertRow(const PixelFloatRGBA *src, PixelByteRGBA *dst, int n)
+		{
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4)
+				_mm_storeu_si128((__m128i*)(dst + i), RoundPixels(src + i));
+
+			ConvertRow<PixelFloatRGBA, PixelByteRGBA>(src + i, dst + i, n - i);
+		}
+	}
+}
+
 // ==================================================================================================
 //                                         ImageIO               
 // ==================================================================================================
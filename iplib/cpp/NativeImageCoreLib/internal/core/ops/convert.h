@@ -8,6 +8,58 @@
 
 namespace ip
 {
+	class PixelByteRGB;
+	class PixelByteRGBA;
+	class PixelFloatRGB;
+	class PixelFloatRGBA;
+	class PixelHalf;
+
+	namespace internal
+	{
+		/* Row converters with the semantics of the casts between the pixel types. The templates are the generic
+		* versions, the overloads are vectorized (core_cpp.hpp) */
+		template <typename SourcePixelType, typename DestinationPixelType>
+		void ConvertRow(const SourcePixelType *src, DestinationPixelType *dst, int n)
+		{
+			for (int i = 0; i < n; i++)
+				dst[i] = (DestinationPixelType)src[i];
+		}
+
+		template <typename PixelType>
+		void ConvertRow(const PixelType *src, PixelType *dst, int n)
+		{
+			std::copy(src, src + n, dst);
+		}
+
+		void ConvertRow(const byte *src, float *dst, int n);
+		void ConvertRow(const float *src, byte *dst, int n);
+		void ConvertRow(const float *src, PixelHalf *dst, int n);
+		void ConvertRow(const PixelHalf *src, float *dst, int n);
+
+		void ConvertRow(const PixelByteRGB *src, float *dst, int n);
+		void ConvertRow(const PixelByteRGB *src, byte *dst, int n);
+		void ConvertRow(const PixelByteRGBA *src, float *dst, int n);
+		void ConvertRow(const PixelByteRGBA *src, byte *dst, int n);
+		void ConvertRow(const PixelFloatRGBA *src, float *dst, int n);
+
+		void ConvertRow(const byte *src, PixelByteRGB *dst, int n);
+		void ConvertRow(const byte *src, PixelByteRGBA *dst, int n);
+		void ConvertRow(const float *src, PixelByteRGB *dst, int n);
+		void ConvertRow(const float *src, PixelFloatRGBA *dst, int n);
+
+		void ConvertRow(const PixelByteRGB *src, PixelByteRGBA *dst, int n);
+		void ConvertRow(const PixelByteRGBA *src, PixelByteRGB *dst, int n);
+		void ConvertRow(const PixelFloatRGB *src, PixelFloatRGBA *dst, int n);
+		void ConvertRow(const PixelFloatRGBA *src, PixelFloatRGB *dst, int n);
+
+		void ConvertRow(const PixelByteRGB *src, PixelFloatRGB *dst, int n);
+		void ConvertRow(const PixelByteRGB *src, PixelFloatRGBA *dst, int n);
+		void ConvertRow(const PixelByteRGBA *src, PixelFloatRGBA *dst, int n);
+		void ConvertRow(const PixelFloatRGB *src, PixelByteRGB *dst, int n);
+		void ConvertRow(const PixelFloatRGBA *src, PixelByteRGB *dst, int n);
+		void ConvertRow(const PixelFloatRGBA *src, PixelByteRGBA *dst, int n);
+	}
+
 	template <typename DestinationPixelType, typename SourcePixelType>
 	class OperationConvert
 	{
@@ -17,6 +69,11 @@ namespace ip
 			return (DestinationPixelType)src;
 		}
 
+		void apply_row(const SourcePixelType *in, DestinationPixelType *out, int n) const
+		{
+			internal::ConvertRow(in, out, n);
+		}
+
 		typedef DestinationPixelType PixelType;
 	};
-}
\ No newline at end of file
+}
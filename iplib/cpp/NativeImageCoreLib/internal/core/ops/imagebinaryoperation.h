@@ -4,6 +4,8 @@
 #error This file should not be included directly
 #endif
 
+#include <type_traits>
+
 #include "../base/imagereadable.h"
 
 namespace ip
@@ -25,6 +27,7 @@ namespace ip
 		int Width() const;
 		int Height() const;
 		typename BinaryOperation::PixelType pixel(int x, int y) const;
+		const typename BinaryOperation::PixelType* row(int x, int y, int n, typename BinaryOperation::PixelType *buf) const;
 	};
 
 	// ==================================================================================================
@@ -52,4 +55,20 @@ namespace ip
 	{
 		return operation(src1.pixel(x, y), src2.pixel(x, y));
 	}
+
+	template <class SourceImageType1, class SourceImageType2, class BinaryOperation>
+	const typename BinaryOperation::PixelType* ImageBinaryOperation<SourceImageType1, SourceImageType2, BinaryOperation>::row(int x, int y, int n,
+		typename BinaryOperation::PixelType *buf) const
+	{
+		dbgcheck(n <= internal::RowChunk);
+
+		typedef typename std::remove_cv<typename std::remove_reference<decltype(src1.pixel(0, 0))>::type>::type SourcePixelType1;
+		typedef typename std::remove_cv<typename std::remove_reference<decltype(src2.pixel(0, 0))>::type>::type SourcePixelType2;
+
+		SourcePixelType1 tmp1[internal::RowChunk];
+		SourcePixelType2 tmp2[internal::RowChunk];
+
+		internal::ApplyRow(operation, src1.GetRow(x, y, n, tmp1), src2.GetRow(x, y, n, tmp2), buf, n);
+		return buf;
+	}
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ namespace ip
 		int Width() const;
 		int Height() const;
 		typename UnaryOperation::PixelType pixel(int x, int y) const;
+		const typename UnaryOperation::PixelType* row(int x, int y, int n, typename UnaryOperation::PixelType *buf) const;
 	};
 
 	// ==================================================================================================
@@ -51,4 +52,15 @@ namespace ip
 	{
 		return operation(src.pixel(x, y));
 	}
+
+	template <typename PixelType, class SourceImageType, class UnaryOperation>
+	const typename UnaryOperation::PixelType* ImageUnaryOperation<PixelType, SourceImageType, UnaryOperation>::row(int x, int y, int n,
+		typename UnaryOperation::PixelType *buf) const
+	{
+		dbgcheck(n <= internal::RowChunk);
+
+		PixelType tmp[internal::RowChunk];
+		internal::ApplyRow(operation, src.GetRow(x, y, n, tmp), buf, n);
+		return buf;
+	}
 }
\ No newline at end of file
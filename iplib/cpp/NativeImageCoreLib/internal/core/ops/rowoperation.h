@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef IPLIB_INCLUDE_BASE_H
+#error This file should not be included directly
+#endif
+
+#include <algorithm>
+#include <iplib/parallel.h>
+
+namespace ip
+{
+	namespace internal
+	{
+		// The expressions are evaluated by chunks of a row, so the operations can keep the intermediate pixels on the stack
+		const int RowChunk = 256;
+
+		/* Images up to this size are evaluated by the calling thread, the larger ones by bands of BandPixels over Parallel.
+		* Inside a Parallel body (a tile of ProcessTiled, a job of a worker) every image is evaluated by the calling thread */
+		const int ParallelPixels = 1 << 16;
+		const int BandPixels = 1 << 14;
+
+		// ==================================================================================================
+		//                          ApplyRow - optional vectorized hooks of the operations
+		// ==================================================================================================
+
+		/* An operation may provide apply_row(in, out, n) (or apply_row(in1, in2, out, n) for the binary ones), that
+		* processes n pixels at once. Otherwise operator () is called in a loop over the contiguous arrays */
+		template <class Operation, typename SourcePixelType, typename DestinationPixelType>
+		auto ApplyRowSelect(const Operation &operation, const SourcePixelType *in, DestinationPixelType *out, int n, int)
+			-> decltype(operation.apply_row(in, out, n), void())
+		{
+			operation.apply_row(in, out, n);
+		}
+
+		template <class Operation, typename SourcePixelType, typename DestinationPixelType>
+		void ApplyRowSelect(const Operation &operation, const SourcePixelType *in, DestinationPixelType *out, int n, long)
+		{
+			for (int i = 0; i < n; i++)
+				out[i] = operation(in[i]);
+		}
+
+		template <class Operation, typename SourcePixelType1, typename SourcePixelType2, typename DestinationPixelType>
+		auto ApplyRowSelect(const Operation &operation, const SourcePixelType1 *in1, const SourcePixelType2 *in2, DestinationPixelType *out, int n, int)
+			-> decltype(operation.apply_row(in1, in2, out, n), void())
+		{
+			operation.apply_row(in1, in2, out, n);
+		}
+
+		template <class Operation, typename SourcePixelType1, typename SourcePixelType2, typename DestinationPixelType>
+		void ApplyRowSelect(const Operation &operation, const SourcePixelType1 *in1, const SourcePixelType2 *in2, DestinationPixelType *out, int n, long)
+		{
+			for (int i = 0; i < n; i++)
+				out[i] = operation(in1[i], in2[i]);
+		}
+
+		template <class Operation, typename SourcePixelType, typename DestinationPixelType>
+		void ApplyRow(const Operation &operation, const SourcePixelType *in, DestinationPixelType *out, int n)
+		{
+			ApplyRowSelect(operation, in, out, n, 0);
+		}
+
+		template <class Operation, typename SourcePixelType1, typename SourcePixelType2, typename DestinationPixelType>
+		void ApplyRow(const Operation &operation, const SourcePixelType1 *in1, const SourcePixelType2 *in2, DestinationPixelType *out, int n)
+		{
+			ApplyRowSelect(operation, in1, in2, out, n, 0);
+		}
+
+		// ==================================================================================================
+		//                                 ForEachRowChunk - evaluation order
+		// ==================================================================================================
+
+		// Calls func(x, y, n) for the chunks of RowChunk pixels at most covering the image
+		template <class Func>
+		void ForEachRowChunk(int width, int height, const Func &func)
+		{
+			auto band = [width, &func](int y0, int y1)
+			{
+				for (int y = y0; y < y1; y++)
+					for (int x = 0; x < width; x += RowChunk)
+						func(x, y, (std::min)(RowChunk, width - x));
+			};
+
+			if ((long long)width * height < ParallelPixels || Parallel::Nested())
+			{
+				band(0, height);
+				return;
+			}
+
+			int rows = (std::max)(1, BandPixels / width);
+			int bands = (height + rows - 1) / rows;
+
+			Parallel::For(0, bands, [rows, height, &band](int k)
+			{
+				band(k * rows, (std::min)(height, (k + 1) * rows));
+			});
+		}
+	}
+}
@@ -1,5 +1,6 @@
 #include "../../iplib/image/diffusion/diffusion.h"
 #include <algorithm>
+#include <string.h>
 #include <iplib/parallel.h>
 #include <immintrin.h>
 
@@ -10,194 +11,291 @@ namespace ip
 	const float LQ1 = 0.70710678118654752440084436210485f;
 	const float LQ2 = 6.8284271247461900976033774484194f;
 
-	void Diffusion::PeronaMalikDivisionIteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
+	namespace internal
 	{
-		Diffusion d(src, dst, dt, k);
+		// exp(x) for -87 <= x <= 0 (smaller values are clamped), the relative error is below 1e-6. Only AVX instructions are used
+		static inline __m256 FastExp256(__m256 x)
+		{
+			x = _mm256_max_ps(x, _mm256_set1_ps(-87.0f));
+
+			__m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f));
+			__m256 n = _mm256_floor_ps(t);
+			__m256 f = _mm256_sub_ps(t, n);
+
+			// 2^f, f = [0, 1)
+			__m256 p = _mm256_set1_ps(1.535336188319500e-4f);
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.339887440266574e-3f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(9.618437357674640e-3f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(5.550332471162809e-2f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(2.402264791363012e-1f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(6.931472028550421e-1f));
+			p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+
+			// 2^n is built directly in the exponent field
+			__m256i ni = _mm256_cvtps_epi32(n);
+			__m128i bias = _mm_set1_epi32(127);
+			__m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(ni), bias), 23);
+			__m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(ni, 1), bias), 23);
+			__m256 scale = _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+
+			return _mm256_mul_ps(p, scale);
+		}
+
+		// Diffusion coefficient 1 / (1 + (|grad| / k)^2)
+		struct DiffusionDivision
+		{
+			static inline float Calc(float q2)
+			{
+				return 1.0f / (1.0f + q2);
+			}
 
-		for (int i = 0; i < src.Width(); i++)
-			d.IteratePeronaMalikDivisionSafe(i, 0);
+			static inline __m256 Calc(__m256 q2)
+			{
+				__m256 one = _mm256_set1_ps(1.0f);
+				return _mm256_div_ps(one, _mm256_add_ps(one, q2));
+			}
+		};
 
-		ip::Parallel::For(1, src.Height() - 1, [&d](int j)
+		// Diffusion coefficient exp(-(|grad| / k)^2)
+		struct DiffusionExponent
 		{
-			d.IteratePeronaMalikDivisionSafe(0, j);
+			static inline float Calc(float q2)
+			{
+				return expf(-q2);
+			}
+
+			static inline __m256 Calc(__m256 q2)
+			{
+				return FastExp256(_mm256_sub_ps(_mm256_setzero_ps(), q2));
+			}
+		};
 
-			int i = 1;
+		/* Perform one iteration for 'count' pixels of the row 'row', the rows 'above' and 'below' are its neighbours.
+		* The pixels with indices -1 and 'count' of all three rows must be readable */
+		template <class Coefficient>
+		static void DiffusionRow(const float* above, const float* row, const float* below, float* out, int count, float dt, float inv_k)
+		{
+			int i = 0;
 
-			while (i < d.src.Width() - 8)
+			for (; i <= count - 8; i += 8)
 			{
 				// CalcGradient, CalcLaplas
 				__m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
-				__m256 c = _mm256_loadu_ps(d.src.pixeladdr(i, j));
-				__m256 one = _mm256_set1_ps(1.0f);
+				__m256 c = _mm256_loadu_ps(row + i);
 
-				__m256 v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j - 1));
+				__m256 v = _mm256_loadu_ps(above + i - 1);
 				__m256 laplas = v;
 				__m256 a1 = _mm256_and_ps(_mm256_sub_ps(c, v), absmask);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j - 1));
+				v = _mm256_loadu_ps(above + i + 1);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j + 1));
+				v = _mm256_loadu_ps(below + i - 1);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j + 1));
+				v = _mm256_loadu_ps(below + i + 1);
 				laplas = _mm256_mul_ps(_mm256_add_ps(laplas, v), _mm256_set1_ps(LQ1));
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
 				__m256 grad = _mm256_mul_ps(a1, _mm256_set1_ps(GQ2));
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j));
+				v = _mm256_loadu_ps(row + i - 1);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_and_ps(_mm256_sub_ps(c, v), absmask);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j));
+				v = _mm256_loadu_ps(row + i + 1);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i, j - 1));
+				v = _mm256_loadu_ps(above + i);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
-				v = _mm256_loadu_ps(d.src.pixeladdr(i, j + 1));
+				v = _mm256_loadu_ps(below + i);
 				laplas = _mm256_add_ps(laplas, v);
 				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
 
 				grad = _mm256_add_ps(_mm256_mul_ps(a1, _mm256_set1_ps(GQ1)), grad);
 				laplas = _mm256_sub_ps(laplas, _mm256_mul_ps(c, _mm256_set1_ps(LQ2)));
-			
-				// DivisonCoefficient
-				grad = _mm256_div_ps(grad, _mm256_set1_ps(d.k));
-				grad = _mm256_div_ps(one, _mm256_add_ps(one, _mm256_mul_ps(grad, grad)));
 
-				// Apply
-				c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(d.dt), grad), laplas));
-				_mm256_storeu_ps(d.dst.pixeladdr(i, j), c);
+				// Coefficient
+				grad = _mm256_mul_ps(grad, _mm256_set1_ps(inv_k));
+				grad = Coefficient::Calc(_mm256_mul_ps(grad, grad));
 
-				i += 8;
+				// Apply
+				c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(dt), grad), laplas));
+				_mm256_storeu_ps(out + i, c);
 			}
 
-			while (i < d.src.Width())
+			for (; i < count; i++)
 			{
-				d.IteratePeronaMalikDivisionSafe(i++, j);
+				float p = row[i];
+				float p1 = fabsf(p - row[i - 1]) + fabsf(p - row[i + 1]) + fabsf(p - above[i]) + fabsf(p - below[i]);
+				float p2 = fabsf(p - above[i - 1]) + fabsf(p - above[i + 1]) + fabsf(p - below[i - 1]) + fabsf(p - below[i + 1]);
+				float q = (p1 * GQ1 + p2 * GQ2) * inv_k;
+
+				float laplas = (above[i - 1] + above[i + 1] + below[i - 1] + below[i + 1]) * LQ1 +
+					above[i] + below[i] + row[i - 1] + row[i + 1] - p * LQ2;
+
+				out[i] = p + dt * Coefficient::Calc(q * q) * laplas;
 			}
-		});
+		}
+	}
 
-		for (int i = 0; i < src.Width(); i++)
-			d.IteratePeronaMalikDivisionSafe(i, src.Height() - 1);
+	void Diffusion::PeronaMalikDivisionIteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
+	{
+		Iteration<internal::DiffusionDivision>(src, dst, dt, k);
 	}
 
 	void Diffusion::PeronaMalikExponentIteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
 	{
-		Diffusion d(src, dst, dt, k);
+		Iteration<internal::DiffusionExponent>(src, dst, dt, k);
+	}
 
-		for (int i = 0; i < src.Width(); i++)
-			d.IteratePeronaMalikExponentSafe(i, 0);
+	void Diffusion::Run(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k, int iterations, Mode mode)
+	{
+		check(src.Width() == dst.Width() && src.Height() == dst.Height());
+		check(src.Data().data != dst.Data().data);
 
-		ip::Parallel::For(1, src.Height() - 1, [&d](int j)
+		if (iterations <= 0)
 		{
-			d.IteratePeronaMalikExponentSafe(0, j);
-
-			int i = 1;
-
-			while (i < d.src.Width() - 8)
+			ip::Parallel::For(0, src.Height(), [&src, &dst](int j)
 			{
-				// CalcGradient, CalcLaplas
-				__m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
-				__m256 c = _mm256_loadu_ps(d.src.pixeladdr(i, j));
-				// __m256 one = _mm256_set1_ps(1.0f);
-
-				__m256 v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j - 1));
-				__m256 laplas = v;
-				__m256 a1 = _mm256_and_ps(_mm256_sub_ps(c, v), absmask);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j - 1));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j + 1));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j + 1));
-				laplas = _mm256_mul_ps(_mm256_add_ps(laplas, v), _mm256_set1_ps(LQ1));
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
-
-				__m256 grad = _mm256_mul_ps(a1, _mm256_set1_ps(GQ2));
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i - 1, j));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_and_ps(_mm256_sub_ps(c, v), absmask);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i + 1, j));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i, j - 1));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
-
-				v = _mm256_loadu_ps(d.src.pixeladdr(i, j + 1));
-				laplas = _mm256_add_ps(laplas, v);
-				a1 = _mm256_add_ps(_mm256_and_ps(_mm256_sub_ps(c, v), absmask), a1);
+				memcpy(dst.pixeladdr(0, j), src.pixeladdr(0, j), src.Width() * sizeof(float));
+			});
+			return;
+		}
+
+		if (mode == Mode::Exponent)
+			RunTiled<internal::DiffusionExponent>(src, dst, dt, k, iterations);
+		else
+			RunTiled<internal::DiffusionDivision>(src, dst, dt, k, iterations);
+	}
 
-				grad = _mm256_add_ps(_mm256_mul_ps(a1, _mm256_set1_ps(GQ1)), grad);
-				laplas = _mm256_sub_ps(laplas, _mm256_mul_ps(c, _mm256_set1_ps(LQ2)));
+	template <class Coefficient>
+	void Diffusion::Iteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
+	{
+		Diffusion d(src, dst, dt, k);
 
-				// DivisonCoefficient
-				grad = _mm256_div_ps(grad, _mm256_set1_ps(d.k));
-				grad = _mm256_exp_ps(_mm256_sub_ps(_mm256_set1_ps(0.0f), _mm256_mul_ps(grad, grad)));
+		for (int i = 0; i < src.Width(); i++)
+			d.IterateSafe<Coefficient>(i, 0);
 
-				// Apply
-				c = _mm256_add_ps(c, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(d.dt), grad), laplas));
-				_mm256_storeu_ps(d.dst.pixeladdr(i, j), c);
+		ip::Parallel::For(1, src.Height() - 1, [&d](int j)
+		{
+			int width = d.src.Width();
 
-				i += 8;
-			}
+			d.IterateSafe<Coefficient>(0, j);
 
-			while (i < d.src.Width())
+			if (width > 2)
 			{
-				d.IteratePeronaMalikExponentSafe(i++, j);
+				internal::DiffusionRow<Coefficient>(d.src.pixeladdr(1, j - 1), d.src.pixeladdr(1, j), d.src.pixeladdr(1, j + 1),
+					d.dst.pixeladdr(1, j), width - 2, d.dt, 1.0f / d.k);
 			}
+
+			if (width > 1)
+				d.IterateSafe<Coefficient>(width - 1, j);
 		});
 
 		for (int i = 0; i < src.Width(); i++)
-			d.IteratePeronaMalikExponentSafe(i, src.Height() - 1);
+			d.IterateSafe<Coefficient>(i, src.Height() - 1);
 	}
 
-	Diffusion::Diffusion(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
-		: src(src), dst(dst), dt(dt), k(k) {}
-
-	static float DivisonCoefficient(float grad, float k)
+	template <class Coefficient>
+	void Diffusion::RunTiled(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k, int iterations)
 	{
-		float q = grad / k;
-		return 1.0f / (1.0f + q * q);
-	}
+		int width = src.Width();
+		int height = src.Height();
+		int tiles_x = (width + TileWidth - 1) / TileWidth;
+		int tiles_y = (height + TileHeight - 1) / TileHeight;
+		int passes = (iterations + TemporalBlock - 1) / TemporalBlock;
+		float inv_k = 1.0f / k;
+
+		// Passes are ping-ponged between dst and tmp so that the last one is written to dst
+		ImageFloat tmp = passes > 1 ? ImageFloat(width, height) : ImageFloat();
+		const ImageFloat* from = &src;
+
+		for (int pass = 0; pass < passes; pass++)
+		{
+			int steps = iterations - pass * TemporalBlock;
+			if (steps > TemporalBlock)
+				steps = TemporalBlock;
 
-	static float ExponentCoefficient(float grad, float k)
-	{
-		float q = grad / k;
-		return expf(-q * q);
-	}
+			ImageFloat& to = ((passes - 1 - pass) % 2 == 0) ? dst : tmp;
+			const ImageFloat& cur = *from;
 
-	void Diffusion::IteratePeronaMalikDivisionSafe(int x, int y)
-	{
-		float grad = CalcGradientSafe(x, y);
-		float q = DivisonCoefficient(grad, k);
-		float laplas = CalcLaplasSafe(x, y);
-		dst(x, y) = src(x, y) + dt * q * laplas;
+			ip::Parallel::For([&cur, &to, width, height, tiles_x, tiles_y, steps, dt, inv_k](std::atomic_int& counter)
+			{
+				// The tile with its halo, and one pixel of padding on each side
+				ImageFloat buf0(TileWidth + 2 * TemporalBlock + 2, TileHeight + 2 * TemporalBlock + 2);
+				ImageFloat buf1(buf0.Width(), buf0.Height());
+
+				for (int t = counter++; t < tiles_x * tiles_y; t = counter++)
+				{
+					int x0 = (t % tiles_x) * TileWidth, x1 = (std::min)(x0 + TileWidth, width);
+					int y0 = (t / tiles_x) * TileHeight, y1 = (std::min)(y0 + TileHeight, height);
+
+					// The loaded area is clipped by the image boundaries
+					int ex0 = (std::max)(x0 - steps, 0), ex1 = (std::min)(x1 + steps, width);
+					int ey0 = (std::max)(y0 - steps, 0), ey1 = (std::min)(y1 + steps, height);
+					int lw = ex1 - ex0, lh = ey1 - ey0;
+
+					for (int j = 0; j < lh; j++)
+						memcpy(buf0.pixeladdr(1, j + 1), cur.pixeladdr(ex0, ey0 + j), lw * sizeof(float));
+
+					ImageFloat *a = &buf0, *b = &buf1;
+
+					for (int s = 1; s <= steps; s++)
+					{
+						// The image boundaries are replicated into the padding as GetSafe does,
+						// the valid area shrinks by one pixel per step at the inner boundaries
+						if (ex0 == 0)
+							for (int j = 1; j <= lh; j++)
+								a->pixel(0, j) = a->pixel(1, j);
+
+						if (ex1 == width)
+							for (int j = 1; j <= lh; j++)
+								a->pixel(lw + 1, j) = a->pixel(lw, j);
+
+						if (ey0 == 0)
+							memcpy(a->pixeladdr(0, 0), a->pixeladdr(0, 1), (lw + 2) * sizeof(float));
+
+						if (ey1 == height)
+							memcpy(a->pixeladdr(0, lh + 1), a->pixeladdr(0, lh), (lw + 2) * sizeof(float));
+
+						int cx0 = (ex0 == 0) ? 0 : s, cx1 = (ex1 == width) ? lw : lw - s;
+						int cy0 = (ey0 == 0) ? 0 : s, cy1 = (ey1 == height) ? lh : lh - s;
+
+						for (int j = cy0; j < cy1; j++)
+						{
+							internal::DiffusionRow<Coefficient>(a->pixeladdr(cx0 + 1, j), a->pixeladdr(cx0 + 1, j + 1), a->pixeladdr(cx0 + 1, j + 2),
+								b->pixeladdr(cx0 + 1, j + 1), cx1 - cx0, dt, inv_k);
+						}
+
+						std::swap(a, b);
+					}
+
+					for (int j = y0; j < y1; j++)
+						memcpy(to.pixeladdr(x0, j), a->pixeladdr(x0 - ex0 + 1, j - ey0 + 1), (x1 - x0) * sizeof(float));
+				}
+			});
+
+			from = &to;
+		}
 	}
 
-	void Diffusion::IteratePeronaMalikExponentSafe(int x, int y)
+	Diffusion::Diffusion(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k)
+		: src(src), dst(dst), dt(dt), k(k) {}
+
+	template <class Coefficient>
+	void Diffusion::IterateSafe(int x, int y)
 	{
-		float grad = CalcGradientSafe(x, y);
-		float q = ExponentCoefficient(grad, k);
+		float q = CalcGradientSafe(x, y) / k;
 		float laplas = CalcLaplasSafe(x, y);
-		dst(x, y) = src(x, y) + dt * q * laplas;
+		dst(x, y) = src(x, y) + dt * Coefficient::Calc(q * q) * laplas;
 	}
 
-
 	float Diffusion::GetSafe(int x, int y)
 	{
 		auto x0 = (std::max)(0, (std::min)(src.Width() - 1, x));
@@ -220,4 +318,4 @@ namespace ip
 
 		return p - src(x, y) * LQ2;
 	}
-}
\ No newline at end of file
+}
@@ -1,6 +1,12 @@
 #include "../../iplib/image/resampling/edresampling.h"
+#include "../../iplib/image/io/imageio.h"
+#include "../../iplib/image/filter.h"
 
+#include <immintrin.h>
 #include <math.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 namespace ip
 {
@@ -127,6 +133,190 @@ namespace ip
 		return kernels;
 	}
 
+	std::vector<EDResamplingExt::SkippedImage> EDResamplingExt::Learn(const std::vector<std::wstring>& hr_files, const std::vector<std::wstring>& lr_files, int io_threads, int prefetch)
+	{
+		check(hr_files.size() == lr_files.size());
+		check(io_threads > 0 && prefetch > 0);
+
+		std::vector<SkippedImage> skipped;
+
+		LearnPass(hr_files, lr_files, io_threads, prefetch, false, &skipped);
+		UpdateCoefficientsStep1();
+
+		// The second pass skips the same images
+		LearnPass(hr_files, lr_files, io_threads, prefetch, true, nullptr);
+		UpdateCoefficientsStep2();
+
+		return skipped;
+	}
+
+	void EDResamplingExt::LearnPass(const std::vector<std::wstring>& hr_files, const std::vector<std::wstring>& lr_files, int io_threads, int prefetch, bool step2,
+		std::vector<SkippedImage> *skipped)
+	{
+		struct LoadedPair
+		{
+			ImageFloatColor hr, lr;
+		};
+
+		size_t count = hr_files.size();
+		std::vector<std::unique_ptr<LoadedPair>> loaded(count);
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t next_load = 0, next_learn = 0;
+
+		// The decoding only, the filtering uses the worker threads and is done by the learning thread
+		auto loader = [&]()
+		{
+			for (;;)
+			{
+				size_t index;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [&] { return next_load >= count || next_load < next_learn + prefetch; });
+
+					if (next_load >= count)
+						return;
+
+					index = next_load++;
+				}
+
+				std::unique_ptr<LoadedPair> item(new LoadedPair);
+
+				ImageFloatColor hr = ImageIO::FromFile<PixelFloatRGBA>(hr_files[index].c_str());
+				item->hr.swap(hr);
+
+				if (!lr_files[index].empty())
+				{
+					ImageFloatColor lr = ImageIO::FromFile<PixelFloatRGBA>(lr_files[index].c_str());
+					item->lr.swap(lr);
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					loaded[index].swap(item);
+				}
+
+				cv.notify_all();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < io_threads; i++)
+			threads.emplace_back(loader);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			std::unique_ptr<LoadedPair> item;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&] { return loaded[i] != nullptr; });
+
+				item.swap(loaded[i]);
+				next_learn = i + 1;
+			}
+
+			cv.notify_all();
+
+			if (!item->hr || (!lr_files[i].empty() && !item->lr))
+			{
+				if (skipped != nullptr)
+					skipped->push_back({ lr_files[i].empty() || !item->hr ? hr_files[i] : lr_files[i], L"cannot be opened" });
+
+				continue;
+			}
+
+			if (!item->lr)
+			{
+				ImageFloatColor tmp(item->hr.Width(), item->hr.Height());
+				ImageFloatColor lr(item->hr.Width() / 2, item->hr.Height() / 2);
+
+				GaussFilter(item->hr, tmp, 0.7f);
+
+				Parallel::For(0, lr.Height(), [&lr, &tmp](int j)
+				{
+					for (int i = 0; i < lr.Width(); i++)
+						lr(i, j) = tmp(i * 2, j * 2);
+				});
+
+				item->lr.swap(lr);
+			}
+
+			if (item->lr.Width() * 2 > item->hr.Width() || item->lr.Height() * 2 > item->hr.Height())
+			{
+				if (skipped != nullptr)
+					skipped->push_back({ hr_files[i], L"is smaller than twice the low resolution image" });
+
+				continue;
+			}
+
+			if (step2)
+				LearnStep2(item->lr, item->hr);
+			else
+				LearnStep1(item->lr, item->hr);
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	// ========================================================================================================
+
+	EDResampling::LearnerShard::LearnerShard(const int * lengths, int count)
+		: opt(count), lengths(lengths, lengths + count) {}
+
+	void EDResampling::LearnerShard::Add(int index, const float * q, float v)
+	{
+		opt[index].AddData(q, lengths[index], v);
+	}
+
+	void EDResampling::LearnerShard::Merge(const LearnerShard & other)
+	{
+		dbgcheck(opt.size() == other.opt.size());
+
+		for (size_t k = 0; k < opt.size(); k++)
+			opt[k].Merge(other.opt[k]);
+	}
+
+	const QuadraticOptimization & EDResampling::LearnerShard::Result(int index) const
+	{
+		return opt[index];
+	}
+
+	void EDResampling::LearnSharded(QuadraticOptimization * const * opt, const int * lengths, int count, int begin, int end, std::function<void(int y, LearnerShard &shard)> func)
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<LearnerShard>> shards;
+
+		Parallel::For([&](std::atomic_int &counter)
+		{
+			std::unique_ptr<LearnerShard> shard(new LearnerShard(lengths, count));
+
+			for (int y = counter++; y < end; y = counter++)
+				func(y, *shard);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			shards.push_back(std::move(shard));
+		}, begin);
+
+		// Tree reduction, the pairs of every level are merged in parallel
+		for (size_t step = 1; step < shards.size(); step *= 2)
+		{
+			Parallel::For(0, (int)((shards.size() + step * 2 - 1) / (step * 2)), [&shards, step](int k)
+			{
+				size_t a = k * step * 2, b = a + step;
+
+				if (b < shards.size())
+					shards[a]->Merge(*shards[b]);
+			});
+		}
+
+		for (int k = 0; k < count; k++)
+			opt[k]->Merge(shards[0]->Result(k));
+	}
+
 	// ========================================================================================================
 
 	EDResampling::WeightCalculator::WeightCalculator(bool fast, int Width, int Height)
@@ -136,4 +326,296 @@ namespace ip
 	{
 		return data(x, y);
 	}
-}
\ No newline at end of file
+
+	// ========================================================================================================
+
+	void EDResampling::StoreColor(PixelFloatRGBA & p, float r, float g, float b, float a)
+	{
+		p = PixelFloatRGBA(r, g, b, a);
+	}
+
+	void EDResampling::StoreColor(PixelByteRGBA & p, float r, float g, float b, float a)
+	{
+		p = PixelByteRGBA(f2b(r), f2b(g), f2b(b), f2b(a));
+	}
+
+	// ========================================================================================================
+
+	EDResampling::ColorResampler::ColorResampler(EDResampling::Kernels kernels, bool fast, int Width, int Height)
+		: kernels(kernels), weights(fast, Width * 2, Height * 2), width(Width), height(Height), luma(Width * 2, Height * 2)
+	{
+		check(Width >= MinSize && Height >= MinSize);
+
+		for (int c = 0; c < Channels; c++)
+			Allocate(source[c]);
+
+		for (int p = 0; p < 4; p++)
+			for (int c = 0; c < Channels - 1; c++)
+				Allocate(phases[p][c]);
+	}
+
+	void EDResampling::ColorResampler::Allocate(Image<float>& plane)
+	{
+		// The rows are rounded up to the whole AVX vectors, so the last vector of the row needs no tail processing
+		Image<float> tmp(((width + 7) & ~7) + Padding * 2, height + Border * 2);
+		plane.swap(tmp);
+	}
+
+	float * EDResampling::ColorResampler::Row(const Image<float>& plane, int y) const
+	{
+		return (float*)plane.pixeladdr(Padding, Border + y);
+	}
+
+	float * EDResampling::ColorResampler::SourceRow(int channel, int y)
+	{
+		return Row(source[channel], y);
+	}
+
+	const float * EDResampling::ColorResampler::DestinationRow(int phase, int channel, int y) const
+	{
+		return Row(phases[phase][channel - 1], y);
+	}
+
+	// Fill the padding with the mirrored pixels. The plane holds every second pixel of the mirrored image, so the edge pixel
+	// is duplicated on the side where the mirror axis lies between two pixels of the plane
+	void EDResampling::ColorResampler::Mirror(Image<float>& plane, bool dup_low, bool dup_high)
+	{
+		auto index = [dup_low, dup_high](int x, int n)
+		{
+			if (x < 0)
+				x = dup_low ? -1 - x : -x;
+
+			if (x >= n)
+				x = dup_high ? 2 * n - 1 - x : 2 * n - 2 - x;
+
+			return x < 0 ? 0 : (x >= n ? n - 1 : x);
+		};
+
+		int pw = plane.Width() - Padding;
+
+		for (int y = -Border; y < height + Border; y++)
+		{
+			float* row = Row(plane, y);
+			const float* src = Row(plane, index(y, height));
+
+			if (src != row)
+			{
+				for (int x = 0; x < width; x++)
+					row[x] = src[x];
+			}
+
+			for (int x = -Padding; x < 0; x++)
+				row[x] = row[index(x, width)];
+
+			for (int x = width; x < pw; x++)
+				row[x] = row[index(x, width)];
+		}
+	}
+
+	void EDResampling::ColorResampler::SetKernels(EDResampling::Mode mode)
+	{
+		static const int swap[6] = { 3, 2, 1, 0, 5, 4 };
+
+		for (int k = 0; k < 6; k++)
+		{
+			step1[0][k] = kernels.kernel1[k];
+			step1[1][k] = kernels.kernel1[swap[k]];
+		}
+
+		// Phase 0 is the even output rows, phase 1 is the odd output rows
+		for (int k = 0; k < 6; k++)
+		{
+			switch (mode)
+			{
+			case EDResampling::Mode::Isotropic:
+				step2[0][0][k] = step2[1][0][k] = kernels.kernel2[k];
+				step2[0][1][k] = step2[1][1][k] = kernels.kernel2[swap[k]];
+				break;
+
+			case EDResampling::Mode::Anisotropic:
+				step2[0][0][k] = kernels.kernel2a[k];
+				step2[0][1][k] = kernels.kernel2a[k + 6];
+				step2[1][0][k] = kernels.kernel2b[k];
+				step2[1][1][k] = kernels.kernel2b[k + 6];
+				break;
+
+			case EDResampling::Mode::Anisoptropic2:
+				step2[0][0][k] = kernels.kernel2c[k];
+				step2[0][1][k] = kernels.kernel2c[k + 6];
+				step2[1][0][k] = kernels.kernel2c[swap[k] + 6];
+				step2[1][1][k] = kernels.kernel2c[swap[k]];
+				break;
+			}
+		}
+	}
+
+	void EDResampling::ColorResampler::Perform(EDResampling::Mode mode)
+	{
+		SetKernels(mode);
+
+		for (int c = 0; c < Channels; c++)
+			Mirror(source[c], false, false);
+
+		CustomBitmapImage<float> src_luma;
+		src_luma.Init(SourceRow(0, 0), width, height, source[0].Data().stride);
+		weights.CalcStep1(src_luma);
+
+		Parallel::For(0, height, [this](int j)
+		{
+			PerformStep01(j);
+		});
+
+		for (int c = 0; c < Channels - 1; c++)
+		{
+			Mirror(phases[0][c], false, true);
+			Mirror(phases[3][c], true, false);
+		}
+
+		weights.CalcStep2(luma);
+
+		Parallel::For(0, height, [this](int j)
+		{
+			PerformStep2(j);
+		});
+	}
+
+	// Weighted kernel of step 1 or step 2 for eight output pixels
+	static inline void EDRMixKernels(const float* w, const float kernel[2][6], __m256 e[6])
+	{
+		__m256 w0 = _mm256_load_ps(w);
+		__m256 w1 = _mm256_sub_ps(_mm256_set1_ps(1.0f), w0);
+
+		for (int k = 0; k < 6; k++)
+			e[k] = _mm256_add_ps(_mm256_mul_ps(w0, _mm256_broadcast_ss(kernel[0] + k)), _mm256_mul_ps(w1, _mm256_broadcast_ss(kernel[1] + k)));
+	}
+
+	static inline __m256 EDRApplyKernel(const __m256 d[6], const __m256 e[6])
+	{
+		__m256 res = _mm256_mul_ps(d[0], e[0]);
+
+		for (int k = 1; k < 6; k++)
+			res = _mm256_add_ps(res, _mm256_mul_ps(d[k], e[k]));
+
+		return res;
+	}
+
+	void EDResampling::ColorResampler::PerformStep01(int j)
+	{
+		__m256 e0[6], e1[6], d[6];
+		alignas(32) float w[8], l[8];
+
+		for (int k = 0; k < 6; k++)
+			e0[k] = _mm256_broadcast_ss(kernels.kernel0 + k);
+
+		for (int i0 = 0; i0 < width; i0 += 8)
+		{
+			int count = width - i0 < 8 ? width - i0 : 8;
+
+			for (int k = 0; k < 8; k++)
+				w[k] = k < count ? weights.get((i0 + k) * 2 + 1, j * 2 + 1) : 0.0f;
+
+			EDRMixKernels(w, step1, e1);
+
+			for (int c = 0; c < Channels; c++)
+			{
+				const float* r[5];
+				for (int dy = -2; dy <= 2; dy++)
+					r[dy + 2] = SourceRow(c, j + dy) + i0;
+
+				auto t = [&r](int dx, int dy) { return _mm256_loadu_ps(r[dy + 2] + dx); };
+
+				// Step 0: the pixel (2i, 2j)
+				d[0] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(-2, -2), t(2, -2)), t(-2, 2)), t(2, 2));
+				d[1] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					t(-1, -2), t(1, -2)), t(-2, -1)), t(2, -1)), t(-2, 1)), t(2, 1)), t(-1, 2)), t(1, 2));
+				d[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(0, -2), t(-2, 0)), t(2, 0)), t(0, 2));
+				d[3] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(-1, -1), t(1, -1)), t(-1, 1)), t(1, 1));
+				d[4] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(0, -1), t(-1, 0)), t(1, 0)), t(0, 1));
+				d[5] = t(0, 0);
+
+				__m256 v0 = EDRApplyKernel(d, e0);
+
+				// Step 1: the pixel (2i + 1, 2j + 1)
+				d[0] = _mm256_add_ps(t(-1, -1), t(2, 2));
+				d[1] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(0, -1), t(-1, 0)), t(2, 1)), t(1, 2));
+				d[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(t(1, -1), t(-1, 1)), t(2, 0)), t(0, 2));
+				d[3] = _mm256_add_ps(t(2, -1), t(-1, 2));
+				d[4] = _mm256_add_ps(t(0, 0), t(1, 1));
+				d[5] = _mm256_add_ps(t(1, 0), t(0, 1));
+
+				__m256 v1 = EDRApplyKernel(d, e1);
+
+				if (c == 0)
+				{
+					// Only the interleaved luma is needed for the step 2 weights
+					_mm256_store_ps(l, v0);
+					for (int k = 0; k < count; k++)
+						luma((i0 + k) * 2, j * 2) = l[k];
+
+					_mm256_store_ps(l, v1);
+					for (int k = 0; k < count; k++)
+						luma((i0 + k) * 2 + 1, j * 2 + 1) = l[k];
+				}
+				else
+				{
+					_mm256_storeu_ps(Row(phases[0][c - 1], j) + i0, v0);
+					_mm256_storeu_ps(Row(phases[3][c - 1], j) + i0, v1);
+				}
+			}
+		}
+	}
+
+	void EDResampling::ColorResampler::PerformStep2(int j)
+	{
+		__m256 e[2][6], d[6];
+		alignas(32) float w[2][8];
+
+		for (int i0 = 0; i0 < width; i0 += 8)
+		{
+			int count = width - i0 < 8 ? width - i0 : 8;
+
+			for (int k = 0; k < 8; k++)
+			{
+				w[0][k] = k < count ? weights.get((i0 + k) * 2 + 1, j * 2) : 0.0f;
+				w[1][k] = k < count ? weights.get((i0 + k) * 2, j * 2 + 1) : 0.0f;
+			}
+
+			EDRMixKernels(w[0], step2[0], e[0]);
+			EDRMixKernels(w[1], step2[1], e[1]);
+
+			for (int c = 0; c < Channels - 1; c++)
+			{
+				// a - the pixels (2i, 2j), b - the pixels (2i + 1, 2j + 1)
+				const float *ra[5], *rb[5];
+				for (int dy = -2; dy <= 2; dy++)
+				{
+					ra[dy + 2] = Row(phases[0][c], j + dy) + i0;
+					rb[dy + 2] = Row(phases[3][c], j + dy) + i0;
+				}
+
+				auto a = [&ra](int dx, int dy) { return _mm256_loadu_ps(ra[dy + 2] + dx); };
+				auto b = [&rb](int dx, int dy) { return _mm256_loadu_ps(rb[dy + 2] + dx); };
+
+				// The pixel (2i + 1, 2j)
+				d[0] = _mm256_add_ps(b(0, -2), b(0, 1));
+				d[1] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(a(0, -1), a(1, -1)), a(0, 1)), a(1, 1));
+				d[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(b(-1, -1), b(1, -1)), b(-1, 0)), b(1, 0));
+				d[3] = _mm256_add_ps(a(-1, 0), a(2, 0));
+				d[4] = _mm256_add_ps(b(0, -1), b(0, 0));
+				d[5] = _mm256_add_ps(a(0, 0), a(1, 0));
+
+				_mm256_storeu_ps(Row(phases[1][c], j) + i0, EDRApplyKernel(d, e[0]));
+
+				// The pixel (2i, 2j + 1)
+				d[0] = _mm256_add_ps(a(0, -1), a(0, 2));
+				d[1] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(b(-1, -1), b(0, -1)), b(-1, 1)), b(0, 1));
+				d[2] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(a(-1, 0), a(1, 0)), a(-1, 1)), a(1, 1));
+				d[3] = _mm256_add_ps(b(-2, 0), b(1, 0));
+				d[4] = _mm256_add_ps(a(0, 0), a(0, 1));
+				d[5] = _mm256_add_ps(b(-1, 0), b(0, 0));
+
+				_mm256_storeu_ps(Row(phases[2][c], j) + i0, EDRApplyKernel(d, e[1]));
+			}
+		}
+	}
+}
@@ -120,6 +120,11 @@ namespace ip
 		});
 	}
 
+	int Filter::GaussHalo(float sigma)
+	{
+		return (int)ceilf(3.0f * sigma);
+	}
+
 	void Filter::Gauss(const ip::ImageFloat& src, ip::ImageFloat& dst, float sigma)
 	{
 		ImageFloat tmp(src.Width(), src.Height());
@@ -128,7 +133,7 @@ namespace ip
 
 	void Filter::Gauss(const ip::ImageFloat& src, ip::ImageFloat& tmp, ip::ImageFloat& dst, float sigma)
 	{
-		int hsize = (int)ceilf(3.0f * sigma);
+		int hsize = GaussHalo(sigma);
 		std::vector<float> filter(hsize * 2 + 1);
 
 		filter[hsize] = 1.0f;
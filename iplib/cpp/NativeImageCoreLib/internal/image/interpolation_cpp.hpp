@@ -0,0 +1,238 @@
+#include "../../iplib/image/interpolation.h"
+#include <iplib/parallel.h>
+#include <immintrin.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace ip
+{
+	namespace internal
+	{
+		class RemapEngine
+		{
+		public:
+			RemapEngine(const ip::ImageFloat& src, Interp interp);
+
+			void Perform(const ip::ImageFloat& mapx, const ip::ImageFloat& mapy, ip::ImageFloat& dst) const;
+
+		private:
+			// Source padding, enough for a 8-float load starting 2 pixels to the left of the Lanczos3 window
+			static const int Padding = 8;
+			static const int Phases = 256;
+
+			/* The taps of a sample are consecutive in the rows of padded and read by unaligned loads, so no gathers are
+			* needed. For the near-identity maps the rows of a tile stay in the cache, so there is no separate row-cached path */
+			static const int TileWidth = 128;
+			static const int TileHeight = 32;
+
+			Interp interp;
+			int width, height;
+			ip::ImageFloat padded;
+
+			// Bicubic: 4 weights per phase, Lanczos3: 6 weights (padded to 8) per phase
+			std::vector<float> lut;
+
+			void Coordinates(float x, float y, int& ix, int& iy, float& tx, float& ty) const;
+			void RowBilinear(const float* mx, const float* my, float* out, int count) const;
+			void RowBicubic(const float* mx, const float* my, float* out, int count) const;
+			void RowLanczos3(const float* mx, const float* my, float* out, int count) const;
+		};
+
+		static inline float HorizontalSum(__m128 v)
+		{
+			v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+			return _mm_cvtss_f32(v);
+		}
+
+		static inline float LanczosKernel(float x)
+		{
+			if (fabsf(x) < 1e-6f)
+				return 1.0f;
+
+			if (fabsf(x) >= 3.0f)
+				return 0.0f;
+
+			const float pi = 3.14159265358979f;
+			return 3.0f * sinf(pi * x) * sinf(pi * x / 3.0f) / (pi * pi * x * x);
+		}
+
+		RemapEngine::RemapEngine(const ip::ImageFloat& src, Interp interp)
+			: interp(interp), width(src.Width()), height(src.Height()), padded(src.Width() + 2 * Padding, src.Height() + 2 * Padding)
+		{
+			// The border pixels are replicated, so the inner loop has no bounds checks
+			ip::Parallel::For(0, padded.Height(), [this, &src](int y)
+			{
+				const float* s = src.pixeladdr(0, (std::min)((std::max)(y - Padding, 0), height - 1));
+				float* d = padded.pixeladdr(0, y);
+
+				for (int x = 0; x < Padding; x++)
+				{
+					d[x] = s[0];
+					d[Padding + width + x] = s[width - 1];
+				}
+
+				memcpy(d + Padding, s, width * sizeof(float));
+			});
+
+			if (interp == Interp::Bicubic)
+			{
+				lut.resize((Phases + 1) * 4);
+
+				for (int p = 0; p <= Phases; p++)
+				{
+					float x = (float)p / Phases, x2 = x * x, x3 = x2 * x;
+					float* w = &lut[p * 4];
+
+					w[0] = 0.5f * (-x + 2.0f * x2 - x3);
+					w[1] = 0.5f * (2.0f - 5.0f * x2 + 3.0f * x3);
+					w[2] = 0.5f * (x + 4.0f * x2 - 3.0f * x3);
+					w[3] = 0.5f * (x3 - x2);
+				}
+			}
+			else if (interp == Interp::Lanczos3)
+			{
+				lut.resize((Phases + 1) * 8);
+
+				for (int p = 0; p <= Phases; p++)
+				{
+					float x = (float)p / Phases, sum = 0.0f;
+					float* w = &lut[p * 8];
+
+					for (int k = 0; k < 6; k++)
+						sum += w[k] = LanczosKernel(x + 2 - k);
+
+					for (int k = 0; k < 6; k++)
+						w[k] /= sum;
+
+					w[6] = w[7] = 0.0f;
+				}
+			}
+		}
+
+		void RemapEngine::Perform(const ip::ImageFloat& mapx, const ip::ImageFloat& mapy, ip::ImageFloat& dst) const
+		{
+			int tiles_x = (dst.Width() + TileWidth - 1) / TileWidth;
+			int tiles_y = (dst.Height() + TileHeight - 1) / TileHeight;
+
+			ip::Parallel::For([this, &mapx, &mapy, &dst, tiles_x, tiles_y](std::atomic_int& counter)
+			{
+				for (int t = counter++; t < tiles_x * tiles_y; t = counter++)
+				{
+					int x0 = (t % tiles_x) * TileWidth, x1 = (std::min)(x0 + TileWidth, dst.Width());
+					int y0 = (t / tiles_x) * TileHeight, y1 = (std::min)(y0 + TileHeight, dst.Height());
+
+					for (int y = y0; y < y1; y++)
+					{
+						const float* mx = mapx.pixeladdr(x0, y);
+						const float* my = mapy.pixeladdr(x0, y);
+						float* out = dst.pixeladdr(x0, y);
+
+						switch (interp)
+						{
+						case Interp::Bilinear:
+							RowBilinear(mx, my, out, x1 - x0);
+							break;
+
+						case Interp::Bicubic:
+							RowBicubic(mx, my, out, x1 - x0);
+							break;
+
+						case Interp::Lanczos3:
+							RowLanczos3(mx, my, out, x1 - x0);
+							break;
+						}
+					}
+				}
+			});
+		}
+
+		/* Clamp the coordinates and split them into the integer and the fractional parts. NaN fails both comparisons
+		* and goes to 0 */
+		inline void RemapEngine::Coordinates(float x, float y, int& ix, int& iy, float& tx, float& ty) const
+		{
+			x = x >= 0.0f ? (x <= (float)(width - 1) ? x : (float)(width - 1)) : 0.0f;
+			y = y >= 0.0f ? (y <= (float)(height - 1) ? y : (float)(height - 1)) : 0.0f;
+			ix = (int)x;
+			iy = (int)y;
+			tx = x - ix;
+			ty = y - iy;
+		}
+
+		void RemapEngine::RowBilinear(const float* mx, const float* my, float* out, int count) const
+		{
+			for (int i = 0; i < count; i++)
+			{
+				int ix, iy;
+				float tx, ty;
+				Coordinates(mx[i], my[i], ix, iy, tx, ty);
+
+				const float* r0 = padded.pixeladdr(Padding + ix, Padding + iy);
+				const float* r1 = padded.pixeladdr(Padding + ix, Padding + iy + 1);
+
+				float a = r0[0] + (r0[1] - r0[0]) * tx;
+				float b = r1[0] + (r1[1] - r1[0]) * tx;
+				out[i] = a + (b - a) * ty;
+			}
+		}
+
+		void RemapEngine::RowBicubic(const float* mx, const float* my, float* out, int count) const
+		{
+			for (int i = 0; i < count; i++)
+			{
+				int ix, iy;
+				float tx, ty;
+				Coordinates(mx[i], my[i], ix, iy, tx, ty);
+
+				__m128 wx = _mm_loadu_ps(&lut[(int)(tx * Phases + 0.5f) * 4]);
+				const float* wy = &lut[(int)(ty * Phases + 0.5f) * 4];
+
+				__m128 s = _mm_setzero_ps();
+
+				for (int k = 0; k < 4; k++)
+				{
+					__m128 v = _mm_loadu_ps(padded.pixeladdr(Padding + ix - 1, Padding + iy - 1 + k));
+					s = _mm_add_ps(s, _mm_mul_ps(v, _mm_set1_ps(wy[k])));
+				}
+
+				out[i] = HorizontalSum(_mm_mul_ps(s, wx));
+			}
+		}
+
+		void RemapEngine::RowLanczos3(const float* mx, const float* my, float* out, int count) const
+		{
+			for (int i = 0; i < count; i++)
+			{
+				int ix, iy;
+				float tx, ty;
+				Coordinates(mx[i], my[i], ix, iy, tx, ty);
+
+				__m256 wx = _mm256_loadu_ps(&lut[(int)(tx * Phases + 0.5f) * 8]);
+				const float* wy = &lut[(int)(ty * Phases + 0.5f) * 8];
+
+				__m256 s = _mm256_setzero_ps();
+
+				for (int k = 0; k < 6; k++)
+				{
+					__m256 v = _mm256_loadu_ps(padded.pixeladdr(Padding + ix - 2, Padding + iy - 2 + k));
+					s = _mm256_add_ps(s, _mm256_mul_ps(v, _mm256_broadcast_ss(wy + k)));
+				}
+
+				s = _mm256_mul_ps(s, wx);
+				out[i] = HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1)));
+			}
+		}
+	}
+
+	void Remap(const ImageFloat& src, const ImageFloat& mapx, const ImageFloat& mapy, ImageFloat& dst, Interp interp)
+	{
+		check(src.Width() > 0 && src.Height() > 0);
+		check(mapx.Width() == dst.Width() && mapx.Height() == dst.Height());
+		check(mapy.Width() == dst.Width() && mapy.Height() == dst.Height());
+
+		internal::RemapEngine engine(src, interp);
+		engine.Perform(mapx, mapy, dst);
+	}
+}
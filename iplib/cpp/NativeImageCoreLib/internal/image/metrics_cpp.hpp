@@ -2,97 +2,392 @@
 #include <immintrin.h>
 #include <iplib/parallel.h>
 #include <math.h>
-#include <iplib/image/filter/filter.hpp>
+#include <string.h>
+#include <algorithm>
+#include <vector>
 
 namespace ip
 {
-	float Metrics::PSNR(const ip::ImageFloat& img1, const ip::ImageFloat& img2)
+	namespace internal
 	{
-		double mse = ip::Parallel::For<double>(0, img1.Height(), [&img1, &img2](int y, double& state)
+		// Sums of the SSIM map and of its contrast-structure part
+		struct SSIMStats
+		{
+			double ssim = 0.0;
+			double cs = 0.0;
+		};
+
+		/* Fused SSIM. The five moment channels (x, y, x^2, y^2, xy) are blurred together: every source row is filtered
+		* horizontally once into a ring of 2 * hsize + 1 rows, then the vertical pass and the SSIM formula are evaluated
+		* for one output row at a time. The image is processed by bands of rows, each worker has its own buffers */
+		class FusedSSIM
 		{
+		public:
+			FusedSSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma);
+
+			// Calculate the SSIM map into 'map' (if not nullptr) and return the sums over the image
+			SSIMStats Run(ip::ImageFloat* map);
+
+		private:
+			static const int Channels = 5;
+			static const int BandHeight = 32;
+
+			const ip::ImageFloat& img1;
+			const ip::ImageFloat& img2;
+			std::vector<float> kernel;
+			int hsize, width, height, stride;
+
+			void FilterRow(int y, float* ring_row, float* line) const;
+			void CalcRow(int y, const float* ring, float* ssim, float* cs) const;
+		};
+
+		FusedSSIM::FusedSSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma)
+			: img1(img1), img2(img2)
+		{
+			check(img1.Width() == img2.Width() && img1.Height() == img2.Height());
+
+			hsize = (int)ceilf(3.0f * sigma);
+			kernel.resize(hsize * 2 + 1);
+
+			kernel[hsize] = 1.0f;
+
+			for (int i = 1; i <= hsize; i++)
+			{
+				kernel[hsize + i] = kernel[hsize - i] = expf(i * i / (-2.0f * sigma * sigma));
+			}
+
 			float sum = 0.0f;
+			for (int i = 0; i <= 2 * hsize; i++)
+				sum += kernel[i];
+
+			for (int i = 0; i <= 2 * hsize; i++)
+				kernel[i] /= sum;
+
+			width = img1.Width();
+			height = img1.Height();
+			stride = (width + 7) & ~7;
+		}
+
+		SSIMStats FusedSSIM::Run(ip::ImageFloat* map)
+		{
+			int ring_size = 2 * hsize + 1;
+			int line_size = stride + 2 * hsize + 8;
+			int bands = (height + BandHeight - 1) / BandHeight;
+
+			return ip::Parallel::For<SSIMStats>([this, map, ring_size, line_size, bands](std::atomic_int& counter)
+			{
+				SSIMStats stats;
+
+				std::vector<float> ring(ring_size * Channels * stride);
+				std::vector<float> line(Channels * line_size);
+				std::vector<float> ssim(stride), cs(stride);
+
+				for (int band = counter++; band < bands; band = counter++)
+				{
+					int y0 = band * BandHeight;
+					int y1 = (std::min)(y0 + BandHeight, height);
+
+					for (int j = y0 - hsize; j < y0 + hsize; j++)
+						FilterRow(j, &ring[((j + ring_size) % ring_size) * Channels * stride], line.data());
+
+					for (int y = y0; y < y1; y++)
+					{
+						int j = y + hsize;
+						FilterRow(j, &ring[(j % ring_size) * Channels * stride], line.data());
+
+						CalcRow(y, ring.data(), ssim.data(), cs.data());
 
-			for (int x = 0; x < img1.Width(); x++)
+						float sum_ssim = 0.0f, sum_cs = 0.0f;
+
+						for (int x = 0; x < width; x++)
+						{
+							sum_ssim += ssim[x];
+							sum_cs += cs[x];
+						}
+
+						stats.ssim += sum_ssim;
+						stats.cs += sum_cs;
+
+						if (map)
+							memcpy(map->pixeladdr(0, y), ssim.data(), width * sizeof(float));
+					}
+				}
+
+				return stats;
+			},
+			[](SSIMStats& x, const SSIMStats& y) { x.ssim += y.ssim; x.cs += y.cs; });
+		}
+
+		// Filter the row y (clamped by the image boundaries) of all five channels horizontally
+		void FusedSSIM::FilterRow(int y, float* ring_row, float* line) const
+		{
+			int line_size = stride + 2 * hsize + 8;
+			int yc = (std::min)((std::max)(y, 0), height - 1);
+
+			const float* a = img1.pixeladdr(0, yc);
+			const float* b = img2.pixeladdr(0, yc);
+
+			float* l1 = line;
+			float* l2 = l1 + line_size;
+			float* l11 = l2 + line_size;
+			float* l22 = l11 + line_size;
+			float* l12 = l22 + line_size;
+
+			for (int i = 0; i < line_size; i++)
 			{
-				float q = img1(x, y) - img2(x, y);
-				sum += q * q;
+				int x = (std::min)((std::max)(i - hsize, 0), width - 1);
+				float p = a[x], q = b[x];
+
+				l1[i] = p;
+				l2[i] = q;
+				l11[i] = p * p;
+				l22[i] = q * q;
+				l12[i] = p * q;
 			}
 
-			state += sum;
-		},
-		[](double& x, const double& y) { x += y; });
+			for (int x = 0; x < stride; x += 8)
+			{
+				__m256 s1 = _mm256_setzero_ps();
+				__m256 s2 = _mm256_setzero_ps();
+				__m256 s11 = _mm256_setzero_ps();
+				__m256 s22 = _mm256_setzero_ps();
+				__m256 s12 = _mm256_setzero_ps();
 
-		return (float)(10.0 * log10(255.0 * 255.0 * img1.Width() * img1.Height() / mse));
-	}
+				for (int k = 0; k <= 2 * hsize; k++)
+				{
+					__m256 w = _mm256_broadcast_ss(&kernel[k]);
+					s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(l1 + x + k), w));
+					s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_loadu_ps(l2 + x + k), w));
+					s11 = _mm256_add_ps(s11, _mm256_mul_ps(_mm256_loadu_ps(l11 + x + k), w));
+					s22 = _mm256_add_ps(s22, _mm256_mul_ps(_mm256_loadu_ps(l22 + x + k), w));
+					s12 = _mm256_add_ps(s12, _mm256_mul_ps(_mm256_loadu_ps(l12 + x + k), w));
+				}
 
-	static void Mul(const ip::ImageFloat& src1, const ip::ImageFloat &src2, ip::ImageFloat &dst)
-	{
-		ip::Parallel::For(0, src1.Height(), [&src1, &src2, &dst](int y)
+				_mm256_storeu_ps(ring_row + x, s1);
+				_mm256_storeu_ps(ring_row + stride + x, s2);
+				_mm256_storeu_ps(ring_row + 2 * stride + x, s11);
+				_mm256_storeu_ps(ring_row + 3 * stride + x, s22);
+				_mm256_storeu_ps(ring_row + 4 * stride + x, s12);
+			}
+		}
+
+		// Vertical pass over the ring and the SSIM formula for the output row y
+		void FusedSSIM::CalcRow(int y, const float* ring, float* ssim, float* cs) const
 		{
-			for (int x = 0; x < src1.Width(); x++)
+			int ring_size = 2 * hsize + 1;
+
+			float c1 = 0.01f * 255.0f;
+			float c2 = 0.03f * 255.0f;
+			c1 *= c1;
+			c2 *= c2;
+
+			__m256 vc1 = _mm256_set1_ps(c1);
+			__m256 vc2 = _mm256_set1_ps(c2);
+			__m256 two = _mm256_set1_ps(2.0f);
+
+			for (int x = 0; x < stride; x += 8)
 			{
-				dst(x, y) = src1(x, y) * src2(x, y);
+				__m256 m1 = _mm256_setzero_ps();
+				__m256 m2 = _mm256_setzero_ps();
+				__m256 e11 = _mm256_setzero_ps();
+				__m256 e22 = _mm256_setzero_ps();
+				__m256 e12 = _mm256_setzero_ps();
+
+				for (int k = 0; k <= 2 * hsize; k++)
+				{
+					const float* row = ring + ((y - hsize + k + ring_size) % ring_size) * Channels * stride + x;
+					__m256 w = _mm256_broadcast_ss(&kernel[k]);
+
+					m1 = _mm256_add_ps(m1, _mm256_mul_ps(_mm256_loadu_ps(row), w));
+					m2 = _mm256_add_ps(m2, _mm256_mul_ps(_mm256_loadu_ps(row + stride), w));
+					e11 = _mm256_add_ps(e11, _mm256_mul_ps(_mm256_loadu_ps(row + 2 * stride), w));
+					e22 = _mm256_add_ps(e22, _mm256_mul_ps(_mm256_loadu_ps(row + 3 * stride), w));
+					e12 = _mm256_add_ps(e12, _mm256_mul_ps(_mm256_loadu_ps(row + 4 * stride), w));
+				}
+
+				__m256 m11 = _mm256_mul_ps(m1, m1);
+				__m256 m22 = _mm256_mul_ps(m2, m2);
+				__m256 m12 = _mm256_mul_ps(m1, m2);
+
+				__m256 sigma11 = _mm256_sub_ps(e11, m11);
+				__m256 sigma22 = _mm256_sub_ps(e22, m22);
+				__m256 sigma12 = _mm256_sub_ps(e12, m12);
+
+				__m256 l = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(two, m12), vc1), _mm256_add_ps(_mm256_add_ps(m11, m22), vc1));
+				__m256 c = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(two, sigma12), vc2), _mm256_add_ps(_mm256_add_ps(sigma11, sigma22), vc2));
+
+				_mm256_storeu_ps(cs + x, c);
+				_mm256_storeu_ps(ssim + x, _mm256_mul_ps(l, c));
 			}
-		});
-	}
+		}
 
-	float Metrics::SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma)
-	{
-		ImageFloat tmp(img1.Width(), img2.Height());
-		SSIM(img1, img2, sigma, tmp);
+		// 2x downsampling by averaging of 2x2 blocks
+		static void Downsample(const ip::ImageFloat& src, ip::ImageFloat& dst)
+		{
+			ip::Parallel::For(0, dst.Height(), [&src, &dst](int y)
+			{
+				for (int x = 0; x < dst.Width(); x++)
+				{
+					dst(x, y) = 0.25f * (src(2 * x, 2 * y) + src(2 * x + 1, 2 * y) + src(2 * x, 2 * y + 1) + src(2 * x + 1, 2 * y + 1));
+				}
+			});
+		}
 
-		double aver = 0.0;
+		// Sums of the squared pixel differences and of the squared gradient differences
+		struct ErrorStats
+		{
+			double sqr = 0.0;
+			double grad = 0.0;
+		};
 
-		for (int j = 0; j < img1.Height(); j++)
-			for (int i = 0; i < img1.Width(); i++)
-				aver += tmp(i, j);
+		static ErrorStats CalcErrorStats(const ip::ImageFloat& img1, const ip::ImageFloat& img2)
+		{
+			check(img1.Width() == img2.Width() && img1.Height() == img2.Height());
 
-		return (float)aver / (img1.Width() * img1.Height());
-	}
+			return ip::Parallel::For<ErrorStats>(0, img1.Height(), [&img1, &img2](int y, ErrorStats& state)
+			{
+				int width = img1.Width();
+				int y0 = (std::max)(y - 1, 0), y1 = (std::min)(y + 1, img1.Height() - 1);
 
-	void Metrics::SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, ip::ImageFloat& dst)
-	{	
-		ImageFloat m1(img1.Width(), img1.Height());
-		Filter::Gauss(img1, m1, sigma);
+				const float *a = img1.pixeladdr(0, y), *a0 = img1.pixeladdr(0, y0), *a1 = img1.pixeladdr(0, y1);
+				const float *b = img2.pixeladdr(0, y), *b0 = img2.pixeladdr(0, y0), *b1 = img2.pixeladdr(0, y1);
+
+				float sqr = 0.0f, grad = 0.0f;
+
+				for (int x = 0; x < width; x++)
+				{
+					int xl = (std::max)(x - 1, 0), xr = (std::min)(x + 1, width - 1);
+
+					float q = a[x] - b[x];
+					float gx = (a[xr] - a[xl]) - (b[xr] - b[xl]);
+					float gy = (a1[x] - a0[x]) - (b1[x] - b0[x]);
+
+					sqr += q * q;
+					grad += 0.25f * (gx * gx + gy * gy);
+				}
+
+				state.sqr += sqr;
+				state.grad += grad;
+			},
+			[](ErrorStats& x, const ErrorStats& y) { x.sqr += y.sqr; x.grad += y.grad; });
+		}
+
+		// MS-SSIM with the statistics of the first scale already calculated
+		static float MultiScaleSSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, int scales, const SSIMStats& first)
+		{
+			static const float weights[] = { 0.0448f, 0.2856f, 0.3001f, 0.2363f, 0.1333f };
+
+			check(scales >= 1 && scales <= 5);
+
+			int window = 2 * (int)ceilf(3.0f * sigma) + 1;
+
+			while (scales > 1 && (std::min)(img1.Width(), img1.Height()) >> (scales - 1) < window)
+				scales--;
+
+			float weight_sum = 0.0f;
+			for (int i = 0; i < scales; i++)
+				weight_sum += weights[i];
+
+			ImageFloat cur1, cur2;
+			const ImageFloat* p1 = &img1;
+			const ImageFloat* p2 = &img2;
+
+			double result = 1.0;
+
+			for (int i = 0; i < scales; i++)
+			{
+				SSIMStats stats = first;
+
+				if (i > 0)
+				{
+					ImageFloat next1(p1->Width() / 2, p1->Height() / 2);
+					ImageFloat next2(p2->Width() / 2, p2->Height() / 2);
+					Downsample(*p1, next1);
+					Downsample(*p2, next2);
+
+					cur1.swap(next1);
+					cur2.swap(next2);
+					p1 = &cur1;
+					p2 = &cur2;
 
-		ImageFloat m2(img2.Width(), img2.Height());
-		Filter::Gauss(img2, m2, sigma);
+					FusedSSIM ssim(*p1, *p2, sigma);
+					stats = ssim.Run(nullptr);
+				}
 
-		ImageFloat tmp(img1.Width(), img1.Height());
-		Mul(img1, img1, tmp);
+				double count = (double)p1->Width() * p1->Height();
+				double value = (i == scales - 1) ? stats.ssim / count : stats.cs / count;
 
-		ImageFloat sigma11(img1.Width(), img1.Height());
-		Filter::Gauss(tmp, sigma11, sigma);
+				result *= pow((std::max)(value, 0.0), weights[i] / weight_sum);
+			}
+
+			return (float)result;
+		}
+
+		double SquaredError(const ip::ImageFloat& img1, const ip::ImageFloat& img2)
+		{
+			return ip::Parallel::For<double>(0, img1.Height(), [&img1, &img2](int y, double& state)
+			{
+				float sum = 0.0f;
+
+				for (int x = 0; x < img1.Width(); x++)
+				{
+					float q = img1(x, y) - img2(x, y);
+					sum += q * q;
+				}
+
+				state += sum;
+			},
+			[](double& x, const double& y) { x += y; });
+		}
+	}
+
+	float Metrics::PSNR(const ip::ImageFloat& img1, const ip::ImageFloat& img2)
+	{
+		double mse = internal::SquaredError(img1, img2);
+		return (float)(10.0 * log10(255.0 * 255.0 * img1.Width() * img1.Height() / mse));
+	}
 
-		for (int j = 0; j < img1.Height(); j++)
-			for (int i = 0; i < img1.Width(); i++)
-				sigma11(i, j) -= m1(i, j) * m1(i, j);
+	float Metrics::SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma)
+	{
+		internal::FusedSSIM ssim(img1, img2, sigma);
+		return (float)(ssim.Run(nullptr).ssim / ((double)img1.Width() * img1.Height()));
+	}
 
-		Mul(img1, img2, tmp);
+	void Metrics::SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, ip::ImageFloat& dst)
+	{
+		check(img1.Width() == dst.Width() && img1.Height() == dst.Height());
 
-		ImageFloat sigma12(img1.Width(), img1.Height());
-		Filter::Gauss(tmp, sigma12, sigma);
+		internal::FusedSSIM ssim(img1, img2, sigma);
+		ssim.Run(&dst);
+	}
 
-		for (int j = 0; j < img1.Height(); j++)
-			for (int i = 0; i < img1.Width(); i++)
-				sigma12(i, j) -= m1(i, j) * m2(i, j);
+	float Metrics::MSSSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, int scales)
+	{
+		internal::FusedSSIM ssim(img1, img2, sigma);
+		return internal::MultiScaleSSIM(img1, img2, sigma, scales, ssim.Run(nullptr));
+	}
 
-		Mul(img2, img2, tmp);
+	float Metrics::GradientError(const ip::ImageFloat& img1, const ip::ImageFloat& img2)
+	{
+		internal::ErrorStats stats = internal::CalcErrorStats(img1, img2);
+		return (float)sqrt(stats.grad / ((double)img1.Width() * img1.Height()));
+	}
 
-		ImageFloat sigma22(img1.Width(), img1.Height());
-		Filter::Gauss(tmp, sigma22, sigma);
+	float Metrics::PSNR(const ip::PlanarImage<float, 3>& img1, const ip::PlanarImage<float, 3>& img2)
+	{
+		double mse = 0.0;
+		for (int c = 0; c < 3; c++)
+			mse += internal::SquaredError(img1.Plane(c), img2.Plane(c));
 
-		for (int j = 0; j < img1.Height(); j++)
-			for (int i = 0; i < img1.Width(); i++)
-				sigma22(i, j) -= m2(i, j) * m2(i, j);
+		return (float)(10.0 * log10(255.0 * 255.0 * 3.0 * img1.Width() * img1.Height() / mse));
+	}
 
-		float c1 = 0.01f * 255.0f;
-		float c2 = 0.03f * 255.0f;
-		c1 *= c1;
-		c2 *= c2;
+	float Metrics::SSIM(const ip::PlanarImage<float, 3>& img1, const ip::PlanarImage<float, 3>& img2, float sigma)
+	{
+		float sum = 0.0f;
+		for (int c = 0; c < 3; c++)
+			sum += SSIM(img1.Plane(c), img2.Plane(c), sigma);
 
-		for (int j = 0; j < img1.Height(); j++)
-			for (int i = 0; i < img1.Width(); i++)
-				dst(i, j) = ((2.0f * m1(i, j) * m2(i, j) + c1) * (2.0f * sigma12(i, j) + c2) / ((m1(i, j) * m1(i, j) + m2(i, j) * m2(i, j) + c1) * (sigma11(i, j) + sigma22(i, j) + c2)));
+		return sum / 3.0f;
 	}
-}
\ No newline at end of file
+}
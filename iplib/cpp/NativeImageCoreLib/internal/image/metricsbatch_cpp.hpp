@@ -0,0 +1,266 @@
+#include "../../iplib/image/metrics/metricsbatch.h"
+#include "../../iplib/image/metrics/metrics.h"
+#include "../../iplib/image/io/imageio.h"
+#include "../../iplib/image/io/textio.h"
+#include <iplib/parallel.h>
+#include <math.h>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace ip
+{
+	namespace internal
+	{
+		// Extract the channel (0 - red, 1 - green, 2 - blue, -1 - luma) of the color image
+		static void ExtractChannel(const ip::ImageFloatColor& src, int channel, ip::ImageFloat& dst)
+		{
+			ip::Parallel::For(0, src.Height(), [&src, channel, &dst](int y)
+			{
+				for (int x = 0; x < src.Width(); x++)
+				{
+					PixelFloatRGBA p = src(x, y);
+
+					switch (channel)
+					{
+					case 0: dst(x, y) = p.r; break;
+					case 1: dst(x, y) = p.g; break;
+					case 2: dst(x, y) = p.b; break;
+					default: dst(x, y) = (float)p; break;
+					}
+				}
+			});
+		}
+
+		static const char* ChannelName(int channels, int channel)
+		{
+			static const char* names[] = { "R", "G", "B" };
+			return channels == 1 ? "Y" : names[channel];
+		}
+	}
+
+	MetricsBatch::MetricsBatch(int metrics, Channels channels, float sigma)
+		: metrics(metrics), channels(channels), sigma(sigma)
+	{
+		check((metrics & MetricAll) != 0);
+		check(sigma > 0.0f);
+	}
+
+	void MetricsBatch::AddPair(const std::wstring& reference, const std::wstring& candidate)
+	{
+		pairs.push_back(std::make_pair(reference, candidate));
+	}
+
+	size_t MetricsBatch::PairCount() const
+	{
+		return pairs.size();
+	}
+
+	std::vector<MetricsBatch::Result> MetricsBatch::Run(int io_threads, int prefetch) const
+	{
+		check(io_threads > 0 && prefetch > 0);
+
+		struct LoadedPair
+		{
+			ImageFloatColor reference, candidate;
+		};
+
+		size_t count = pairs.size();
+		std::vector<Result> results(count);
+		std::vector<std::unique_ptr<LoadedPair>> loaded(count);
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t next_load = 0, next_eval = 0;
+
+		auto loader = [&]()
+		{
+			for (;;)
+			{
+				size_t index;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [&] { return next_load >= count || next_load < next_eval + prefetch; });
+
+					if (next_load >= count)
+						return;
+
+					index = next_load++;
+				}
+
+				std::unique_ptr<LoadedPair> item(new LoadedPair{
+					ImageIO::FromFile<PixelFloatRGBA>(pairs[index].first.c_str()),
+					ImageIO::FromFile<PixelFloatRGBA>(pairs[index].second.c_str()) });
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					loaded[index].swap(item);
+				}
+
+				cv.notify_all();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < io_threads; i++)
+			threads.emplace_back(loader);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			std::unique_ptr<LoadedPair> item;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&] { return loaded[i] != nullptr; });
+
+				item.swap(loaded[i]);
+				next_eval = i + 1;
+			}
+
+			cv.notify_all();
+
+			results[i].reference = pairs[i].first;
+			results[i].candidate = pairs[i].second;
+			Evaluate(item->reference, item->candidate, results[i]);
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		return results;
+	}
+
+	void MetricsBatch::Evaluate(const ip::ImageFloatColor& reference, const ip::ImageFloatColor& candidate, Result& result) const
+	{
+		for (int c = 0; c < 3; c++)
+			for (int m = 0; m < MetricCount; m++)
+				result.values[c][m] = std::numeric_limits<float>::quiet_NaN();
+
+		result.channels = channels == Channels::Luma ? 1 : 3;
+		result.ok = reference && candidate && reference.Width() == candidate.Width() && reference.Height() == candidate.Height();
+		result.width = reference ? reference.Width() : 0;
+		result.height = reference ? reference.Height() : 0;
+
+		if (!result.ok)
+			return;
+
+		ImageFloat img1(reference.Width(), reference.Height());
+		ImageFloat img2(reference.Width(), reference.Height());
+		double pixels = (double)img1.Width() * img1.Height();
+
+		for (int c = 0; c < result.channels; c++)
+		{
+			internal::ExtractChannel(reference, result.channels == 1 ? -1 : c, img1);
+			internal::ExtractChannel(candidate, result.channels == 1 ? -1 : c, img2);
+
+			float* values = result.values[c];
+
+			// PSNR and the gradient error share one pass
+			if (metrics & (MetricPSNR | MetricGradientError))
+			{
+				internal::ErrorStats stats = internal::CalcErrorStats(img1, img2);
+
+				if (metrics & MetricPSNR)
+					values[0] = (float)(10.0 * log10(255.0 * 255.0 * pixels / stats.sqr));
+
+				if (metrics & MetricGradientError)
+					values[3] = (float)sqrt(stats.grad / pixels);
+			}
+
+			// The first scale of MS-SSIM is the same SSIM pass
+			if (metrics & (MetricSSIM | MetricMSSSIM))
+			{
+				internal::FusedSSIM ssim(img1, img2, sigma);
+				internal::SSIMStats stats = ssim.Run(nullptr);
+
+				if (metrics & MetricSSIM)
+					values[1] = (float)(stats.ssim / pixels);
+
+				if (metrics & MetricMSSSIM)
+					values[2] = internal::MultiScaleSSIM(img1, img2, sigma, 5, stats);
+			}
+		}
+	}
+
+	const char* MetricsBatch::MetricName(int index)
+	{
+		static const char* names[MetricCount] = { "psnr", "ssim", "msssim", "graderr" };
+		check(index >= 0 && index < MetricCount);
+		return names[index];
+	}
+
+	void MetricsBatch::WriteCSV(const std::vector<Result>& results, FILE* f)
+	{
+		fprintf(f, "reference,candidate,status,width,height,channel");
+		for (int m = 0; m < MetricCount; m++)
+			fprintf(f, ",%s", MetricName(m));
+		fprintf(f, "\n");
+
+		for (auto& r : results)
+		{
+			for (int c = 0; c < (r.ok ? r.channels : 1); c++)
+			{
+				WriteQuoted(r.reference, f, false);
+				fputc(',', f);
+				WriteQuoted(r.candidate, f, false);
+				fprintf(f, ",%s,%d,%d,%s", r.ok ? "ok" : "error", r.width, r.height, r.ok ? internal::ChannelName(r.channels, c) : "");
+
+				for (int m = 0; m < MetricCount; m++)
+				{
+					if (r.ok && !_isnan(r.values[c][m]))
+						fprintf(f, ",%.6f", r.values[c][m]);
+					else
+						fprintf(f, ",");
+				}
+
+				fprintf(f, "\n");
+			}
+		}
+	}
+
+	void MetricsBatch::WriteJSON(const std::vector<Result>& results, FILE* f)
+	{
+		fprintf(f, "[\n");
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			auto& r = results[i];
+
+			fprintf(f, "  { \"reference\": ");
+			WriteQuoted(r.reference, f, true);
+			fprintf(f, ", \"candidate\": ");
+			WriteQuoted(r.candidate, f, true);
+			fprintf(f, ", \"ok\": %s", r.ok ? "true" : "false");
+
+			if (r.ok)
+			{
+				fprintf(f, ", \"width\": %d, \"height\": %d, \"channels\": [", r.width, r.height);
+
+				for (int c = 0; c < r.channels; c++)
+				{
+					fprintf(f, "%s{ \"channel\": \"%s\"", c > 0 ? ", " : " ", internal::ChannelName(r.channels, c));
+
+					// JSON has no representation for NaN and infinity
+					for (int m = 0; m < MetricCount; m++)
+					{
+						if (_finite(r.values[c][m]))
+							fprintf(f, ", \"%s\": %.6f", MetricName(m), r.values[c][m]);
+						else if (!_isnan(r.values[c][m]))
+							fprintf(f, ", \"%s\": null", MetricName(m));
+					}
+
+					fprintf(f, " }");
+				}
+
+				fprintf(f, " ]");
+			}
+
+			fprintf(f, " }%s\n", i + 1 < results.size() ? "," : "");
+		}
+
+		fprintf(f, "]\n");
+	}
+}
@@ -0,0 +1,324 @@
+#include "../../iplib/image/analysis/structuretensoranalysis.h"
+#include "../../iplib/math/gauss_function.h"
+#include <iplib/parallel.h>
+#include <immintrin.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace ip
+{
+	namespace internal
+	{
+		/* Single-pass structure tensor pipeline. Every band of rows is processed with two rings of rows:
+		* the source rows filtered horizontally (derivative and Gaussian), and the tensor rows filtered horizontally.
+		* The tensor components are interleaved (A, B, C for every pixel), so one loop blurs all three of them */
+		class StructureTensorPipeline
+		{
+		public:
+			StructureTensorPipeline(const ip::ImageFloat& img, float der_sigma, float tensor_sigma, int wsize, StructureTensorAnalysis& res);
+
+			void Run();
+
+		private:
+			static const int BandHeight = 32;
+
+			const ip::ImageFloat& img;
+			StructureTensorAnalysis& res;
+
+			// Correlation kernels: dst(x) = sum(src(x + k - r) * filter[k])
+			std::vector<float> der_filter, n_filter, t_filter;
+			int rd, rt, width, height, stride;
+
+			int RingD() const { return 2 * rd + 1; }
+			int RingT() const { return 2 * rt + 1; }
+			size_t BufferSize() const;
+
+			void Process(int y0, int y1, float* buffer);
+			void FilterSourceRow(int y, float* ring_row, float* line) const;
+			void TensorRow(int y, const float* ring_d, float* ring_row, float* tmp) const;
+			void AnalyzeRow(int y, const float* ring_t, float* tmp);
+		};
+
+		static inline int RingIndex(int y, int size)
+		{
+			return ((y % size) + size) % size;
+		}
+
+		StructureTensorPipeline::StructureTensorPipeline(const ip::ImageFloat& img, float der_sigma, float tensor_sigma, int wsize, StructureTensorAnalysis& res)
+			: img(img), res(res)
+		{
+			check(wsize >= 2);
+
+			rd = wsize / 2;
+			rt = wsize / 2 - 1;
+			width = img.Width();
+			height = img.Height();
+			stride = (width + 7) & ~7;
+
+			GaussFunction gd(der_sigma);
+			GaussFunctionDerivative gd2(der_sigma);
+			GaussFunction gt(tensor_sigma);
+
+			der_filter.resize(2 * rd + 1);
+			n_filter.resize(2 * rd + 1);
+			t_filter.resize(2 * rt + 1);
+
+			float sn = 0.0f, sd = 0.0f, st = 0.0f;
+
+			for (int k = -rd; k <= rd; k++)
+			{
+				n_filter[k + rd] = gd((float)k);
+				der_filter[k + rd] = -gd2((float)k);
+				sn += n_filter[k + rd];
+				sd += k * der_filter[k + rd];
+			}
+
+			for (int k = -rt; k <= rt; k++)
+			{
+				t_filter[k + rt] = gt((float)k);
+				st += t_filter[k + rt];
+			}
+
+			// The derivative filter gives 1 on a unit ramp
+			for (int k = 0; k <= 2 * rd; k++)
+			{
+				n_filter[k] /= sn;
+				der_filter[k] /= sd;
+			}
+
+			for (int k = 0; k <= 2 * rt; k++)
+				t_filter[k] /= st;
+		}
+
+		size_t StructureTensorPipeline::BufferSize() const
+		{
+			return (size_t)RingD() * 2 * stride + (size_t)RingT() * 3 * stride + (stride + 2 * rd + 8) + (6 * stride + 6 * rt + 8);
+		}
+
+		void StructureTensorPipeline::Run()
+		{
+			int bands = (height + BandHeight - 1) / BandHeight;
+
+			ip::Parallel::For([this, bands](std::atomic_int& counter)
+			{
+				std::vector<float> buffer(BufferSize());
+
+				for (int band = counter++; band < bands; band = counter++)
+				{
+					int y0 = band * BandHeight;
+					Process(y0, (std::min)(y0 + BandHeight, height), buffer.data());
+				}
+			});
+		}
+
+		void StructureTensorPipeline::Process(int y0, int y1, float* buffer)
+		{
+			float* ring_d = buffer;
+			float* ring_t = ring_d + RingD() * 2 * stride;
+			float* line = ring_t + RingT() * 3 * stride;
+			float* tmp = line + stride + 2 * rd + 8;
+
+			// Tensor rows are clamped by the image boundaries, so are the source rows of every tensor row
+			int filled = (std::max)(y0 - rt, 0) - rd - 1;
+
+			for (int j = y0 - rt; j < y1 + rt; j++)
+			{
+				int jc = (std::min)((std::max)(j, 0), height - 1);
+
+				while (filled < jc + rd)
+				{
+					filled++;
+					FilterSourceRow(filled, ring_d + RingIndex(filled, RingD()) * 2 * stride, line);
+				}
+
+				TensorRow(jc, ring_d, ring_t + RingIndex(j, RingT()) * 3 * stride, tmp);
+
+				if (j - rt >= y0)
+					AnalyzeRow(j - rt, ring_t, tmp);
+			}
+		}
+
+		// Horizontal pass of Ix (derivative filter) and Iy (Gaussian filter) for the source row y
+		void StructureTensorPipeline::FilterSourceRow(int y, float* ring_row, float* line) const
+		{
+			const float* src = img.pixeladdr(0, (std::min)((std::max)(y, 0), height - 1));
+
+			for (int i = 0; i < stride + 2 * rd + 8; i++)
+				line[i] = src[(std::min)((std::max)(i - rd, 0), width - 1)];
+
+			for (int x = 0; x < stride; x += 8)
+			{
+				__m256 hx = _mm256_setzero_ps();
+				__m256 hn = _mm256_setzero_ps();
+
+				for (int k = 0; k <= 2 * rd; k++)
+				{
+					__m256 v = _mm256_loadu_ps(line + x + k);
+					hx = _mm256_add_ps(hx, _mm256_mul_ps(v, _mm256_broadcast_ss(&der_filter[k])));
+					hn = _mm256_add_ps(hn, _mm256_mul_ps(v, _mm256_broadcast_ss(&n_filter[k])));
+				}
+
+				_mm256_storeu_ps(ring_row + x, hx);
+				_mm256_storeu_ps(ring_row + stride + x, hn);
+			}
+		}
+
+		// Vertical pass of Ix and Iy, tensor components and their horizontal pass for the row y
+		void StructureTensorPipeline::TensorRow(int y, const float* ring_d, float* ring_row, float* tmp) const
+		{
+			float* abc = tmp;
+			float* tline = tmp + 3 * stride;
+
+			for (int x = 0; x < stride; x += 8)
+			{
+				__m256 ix = _mm256_setzero_ps();
+				__m256 iy = _mm256_setzero_ps();
+
+				for (int k = 0; k <= 2 * rd; k++)
+				{
+					const float* row = ring_d + RingIndex(y - rd + k, RingD()) * 2 * stride + x;
+					ix = _mm256_add_ps(ix, _mm256_mul_ps(_mm256_loadu_ps(row), _mm256_broadcast_ss(&n_filter[k])));
+					iy = _mm256_add_ps(iy, _mm256_mul_ps(_mm256_loadu_ps(row + stride), _mm256_broadcast_ss(&der_filter[k])));
+				}
+
+				_mm256_storeu_ps(abc + x, _mm256_mul_ps(ix, ix));
+				_mm256_storeu_ps(abc + stride + x, _mm256_mul_ps(iy, iy));
+				_mm256_storeu_ps(abc + 2 * stride + x, _mm256_mul_ps(ix, iy));
+			}
+
+			for (int p = 0; p < stride + 2 * rt; p++)
+			{
+				int x = (std::min)((std::max)(p - rt, 0), width - 1);
+				tline[3 * p] = abc[x];
+				tline[3 * p + 1] = abc[stride + x];
+				tline[3 * p + 2] = abc[2 * stride + x];
+			}
+
+			// The neighbour pixel is 3 floats away for every component
+			for (int i = 0; i < 3 * stride; i += 8)
+			{
+				__m256 s = _mm256_setzero_ps();
+
+				for (int k = 0; k <= 2 * rt; k++)
+					s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(tline + i + 3 * k), _mm256_broadcast_ss(&t_filter[k])));
+
+				_mm256_storeu_ps(ring_row + i, s);
+			}
+		}
+
+		// Vertical pass of the tensor and the eigen-analysis for the output row y
+		void StructureTensorPipeline::AnalyzeRow(int y, const float* ring_t, float* tmp)
+		{
+			float* v = tmp;
+			float* a = tmp + 3 * stride;
+			float* b = a + stride;
+			float* c = b + stride;
+
+			for (int i = 0; i < 3 * stride; i += 8)
+			{
+				__m256 s = _mm256_setzero_ps();
+
+				for (int k = 0; k <= 2 * rt; k++)
+					s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(ring_t + RingIndex(y - rt + k, RingT()) * 3 * stride + i), _mm256_broadcast_ss(&t_filter[k])));
+
+				_mm256_storeu_ps(v + i, s);
+			}
+
+			for (int x = 0; x < width; x++)
+			{
+				a[x] = v[3 * x];
+				b[x] = v[3 * x + 1];
+				c[x] = v[3 * x + 2];
+			}
+
+			float* l1 = res.lambda1.pixeladdr(0, y);
+			float* l2 = res.lambda2.pixeladdr(0, y);
+			float* dir = reinterpret_cast<float*>(res.dir.pixeladdr(0, y));
+
+			const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+			const __m256 half = _mm256_set1_ps(0.5f);
+			const __m256 four = _mm256_set1_ps(4.0f);
+			const __m256 eps = _mm256_set1_ps(1e-6f);
+
+			int x = 0;
+
+			for (; x <= width - 8; x += 8)
+			{
+				__m256 lxx = _mm256_loadu_ps(a + x);
+				__m256 lyy = _mm256_loadu_ps(b + x);
+				__m256 lxy = _mm256_loadu_ps(c + x);
+
+				__m256 q = _mm256_sub_ps(lxx, lyy);
+				__m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(q, q), _mm256_mul_ps(four, _mm256_mul_ps(lxy, lxy))));
+				__m256 t = _mm256_add_ps(lxx, lyy);
+				__m256 e1 = _mm256_mul_ps(_mm256_add_ps(t, d), half);
+				__m256 e2 = _mm256_mul_ps(_mm256_sub_ps(t, d), half);
+
+				_mm256_storeu_ps(l1 + x, e1);
+				_mm256_storeu_ps(l2 + x, e2);
+
+				// The eigenvalue with the smaller absolute value
+				__m256 lm = _mm256_blendv_ps(e2, e1, _mm256_cmp_ps(_mm256_and_ps(e1, absmask), _mm256_and_ps(e2, absmask), _CMP_LT_OQ));
+
+				__m256 sel = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(lxx, lm), absmask), _mm256_and_ps(_mm256_sub_ps(lyy, lm), absmask), _CMP_GT_OQ);
+				__m256 dx = _mm256_blendv_ps(_mm256_sub_ps(lm, lyy), lxy, sel);
+				__m256 dy = _mm256_blendv_ps(lxy, _mm256_sub_ps(lm, lxx), sel);
+
+				__m256 n = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+				__m256 valid = _mm256_cmp_ps(n, eps, _CMP_GT_OQ);
+				__m256 rn = _mm256_and_ps(_mm256_div_ps(_mm256_set1_ps(1.0f), n), valid);
+
+				dx = _mm256_mul_ps(dx, rn);
+				dy = _mm256_mul_ps(dy, rn);
+
+				// Interleave into (x, y) pairs
+				__m256 lo = _mm256_unpacklo_ps(dx, dy);
+				__m256 hi = _mm256_unpackhi_ps(dx, dy);
+				_mm256_storeu_ps(dir + 2 * x, _mm256_permute2f128_ps(lo, hi, 0x20));
+				_mm256_storeu_ps(dir + 2 * x + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+			}
+
+			for (; x < width; x++)
+			{
+				StructureTensorAnalysis::Analyze(a[x], c[x], b[x], l1[x], l2[x], res.dir(x, y));
+			}
+		}
+	}
+
+	StructureTensorAnalysis::StructureTensorAnalysis(const ImageFloat& img, float der_sigma, float tensor_sigma, int wsize)
+		: lambda1(img.Width(), img.Height()), lambda2(img.Width(), img.Height()), dir(img.Width(), img.Height())
+	{
+		internal::StructureTensorPipeline pipeline(img, der_sigma, tensor_sigma, wsize, *this);
+		pipeline.Run();
+	}
+
+	void StructureTensorAnalysis::Analyze(float lxx, float lxy, float lyy, float& l1, float& l2, PixelFloatVector& dir)
+	{
+		float d = sqrtf((lxx - lyy) * (lxx - lyy) + 4 * lxy * lxy);
+		l1 = (lxx + lyy + d) * 0.5f;
+		l2 = (lxx + lyy - d) * 0.5f;
+
+		float dx, dy;
+
+		float lmin = fabsf(l1) < fabsf(l2) ? l1 : l2;
+
+		if (fabsf(lxx - lmin) > fabsf(lyy - lmin))
+		{
+			dx = lxy;
+			dy = lmin - lxx;
+		}
+		else
+		{
+			dx = lmin - lyy;
+			dy = lxy;
+		}
+
+		d = sqrtf(dx * dx + dy * dy);
+
+		if (d > 1e-6f)
+			dir = PixelFloatVector(dx / d, dy / d);
+		else
+			dir = PixelFloatVector(0.0f, 0.0f);
+	}
+}
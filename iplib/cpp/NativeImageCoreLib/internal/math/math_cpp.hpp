@@ -3,6 +3,8 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <immintrin.h>
+#include <algorithm>
 
 namespace ip
 {
@@ -76,11 +78,198 @@ namespace ip
 	//                                   QuadraticOptimization               
 	// ==================================================================================================
 
+	void QuadraticOptimization::Init(int len)
+	{
+		A = Matrix<double>::Zero(len, len);
+		B = Matrix<double>::Zero(len, 1);
+
+		// len + 1 rows rounded up to the group of four rows processed by RankUpdate at once
+		block.assign(((len + 4) & ~3) * BlockSize, 0.0);
+		buffered = 0;
+	}
+
+	void QuadraticOptimization::Flush()
+	{
+		if (buffered == 0)
+			return;
+
+		RankUpdate(block.data(), A.NumColumns(), &A(0, 0), &B(0, 0));
+
+		// The unused columns of a partial block must be zero
+		std::fill(block.begin(), block.end(), 0.0);
+		buffered = 0;
+	}
+
+	void QuadraticOptimization::RankUpdate(const double * block, int len, double * a, double * b)
+	{
+		int rows = (len + 4) & ~3;
+		std::vector<double> sums(rows);
+
+		for (int j = 0; j < len; j++)
+		{
+			const double *qj = block + j * BlockSize;
+
+			// Dot products of the row j with the rows i..i + 3, the row len gives the right side
+			for (int i = j & ~3; i < rows; i += 4)
+			{
+				const double *qi = block + i * BlockSize;
+
+				__m256d s0 = _mm256_setzero_pd();
+				__m256d s1 = _mm256_setzero_pd();
+				__m256d s2 = _mm256_setzero_pd();
+				__m256d s3 = _mm256_setzero_pd();
+
+				for (int k = 0; k < BlockSize; k += 4)
+				{
+					__m256d x = _mm256_loadu_pd(qj + k);
+
+					s0 = _mm256_add_pd(s0, _mm256_mul_pd(x, _mm256_loadu_pd(qi + k)));
+					s1 = _mm256_add_pd(s1, _mm256_mul_pd(x, _mm256_loadu_pd(qi + BlockSize + k)));
+					s2 = _mm256_add_pd(s2, _mm256_mul_pd(x, _mm256_loadu_pd(qi + BlockSize * 2 + k)));
+					s3 = _mm256_add_pd(s3, _mm256_mul_pd(x, _mm256_loadu_pd(qi + BlockSize * 3 + k)));
+				}
+
+				__m256d h01 = _mm256_hadd_pd(s0, s1);
+				__m256d h23 = _mm256_hadd_pd(s2, s3);
+
+				_mm256_storeu_pd(&sums[i], _mm256_add_pd(_mm256_permute2f128_pd(h01, h23, 0x20), _mm256_permute2f128_pd(h01, h23, 0x31)));
+			}
+
+			for (int i = j; i < len; i++)
+				a[j * len + i] += sums[i];
+
+			b[j] += sums[len];
+		}
+	}
+
+	void QuadraticOptimization::Merge(const QuadraticOptimization & other)
+	{
+		if (!other.A)
+			return;
+
+		if (!A)
+			Init(other.A.NumColumns());
+
+		check(A.NumColumns() == other.A.NumColumns());
+
+		int len = A.NumColumns();
+
+		for (int j = 0; j < len; j++)
+		{
+			for (int i = j; i < len; i++)
+				A(j, i) += other.A(j, i);
+
+			B(j, 0) += other.B(j, 0);
+		}
+
+		if (other.buffered > 0)
+			RankUpdate(other.block.data(), len, &A(0, 0), &B(0, 0));
+
+		N += other.N;
+	}
+
+	void QuadraticOptimization::AddNormalEquations(const double * a, const double * b, int len, int count)
+	{
+		if (!A)
+			Init(len);
+
+		check(A.NumColumns() == len);
+
+		for (int j = 0; j < len; j++)
+		{
+			for (int i = j; i < len; i++)
+				A(j, i) += a[j * len + i];
+
+			B(j, 0) += b[j];
+		}
+
+		N += count;
+	}
+
+	bool QuadraticOptimization::Solve(std::vector<double>& x) const
+	{
+		if (!A)
+			return false;
+
+		int n = A.NumColumns();
+
+		std::vector<double> a(n * n), b(n);
+
+		for (int j = 0; j < n; j++)
+		{
+			for (int i = j; i < n; i++)
+				a[j * n + i] = A(j, i);
+
+			b[j] = B(j, 0);
+		}
+
+		// The buffered samples are added to the copy, so the solve does not change the state
+		if (buffered > 0)
+			RankUpdate(block.data(), n, a.data(), b.data());
+
+		double trace = 0.0;
+		for (int j = 0; j < n; j++)
+			trace += a[j * n + j];
+
+		double reg = lambda * trace / n;
+		double eps = 1e-14 * trace / n;
+
+		// LDL^T in place, the factor L is stored in the upper triangle (transposed)
+		for (int j = 0; j < n; j++)
+			a[j * n + j] += reg;
+
+		for (int j = 0; j < n; j++)
+		{
+			double d = a[j * n + j];
+
+			for (int k = 0; k < j; k++)
+				d -= a[k * n + j] * a[k * n + j] * a[k * n + k];
+
+			if (!(d > eps))
+				return false;
+
+			a[j * n + j] = d;
+
+			for (int i = j + 1; i < n; i++)
+			{
+				double s = a[j * n + i];
+
+				for (int k = 0; k < j; k++)
+					s -= a[k * n + i] * a[k * n + j] * a[k * n + k];
+
+				a[j * n + i] = s / d;
+			}
+		}
+
+		// L y = b, D z = y, L^T x = z
+		for (int j = 0; j < n; j++)
+			for (int k = 0; k < j; k++)
+				b[j] -= a[k * n + j] * b[k];
+
+		for (int j = 0; j < n; j++)
+			b[j] /= a[j * n + j];
+
+		for (int j = n - 1; j >= 0; j--)
+			for (int i = j + 1; i < n; i++)
+				b[j] -= a[j * n + i] * b[i];
+
+		x.swap(b);
+		return true;
+	}
+
+	void QuadraticOptimization::SetRegularization(double lambda)
+	{
+		check(lambda >= 0.0);
+		this->lambda = lambda;
+	}
+
 	void QuadraticOptimization::Reset()
 	{
 		A = Matrix<double>();
 		B = Matrix<double>();
 		N = 0;
+		block.clear();
+		buffered = 0;
 	}
 
 	int QuadraticOptimization::Count() const
@@ -92,4 +281,4 @@ namespace ip
 	{
 		return A.NumColumns();
 	}
-}
\ No newline at end of file
+}
@@ -39,9 +39,7 @@ namespace ip
 
 				img->CreateImage(image.Width(), image.Height(), sizeof(PixelType));
 
-				for (int j = 0; j < image.Height(); j++)
-					for (int i = 0; i < image.Width(); i++)
-						((Image<PixelType>*)img)->pixel(i, j) = image.pixel(i, j);
+				image.CopyTo(*(Image<PixelType>*)img);
 
 				images.push_back(img);
 				names.emplace_back(std::move(name));
@@ -2,48 +2,132 @@
 
 #include <iplib/image/core.h>
 #include <iplib/image/filter.h>
+#include <vector>
 
 namespace ip
 {
-	class Canny
-		: public ImageReadable<float, Canny>
+	/* StorageType is the pixel type of the derivatives and the gradient modulus: float, or PixelHalf to halve
+	* their memory. The filters accumulate in float either way, the suppressed result is float. The PixelHalf planes
+	* are converted by whole rows, never pixel by pixel, so CannyHalf saves memory at the cost of the conversions. Where
+	* the neighbouring magnitudes are within the half-precision rounding, the suppression may keep a different pixel of
+	* the edge than Canny does (see the half-canny check of Verification) */
+	template <typename StorageType>
+	class BasicCanny
+		: public ImageReadable<float, BasicCanny<StorageType>>
 	{
 	public:
 		template <typename PixelType, class ImageType>
-		Canny(const ImageReadable<PixelType, ImageType> &img, float sigma);
+		BasicCanny(const ImageReadable<PixelType, ImageType> &img, float sigma);
 
 		int Width() const;
 		int Height() const;
 		float pixel(int x, int y) const;
+		const float* row(int x, int y, int n, float *buf) const;
 
 		Image<PixelFloatVector> GetGradient() const;
 
+		// The derivative filters and the suppression window, the context ProcessRegion needs around a region
+		static int Halo(float sigma)
+		{
+			return (int)(sigma * 3.0f) + 1;
+		}
+
 	private:
-		Image<float> dx, dy, grad, nms, res;
+		Image<StorageType> dx, dy, grad;
+		Image<float> nms, res;
 
 		void NonMaximumSuppression();
 	};
 
+	typedef BasicCanny<float> Canny;
+	typedef BasicCanny<PixelHalf> CannyHalf;
+
+	namespace internal
+	{
+		// Row y of a plane as floats: the image memory of a float plane, converted into buf otherwise
+		template <typename StorageType>
+		const float* CannyReadRow(const Image<StorageType> &img, int y, float *buf)
+		{
+			ConvertRow(img.pixeladdr(0, y), buf, img.Width());
+			return buf;
+		}
+
+		inline const float* CannyReadRow(const Image<float> &img, int y, float *buf)
+		{
+			return img.pixeladdr(0, y);
+		}
+
+		// The row to write y of a plane to, CannyWriteRow stores it
+		template <typename StorageType>
+		float* CannyOutputRow(Image<StorageType> &img, int y, float *buf)
+		{
+			return buf;
+		}
+
+		inline float* CannyOutputRow(Image<float> &img, int y, float *buf)
+		{
+			return img.pixeladdr(0, y);
+		}
+
+		template <typename StorageType>
+		void CannyWriteRow(Image<StorageType> &img, int y, const float *row)
+		{
+			ConvertRow(row, img.pixeladdr(0, y), img.Width());
+		}
+
+		inline void CannyWriteRow(Image<float> &img, int y, const float *row)
+		{
+		}
+
+		// The derivative of a non-float plane is filtered into a float image and converted by rows
+		template <typename StorageType, class Filter>
+		void CannyDerivative(Image<StorageType> &dst, Filter filter)
+		{
+			Image<float> tmp(dst.Width(), dst.Height());
+			filter(tmp);
+			tmp.Convert<StorageType>().CopyTo(dst);
+		}
+
+		template <class Filter>
+		void CannyDerivative(Image<float> &dst, Filter filter)
+		{
+			filter(dst);
+		}
+	}
+
 	// ==================================================================================================
 
+	template <typename StorageType>
 	template <typename PixelType, class ImageType>
-	Canny::Canny(const ImageReadable<PixelType, ImageType> &img, float sigma)
+	BasicCanny<StorageType>::BasicCanny(const ImageReadable<PixelType, ImageType> &img, float sigma)
 		: dx(img.Width(), img.Height())
 		, dy(img.Width(), img.Height())
 		, grad(img.Width(), img.Height())
 		, nms(img.Width(), img.Height())
 		, res(img.Width(), img.Height())
 	{
-		DerivativeX(img, dx, sigma);
-		DerivativeY(img, dy, sigma);
+		internal::CannyDerivative(dx, [&img, sigma](Image<float> &dst) { DerivativeX(img, dst, sigma); });
+		internal::CannyDerivative(dy, [&img, sigma](Image<float> &dst) { DerivativeY(img, dst, sigma); });
+
+		int w = img.Width();
+		std::vector<float> buf(w * 3);
 
 		for (int j = 0; j < img.Height(); j++)
-			for (int i = 0; i < img.Width(); i++)
+		{
+			const float *vx = internal::CannyReadRow(dx, j, buf.data());
+			const float *vy = internal::CannyReadRow(dy, j, buf.data() + w);
+			float *g = internal::CannyOutputRow(grad, j, buf.data() + w * 2);
+			float *n = nms.pixeladdr(0, j);
+
+			for (int i = 0; i < w; i++)
 			{
-				grad(i, j) = sqrtf(dx(i, j) * dx(i, j) + dy(i, j) * dy(i, j));
-				nms(i, j) = 0.0f;
+				g[i] = sqrtf(vx[i] * vx[i] + vy[i] * vy[i]);
+				n[i] = 0.0f;
 			}
 
+			internal::CannyWriteRow(grad, j, g);
+		}
+
 		NonMaximumSuppression();
 
 		for (int j = 0; j < img.Height(); j++)
@@ -51,22 +135,32 @@ namespace ip
 				res(i, j) = nms(i, j);
 	}
 
-	int Canny::Width() const
+	template <typename StorageType>
+	int BasicCanny<StorageType>::Width() const
 	{
 		return res.Width();
 	}
 
-	int Canny::Height() const
+	template <typename StorageType>
+	int BasicCanny<StorageType>::Height() const
 	{
 		return res.Height();
 	}
 
-	float Canny::pixel(int x, int y) const
+	template <typename StorageType>
+	float BasicCanny<StorageType>::pixel(int x, int y) const
 	{
 		return res.pixel(x, y);
 	}
 
-	Image<PixelFloatVector> Canny::GetGradient() const
+	template <typename StorageType>
+	const float* BasicCanny<StorageType>::row(int x, int y, int n, float *buf) const
+	{
+		return res.pixeladdr(x, y);
+	}
+
+	template <typename StorageType>
+	Image<PixelFloatVector> BasicCanny<StorageType>::GetGradient() const
 	{
 		Image<PixelFloatVector> res(res.Width(), res.Height());
 
@@ -77,37 +171,48 @@ namespace ip
 		return res;
 	}
 
-	void Canny::NonMaximumSuppression()
+	template <typename StorageType>
+	void BasicCanny<StorageType>::NonMaximumSuppression()
 	{
+		int w = res.Width();
+		std::vector<float> buf(w * 5);
+
 		for (int j = 1; j < res.Height() - 1; j++)
 		{
-			for (int i = 1; i < res.Width() - 1; i++)
+			const float *g0 = internal::CannyReadRow(grad, j - 1, buf.data());
+			const float *g1 = internal::CannyReadRow(grad, j, buf.data() + w);
+			const float *g2 = internal::CannyReadRow(grad, j + 1, buf.data() + w * 2);
+			const float *dxr = internal::CannyReadRow(dx, j, buf.data() + w * 3);
+			const float *dyr = internal::CannyReadRow(dy, j, buf.data() + w * 4);
+			float *out = nms.pixeladdr(0, j);
+
+			for (int i = 1; i < w - 1; i++)
 			{
-				float gval = grad(i, j);
-				float vx = dx(i, j);
-				float vy = dy(i, j);
+				float gval = g1[i];
+				float vx = dxr[i];
+				float vy = dyr[i];
 
 				float tan = (vx == 0.0f ? 10000.0f : vy / vx);
 
 				if (tan > 2.5f || tan < -2.5f)
 				{
-					if (gval > grad(i, j - 1) && gval > grad(i, j + 1))
-						nms(i, j) = gval;
+					if (gval > g0[i] && gval > g2[i])
+						out[i] = gval;
 				}
 				else if (tan > 0.4f && tan <= 2.5f)
 				{
-					if (gval > grad(i - 1, j - 1) && gval > grad(i + 1, j + 1))
-						nms(i, j) = gval;
+					if (gval > g0[i - 1] && gval > g2[i + 1])
+						out[i] = gval;
 				}
 				else if (tan > -0.4f && tan <= 0.4f)
 				{
-					if (gval > grad(i - 1, j) && gval > grad(i + 1, j))
-						nms(i, j) = gval;
+					if (gval > g1[i - 1] && gval > g1[i + 1])
+						out[i] = gval;
 				}
 				else
 				{
-					if (gval > grad(i - 1, j + 1) && gval > grad(i + 1, j - 1))
-						nms(i, j) = gval;
+					if (gval > g2[i - 1] && gval > g0[i + 1])
+						out[i] = gval;
 				}
 			}
 		}
@@ -16,6 +16,7 @@
 #include "../../internal/core/bitmap/bitmapimage.h"
 #include "../../internal/core/bitmap/custombitmapimage.h"
 #include "../../internal/core/bitmap/image.h"
+#include "../../internal/core/bitmap/planarimage.h"
 
 #include "../../internal/core/ops/imagebinaryoperation.h"
 
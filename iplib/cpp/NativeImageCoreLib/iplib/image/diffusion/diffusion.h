@@ -7,21 +7,38 @@ namespace ip
 	class Diffusion
 	{
 	public:
+		enum class Mode { Division, Exponent };
+
 		static void PeronaMalikDivisionIteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k);
 		static void PeronaMalikExponentIteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k);
 
+		/* Perform the given number of Perona-Malik iterations. The image is processed by tiles, each tile is advanced
+		* by several time steps in a local buffer before it is written back (overlapped temporal tiling).
+		* The images src and dst must not share the same data */
+		static void Run(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k, int iterations, Mode mode = Mode::Division);
+
 	private:
 		const ip::ImageFloat& src;
 		ip::ImageFloat& dst;
 		float dt, k;
 
+		static const int TileWidth = 256;
+		static const int TileHeight = 64;
+		static const int TemporalBlock = 8;
+
 		Diffusion(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k);
 
-		void IteratePeronaMalikDivisionSafe(int x, int y);
-		void IteratePeronaMalikExponentSafe(int x, int y);
+		template <class Coefficient>
+		static void Iteration(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k);
+
+		template <class Coefficient>
+		static void RunTiled(const ip::ImageFloat& src, ip::ImageFloat& dst, float dt, float k, int iterations);
+
+		template <class Coefficient>
+		void IterateSafe(int x, int y);
 
 		float GetSafe(int x, int y);
 		float CalcGradientSafe(int x, int y);
 		float CalcLaplasSafe(int x, int y);
 	};
-}
\ No newline at end of file
+}
@@ -88,13 +88,16 @@ namespace ip
 
 		Image<int> tmp(src.Height(), src.Width());
 		StandardEDT step1(src.Width());
+		std::unique_ptr<bool[]> mask(new bool[src.Width()]);
 
 		// Parallel::For(0, src.Height(), [step1, &src, &tmp](int j) mutable
 		for (int j = 0; j < src.Height(); j++)
 		{
+			src.ReadRow(j, mask.get());
+
 			int* input = step1.GetInput();
 			for (int i = 0; i < src.Width(); i++)
-				input[i] = src(i, j) ? 0 : -1;
+				input[i] = mask[i] ? 0 : -1;
 
 			step1.ProcessFirst(input);
 
@@ -128,12 +131,15 @@ namespace ip
 		Parallel::For([&src, &tmp, &vref](std::atomic_int &cnt)
 		{
 			StandardEDT step1(src.Width());
+			std::unique_ptr<bool[]> mask(new bool[src.Width()]);
 
 			for (int j = cnt++; j < src.Height(); j = cnt++)
 			{
+				src.ReadRow(j, mask.get());
+
 				int* input = step1.GetInput();
 				for (int i = 0; i < src.Width(); i++)
-					input[i] = src(i, j) ? 0 : -1;
+					input[i] = mask[i] ? 0 : -1;
 
 				step1.ProcessFirst(input);
 
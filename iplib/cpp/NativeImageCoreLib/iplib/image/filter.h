@@ -193,7 +193,18 @@ namespace ip
 
 		int Width() const { return img.Width(); }
 		int Height() const { return img.Height(); }
-		DestinationPixelType pixel(int x, int y) { return (DestinationPixelType)img.pixel(x, y); }
+		DestinationPixelType pixel(int x, int y) const { return (DestinationPixelType)img.pixel(x, y); }
+
+		const DestinationPixelType* row(int x, int y, int n, DestinationPixelType *buf) const
+		{
+			SourcePixelType tmp[internal::RowChunk];
+			const SourcePixelType *in = img.GetRow(x, y, n, tmp);
+
+			for (int i = 0; i < n; i++)
+				buf[i] = (DestinationPixelType)in[i];
+
+			return buf;
+		}
 	};
 
 	template <typename DestinationPixelType, typename SourcePixelType, class SourceImageType>
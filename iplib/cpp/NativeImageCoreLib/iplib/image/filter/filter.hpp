@@ -12,5 +12,33 @@ namespace ip
 		static void Filter2D(const ip::ImageFloat& src, const ip::ImageFloat& kernel, int cx, int cy, ip::ImageFloat& dst);
 		static void Gauss(const ip::ImageFloat& src, ip::ImageFloat& dst, float sigma);
 		static void Gauss(const ip::ImageFloat& src, ip::ImageFloat& tmp, ip::ImageFloat& dst, float sigma);
+
+		// Half size of the Gauss kernel, the context ProcessRegion needs around a region
+		static int GaussHalo(float sigma);
+
+		// Colour versions, each channel is filtered as a grayscale plane
+
+		template <int Channels>
+		static void FilterHorizontal(const ip::PlanarImage<float, Channels>& src, float* kernel, int kernel_center, int kernel_length, ip::PlanarImage<float, Channels>& dst)
+		{
+			for (int c = 0; c < Channels; c++)
+				FilterHorizontal(src.Plane(c), kernel, kernel_center, kernel_length, dst.Plane(c));
+		}
+
+		template <int Channels>
+		static void FilterVertical(const ip::PlanarImage<float, Channels>& src, float* kernel, int kernel_center, int kernel_length, ip::PlanarImage<float, Channels>& dst)
+		{
+			for (int c = 0; c < Channels; c++)
+				FilterVertical(src.Plane(c), kernel, kernel_center, kernel_length, dst.Plane(c));
+		}
+
+		template <int Channels>
+		static void Gauss(const ip::PlanarImage<float, Channels>& src, ip::PlanarImage<float, Channels>& dst, float sigma)
+		{
+			ImageFloat tmp(src.Width(), src.Height());
+
+			for (int c = 0; c < Channels; c++)
+				Gauss(src.Plane(c), tmp, dst.Plane(c), sigma);
+		}
 	};
 }
@@ -92,4 +92,11 @@ namespace ip
 
 		return helper(a0, a1, a2, a3)(y, y2, y3);
 	}
-}
\ No newline at end of file
+
+	enum class Interp { Bilinear, Bicubic, Lanczos3 };
+
+	/* Bulk resampling: dst(x, y) = src(mapx(x, y), mapy(x, y)). The coordinates are clamped by the source boundaries,
+	* a NaN coordinate is taken as 0. Bicubic (the same kernel as Bicubic above) and Lanczos3 use weight tables for
+	* 1/256-pixel subpixel phases */
+	void Remap(const ImageFloat& src, const ImageFloat& mapx, const ImageFloat& mapy, ImageFloat& dst, Interp interp);
+}
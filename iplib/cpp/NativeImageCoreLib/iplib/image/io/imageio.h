@@ -91,9 +91,7 @@ namespace ip
 				CustomBitmapImage<PixelByteRGB> src;
 				src.Init(lbi.bitmapdata.Scan0, Width, Height, lbi.bitmapdata.Stride);
 
-				for (int j = 0; j < Height; j++)
-					for (int i = 0; i < Width; i++)
-						res(i, j) = (PixelType)src(i, j);
+				src.Convert<PixelType>().CopyTo(res);
 			}
 
 			return res;
@@ -121,13 +119,16 @@ namespace ip
 			return B;
 		}
 
+		// Saves as PNG, false if the file cannot be written
 		template <typename PixelType, class ImageType>
-		static void ToFile(const ImageReadable<PixelType, ImageType>& image, const WCHAR* filename)
+		static bool ToFile(const ImageReadable<PixelType, ImageType>& image, const WCHAR* filename)
 		{
 			std::unique_ptr<Gdiplus::Bitmap> B(ToBitmap(image));
 			CLSID pngClsid;
-			GetEncoderClsid(L"image/png", &pngClsid);
-			B->Save(filename, &pngClsid);
+			if (GetEncoderClsid(L"image/png", &pngClsid) < 0)
+				return false;
+
+			return B->Save(filename, &pngClsid) == Gdiplus::Ok;
 		}
 	};
 
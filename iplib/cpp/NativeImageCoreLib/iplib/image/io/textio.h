@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <stdio.h>
+#include <string>
+
+namespace ip
+{
+	// The file names in the reports and the text protocols are UTF-8
+	inline std::string ToUTF8(const std::wstring &str)
+	{
+		int size = WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), nullptr, 0, nullptr, nullptr);
+		std::string res(size, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), &res[0], size, nullptr, nullptr);
+		return res;
+	}
+
+	inline std::wstring FromUTF8(const std::string &str)
+	{
+		int size = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), nullptr, 0);
+		std::wstring res(size, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), &res[0], size);
+		return res;
+	}
+
+	// Writes str in UTF-8 between the double quotes, a quote is doubled for CSV, a quote and a backslash are escaped for JSON
+	inline void WriteQuoted(const std::wstring &str, FILE *f, bool json = false)
+	{
+		fputc('"', f);
+
+		for (char c : ToUTF8(str))
+		{
+			if (c == '"')
+				fputs(json ? "\\\"" : "\"\"", f);
+			else if (c == '\\' && json)
+				fputs("\\\\", f);
+			else
+				fputc(c, f);
+		}
+
+		fputc('"', f);
+	}
+}
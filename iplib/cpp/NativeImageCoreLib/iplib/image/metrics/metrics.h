@@ -10,5 +10,16 @@ namespace ip
 		static float PSNR(const ip::ImageFloat& img1, const ip::ImageFloat& img2);
 		static float SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma);
 		static void SSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, ip::ImageFloat& dst);
+
+		/* Multi-scale SSIM. The images are downsampled by 2 between the scales, the number of scales is reduced
+		* when the images become smaller than the Gaussian window */
+		static float MSSSIM(const ip::ImageFloat& img1, const ip::ImageFloat& img2, float sigma, int scales = 5);
+
+		// Root mean square of the difference between the image gradients (central differences)
+		static float GradientError(const ip::ImageFloat& img1, const ip::ImageFloat& img2);
+
+		// Colour versions: PSNR of the mean squared error over all channels, SSIM averaged over the channels
+		static float PSNR(const ip::PlanarImage<float, 3>& img1, const ip::PlanarImage<float, 3>& img2);
+		static float SSIM(const ip::PlanarImage<float, 3>& img1, const ip::PlanarImage<float, 3>& img2, float sigma);
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../core.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace ip
+{
+	/* Quality metrics over a list of (reference, candidate) image pairs. The pairs are decoded by several I/O threads
+	* ahead of the computation, so loading of the next pairs is overlapped with the evaluation of the current one.
+	* Every pair is evaluated channel by channel, each metric uses all worker threads */
+	class MetricsBatch
+	{
+	public:
+		enum Metric
+		{
+			MetricPSNR = 1,
+			MetricSSIM = 2,
+			MetricMSSSIM = 4,
+			MetricGradientError = 8,
+			MetricAll = 15
+		};
+
+		static const int MetricCount = 4;
+
+		enum class Channels { Luma, RGB };
+
+		struct Result
+		{
+			std::wstring reference, candidate;
+
+			// false if one of the images cannot be loaded or their sizes differ
+			bool ok;
+			int width, height;
+
+			// 1 for Luma, 3 for RGB
+			int channels;
+
+			// Indexed by [channel][metric], the metric index is the bit number in Metric. NaN if not requested
+			float values[3][MetricCount];
+		};
+
+		MetricsBatch(int metrics = MetricAll, Channels channels = Channels::Luma, float sigma = 1.5f);
+
+		void AddPair(const std::wstring& reference, const std::wstring& candidate);
+		size_t PairCount() const;
+
+		/* Evaluate all pairs in the order they were added. At most 'prefetch' decoded pairs are kept in memory */
+		std::vector<Result> Run(int io_threads = 2, int prefetch = 4) const;
+
+		// Evaluate images already in memory, the images are assumed to be in range 0..255
+		void Evaluate(const ip::ImageFloatColor& reference, const ip::ImageFloatColor& candidate, Result& result) const;
+
+		static const char* MetricName(int index);
+
+		static void WriteCSV(const std::vector<Result>& results, FILE* f);
+		static void WriteJSON(const std::vector<Result>& results, FILE* f);
+
+	private:
+		int metrics;
+		Channels channels;
+		float sigma;
+		std::vector<std::pair<std::wstring, std::wstring>> pairs;
+	};
+}
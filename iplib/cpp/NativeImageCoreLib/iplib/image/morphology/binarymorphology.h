@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../edt/edt.h"
+#include "../transform.h"
 
 namespace ip
 {
@@ -29,6 +30,16 @@ namespace ip
 		{
 			return !src.pixel(x, y);
 		}
+
+		const bool* row(int x, int y, int n, bool *buf) const
+		{
+			const bool *in = src.GetRow(x, y, n, buf);
+
+			for (int i = 0; i < n; i++)
+				buf[i] = !in[i];
+
+			return buf;
+		}
 	};
 
 	template <class SourceImageType, class DestinationImageType>
@@ -39,9 +50,7 @@ namespace ip
 		
 		int dthr = (int)(rad * rad);
 
-		for (int j = 0; j < src.Height(); j++)
-			for (int i = 0; i < src.Width(); i++)
-				dst(i, j) = (tmp(i, j) > dthr || tmp(i, j) == -1);
+		PixelTransform(tmp, [dthr](int d) { return d > dthr || d == -1; }).CopyTo(dst);
 	}
 
 	template <class SourceImageType, class DestinationImageType>
@@ -52,9 +61,7 @@ namespace ip
 
 		int dthr = (int)(rad * rad);
 
-		for (int j = 0; j < src.Height(); j++)
-			for (int i = 0; i < src.Width(); i++)
-				dst(i, j) = (tmp(i, j) <= dthr);
+		PixelTransform(tmp, [dthr](int d) { return d <= dthr; }).CopyTo(dst);
 	}
 
 }
\ No newline at end of file
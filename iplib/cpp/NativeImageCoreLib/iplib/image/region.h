@@ -0,0 +1,133 @@
+#pragma once
+
+#include "core.h"
+#include <iplib/parallel.h>
+#include <algorithm>
+
+namespace ip
+{
+	// ==================================================================================================
+	//                                              Region
+	// ==================================================================================================
+
+	// Rectangle in the pixel coordinates of an image
+	struct Region
+	{
+		int x, y, width, height;
+
+		Region()
+			: x(0), y(0), width(0), height(0) {}
+
+		Region(int x, int y, int width, int height)
+			: x(x), y(y), width(width), height(height) {}
+
+		// Grown by halo pixels on each side
+		Region Inflate(int halo) const
+		{
+			return Region(x - halo, y - halo, width + 2 * halo, height + 2 * halo);
+		}
+
+		Region Intersect(const Region &other) const
+		{
+			int x0 = (std::max)(x, other.x), y0 = (std::max)(y, other.y);
+			int x1 = (std::min)(x + width, other.x + other.width), y1 = (std::min)(y + height, other.y + other.height);
+			return Region(x0, y0, (std::max)(x1 - x0, 0), (std::max)(y1 - y0, 0));
+		}
+
+		// The same region in the coordinates of an image scale times larger
+		Region Scale(int scale) const
+		{
+			return Region(x * scale, y * scale, width * scale, height * scale);
+		}
+	};
+
+	/* View of the region of img, sharing its pixels; writing to the view writes to img. The rows of a fragment
+	* are not aligned, so it is a CustomBitmapImage rather than an Image */
+	template <typename PixelType, bool Aligned>
+	CustomBitmapImage<PixelType> Fragment(const BitmapImage<PixelType, Aligned> &img, const Region &region)
+	{
+		check(region.x >= 0 && region.y >= 0 && region.width >= 0 && region.height >= 0);
+		check(region.x + region.width <= img.Width() && region.y + region.height <= img.Height());
+
+		BitmapDataStructure data = img.Data();
+		BitmapDataStructure fragment = data.Fragment(data, region.x, region.y, region.width, region.height, sizeof(PixelType));
+
+		CustomBitmapImage<PixelType> res;
+		res.Init(fragment.data, fragment.width, fragment.height, fragment.stride);
+		return res;
+	}
+
+	// ==================================================================================================
+	//                                     ProcessRegion / ProcessTiled
+	// ==================================================================================================
+
+	/* Runs a whole-image algorithm func(const Image<SourcePixelType> &src, Image<DestinationPixelType> &dst) on a region
+	* of src only; dst of func is scale times larger than src (1 for the filters, 2 for the x2 resamplers).
+	* func gets a copy of the region with halo pixels of real neighbours on each side, cut at the image border only,
+	* so it replicates the border just where the whole image has it. The result for the region is written to
+	* region * scale of dst and equals the whole-image result when halo covers the radius of the algorithm:
+	* Filter::GaussHalo, BasicCanny::Halo, EDR_Halo. The iterative methods with global terms (DeblurTV normalises
+	* the step by the norm over the whole image) have no finite radius, a larger halo only makes the seams smaller */
+	template <typename SourcePixelType, bool SourceAligned, typename DestinationPixelType, bool DestinationAligned, class Func>
+	void ProcessRegion(const BitmapImage<SourcePixelType, SourceAligned> &src, BitmapImage<DestinationPixelType, DestinationAligned> &dst,
+		const Region &region, int halo, int scale, const Func &func)
+	{
+		check(dst.Width() >= src.Width() * scale && dst.Height() >= src.Height() * scale);
+
+		Region context = region.Inflate(halo).Intersect(Region(0, 0, src.Width(), src.Height()));
+		Region inner(region.x - context.x, region.y - context.y, region.width, region.height);
+
+		Image<SourcePixelType> tile(context.width, context.height);
+		Fragment(src, context).CopyTo(tile);
+
+		Image<DestinationPixelType> res(context.width * scale, context.height * scale);
+		func(static_cast<const Image<SourcePixelType>&>(tile), res);
+
+		CustomBitmapImage<DestinationPixelType> out = Fragment(dst, region.Scale(scale));
+		Fragment(res, inner.Scale(scale)).CopyTo(out);
+	}
+
+	// The same for the colour images, func(const PlanarImage<T, Channels> &src, PlanarImage<T, Channels> &dst)
+	template <typename T, int Channels, class Func>
+	void ProcessRegion(const PlanarImage<T, Channels> &src, PlanarImage<T, Channels> &dst,
+		const Region &region, int halo, int scale, const Func &func)
+	{
+		check(dst.Width() >= src.Width() * scale && dst.Height() >= src.Height() * scale);
+
+		Region context = region.Inflate(halo).Intersect(Region(0, 0, src.Width(), src.Height()));
+		Region inner(region.x - context.x, region.y - context.y, region.width, region.height);
+
+		PlanarImage<T, Channels> tile(context.width, context.height);
+		for (int c = 0; c < Channels; c++)
+			Fragment(src.Plane(c), context).CopyTo(tile.Plane(c));
+
+		PlanarImage<T, Channels> res(context.width * scale, context.height * scale);
+		func(static_cast<const PlanarImage<T, Channels>&>(tile), res);
+
+		for (int c = 0; c < Channels; c++)
+		{
+			CustomBitmapImage<T> out = Fragment(dst.Plane(c), region.Scale(scale));
+			Fragment(res.Plane(c), inner.Scale(scale)).CopyTo(out);
+		}
+	}
+
+	/* Processes the whole src by tiles of tile x tile pixels in parallel, each with ProcessRegion. The memory of
+	* the algorithm is that of a tile plus its halo, so the images far larger than the algorithm could take at once
+	* are processed with no seams between the tiles. The tiles are the parallel work, the Parallel calls of func
+	* run serially on the thread of its tile (see Parallel::Nested) */
+	template <class SourceImageType, class DestinationImageType, class Func>
+	void ProcessTiled(const SourceImageType &src, DestinationImageType &dst, int tile, int halo, int scale, const Func &func)
+	{
+		check(tile > 0);
+
+		int nx = (src.Width() + tile - 1) / tile;
+		int ny = (src.Height() + tile - 1) / tile;
+
+		Parallel::For(0, nx * ny, [&src, &dst, tile, halo, scale, &func, nx](int k)
+		{
+			int x = (k % nx) * tile, y = (k / nx) * tile;
+			Region region(x, y, (std::min)(tile, src.Width() - x), (std::min)(tile, src.Height() - y));
+			ProcessRegion(src, dst, region, halo, scale, func);
+		});
+	}
+}
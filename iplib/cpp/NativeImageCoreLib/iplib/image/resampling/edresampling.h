@@ -2,6 +2,11 @@
 
 #include <iplib/image/core.h>
 #include <iplib/math/quadratic_optimization.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace ip
 {
@@ -43,6 +48,13 @@ namespace ip
 		template <class PixelType, class SourceImageType, class DestinationImageType>
 		void Perform(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode);
 
+		// Color images are processed by the planar vectorized implementation
+		template <class SourceImageType, class DestinationImageType>
+		void Perform(const ImageReadable<PixelFloatRGBA, SourceImageType> & src, ImageWritable<PixelFloatRGBA, DestinationImageType> & dst, EDResampling::Mode mode);
+
+		template <class SourceImageType, class DestinationImageType>
+		void Perform(const ImageReadable<PixelByteRGBA, SourceImageType> & src, ImageWritable<PixelByteRGBA, DestinationImageType> & dst, EDResampling::Mode mode);
+
 	protected:
 		Kernels kernels;
 		bool fast_weights = false;
@@ -58,6 +70,8 @@ namespace ip
 		template <class PixelType, class ImageType>	class SafeWrapImpl;
 
 		class WeightCalculator;
+		class ColorResampler;
+		class LearnerShard;
 
 		template <class PixelType, class SourcePixelType, class DestinationPixelType> class Resampler;
 		template <class PixelType, class SourcePixelType, class DestinationPixelType> class Learner;
@@ -73,6 +87,19 @@ namespace ip
 
 		template<class ImageType>
 		auto static SafeWrap(const ImageType &img) -> SafeWrapImpl<decltype(img(0, 0)), ImageType>;
+
+		template <class PixelType, class SourceImageType, class DestinationImageType>
+		void PerformGeneric(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode);
+
+		template <class PixelType, class SourceImageType, class DestinationImageType>
+		void PerformColor(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode);
+
+		static void StoreColor(PixelFloatRGBA &p, float r, float g, float b, float a);
+		static void StoreColor(PixelByteRGBA &p, float r, float g, float b, float a);
+
+		/* Call func for the rows begin..end - 1 on all threads, every thread collects the samples into its own shard.
+		* The shards are merged pairwise and added to the optimizers opt[0..count - 1] with the vector lengths 'lengths' */
+		static void LearnSharded(QuadraticOptimization * const *opt, const int *lengths, int count, int begin, int end, std::function<void(int y, LearnerShard &shard)> func);
 	};
 
 	// ==================================================================================================
@@ -97,8 +124,22 @@ namespace ip
 
 		EDResampling::Kernels GetKernels() const;
 
+		struct SkippedImage
+		{
+			std::wstring file, reason;
+		};
+
+		/* Learn the kernels of both steps from a set of images. If lr_files[i] is empty, the low resolution image is obtained
+		* from hr_files[i] by the Gauss filter and decimation. The step 2 needs the step 1 kernels, so the images are read twice;
+		* 'io_threads' threads decode up to 'prefetch' images ahead of the learning. Returns the images that could not be used */
+		std::vector<SkippedImage> Learn(const std::vector<std::wstring> &hr_files, const std::vector<std::wstring> &lr_files, int io_threads = 2, int prefetch = 4);
+
 	private:
 		QuadraticOptimization opt0, opt1, opt2, opt2a, opt2b, opt2c;
+
+		// The skipped images are added to 'skipped' if it is not null
+		void LearnPass(const std::vector<std::wstring> &hr_files, const std::vector<std::wstring> &lr_files, int io_threads, int prefetch, bool step2,
+			std::vector<SkippedImage> *skipped);
 	};
 
 	// ==================================================================================================
@@ -384,19 +425,20 @@ namespace ip
 			return img.Height();
 		}
 
+		// The mirrored coordinates are clamped as well for the images narrower than 3 pixels
 		inline PixelType operator()(int x, int y) const
 		{
 			if (x < 0)
-				x = -x;
+				x = (std::min)(-x, img.Width() - 1);
 
 			if (x >= img.Width())
-				x = 2 * img.Width() - 2 - x;
+				x = (std::max)(2 * img.Width() - 2 - x, 0);
 
 			if (y < 0)
-				y = -y;
+				y = (std::min)(-y, img.Height() - 1);
 
 			if (y >= img.Height())
-				y = 2 * img.Height() - 2 - y;
+				y = (std::max)(2 * img.Height() - 2 - y, 0);
 
 			return img(x, y);
 		}
@@ -526,6 +568,78 @@ namespace ip
 		}
 	};
 
+	// ==================================================================================================
+	//                                 ColorResampler
+	// ==================================================================================================
+
+	/* Planar implementation of the resampler for the color images. The luma and the color channels are kept in separate
+	* padded planes and the result is kept as four phase planes (even / odd x and y), so every step computes eight output
+	* pixels of one phase with AVX and the mirrored borders are read from the padding. The luma is derived once from the
+	* source pixels and then interpolated as one more channel by the steps 0 and 1 */
+	class EDResampling::ColorResampler
+	{
+	public:
+		// Channel 0 is luma, channels 1..4 are red, green, blue and alpha
+		static const int Channels = 5;
+
+		// The smallest supported source width and height
+		static const int MinSize = 4;
+
+		ColorResampler(EDResampling::Kernels kernels, bool fast, int Width, int Height);
+
+		float* SourceRow(int channel, int y);
+
+		// Phase is (y % 2) * 2 + (x % 2), channel is 1..4
+		const float* DestinationRow(int phase, int channel, int y) const;
+
+		void Perform(EDResampling::Mode mode);
+
+	private:
+		static const int Padding = 8;
+		static const int Border = 2;
+
+		EDResampling::Kernels kernels;
+		EDResampling::WeightCalculator weights;
+
+		int width, height;
+
+		Image<float> source[Channels];
+		Image<float> phases[4][Channels - 1];
+		Image<float> luma;
+
+		// Step 1 and step 2 kernels in the form sum(data[k] * (w * kernel[0][k] + (1 - w) * kernel[1][k]))
+		float step1[2][6];
+		float step2[2][2][6];
+
+		void Allocate(Image<float> &plane);
+		void Mirror(Image<float> &plane, bool dup_low, bool dup_high);
+		float* Row(const Image<float> &plane, int y) const;
+
+		void SetKernels(EDResampling::Mode mode);
+		void PerformStep01(int j);
+		void PerformStep2(int j);
+	};
+
+	// ==================================================================================================
+	//                                 LearnerShard
+	// ==================================================================================================
+
+	// Per-thread learning samples, one optimizer per each optimizer of the learning step
+	class EDResampling::LearnerShard
+	{
+	public:
+		LearnerShard(const int *lengths, int count);
+
+		void Add(int index, const float *q, float v);
+		void Merge(const LearnerShard &other);
+
+		const QuadraticOptimization& Result(int index) const;
+
+	private:
+		std::vector<QuadraticOptimization> opt;
+		std::vector<int> lengths;
+	};
+
 	// ==================================================================================================
 	//                                 Resampler
 	// ==================================================================================================
@@ -880,25 +994,33 @@ namespace ip
 	template<class PixelType, class SourcePixelType, class DestinationPixelType> template<class ReferencePixelType>
 	void EDResampling::Learner<PixelType, SourcePixelType, DestinationPixelType>::LearnStep0(const ImageReadable<PixelType, ReferencePixelType>& reference, QuadraticOptimization & opt)
 	{
-		for (int j = 2; j < src.Height() - 2; j++)
-			for (int i = 2; i < src.Width() - 2; i++)
+		QuadraticOptimization *opts[] = { &opt };
+		const int lengths[] = { 6 };
+
+		EDResampling::LearnSharded(opts, lengths, 1, 2, this->src.Height() - 2, [this, &reference](int j, EDResampling::LearnerShard &shard)
+		{
+			for (int i = 2; i < this->src.Width() - 2; i++)
 			{
-				EDResampling::CoefficientsStep0<float> c = this->GetCoefficientsStep0(src.get_imgf(), i, j);
-				opt.AddData(c.data, 6, (float)reference(i * 2, j * 2));
+				EDResampling::CoefficientsStep0<float> c = this->GetCoefficientsStep0(this->src.get_imgf(), i, j);
+				shard.Add(0, c.data, (float)reference(i * 2, j * 2));
 			}
+		});
 	}
 
 	template<class PixelType, class SourcePixelType, class DestinationPixelType> template<class ReferencePixelType>
 	void EDResampling::Learner<PixelType, SourcePixelType, DestinationPixelType>::LearnStep1(const ImageReadable<PixelType, ReferencePixelType>& reference, QuadraticOptimization & opt)
 	{
-		weights.CalcStep1(src.get_imgf());
+		this->weights.CalcStep1(this->src.get_imgf());
 
-		for (int j = 1; j < src.Height() - 2; j++)
+		QuadraticOptimization *opts[] = { &opt };
+		const int lengths[] = { 6 };
+
+		EDResampling::LearnSharded(opts, lengths, 1, 1, this->src.Height() - 2, [this, &reference](int j, EDResampling::LearnerShard &shard)
 		{
-			for (int i = 1; i < src.Width() - 2; i++)
+			for (int i = 1; i < this->src.Width() - 2; i++)
 			{
-				EDResampling::CoefficientsStep1<float> c = this->GetCoefficientsStep1(src.get_imgf(), i, j);
-				float w = weights.get(i * 2 + 1, j * 2 + 1);
+				EDResampling::CoefficientsStep1<float> c = this->GetCoefficientsStep1(this->src.get_imgf(), i, j);
+				float w = this->weights.get(i * 2 + 1, j * 2 + 1);
 				float nw = 1.0f - w;
 
 				float v[6] = { c.data[0] * w + c.data[3] * nw,
@@ -908,23 +1030,27 @@ namespace ip
 					           c.data[4] * w + c.data[5] * nw,
 					           c.data[5] * w + c.data[4] * nw };
 
-				opt.AddData(v, 6, (float)reference(i * 2 + 1, j * 2 + 1));
+				shard.Add(0, v, (float)reference(i * 2 + 1, j * 2 + 1));
 			}
-		}
+		});
 	}
 
 	template<class PixelType, class SourcePixelType, class DestinationPixelType> template<class ReferencePixelType>
 	void EDResampling::Learner<PixelType, SourcePixelType, DestinationPixelType>::LearnStep2(const ImageReadable<PixelType, ReferencePixelType>& reference, QuadraticOptimization & opt2, QuadraticOptimization & opt2a, QuadraticOptimization & opt2b, QuadraticOptimization & opt2c)
 	{
-		weights.CalcStep2(dst.get_imgf());
+		this->weights.CalcStep2(this->dst.get_imgf());
 
-		for (int j = 5; j < dst.Height() - 5; j++)
+		QuadraticOptimization *opts[] = { &opt2, &opt2a, &opt2b, &opt2c };
+		const int lengths[] = { 6, 12, 12, 12 };
+
+		EDResampling::LearnSharded(opts, lengths, 4, 5, this->dst.Height() - 5, [this, &reference](int j, EDResampling::LearnerShard &shard)
 		{
-			for (int i = 5 + (j % 2); i < src.Width() - 5; i += 2)
+			for (int i = 5 + (j % 2); i < this->src.Width() - 5; i += 2)
 			{
-				EDResampling::CoefficientsStep2<float> c = this->GetCoefficientsStep2(dst.get_imgf(), i, j);
-				float w = weights.get(i, j);
+				EDResampling::CoefficientsStep2<float> c = this->GetCoefficientsStep2(this->dst.get_imgf(), i, j);
+				float w = this->weights.get(i, j);
 				float nw = 1.0f - w;
+				float r = (float)reference(i, j);
 
 				float v[6] = { c.data[0] * w + c.data[3] * nw,
 					c.data[1] * w + c.data[2] * nw,
@@ -933,7 +1059,7 @@ namespace ip
 					c.data[4] * w + c.data[5] * nw,
 					c.data[5] * w + c.data[4] * nw };
 
-				opt2.AddData(v, 6, (float)reference(i, j));
+				shard.Add(0, v, r);
 
 				float v1[12] = { c.data[0] * w,  c.data[1] * w,  c.data[2] * w,  c.data[3] * w,  c.data[4] * w,  c.data[5] * w,
 					             c.data[0] * nw, c.data[1] * nw, c.data[2] * nw, c.data[3] * nw, c.data[4] * nw, c.data[5] * nw };
@@ -943,16 +1069,16 @@ namespace ip
 
 				if (j % 2 == 0)
 				{
-					opt2a.AddData(v1, 12, (float)reference(i, j));
-					opt2c.AddData(v1, 12, (float)reference(i, j));
+					shard.Add(1, v1, r);
+					shard.Add(3, v1, r);
 				}
 				else
 				{
-					opt2b.AddData(v1, 12, (float)reference(i, j));
-					opt2c.AddData(v2, 12, (float)reference(i, j));
+					shard.Add(2, v1, r);
+					shard.Add(3, v2, r);
 				}
 			}
-		}
+		});
 	}
 
 	// =====================================================================================================================================
@@ -965,11 +1091,98 @@ namespace ip
 
 	template <class PixelType, class SourceImageType, class DestinationImageType>
 	void EDResampling::Perform(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode)
+	{
+		PerformGeneric(src, dst, mode);
+	}
+
+	template <class PixelType, class SourceImageType, class DestinationImageType>
+	void EDResampling::PerformGeneric(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode)
 	{
 		EDResampling::Resampler<PixelType, SourceImageType, DestinationImageType> resampler(src, dst, kernels, fast_weights);
 		resampler.Perform(mode);
 	}
 
+	template <class SourceImageType, class DestinationImageType>
+	void EDResampling::Perform(const ImageReadable<PixelFloatRGBA, SourceImageType> & src, ImageWritable<PixelFloatRGBA, DestinationImageType> & dst, EDResampling::Mode mode)
+	{
+		PerformColor(src, dst, mode);
+	}
+
+	template <class SourceImageType, class DestinationImageType>
+	void EDResampling::Perform(const ImageReadable<PixelByteRGBA, SourceImageType> & src, ImageWritable<PixelByteRGBA, DestinationImageType> & dst, EDResampling::Mode mode)
+	{
+		PerformColor(src, dst, mode);
+	}
+
+	template <class PixelType, class SourceImageType, class DestinationImageType>
+	void EDResampling::PerformColor(const ImageReadable<PixelType, SourceImageType> & src, ImageWritable<PixelType, DestinationImageType> & dst, EDResampling::Mode mode)
+	{
+		check(src.Width() * 2 == dst.Width() && src.Height() * 2 == dst.Height());
+
+		// The mirrored padding of the planes needs a few pixels, the tiny images go through the generic resampler in float
+		if (src.Width() < ColorResampler::MinSize || src.Height() < ColorResampler::MinSize)
+		{
+			ImageFloatColor fsrc(src.Width(), src.Height()), fdst(dst.Width(), dst.Height());
+
+			for (int j = 0; j < src.Height(); j++)
+				for (int i = 0; i < src.Width(); i++)
+				{
+					PixelType p = src(i, j);
+					fsrc(i, j) = PixelFloatRGBA(p.r, p.g, p.b, p.a);
+				}
+
+			PerformGeneric(fsrc, fdst, mode);
+
+			for (int y = 0; y < dst.Height(); y++)
+				for (int x = 0; x < dst.Width(); x++)
+				{
+					PixelFloatRGBA p = fdst(x, y);
+					StoreColor(dst(x, y), p.r, p.g, p.b, p.a);
+				}
+
+			return;
+		}
+
+		EDResampling::ColorResampler resampler(kernels, fast_weights, src.Width(), src.Height());
+
+		Parallel::For(0, src.Height(), [&src, &resampler](int j)
+		{
+			float *l = resampler.SourceRow(0, j);
+			float *r = resampler.SourceRow(1, j);
+			float *g = resampler.SourceRow(2, j);
+			float *b = resampler.SourceRow(3, j);
+			float *a = resampler.SourceRow(4, j);
+
+			for (int i = 0; i < src.Width(); i++)
+			{
+				PixelType p = src(i, j);
+
+				l[i] = (float)p;
+				r[i] = p.r;
+				g[i] = p.g;
+				b[i] = p.b;
+				a[i] = p.a;
+			}
+		});
+
+		resampler.Perform(mode);
+
+		Parallel::For(0, dst.Height(), [&src, &dst, &resampler](int y)
+		{
+			const float *c[2][4];
+
+			for (int px = 0; px < 2; px++)
+				for (int k = 0; k < 4; k++)
+					c[px][k] = resampler.DestinationRow((y % 2) * 2 + px, k + 1, y / 2);
+
+			for (int i = 0; i < src.Width(); i++)
+			{
+				StoreColor(dst(i * 2, y), c[0][0][i], c[0][1][i], c[0][2][i], c[0][3][i]);
+				StoreColor(dst(i * 2 + 1, y), c[1][0][i], c[1][1][i], c[1][2][i], c[1][3][i]);
+			}
+		});
+	}
+
 	// =====================================================================================================================================
 
 	template<class PixelType, class SourceImageType, class DestinationImageType>
@@ -30,6 +30,13 @@ namespace ip
 		{
 			return operation(src(x, y));
 		}
+
+		const DestinationPixelType* row(int x, int y, int n, DestinationPixelType *buf) const
+		{
+			SourcePixelType tmp[internal::RowChunk];
+			internal::ApplyRow(operation, src.GetRow(x, y, n, tmp), buf, n);
+			return buf;
+		}
 	};
 
 	template <typename SourcePixelType1, class SourceImageType1, typename SourcePixelType2, class SourceImageType2, typename DestinationPixelType, class TransformOperation>
@@ -62,8 +69,18 @@ namespace ip
 		{
 			return operation(src1(x, y), src2(x, y));
 		}
+
+		const DestinationPixelType* row(int x, int y, int n, DestinationPixelType *buf) const
+		{
+			SourcePixelType1 tmp1[internal::RowChunk];
+			SourcePixelType2 tmp2[internal::RowChunk];
+
+			internal::ApplyRow(operation, src1.GetRow(x, y, n, tmp1), src2.GetRow(x, y, n, tmp2), buf, n);
+			return buf;
+		}
 	};
 
+	// The operation is called concurrently and in no particular order when the result is evaluated, see ImageReadable
 	template <typename SourcePixelType, class SourceImageType, class TransformOperation>
 	auto PixelTransform(const ImageReadable<SourcePixelType, SourceImageType> &src, const TransformOperation &operation)
 		-> PixelTransformImage<SourcePixelType, SourceImageType, typename decltype(operation(std::declval<SourcePixelType>())), TransformOperation>
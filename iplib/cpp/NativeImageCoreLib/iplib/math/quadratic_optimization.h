@@ -1,14 +1,19 @@
 #pragma once
 
 #include "matrix.h"
+#include <vector>
 
 namespace ip
 {
 	// ==================================================================================================
 
+	/* Least squares fit of the coefficients x minimizing sum((q, x) - v)^2 over the added samples.
+	* The samples are buffered into blocks of BlockSize and added to the normal equations as one symmetric rank-k update
+	* of the upper triangle. The system is solved by the LDL^T decomposition with a small Tikhonov regularization */
 	class QuadraticOptimization
 	{
 	public:
+		static const int BlockSize = 32;
 
 		template <typename T>
 		void AddData(T *q, int len, float v);
@@ -16,16 +21,39 @@ namespace ip
 		template <typename T, size_t L>
 		void AddData(T(&q)[L], float v);
 
+		// Add the data accumulated by another optimizer with the same vector length
+		void Merge(const QuadraticOptimization &other);
+
+		/* Add the normal equations accumulated elsewhere from count samples: a is the len x len matrix sum(q q^T) stored
+		* by rows, only its upper triangle is read, b is sum(q v) */
+		void AddNormalEquations(const double *a, const double *b, int len, int count);
+
 		template <typename T>
 		bool CalcOptimizedCoefficients(T *target) const;
 
+		// The regularization term is lambda * trace(A) / len added to the diagonal, 1e-9 by default
+		void SetRegularization(double lambda);
+
 		void Reset();
 		int Count() const;
 		int GetVectorLength() const;
 
 	private:
+		// Only the upper triangle of A is updated
 		Matrix<double> A, B;
 		int N = 0;
+
+		double lambda = 1e-9;
+
+		// Transposed block of the samples, the row len holds the values, the rest rows are zero
+		std::vector<double> block;
+		int buffered = 0;
+
+		void Init(int len);
+		void Flush();
+		bool Solve(std::vector<double> &x) const;
+
+		static void RankUpdate(const double *block, int len, double *a, double *b);
 	};
 
 	// ==================================================================================================
@@ -34,22 +62,20 @@ namespace ip
 	void QuadraticOptimization::AddData(T *q, int len, float v)
 	{
 		if (!A)
-		{
-			A = Matrix<double>::Zero(len, len);
-			B = Matrix<double>::Zero(len, 1);
-		}
+			Init(len);
 
 		dbgcheck(A.NumColumns() == len);
 
 		for (int j = 0; j < len; j++)
 		{
 			check(q[j] == q[j]);
+			block[j * BlockSize + buffered] = q[j];
+		}
 
-			for (int i = 0; i < len; i++)
-				A(j, i) += q[i] * q[j];
+		block[len * BlockSize + buffered] = v;
 
-			B(j, 0) += v * q[j];
-		}
+		if (++buffered == BlockSize)
+			Flush();
 
 		N++;
 	}
@@ -63,19 +89,15 @@ namespace ip
 	template<typename T>
 	bool QuadraticOptimization::CalcOptimizedCoefficients(T * target) const
 	{
-		Matrix<double> X = A.GaussSolve(B);
+		std::vector<double> x;
 
-		if (X)
-		{
-			for (int i = 0; i < X.NumRows(); i++)
-				target[i] = (T)X(i, 0);
-
-			return true;
-		}
-		else
-		{
+		if (!Solve(x))
 			return false;
-		}
+
+		for (size_t i = 0; i < x.size(); i++)
+			target[i] = (T)x[i];
+
+		return true;
 	}
 
-}
\ No newline at end of file
+}
@@ -8,6 +8,9 @@
 #include "internal/image/varmethods_cpp.hpp"
 #include "internal/image/diffusion_cpp.hpp"
 #include "internal/image/metrics_cpp.hpp"
+#include "internal/image/metricsbatch_cpp.hpp"
+#include "internal/image/structuretensoranalysis_cpp.hpp"
+#include "internal/image/interpolation_cpp.hpp"
 #include "internal/image/filter_cpp.hpp"
 
 // #include "test_cpp.hpp"
@@ -3,6 +3,7 @@
 #include <string>
 #include <warping/meowarping.hpp>
 #include <iplib/image/io/imageio.h>
+#include <iplib/image/io/textio.h>
 #include <random>
 #include <iplib/image/edt/edt.h>
 #include <misc/basicedges/basicedges.hpp>
@@ -13,10 +14,22 @@
 #include <resampling/edrfast.h>
 #include <resampling/edrvector.h>
 #include <resampling/si_resampling.h>
+#include <misc/cpudispatch.h>
+#include <algorithm>
 #include <functional>
 #include <fstream>
 #include <iostream>
 #include <iplib/image/deblur/deblurtv.h>
+#include <iplib/image/metrics/metricsbatch.h>
+#include <pipeline/pipeline.h>
+#include <pipeline/pipelinebatch.h>
+#include <pipeline/pipelineserver.h>
+#include <bench/benchmark.h>
+#include <bench/verification.h>
+#include <io.h>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
 
 using namespace ip;
 using namespace std;
@@ -24,7 +37,8 @@ using namespace std;
 void DisplayHelp()
 {
 	printf("Program usage:\n");
-	printf("(programname) <operation> [options] <input_image> <output_image>\n\n");
+	printf("(programname) [-isa <sse41|avx2|avx512>] <operation> [options] <input_image> <output_image>\n\n");
+	printf("  -isa <name> - use the vector kernels for a lower instruction set than detected (also IP_CPU_ISA environment variable)\n\n");
 	printf("List of operations:\n\n");
 	printf("  warp - perform image sharpening by grid warping. Available options:\n");
 	printf("    -sigma <value> - (mandatory) set blur parameter for the input image, range: 1.0 to 20.0, default value is 2.0\n");
@@ -40,14 +54,80 @@ void DisplayHelp()
 	printf("      edr (default) - Our edge-directional algorithm\n");
 	printf("      srcnn - SRCNN (deep learning)\n");
 	printf("      si1, si2, si3 - SI-1, SI-2 and SI-3 respectively\n");
-	printf("    -cfile <filename> - Read coefficient data from the specified file\n");
-	printf("    -selfsim - Use the input image to compute the interpolation kernels instead of predefined values ('edr' method only)\n\n");
+	printf("    -cfile <filename> - Read coefficient data from the specified file, a model file or the output of 'train'\n");
+	printf("    -selfsim - Use the input image to compute the interpolation kernels instead of predefined values ('edr' method only)\n");
+	printf("    -fixed - Use the 16-bit fixed-point path for 'edr' and the SI methods, the throughput is reported in MPix/s\n");
+	printf("    -half - Keep the intermediate layer of 'srcnn' in half precision\n\n");
 	printf("  train - learn coefficients for edge-directional resampling\n");
 	printf("    -in <high_res> <low_res> - use a pair of training images\n");
 	printf("    -out <filename> - the result of training (default filename is '(method).bin'");
 	printf("    -method <method_name> - one of 'edr' (default), 'si1', 'si2', and 'si3'\n");
+	printf("    -fp16 - store SI coefficients as half-precision floats\n");
 	printf("    the rest arguments are filenames of high-resolution training images (low-resolution images are generated)\n\n");
 
+	printf("  metrics - compare candidate images with reference images\n");
+	printf("    -pair <reference> <candidate> - add a pair of images, two positional arguments are also treated as a pair\n");
+	printf("    -list <filename> - read pairs from a text file, one tab-separated pair per line\n");
+	printf("    -dir <reference_dir> <candidate_dir> - pair the files with the same names in two directories\n");
+	printf("    -metrics <list> - comma-separated list of psnr, ssim, msssim, graderr (default is all)\n");
+	printf("    -rgb - evaluate every color channel instead of luma\n");
+	printf("    -sigma <value> - Gauss window radius for SSIM, default value is 1.5\n");
+	printf("    -format <csv|json> - output format, default is csv\n");
+	printf("    -out <filename> - write the results to a file instead of the console\n");
+	printf("    -iothreads <value> - number of image loading threads, default value is 2\n\n");
+
+	printf("  pipeline - run a chain of stages, the intermediate images are kept in float\n");
+	printf("    -stages \"<stage> | <stage> | ...\" - (mandatory) the stages, each one is name:param=value,param=value\n");
+	printf("      gaussblur:sigma=1 - Gauss filter\n");
+	printf("      noise:stddev=1 - add Gaussian noise\n");
+	printf("      deblur:sigma=1,alpha=0.01 - TV deblurring of a Gaussian blur\n");
+	printf("      resample:method=edr,precision=float - x2, methods edr (float or half), srcnn (float or half, model=, halfshift=1),\n");
+	printf("        edrvector, si1, si2, si3 (float or fixed, model=) and si1deblur, si2deblur, si3deblur (x1)\n");
+	printf("      warp:sigma=2,power=1 - sharpening by grid warping\n");
+	printf("      levels:gain=1,offset=0, clamp:min=0,max=255, gray - pointwise stages\n");
+	printf("    The consecutive gaussblur, resample:method=edr and pointwise stages are fused and processed by tiles\n\n");
+
+	printf("  batch - run a pipeline over many images in one process, the models are loaded once\n");
+	printf("    -stages \"<stage> | ...\" - (mandatory) the stages, see 'pipeline'\n");
+	printf("    -dir <input_dir> <output_dir> - process all files of a directory, the outputs are PNG files with the same names\n");
+	printf("    -list <filename> - read jobs from a text file, one tab-separated <input> <output> pair per line\n");
+	printf("    -jobs <value> - number of images processed at once, default value is 2\n");
+	printf("    -iothreads <value> - number of image loading and saving threads, default value is 2\n");
+	printf("    -out <filename> - write the per-file timings as CSV\n\n");
+
+	printf("  serve - process pipeline jobs sent over the standard input until 'quit', the models are loaded once\n");
+	printf("    the requests are 'load <name> <stages>', 'run <id> <name> <input> <output>', 'raw <id> <name> <width> <height> <channels>'\n");
+	printf("    followed by the pixels, 'stats' and 'quit', tab-separated, one per line (see pipelineserver.h)\n");
+	printf("    -load <name> \"<stage> | ...\" - define a pipeline before serving\n\n");
+
+	printf("  client - test 'serve': start it as a child process, send the images as jobs and report the round trip times\n");
+	printf("    -stages \"<stage> | ...\" - (mandatory) the stages, see 'pipeline'\n");
+	printf("    -repeat <value> - send every image that many times, default value is 1\n");
+	printf("    -raw - send the pixels instead of the file names\n");
+	printf("    the rest arguments are input images, the results are saved as <input>.served.png\n\n");
+
+	printf("  bench - time every algorithm over several image sizes and thread counts (no input images)\n");
+	printf("    -sizes <list> - comma-separated sides of the square source images, default is 256,1024\n");
+	printf("    -threads <list> - comma-separated thread counts, 0 is all processors, default is 1,0\n");
+	printf("    -warmup <value> - untimed runs before the measurement, default value is 2\n");
+	printf("    -repeats <value> - timed runs, the median and the 95th percentile are reported, default value is 10\n");
+	printf("    -filter <text> - run only the cases with the text in the name (gauss, canny, edt, objectdetection, remap,\n");
+	printf("      edrfast, edrvector, si1, si2, si3, si3deblur, srcnn, meowarping, deblurtv, metrics)\n");
+	printf("    -models <dir> - directory of srcnn.bin and si*.bin, the cases without a model are skipped\n");
+	printf("    -out <filename> - write the results as JSON\n");
+	printf("    -baseline <filename> - compare with the JSON of a previous run, the exit code is 2 on a regression\n");
+	printf("    -tolerance <value> - allowed slowdown against the baseline, default value is 0.1 (10%%)\n\n");
+
+	printf("  verify - compare the optimized paths with their references on generated images (no input images)\n");
+	printf("    -filter <text> - run only the checks with the text in the name (convert, planar, half, tiled, solve, remap, isa, fixed)\n");
+	printf("    -models <dir> - directory of srcnn.bin and si*.bin, the checks without a model are skipped\n");
+	printf("    the exit code is 1 if a check fails\n\n");
+
+	printf("  pack - convert coefficients into the model file format\n");
+	printf("    -method <method_name> - one of 'srcnn', 'si1', 'si2', 'si3', 'si1deblur', 'si2deblur', 'si3deblur' (<input> <output>)\n");
+	printf("      or 'edr' (<output>, the built-in kernels of the vector EDR)\n");
+	printf("    -fp16 - store the coefficients as half-precision floats\n\n");
+
 	printf("  help - display this screen\n\n");
 	printf("  other operations coming soon...\n\n");
 	printf("Formats supported by GdiPlus library can be used: BMP, PNG, JPEG, GIF, TIFF\n");
@@ -295,17 +375,14 @@ void ProcessBasicEdges(int argc, wchar_t **argv)
 	ImageIO::ToFile(res, output_image);
 }
 
+// Single run in seconds, the 'bench' operation measures repeatable timings
 float MeasureExecution(std::function<void()> func)
 {
-	LARGE_INTEGER pFreq, start, stop;
-	QueryPerformanceFrequency(&pFreq);
-	QueryPerformanceCounter(&start);
-	
-	func();
+	auto start = std::chrono::steady_clock::now();
 
-	QueryPerformanceCounter(&stop);
+	func();
 
-	return (float)(stop.QuadPart - start.QuadPart) / pFreq.QuadPart;
+	return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
 }
 
 ImageByteColor OpenImageByteColor(wchar_t *filename)
@@ -321,7 +398,7 @@ ImageByteColor OpenImageByteColor(wchar_t *filename)
 	return res;
 }
 
-std::vector<char> ReadBin(wchar_t *filename)
+std::vector<char> ReadBin(const wchar_t *filename)
 {
 	std::fstream fs;
 	fs.open(filename, fstream::in | fstream::binary | fstream::ate);
@@ -344,10 +421,60 @@ std::vector<char> ReadBin(wchar_t *filename)
 	return res;	
 }
 
+// Both the model files and the legacy raw coefficient files are accepted
+void LoadSICoefficients(SIResampling &sir, const wchar_t *filename)
+{
+	if (ModelFile::IsModelFile(filename))
+	{
+		ModelFile model(filename);
+
+		if (!model || !sir.LoadModel(model))
+		{
+			wprintf(L"Invalid model file %s\n", filename);
+			exit(1);
+		}
+	}
+	else
+	{
+		vector<char> bin = ReadBin(filename);
+
+		if (!sir.LoadCoefficientData(bin.data(), bin.size()))
+		{
+			wprintf(L"Invalid coefficient file %s\n", filename);
+			exit(1);
+		}
+	}
+}
+
+// Both the model files and the raw kernel files of 'train -method edr' are accepted
+void LoadEDRCoefficients(EDRVector &edr, const wchar_t *filename)
+{
+	if (ModelFile::IsModelFile(filename))
+	{
+		ModelFile model(filename);
+
+		if (!model || !edr.LoadModel(model))
+		{
+			wprintf(L"Invalid model file %s\n", filename);
+			exit(1);
+		}
+	}
+	else
+	{
+		vector<char> bin = ReadBin(filename);
+
+		if (!edr.LoadCoefficientData(bin.data(), bin.size()))
+		{
+			wprintf(L"Invalid coefficient file %s\n", filename);
+			exit(1);
+		}
+	}
+}
+
 void ProcessResample(int argc, wchar_t **argv)
 {
 	wchar_t *input_image = nullptr, *output_image = nullptr, *method = nullptr, *cfile = nullptr;
-	bool selfsim = false, half_shift = false;
+	bool selfsim = false, half_shift = false, fixed = false, half = false;
 
 	for (int i = 0; i < argc; i++)
 	{
@@ -355,6 +482,14 @@ void ProcessResample(int argc, wchar_t **argv)
 		{
 			selfsim = true;
 		}
+		else if (lstrcmp(argv[i], L"-fixed") == 0)
+		{
+			fixed = true;
+		}
+		else if (lstrcmp(argv[i], L"-half") == 0)
+		{
+			half = true;
+		}
 		else if (lstrcmp(argv[i], L"-method") == 0)
 		{
 			++i;
@@ -396,22 +531,45 @@ void ProcessResample(int argc, wchar_t **argv)
 	if (output_image == nullptr)
 		Fault(L"No output image specified");
 
+	SIResampling::Precision si_precision = fixed ? SIResampling::Precision::Fixed16 : SIResampling::Precision::Float;
+	const char *precision_name = fixed ? "fixed16" : "float";
+
 	if (method == nullptr || lstrcmp(method, L"edr") == 0)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 		EDRVector edr;
 
+		if (cfile != nullptr)
+			LoadEDRCoefficients(edr, cfile);
+
 		if (selfsim)
 		{
-			printf("Self-similary is not implemented yet\n");
+			float learning = MeasureExecution([&]()
+			{
+				ImageByteColor tmp(src.Width(), src.Height());
+				ImageByteColor lr(src.Width() / 2, src.Height() / 2);
+
+				GaussFilter(src, tmp, 0.7f);
+				for (int j = 0; j < lr.Height(); j++)
+					for (int i = 0; i < lr.Width(); i++)
+						lr(i, j) = tmp(i * 2, j * 2);
+
+				edr.LearnStep1(lr, src);
+				edr.UpdateCoefficientsStep1();
+				edr.LearnStep2(lr, src);
+				edr.UpdateCoefficientsStep2();
+			});
+
+			printf("Self-similarity learning time: %.3f ms\n", learning * 1e3f);
 		}
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(edr.Perform(src));
+			dst.swap(edr.Perform(src, fixed ? EDRVector::Precision::Fixed16 : EDRVector::Precision::Float));
 		});
 
-		printf("Resampling EDR %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Resampling EDR (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -436,21 +594,23 @@ void ProcessResample(int argc, wchar_t **argv)
 		if (half_shift)
 			printf("Half-shift will be used\n");
 
-		SRCNN srcnn(cfile);
+		if (half)
+			printf("The intermediate layer will be stored in half precision\n");
 
-		LARGE_INTEGER pFreq, start, stop;
-		QueryPerformanceFrequency(&pFreq);
-		QueryPerformanceCounter(&start);
+		SRCNN srcnn(cfile);
 
-		bool s_res = srcnn.Resample_x2_915(src, res, half_shift);
+		bool s_res;
 
-		QueryPerformanceCounter(&stop);
+		float time = MeasureExecution([&]()
+		{
+			s_res = srcnn.Resample_x2_915(src, res, half_shift, half ? SRCNN::Precision::Half : SRCNN::Precision::Float);
+		});
 
 		if (!s_res)
 			printf("Error loading SRCNN coefficients\n");
 
 		printf("Resampling SRCNN %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), res.Width(), res.Height(),
-			(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
+			time * 1e3f);
 
 		ImageIO::ToFile(res, output_image);
 	}
@@ -458,15 +618,16 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si1.bin");
-		SIResampling sir{ SIResampling::Mode::SI1, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI1 };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si1.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.Perform(src));
+			dst.swap(sir.Perform(src, si_precision));
 		});
 
-		printf("Resampling SI1 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Resampling SI1 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -474,15 +635,16 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si2.bin");
-		SIResampling sir{ SIResampling::Mode::SI2, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI2 };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si2.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.Perform(src));
+			dst.swap(sir.Perform(src, si_precision));
 		});
 
-		printf("Resampling SI2 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Resampling SI2 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -490,15 +652,16 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si3.bin");
-		SIResampling sir{ SIResampling::Mode::SI3, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI3 };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si3.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.Perform(src));
+			dst.swap(sir.Perform(src, si_precision));
 		});
 
-		printf("Resampling SI3 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Resampling SI3 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -506,15 +669,16 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si1deblur.bin");
-		SIResampling sir{ SIResampling::Mode::SI1Deblur, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI1Deblur };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si1deblur.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.PerformDeblur(src));
+			dst.swap(sir.PerformDeblur(src, si_precision));
 		});
 
-		printf("Deblurring SI1 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Deblurring SI1 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -522,15 +686,16 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si2deblur.bin");
-		SIResampling sir{ SIResampling::Mode::SI2Deblur, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI2Deblur };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si2deblur.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.PerformDeblur(src));
+			dst.swap(sir.PerformDeblur(src, si_precision));
 		});
 
-		printf("Deblurring SI2 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Deblurring SI2 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
@@ -538,194 +703,24 @@ void ProcessResample(int argc, wchar_t **argv)
 	{
 		ImageByteColor src = OpenImageByteColor(input_image), dst;
 
-		vector<char> bin = ReadBin(cfile != nullptr ? cfile : L"si3deblur.bin");
-		SIResampling sir{ SIResampling::Mode::SI3Deblur, bin.data(), bin.size() };
+		SIResampling sir{ SIResampling::Mode::SI3Deblur };
+		LoadSICoefficients(sir, cfile != nullptr ? cfile : L"si3deblur.bin");
 
 		float time = MeasureExecution([&]()
 		{
-			dst.swap(sir.PerformDeblur(src));
+			dst.swap(sir.PerformDeblur(src, si_precision));
 		});
 
-		printf("Deblurring SI3 %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(), time * 1e3f);
+		printf("Deblurring SI3 (%s) %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", precision_name, src.Width(), src.Height(),
+			dst.Width(), dst.Height(), time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
 
 		ImageIO::ToFile(dst, output_image);
 	}
-
-
-	/*
-
-
-
-#ifndef LEGACY
-	if (method == nullptr || lstrcmp(method, L"edrfast") == 0)
-	{
-		if (!grayscale)
-		{
-			ImageFloatColor src = ImageIO::FromFile<PixelFloatRGBA>(input_image);
-			if (!src)
-			{
-				wprintf(L"Error opening file %s\n", input_image);
-				exit(1);
-			}
-
-			ImageFloatColor dst(src.Width() * 2, src.Height() * 2);
-
-			LARGE_INTEGER pFreq, start, stop;
-			QueryPerformanceFrequency(&pFreq);
-			QueryPerformanceCounter(&start);
-
-			EDR_Resampling_x2(src, dst);
-
-			QueryPerformanceCounter(&stop);
-
-			printf("Resampling EDR (fast, color) %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(),
-				(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
-
-			ImageIO::ToFile(dst, output_image);
-		}
-		else
-		{
-			ImageFloat src = ImageIO::FromFile<float>(input_image);
-			if (!src)
-			{
-				wprintf(L"Error opening file %s\n", input_image);
-				exit(1);
-			}
-
-			ImageFloat dst(src.Width() * 2, src.Height() * 2);
-
-			LARGE_INTEGER pFreq, start, stop;
-			QueryPerformanceFrequency(&pFreq);
-			QueryPerformanceCounter(&start);
-
-			EDR_Resampling_x2(src, dst);
-
-			QueryPerformanceCounter(&stop);
-
-			printf("Resampling EDR (fast, gray) %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(),
-				(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
-
-			ImageByte fix(dst.Width(), dst.Height());
-			for (int j = 0; j < dst.Height(); j++)
-				for (int i = 0; i < dst.Width(); i++)
-					fix(i, j) = f2b(dst(i, j));
-
-			ImageIO::ToFile(fix, output_image);
-		}
-	}
-	else if (lstrcmp(method, L"edrvector") == 0)
-	{
-		{
-			ImageByteColor src = ImageIO::FromFile<PixelByteRGBA>(input_image);
-			if (!src)
-			{
-				wprintf(L"Error opening file %s\n", input_image);
-				exit(1);
-			}
-
-			LARGE_INTEGER pFreq, start, stop;
-			QueryPerformanceFrequency(&pFreq);
-			QueryPerformanceCounter(&start);
-
-			EDRVector edr;
-			ImageByteColor dst = edr.Perform(src);
-
-			QueryPerformanceCounter(&stop);
-
-			printf("Resampling EDR (vector, color) %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), dst.Width(), dst.Height(),
-				(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
-
-			ImageIO::ToFile(dst, output_image);
-		}
-	}
-	else
-#endif
-		
-	if (method == nullptr || lstrcmp(method, L"edr") == 0)
-	{
-		ImageFloatColor src = ImageIO::FromFile<PixelFloatRGBA>(input_image);
-		if (!src)
-		{
-			wprintf(L"Error opening file %s\n", input_image);
-			exit(1);
-		}
-
-		printf("Using EDR image resampling algorithm\n");
-
-		if (selfsim)
-			wprintf(L"Using the input image as the source of kernel coefficients\n");
-		else
-			wprintf(L"Using the default coefficients\n");
-
-		if (fast)
-			wprintf(L"Fast weight calculation is turned on\n");
-
-		ImageFloatColor res(src.Width() * 2, src.Height() * 2);
-
-		EDResamplingExt edr;
-		edr.Configure(fast);
-
-		if (selfsim)
-		{
-			ImageFloatColor tmp(src.Width(), src.Height());
-			ImageFloatColor lr(src.Width() / 2, src.Height() / 2);
-
-			GaussFilter(src, tmp, 0.7f);
-			for (int j = 0; j < lr.Height(); j++)
-				for (int i = 0; i < lr.Width(); i++)
-					lr(i, j) = tmp(i * 2, j * 2);
-
-			edr.LearnStep1(lr, src);
-			edr.UpdateCoefficientsStep1();
-			edr.LearnStep2(lr, src);
-			edr.UpdateCoefficientsStep2();
-		}
-
-		LARGE_INTEGER pFreq, start, stop;
-		QueryPerformanceFrequency(&pFreq);
-		QueryPerformanceCounter(&start);
-
-		edr.Perform(src, res, EDResampling::Mode::Isotropic);
-
-		QueryPerformanceCounter(&stop);
-		printf("Resampling EDR (color) %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), res.Width(), res.Height(),
-			(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
-		ImageIO::ToFile(res, output_image);
-	}
-	else if (lstrcmp(method, L"srcnn") == 0)
-	{
-		ImageFloat src = ImageIO::FromFile<float>(input_image);
-		if (!src)
-		{
-			wprintf(L"Error opening file %s\n", input_image);
-			exit(1);
-		}
-
-		printf("Using SRCNN image resampling algorithm\n");
-		printf("The output will be grayscale\n");
-
-		ImageFloat res(src.Width() * 2, src.Height() * 2);
-
-		LARGE_INTEGER pFreq, start, stop;
-		QueryPerformanceFrequency(&pFreq);
-		QueryPerformanceCounter(&start);
-
-		SRCNN_Resampling_x2(src, res);
-
-		QueryPerformanceCounter(&stop);
-		printf("Resampling SRCNN %dx%d -> %dx%d execution time: %.3f ms\n", src.Width(), src.Height(), res.Width(), res.Height(),
-			(stop.QuadPart - start.QuadPart) * 1e3f / pFreq.QuadPart);
-
-		ImageIO::ToFile(res, output_image);
-	}
-	else if (lstrcmp(method, L"si1") == 0)
-	{
-		printf("Sorry, we plan to implement the algorithm in C++ but we are too lazy\n");
-	}
 	else
 	{
 		wprintf(L"Unknown method - %s\n", method);
-	} */
+		exit(1);
+	}
 }
 
 class TP
@@ -821,8 +816,25 @@ void TestEDT()
 	}
 }
 
+void PrintSILearningProgress(const SIResampling::LearningProgress &progress)
+{
+	if (progress.stage == SIResampling::LearningProgress::Stage::Accumulation)
+	{
+		printf("Learning stats per class: min = %d, aver = %d, max = %d\n", progress.min, progress.aver, progress.max);
+	}
+	else
+	{
+		printf("\rSolving class %d of %d", progress.solved, SIResampling::ClassCount);
+
+		if (progress.solved == SIResampling::ClassCount)
+			printf("\n");
+	}
+}
+
 void LearnSIResampling(SIResampling &sir, const std::vector<wchar_t*> hr_files, const std::vector<wchar_t*> lr_files)
 {
+	sir.SetLearningCallback(PrintSILearningProgress);
+
 	for (size_t i = 0; i < hr_files.size(); i++)
 	{
 		wchar_t *hr_file = hr_files[i];
@@ -873,14 +885,12 @@ void LearnSIResampling(SIResampling &sir, const std::vector<wchar_t*> hr_files,
 		}
 	}
 
-	int min, aver, max;
-	sir.GetLearningStats(min, aver, max);
-
-	printf("Learning stats per class: min = %d, aver = %d, max = %d\n", min, aver, max);
 }
 
 void LearnSIDeblur(SIResampling &sir, const std::vector<wchar_t*> hr_files, const std::vector<wchar_t*> lr_files)
 {
+	sir.SetLearningCallback(PrintSILearningProgress);
+
 	for (size_t i = 0; i < hr_files.size(); i++)
 	{
 		wchar_t *hr_file = hr_files[i];
@@ -918,23 +928,14 @@ void LearnSIDeblur(SIResampling &sir, const std::vector<wchar_t*> hr_files, cons
 		}
 	}
 
-	int min, aver, max;
-	sir.GetLearningStats(min, aver, max);
-
-	printf("Learning stats per class: min = %d, aver = %d, max = %d\n", min, aver, max);
 }
 
-void StoreSICoefficients(SIResampling &sir, const wchar_t *filename)
+void StoreSICoefficients(SIResampling &sir, const wchar_t *filename, ModelDataType type)
 {
 	sir.PerformLearning();
 
-	size_t size = sir.SaveCoefficientData(nullptr, 0);
-	std::unique_ptr<char[]> data(new char[size]);
-	sir.SaveCoefficientData(data.get(), size);
-
-	FILE *F = _wfopen(filename, L"wb");
-	fwrite(data.get(), 1, size, F);
-	fclose(F);
+	if (!sir.SaveModel(filename, type))
+		Fault(L"Cannot create the output file");
 }
 
 void ProcessTrain(int argc, wchar_t **argv)
@@ -942,6 +943,7 @@ void ProcessTrain(int argc, wchar_t **argv)
 	wchar_t *method = nullptr, *out_filename = nullptr;
 	std::vector<wchar_t*> hr_files;
 	std::vector<wchar_t*> lr_files;
+	ModelDataType type = ModelDataType::Float32;
 
 	for (int i = 0; i < argc; i++)
 	{
@@ -974,6 +976,10 @@ void ProcessTrain(int argc, wchar_t **argv)
 			else
 				out_filename = argv[i];
 		}
+		else if (lstrcmp(argv[i], L"-fp16") == 0)
+		{
+			type = ModelDataType::Float16;
+		}
 		else
 		{
 			hr_files.push_back(argv[i]);
@@ -986,43 +992,73 @@ void ProcessTrain(int argc, wchar_t **argv)
 
 	if ((method == nullptr) || (lstrcmp(method, L"edr") == 0))
 	{
+		std::vector<std::wstring> hr, lr;
+
+		for (size_t i = 0; i < hr_files.size(); i++)
+		{
+			hr.push_back(hr_files[i]);
+			lr.push_back(lr_files[i] != nullptr ? lr_files[i] : L"");
+		}
+
+		printf("Learning EDR coefficients from %d images\n", (int)hr.size());
+
+		EDResamplingExt edr;
+		std::vector<EDResamplingExt::SkippedImage> skipped;
+
+		float time = MeasureExecution([&]()
+		{
+			skipped = edr.Learn(hr, lr);
+		});
+
+		for (auto &s : skipped)
+			wprintf(L"The training image %s %s, skipped\n", s.file.c_str(), s.reason.c_str());
+
+		printf("Learning time: %.3f s\n", time);
+
+		EDResampling::Kernels kernels = edr.GetKernels();
+
+		FILE *F = _wfopen(out_filename != nullptr ? out_filename : L"edr.bin", L"wb");
+		if (F == nullptr)
+			Fault(L"Cannot create the output file");
 
+		fwrite(&kernels, sizeof(kernels), 1, F);
+		fclose(F);
 	}
 	else if (lstrcmp(method, L"si1") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI1);
 		LearnSIResampling(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si1.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si1.bin", type);
 	}
 	else if (lstrcmp(method, L"si2") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI2);
 		LearnSIResampling(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si2.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si2.bin", type);
 	}
 	else if (lstrcmp(method, L"si3") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI3);
 		LearnSIResampling(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si3.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si3.bin", type);
 	}
 	else if (lstrcmp(method, L"si1deblur") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI1Deblur);
 		LearnSIDeblur(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si1deblur.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si1deblur.bin", type);
 	}
 	else if (lstrcmp(method, L"si2deblur") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI2Deblur);
 		LearnSIDeblur(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si2deblur.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si2deblur.bin", type);
 	}
 	else if (lstrcmp(method, L"si3deblur") == 0)
 	{
 		SIResampling sir(SIResampling::Mode::SI3Deblur);
 		LearnSIDeblur(sir, hr_files, lr_files);
-		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si3deblur.bin");
+		StoreSICoefficients(sir, out_filename != nullptr ? out_filename : L"si3deblur.bin", type);
 	}
 	else
 	{
@@ -1030,214 +1066,91 @@ void ProcessTrain(int argc, wchar_t **argv)
 	}
 }
 
-void PerfTest()
+void ProcessPack(int argc, wchar_t **argv)
 {
-	const int N = 512;
+	wchar_t *method = nullptr;
+	std::vector<wchar_t*> files;
+	ModelDataType type = ModelDataType::Float32;
 
-	Image<float> img1f(N, N), img2f(N, N);
-	Image<byte> img1b(N, N), img2b(N, N);
-
-	for (int j = 0; j < img1f.Height(); j++)
-		for (int i = 0; i < img1f.Width(); i++)
-		{
-			img1f(i, j) = img2f(i, j) = 3 * i + j;
-			img1b(i, j) = img2b(i, j) = 3 * i + j;
-		}
-
-	long long freq = _Query_perf_frequency();
-	long long t0 = _Query_perf_counter();
-
-	for (int j = 1; j < img1f.Height() - 1; j++)
+	for (int i = 0; i < argc; i++)
 	{
-		float *l0 = img1f.pixeladdr(1, j - 1);
-		float *l1 = img1f.pixeladdr(1, j);
-		float *l2 = img1f.pixeladdr(1, j + 1);
-		float *dst = img2f.pixeladdr(1, j);
-
-		for (int i = 1; i < img1f.Width(); i++)
+		if (lstrcmp(argv[i], L"-method") == 0)
 		{
-			float q1 = l0[-1] + l0[1] + l2[-1] + l2[1];
-			float q2 = l0[0] + l1[-1] + l1[1] + l2[0];
-			float q4 = l1[0];
-
-			*dst = (q1 + 2.0f * q2 + 4.0f * q4) * (1.0f / 16.0f);
-
-			l0++;
-			l1++;
-			l2++;
-			dst++;
+			++i;
+			if (i == argc)
+				Fault(L"Missing argument for -method");
+			else
+				method = argv[i];
 		}
-	}
-
-	check(img2f(10, 10) == 40.0f);
-
-	long long t1 = _Query_perf_counter();
-
-	for (int j = 1; j < img1b.Height() - 1; j++)
-	{
-		byte *l0 = img1b.pixeladdr(1, j - 1);
-		byte *l1 = img1b.pixeladdr(1, j);
-		byte *l2 = img1b.pixeladdr(1, j + 1);
-		byte *dst = img2b.pixeladdr(1, j);
-
-		for (int i = 1; i < img1f.Width(); i++)
+		else if (lstrcmp(argv[i], L"-fp16") == 0)
 		{
-			int q1 = l0[-1] + l0[1] + l2[-1] + l2[1];
-			int q2 = l0[0] + l1[-1] + l1[1] + l2[0];
-			int q4 = l1[0];
-
-			*dst = (q1 + 2 * q2 + 4 * q4) >> 4;
-
-			l0++;
-			l1++;
-			l2++;
-			dst++;
+			type = ModelDataType::Float16;
 		}
-	}
-
-	check(img2b(10, 10) == 40);
-
-	long long t2 = _Query_perf_counter();
-
-	const __m128 m16 = _mm_set1_ps(1.0f / 16.0f);
-
-	for (int j = 1; j < img1f.Height() - 1; j++)
-	{
-		float *l0 = img1f.pixeladdr(1, j - 1);
-		float *l1 = img1f.pixeladdr(1, j);
-		float *l2 = img1f.pixeladdr(1, j + 1);
-		float *dst = img2f.pixeladdr(1, j);
-
-		// We do not care about boundary processing. Just benchmark.
-		for (int i = 1; i < img1f.Width() - 4; i += 4)
+		else
 		{
-			__m128 q1 = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(l0 - 1), _mm_loadu_ps(l0 + 1)), _mm_add_ps(_mm_loadu_ps(l2 - 1), _mm_loadu_ps(l2 + 1)));
-			__m128 q2 = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(l0), _mm_loadu_ps(l2)), _mm_add_ps(_mm_loadu_ps(l1 - 1), _mm_loadu_ps(l1 + 1)));
-			__m128 q4 = _mm_loadu_ps(l1);
-			q2 = _mm_add_ps(q2, q2);
-			q4 = _mm_add_ps(q4, q4);
-			__m128 res = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(q4, q4), q2), q1), m16);
-			_mm_storeu_ps(dst, res);
-
-			l0 += 4;
-			l1 += 4;
-			l2 += 4;
-			dst += 4;
+			files.push_back(argv[i]);
 		}
 	}
 
-	check(img2f(10, 10) == 40.0f);
+	if (method == nullptr)
+		Fault(L"No method specified");
 
-	long long t3 = _Query_perf_counter();
-
-	const __m256 q16 = _mm256_set1_ps(1.0f / 16.0f);
-
-	for (int j = 1; j < img1f.Height() - 1; j++)
+	static const struct { const wchar_t *name; SIResampling::Mode mode; } si_modes[] =
 	{
-		float *l0 = img1f.pixeladdr(1, j - 1);
-		float *l1 = img1f.pixeladdr(1, j);
-		float *l2 = img1f.pixeladdr(1, j + 1);
-		float *dst = img2f.pixeladdr(1, j);
+		{ L"si1", SIResampling::Mode::SI1 },
+		{ L"si2", SIResampling::Mode::SI2 },
+		{ L"si3", SIResampling::Mode::SI3 },
+		{ L"si1deblur", SIResampling::Mode::SI1Deblur },
+		{ L"si2deblur", SIResampling::Mode::SI2Deblur },
+		{ L"si3deblur", SIResampling::Mode::SI3Deblur },
+	};
+
+	if (lstrcmp(method, L"edr") == 0)
+	{
+		// The vector EDR has built-in kernels only, so there is no input file
+		if (files.size() != 1)
+			Fault(L"Expected the output file");
 
-		// We do not care about boundary processing. Just benchmark.
-		for (int i = 1; i < img1f.Width() - 8; i += 8)
-		{
-			__m256 q1 = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(l0 - 1), _mm256_load_ps(l0 + 1)), _mm256_add_ps(_mm256_load_ps(l2 - 1), _mm256_load_ps(l2 + 1)));
-			__m256 q2 = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(l0), _mm256_load_ps(l2)), _mm256_add_ps(_mm256_load_ps(l1 - 1), _mm256_load_ps(l1 + 1)));
-			__m256 q4 = _mm256_load_ps(l1);
-			q2 = _mm256_add_ps(q2, q2);
-			q4 = _mm256_add_ps(q4, q4);
-			__m256 res = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(q4, q4), q2), q1), q16);
-			_mm256_storeu_ps(dst, res);
+		EDRVector edr;
+		ModelFileWriter writer;
+		edr.SaveModel(writer, type);
 
-			l0 += 8;
-			l1 += 8;
-			l2 += 8;
-			dst += 8;
-		}
-	}
+		if (!writer.Save(files[0]))
+			Fault(L"Cannot create the output file");
 
-	check(img2f(10, 10) == 40.0f);
+		return;
+	}
 
-	long long t4 = _Query_perf_counter();
+	if (files.size() != 2)
+		Fault(L"Expected the input and the output files");
 
-	for (int j = 1; j < img1f.Height() - 1; j++)
+	if (lstrcmp(method, L"srcnn") == 0)
 	{
-		float *l0 = img1f.pixeladdr(1, j - 1);
-		float *l1 = img1f.pixeladdr(1, j);
-		float *l2 = img1f.pixeladdr(1, j + 1);
-		float *dst = img2f.pixeladdr(1, j);
+		SRCNN srcnn(files[0]);
+		if (!srcnn)
+			Fault(L"Cannot load SRCNN coefficients");
 
-		// We do not care about boundary processing. Just benchmark.
-		for (int i = 1; i < img1f.Width() - 8; i += 8)
-		{
-			__m256 q1 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(l0 - 1), _mm256_loadu_ps(l0 + 1)), _mm256_add_ps(_mm256_loadu_ps(l2 - 1), _mm256_loadu_ps(l2 + 1)));
-			__m256 q2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(l0), _mm256_loadu_ps(l2)), _mm256_add_ps(_mm256_loadu_ps(l1 - 1), _mm256_loadu_ps(l1 + 1)));
-			__m256 q4 = _mm256_loadu_ps(l1);
-			q2 = _mm256_add_ps(q2, q2);
-			q4 = _mm256_add_ps(q4, q4);
-			__m256 res = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(q4, q4), q2), q1), q16);
-			_mm256_storeu_ps(dst, res);
+		if (!srcnn.SaveModel(files[1], type))
+			Fault(L"Cannot create the output file");
 
-			l0 += 8;
-			l1 += 8;
-			l2 += 8;
-			dst += 8;
-		}
+		return;
 	}
 
-	check(img2f(10, 10) == 40.0f);
-
-	long long t5 = _Query_perf_counter();
-
-	for (int j = 1; j < img1b.Height() - 1; j++)
+	for (auto &si : si_modes)
 	{
-		byte *l0 = img1b.pixeladdr(1, j - 1);
-		byte *l1 = img1b.pixeladdr(1, j);
-		byte *l2 = img1b.pixeladdr(1, j + 1);
-		byte *dst = img2b.pixeladdr(1, j);
-
-		for (int i = 1; i < img1f.Width() - 8; i += 8)
+		if (lstrcmp(method, si.name) == 0)
 		{
-			__m128i v1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l0 - 1)), _mm_setzero_si128());
-			__m128i v2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l0 + 1)), _mm_setzero_si128());
-			__m128i v3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l2 - 1)), _mm_setzero_si128());
-			__m128i v4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l2 + 1)), _mm_setzero_si128());
-			__m128i q1 = _mm_add_epi16(_mm_add_epi16(v1, v2), _mm_add_epi16(v3, v4));
-
-			__m128i v5 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l0)), _mm_setzero_si128());
-			__m128i v6 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l2)), _mm_setzero_si128());
-			__m128i v7 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l1 - 1)), _mm_setzero_si128());
-			__m128i v8 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l1 + 1)), _mm_setzero_si128());
-			__m128i q2 = _mm_add_epi16(_mm_add_epi16(v5, v6), _mm_add_epi16(v7, v8));
+			SIResampling sir{ si.mode };
+			LoadSICoefficients(sir, files[0]);
 
-			__m128i q4 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(l1)), _mm_setzero_si128());
+			if (!sir.SaveModel(files[1], type))
+				Fault(L"Cannot create the output file");
 
-			q2 = _mm_add_epi16(q2, q2);
-			q4 = _mm_add_epi16(q4, q4);
-			__m128i res = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(q4, q4), q2), q1), 4), _mm_setzero_si128());
-
-			_mm_storel_epi64((__m128i*)dst, res);
-
-			l0 += 8;
-			l1 += 8;
-			l2 += 8;
-			dst += 8;
+			return;
 		}
 	}
 
-	check(img2b(10, 10) == 40);
-
-	long long t6 = _Query_perf_counter();
-
-	printf("float: %lld us\n", (t1 - t0) * 1000000 / freq);
-	printf("byte: %lld us\n", (t2 - t1) * 1000000 / freq);
-	printf("float sse: %lld us\n", (t3 - t2) * 1000000 / freq);
-	printf("float avx (aligned): %lld us\n", (t4 - t3) * 1000000 / freq);
-	printf("float avx (unaligned): %lld us\n", (t5 - t4) * 1000000 / freq);
-	printf("byte sse: %lld us\n", (t6 - t5) * 1000000 / freq);
-
-	getchar();
+	Fault(L"Unsupported method");
 }
 
 void ProcessGTV(int argc, wchar_t **argv)
@@ -1274,18 +1187,963 @@ void ProcessGTV(int argc, wchar_t **argv)
 	ImageIO::ToFile(dst, argv[2]);
 }
 
-int wmain(int argc, wchar_t **argv)
+void AddDirectoryPairs(MetricsBatch &batch, const wchar_t *ref_dir, const wchar_t *cand_dir)
 {
-	// PerfTest();
+	WIN32_FIND_DATAW fd;
+	HANDLE h = FindFirstFileW((std::wstring(ref_dir) + L"\\*").c_str(), &fd);
 
-	printf("DemoImageProcessing, build %s\n", ip::CompileDateTime);
-	printf("(c) Laboratory of Mathematical Methods of Image Processing\n");
-	printf("Faculty of Computational Mathematics and Cybernetics\n");
-	printf("Lomonosov Moscow State University\n");		
-	printf("http://imaging.cs.msu.ru/ Contact nasonov@cs.msu.ru\n\n");
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		wprintf(L"Cannot read directory %s\n", ref_dir);
+		exit(1);
+	}
 
-	if (argc <= 1)
-		DisplayHelp();
+	do
+	{
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		std::wstring candidate = std::wstring(cand_dir) + L"\\" + fd.cFileName;
+
+		if (GetFileAttributesW(candidate.c_str()) == INVALID_FILE_ATTRIBUTES)
+		{
+			wprintf(L"No candidate for %s, skipped\n", fd.cFileName);
+			continue;
+		}
+
+		batch.AddPair(std::wstring(ref_dir) + L"\\" + fd.cFileName, candidate);
+	} while (FindNextFileW(h, &fd));
+
+	FindClose(h);
+}
+
+void ProcessMetrics(int argc, wchar_t **argv)
+{
+	std::vector<std::pair<std::wstring, std::wstring>> pairs;
+	std::vector<std::pair<wchar_t*, wchar_t*>> dirs;
+	std::vector<wchar_t*> lists, positional;
+	wchar_t *format = nullptr, *out_filename = nullptr;
+	int metrics = MetricsBatch::MetricAll, io_threads = 2;
+	float sigma = 1.5f;
+	bool rgb = false;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-pair") == 0 || lstrcmp(argv[i], L"-dir") == 0)
+		{
+			if (i + 2 >= argc)
+				Fault(L"Missing arguments for -pair or -dir");
+
+			if (argv[i][1] == L'p')
+				pairs.push_back(std::make_pair(std::wstring(argv[i + 1]), std::wstring(argv[i + 2])));
+			else
+				dirs.push_back(std::make_pair(argv[i + 1], argv[i + 2]));
+
+			i += 2;
+		}
+		else if (lstrcmp(argv[i], L"-list") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -list");
+
+			lists.push_back(argv[i]);
+		}
+		else if (lstrcmp(argv[i], L"-metrics") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -metrics");
+
+			metrics = 0;
+			std::wstring list = argv[i];
+
+			for (size_t pos = 0; pos <= list.size();)
+			{
+				size_t next = list.find(L',', pos);
+				if (next == std::wstring::npos)
+					next = list.size();
+
+				std::wstring name = list.substr(pos, next - pos);
+				int m = 0;
+
+				for (; m < MetricsBatch::MetricCount; m++)
+				{
+					std::string s = MetricsBatch::MetricName(m);
+					if (name == std::wstring(s.begin(), s.end()))
+						break;
+				}
+
+				if (m == MetricsBatch::MetricCount)
+					Fault(L"Invalid parameter for -metrics");
+
+				metrics |= 1 << m;
+				pos = next + 1;
+			}
+		}
+		else if (lstrcmp(argv[i], L"-rgb") == 0)
+		{
+			rgb = true;
+		}
+		else if (lstrcmp(argv[i], L"-sigma") == 0)
+		{
+			i++;
+			if (i == argc)
+				Fault(L"No parameter for -sigma");
+
+			size_t idx;
+			sigma = stof(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || sigma <= 0.0f || sigma > 20.0f)
+				Fault(L"Invalid parameter for -sigma");
+		}
+		else if (lstrcmp(argv[i], L"-format") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -format");
+
+			format = argv[i];
+
+			if (lstrcmp(format, L"csv") != 0 && lstrcmp(format, L"json") != 0)
+				Fault(L"Invalid parameter for -format");
+		}
+		else if (lstrcmp(argv[i], L"-out") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -out");
+
+			out_filename = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-iothreads") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -iothreads");
+
+			size_t idx;
+			io_threads = stoi(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || io_threads <= 0 || io_threads > 64)
+				Fault(L"Invalid parameter for -iothreads");
+		}
+		else
+		{
+			positional.push_back(argv[i]);
+		}
+	}
+
+	if (positional.size() == 2)
+		pairs.push_back(std::make_pair(std::wstring(positional[0]), std::wstring(positional[1])));
+	else if (positional.size() != 0)
+		Fault(L"Invalid number of positional arguments");
+
+	MetricsBatch batch(metrics, rgb ? MetricsBatch::Channels::RGB : MetricsBatch::Channels::Luma, sigma);
+
+	for (auto &p : pairs)
+		batch.AddPair(p.first, p.second);
+
+	for (auto list : lists)
+	{
+		std::wifstream fs(list);
+		if (fs.fail())
+		{
+			wprintf(L"Error opening file %s\n", list);
+			exit(1);
+		}
+
+		std::wstring line;
+		while (std::getline(fs, line))
+		{
+			size_t tab = line.find(L'\t');
+			if (tab == std::wstring::npos)
+				continue;
+
+			batch.AddPair(line.substr(0, tab), line.substr(tab + 1));
+		}
+	}
+
+	for (auto &d : dirs)
+		AddDirectoryPairs(batch, d.first, d.second);
+
+	if (batch.PairCount() == 0)
+		Fault(L"No image pairs provided");
+
+	std::vector<MetricsBatch::Result> results;
+
+	float time = MeasureExecution([&]()
+	{
+		results = batch.Run(io_threads, 2 * io_threads);
+	});
+
+	FILE *F = stdout;
+
+	if (out_filename != nullptr)
+	{
+		F = _wfopen(out_filename, L"w");
+		if (F == nullptr)
+		{
+			wprintf(L"Cannot create file %s\n", out_filename);
+			exit(1);
+		}
+	}
+
+	if (format != nullptr && lstrcmp(format, L"json") == 0)
+		MetricsBatch::WriteJSON(results, F);
+	else
+		MetricsBatch::WriteCSV(results, F);
+
+	if (F != stdout)
+		fclose(F);
+
+	int failed = 0;
+	for (auto &r : results)
+		if (!r.ok)
+			failed++;
+
+	// stderr, so the results written to stdout stay machine-readable
+	fprintf(stderr, "Evaluated %d pairs (%d failed) in %.3f s\n", (int)results.size(), failed, time);
+}
+
+void ProcessPipeline(int argc, wchar_t **argv)
+{
+	wchar_t *input_image = nullptr, *output_image = nullptr, *description = nullptr;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-stages") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -stages");
+
+			description = argv[i];
+		}
+		else if (input_image == nullptr)
+			input_image = argv[i];
+		else if (output_image == nullptr)
+			output_image = argv[i];
+		else
+		{
+			wprintf(L"Invalid argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	if (description == nullptr)
+		Fault(L"Parameter -stages not defined");
+
+	if (input_image == nullptr)
+		Fault(L"No input image specified");
+
+	if (output_image == nullptr)
+		Fault(L"No output image specified");
+
+	Pipeline pipeline(description);
+
+	if (!pipeline)
+	{
+		wprintf(L"Error: %s\n", pipeline.Error().c_str());
+		exit(1);
+	}
+
+	ImageFloatColor img = ImageIO::FromFile<PixelFloatRGBA>(input_image);
+	if (!img)
+	{
+		wprintf(L"Error opening file %s\n", input_image);
+		exit(1);
+	}
+
+	Pipeline::ImageType src(img), dst;
+	std::vector<float> times;
+
+	float time = MeasureExecution([&]()
+	{
+		dst.swap(pipeline.Run(src, &times));
+	});
+
+	for (int g = 0; g < pipeline.GroupCount(); g++)
+		printf("  %s: %.3f ms\n", pipeline.GroupDescription(g).c_str(), times[g] * 1e3f);
+
+	printf("Pipeline %dx%d -> %dx%d execution time: %.3f ms, %.1f MPix/s\n", src.Width(), src.Height(), dst.Width(), dst.Height(),
+		time * 1e3f, dst.Width() * dst.Height() * 1e-6f / time);
+
+	// The only quantization of the pipeline
+	ImageByteColor res(dst.Width(), dst.Height());
+	Merge(dst, res);
+
+	ImageIO::ToFile(res, output_image);
+}
+
+void AddDirectoryJobs(PipelineBatch &batch, const wchar_t *input_dir, const wchar_t *output_dir)
+{
+	WIN32_FIND_DATAW fd;
+	HANDLE h = FindFirstFileW((std::wstring(input_dir) + L"\\*").c_str(), &fd);
+
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		wprintf(L"Cannot read directory %s\n", input_dir);
+		exit(1);
+	}
+
+	CreateDirectoryW(output_dir, nullptr);
+
+	do
+	{
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		std::wstring name = fd.cFileName;
+		size_t dot = name.rfind(L'.');
+
+		batch.AddJob(std::wstring(input_dir) + L"\\" + name, std::wstring(output_dir) + L"\\" + name.substr(0, dot) + L".png");
+	} while (FindNextFileW(h, &fd));
+
+	FindClose(h);
+}
+
+void ProcessBatch(int argc, wchar_t **argv)
+{
+	std::vector<std::pair<wchar_t*, wchar_t*>> dirs;
+	std::vector<wchar_t*> lists;
+	wchar_t *description = nullptr, *out_filename = nullptr;
+	int jobs = 2, io_threads = 2;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-stages") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -stages");
+
+			description = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-dir") == 0)
+		{
+			if (i + 2 >= argc)
+				Fault(L"Missing arguments for -dir");
+
+			dirs.push_back(std::make_pair(argv[i + 1], argv[i + 2]));
+			i += 2;
+		}
+		else if (lstrcmp(argv[i], L"-list") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -list");
+
+			lists.push_back(argv[i]);
+		}
+		else if (lstrcmp(argv[i], L"-jobs") == 0 || lstrcmp(argv[i], L"-iothreads") == 0)
+		{
+			bool is_jobs = argv[i][1] == L'j';
+
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -jobs or -iothreads");
+
+			size_t idx;
+			int value = stoi(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || value <= 0 || value > 64)
+				Fault(L"Invalid parameter for -jobs or -iothreads");
+
+			(is_jobs ? jobs : io_threads) = value;
+		}
+		else if (lstrcmp(argv[i], L"-out") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -out");
+
+			out_filename = argv[i];
+		}
+		else
+		{
+			wprintf(L"Invalid argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	if (description == nullptr)
+		Fault(L"Parameter -stages not defined");
+
+	Pipeline pipeline(description);
+
+	if (!pipeline)
+	{
+		wprintf(L"Error: %s\n", pipeline.Error().c_str());
+		exit(1);
+	}
+
+	PipelineBatch batch(pipeline);
+
+	for (auto list : lists)
+	{
+		std::wifstream fs(list);
+		if (fs.fail())
+		{
+			wprintf(L"Error opening file %s\n", list);
+			exit(1);
+		}
+
+		std::wstring line;
+		while (std::getline(fs, line))
+		{
+			size_t tab = line.find(L'\t');
+			if (tab == std::wstring::npos)
+				continue;
+
+			batch.AddJob(line.substr(0, tab), line.substr(tab + 1));
+		}
+	}
+
+	for (auto &d : dirs)
+		AddDirectoryJobs(batch, d.first, d.second);
+
+	if (batch.JobCount() == 0)
+		Fault(L"No images to process");
+
+	std::vector<PipelineBatch::Result> results;
+
+	float time = MeasureExecution([&]()
+	{
+		results = batch.Run(io_threads, jobs);
+	});
+
+	if (out_filename != nullptr)
+	{
+		FILE *F = _wfopen(out_filename, L"w");
+		if (F == nullptr)
+		{
+			wprintf(L"Cannot create file %s\n", out_filename);
+			exit(1);
+		}
+
+		PipelineBatch::WriteCSV(results, F);
+		fclose(F);
+	}
+
+	for (auto &r : results)
+		if (!r.ok)
+			wprintf(r.width > 0 ? L"Error writing file %s\n" : L"Error opening file %s\n", r.width > 0 ? r.output.c_str() : r.input.c_str());
+
+	PipelineBatch::Summary summary = PipelineBatch::Summarize(results, time);
+
+	printf("Processed %d images (%d failed) in %.3f s, %.2f images/s, %.1f MPix/s\n", summary.images, summary.failed, time,
+		summary.images_per_second, summary.megapixels_per_second);
+	printf("Latency per image: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n", summary.p50 * 1e3f, summary.p90 * 1e3f,
+		summary.p99 * 1e3f, summary.max * 1e3f);
+}
+
+void ProcessServe(int argc, wchar_t **argv)
+{
+	// The protocol owns the standard output, everything else printed goes to the standard error
+	fflush(stdout);
+	FILE *out = _fdopen(_dup(_fileno(stdout)), "wb");
+	_dup2(_fileno(stderr), _fileno(stdout));
+	_setmode(_fileno(stdin), _O_BINARY);
+
+	PipelineServer server(stdin, out);
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-load") == 0)
+		{
+			if (i + 2 >= argc)
+				Fault(L"Missing arguments for -load");
+
+			std::wstring error;
+
+			if (!server.Load(argv[i + 1], argv[i + 2], error))
+			{
+				wprintf(L"Error: %s\n", error.c_str());
+				exit(1);
+			}
+
+			i += 2;
+		}
+		else
+		{
+			wprintf(L"Invalid argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	int served = server.Serve();
+	fclose(out);
+
+	printf("Served %d jobs\n", served);
+}
+
+/* Starts 'serve' as a child process and sends it all jobs at once from another thread, so the server batches
+* them and the pipes never block both sides */
+void ProcessClient(int argc, wchar_t **argv)
+{
+	std::vector<std::wstring> inputs;
+	wchar_t *description = nullptr;
+	int repeat = 1;
+	bool raw = false;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-stages") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -stages");
+
+			description = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-repeat") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -repeat");
+
+			size_t idx;
+			repeat = stoi(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || repeat <= 0 || repeat > 1000)
+				Fault(L"Invalid parameter for -repeat");
+		}
+		else if (lstrcmp(argv[i], L"-raw") == 0)
+			raw = true;
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (description == nullptr)
+		Fault(L"Parameter -stages not defined");
+
+	if (inputs.empty())
+		Fault(L"No input image specified");
+
+	// The raw jobs carry the pixels, the images are loaded before the server starts
+	std::vector<ImageByteColor3> images;
+
+	if (raw)
+	{
+		for (auto &input : inputs)
+		{
+			ImageByteColor3 img = ImageIO::FromFile<PixelByteRGB>(input.c_str());
+			if (!img)
+			{
+				wprintf(L"Error opening file %s\n", input.c_str());
+				exit(1);
+			}
+
+			images.push_back(std::move(img));
+		}
+	}
+
+	wchar_t exe[MAX_PATH];
+	GetModuleFileNameW(nullptr, exe, MAX_PATH);
+	std::wstring cmd = L"\"" + std::wstring(exe) + L"\" serve";
+
+	SECURITY_ATTRIBUTES sa = { sizeof(sa), nullptr, TRUE };
+	HANDLE child_in, to_child, from_child, child_out;
+
+	if (!CreatePipe(&child_in, &to_child, &sa, 0) || !CreatePipe(&from_child, &child_out, &sa, 0))
+		Fault(L"Cannot create pipes");
+
+	SetHandleInformation(to_child, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(from_child, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFOW si = { sizeof(si) };
+	si.dwFlags = STARTF_USESTDHANDLES;
+	si.hStdInput = child_in;
+	si.hStdOutput = child_out;
+	si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION pi;
+
+	if (!CreateProcessW(nullptr, &cmd[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &si, &pi))
+		Fault(L"Cannot start the server");
+
+	CloseHandle(child_in);
+	CloseHandle(child_out);
+
+	FILE *to_server = _fdopen(_open_osfhandle((intptr_t)to_child, 0), "wb");
+	FILE *from_server = _fdopen(_open_osfhandle((intptr_t)from_child, _O_RDONLY), "rb");
+
+	int count = (int)inputs.size() * repeat;
+	std::vector<PipelineBatch::Result> results(count);
+	std::vector<std::chrono::steady_clock::time_point> sent(count);
+	std::mutex sent_sync;
+
+	for (int k = 0; k < count; k++)
+	{
+		PipelineBatch::Result &r = results[k];
+		r.input = inputs[k % inputs.size()];
+		r.output = r.input + L".served.png";
+		r.ok = false;
+		r.width = r.height = 0;
+		r.load = r.process = r.save = r.latency = 0.0f;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread sender([&]()
+	{
+		fprintf(to_server, "load\tclient\t%s\n", ToUTF8(description).c_str());
+
+		for (int k = 0; k < count; k++)
+		{
+			{
+				std::lock_guard<std::mutex> lock(sent_sync);
+				sent[k] = std::chrono::steady_clock::now();
+			}
+
+			if (raw)
+			{
+				const ImageByteColor3 &img = images[k % images.size()];
+				fprintf(to_server, "raw\t%d\tclient\t%d\t%d\t3\n", k, img.Width(), img.Height());
+
+				for (int y = 0; y < img.Height(); y++)
+					fwrite(img.pixeladdr(0, y), sizeof(PixelByteRGB), img.Width(), to_server);
+			}
+			else
+				fprintf(to_server, "run\t%d\tclient\t%s\t%s\n", k, ToUTF8(results[k].input).c_str(), ToUTF8(results[k].output).c_str());
+
+			fflush(to_server);
+		}
+
+		fprintf(to_server, "stats\nquit\n");
+		fclose(to_server);
+	});
+
+	// The banner of the server is printed before it takes over the output
+	bool ready = false;
+	int received = 0, errors = 0;
+	char line[4096];
+
+	while (fgets(line, sizeof(line), from_server))
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if (!ready)
+		{
+			ready = strcmp(line, "ready") == 0;
+			continue;
+		}
+
+		int k, width, height, channels, bytes;
+
+		if (sscanf(line, "done\t%d\t%d\t%d\t%d\t%d", &k, &width, &height, &channels, &bytes) == 5 && k >= 0 && k < count)
+		{
+			PipelineBatch::Result &r = results[k];
+			std::vector<byte> payload(bytes);
+
+			if (fread(payload.data(), 1, payload.size(), from_server) != payload.size() || bytes != width * height * channels)
+			{
+				printf("Invalid response: %s\n", line);
+				break;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(sent_sync);
+				r.latency = std::chrono::duration<float>(std::chrono::steady_clock::now() - sent[k]).count();
+			}
+
+			r.ok = true;
+			r.width = width;
+			r.height = height;
+			received++;
+
+			if (raw)
+			{
+				CustomBitmapImage<PixelByteRGB> res;
+				res.Init(payload.data(), width, height, width * channels);
+				ImageIO::ToFile(res, r.output.c_str());
+			}
+
+			printf("%s\n", line);
+		}
+		else
+		{
+			if (strncmp(line, "error", 5) == 0)
+				errors++;
+
+			printf("%s\n", line);
+		}
+	}
+
+	float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+	sender.join();
+	fclose(from_server);
+
+	WaitForSingleObject(pi.hProcess, INFINITE);
+	CloseHandle(pi.hProcess);
+	CloseHandle(pi.hThread);
+
+	if (!ready)
+		Fault(L"The server did not start");
+
+	PipelineBatch::Summary summary = PipelineBatch::Summarize(results, time);
+
+	printf("Received %d of %d results (%d errors) in %.3f s, %.2f images/s, %.1f MPix/s\n", received, count, errors, time,
+		summary.images_per_second, summary.megapixels_per_second);
+	printf("Round trip per job: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n", summary.p50 * 1e3f, summary.p90 * 1e3f,
+		summary.p99 * 1e3f, summary.max * 1e3f);
+}
+
+std::vector<int> ParseIntList(const wchar_t *str, const wchar_t *option)
+{
+	std::vector<int> res;
+	std::wstring s(str);
+	size_t start = 0;
+
+	for (;;)
+	{
+		size_t comma = s.find(L',', start);
+		std::wstring item = s.substr(start, comma == std::wstring::npos ? std::wstring::npos : comma - start);
+
+		size_t idx = 0;
+		int value = -1;
+
+		try
+		{
+			value = stoi(item, &idx);
+		}
+		catch (...)
+		{
+		}
+
+		if (item.empty() || idx != item.size() || value < 0 || value > 16384)
+		{
+			wprintf(L"Invalid parameter for %s\n", option);
+			exit(1);
+		}
+
+		res.push_back(value);
+
+		if (comma == std::wstring::npos)
+			return res;
+
+		start = comma + 1;
+	}
+}
+
+void ProcessBench(int argc, wchar_t **argv)
+{
+	Benchmark::Settings settings;
+	wchar_t *out_filename = nullptr, *baseline_filename = nullptr;
+	std::wstring models;
+	float tolerance = 0.1f;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-sizes") == 0 || lstrcmp(argv[i], L"-threads") == 0)
+		{
+			bool sizes = argv[i][1] == L's';
+
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -sizes or -threads");
+
+			(sizes ? settings.sizes : settings.threads) = ParseIntList(argv[i], sizes ? L"-sizes" : L"-threads");
+
+			if (sizes && std::find(settings.sizes.begin(), settings.sizes.end(), 0) != settings.sizes.end())
+				Fault(L"Invalid parameter for -sizes");
+		}
+		else if (lstrcmp(argv[i], L"-repeats") == 0 || lstrcmp(argv[i], L"-warmup") == 0)
+		{
+			bool repeats = argv[i][1] == L'r';
+
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -repeats or -warmup");
+
+			size_t idx;
+			int value = stoi(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || value < (repeats ? 1 : 0) || value > 1000)
+				Fault(L"Invalid parameter for -repeats or -warmup");
+
+			(repeats ? settings.repeats : settings.warmup) = value;
+		}
+		else if (lstrcmp(argv[i], L"-filter") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -filter");
+
+			settings.filter = std::string(argv[i], argv[i] + wcslen(argv[i]));
+		}
+		else if (lstrcmp(argv[i], L"-models") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -models");
+
+			models = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-out") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -out");
+
+			out_filename = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-baseline") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -baseline");
+
+			baseline_filename = argv[i];
+		}
+		else if (lstrcmp(argv[i], L"-tolerance") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -tolerance");
+
+			size_t idx;
+			tolerance = stof(argv[i], &idx);
+
+			if (idx != lstrlen(argv[i]) || tolerance < 0.0f || tolerance > 10.0f)
+				Fault(L"Invalid parameter for -tolerance");
+		}
+		else
+		{
+			wprintf(L"Invalid argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	std::vector<Benchmark::Result> baseline;
+
+	if (baseline_filename != nullptr && !Benchmark::ReadJSON(baseline_filename, baseline))
+	{
+		wprintf(L"Cannot read the benchmark results from %s\n", baseline_filename);
+		exit(1);
+	}
+
+	Benchmark bench;
+	bench.AddStandardCases(models);
+
+	printf("Warm-up %d, repeats %d\n", settings.warmup, settings.repeats);
+
+	std::vector<Benchmark::Result> results = bench.Run(settings, [](const Benchmark::Result &r)
+	{
+		printf("  %-16s %5dx%-5d %2d threads: median %9.3f ms, p95 %9.3f ms, %8.1f MPix/s\n", r.name.c_str(), r.width, r.height, r.threads,
+			r.median * 1e3f, r.p95 * 1e3f, r.megapixels_per_second);
+	});
+
+	if (out_filename != nullptr)
+	{
+		FILE *F = _wfopen(out_filename, L"w");
+		if (F == nullptr)
+		{
+			wprintf(L"Cannot create file %s\n", out_filename);
+			exit(1);
+		}
+
+		Benchmark::WriteJSON(results, CpuIsaName(GetCpuIsa()), F);
+		fclose(F);
+	}
+
+	if (baseline_filename != nullptr)
+	{
+		printf("\nComparison with the baseline (tolerance %.0f%%):\n", tolerance * 100.0f);
+
+		int regressions = Benchmark::Compare(results, baseline, tolerance, stdout);
+		printf("%d regressions\n", regressions);
+
+		if (regressions > 0)
+			exit(2);
+	}
+}
+
+void ProcessVerify(int argc, wchar_t **argv)
+{
+	std::string filter;
+	std::wstring models;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (lstrcmp(argv[i], L"-filter") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -filter");
+
+			filter = std::string(argv[i], argv[i] + wcslen(argv[i]));
+		}
+		else if (lstrcmp(argv[i], L"-models") == 0)
+		{
+			++i;
+			if (i == argc)
+				Fault(L"No parameter for -models");
+
+			models = argv[i];
+		}
+		else
+		{
+			wprintf(L"Invalid argument: %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	Verification verification;
+	verification.AddStandardChecks(models);
+
+	int failed = 0;
+
+	verification.Run(filter, [&failed](const Verification::Result &r)
+	{
+		const char *status = r.status == Verification::Status::Passed ? "passed" : (r.status == Verification::Status::Failed ? "FAILED" : "skipped");
+		printf("  %-28s %-8s %s\n", r.name.c_str(), status, r.details.c_str());
+
+		if (r.status == Verification::Status::Failed)
+			failed++;
+	});
+
+	printf("%d failed\n", failed);
+
+	if (failed > 0)
+		exit(1);
+}
+
+int wmain(int argc, wchar_t **argv)
+{
+	printf("DemoImageProcessing, build %s\n", ip::CompileDateTime);
+	printf("(c) Laboratory of Mathematical Methods of Image Processing\n");
+	printf("Faculty of Computational Mathematics and Cybernetics\n");
+	printf("Lomonosov Moscow State University\n");		
+	printf("http://imaging.cs.msu.ru/ Contact nasonov@cs.msu.ru\n\n");
+
+	if (argc <= 1)
+		DisplayHelp();
+
+	if (lstrcmp(argv[1], L"-isa") == 0)
+	{
+		if (argc <= 3)
+			DisplayHelp();
+
+		std::string name(argv[2], argv[2] + wcslen(argv[2]));
+		CpuIsa isa;
+
+		if (!ParseCpuIsa(name.c_str(), isa))
+			Fault(L"Unknown instruction set");
+
+		if (!SetCpuIsa(isa))
+			Fault(L"The instruction set is not supported by the processor");
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	printf("Vector kernels: %s\n\n", CpuIsaName(GetCpuIsa()));
+
+	// Reuse the scratch planes between the processing stages
+	ImagePool pool;
 
 	if (lstrcmp(argv[1], L"warp") == 0)
 		ProcessWarp(argc - 2, argv + 2);
@@ -1299,6 +2157,22 @@ int wmain(int argc, wchar_t **argv)
 		ProcessTrain(argc - 2, argv + 2);
 	else if (lstrcmp(argv[1], L"gtv") == 0)
 		ProcessGTV(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"metrics") == 0)
+		ProcessMetrics(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"pack") == 0)
+		ProcessPack(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"pipeline") == 0)
+		ProcessPipeline(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"batch") == 0)
+		ProcessBatch(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"serve") == 0)
+		ProcessServe(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"client") == 0)
+		ProcessClient(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"bench") == 0)
+		ProcessBench(argc - 2, argv + 2);
+	else if (lstrcmp(argv[1], L"verify") == 0)
+		ProcessVerify(argc - 2, argv + 2);
 	else
 		wprintf(L"Unknown operation - %s\n", argv[1]);
 
@@ -0,0 +1,497 @@
+#include "benchmark.h"
+#include <iplib/parallel.h>
+#include <iplib/image/core.h>
+#include <iplib/image/canny.h>
+#include <iplib/image/edt/edt.h>
+#include <iplib/image/analysis/objectdetection.h>
+#include <iplib/image/filter/filter.hpp>
+#include <iplib/image/interpolation.h>
+#include <iplib/image/deblur/deblurtv.h>
+#include <iplib/image/metrics/metrics.h>
+#include <iplib/math/gauss_function.h>
+#include <resampling/edrfast.h>
+#include <resampling/edrvector.h>
+#include <resampling/srcnn.h>
+#include <resampling/si_resampling.h>
+#include <warping/meowarping.hpp>
+#include <misc/modelfile.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <math.h>
+#include <memory>
+
+namespace ip
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		Image<bool> TestMask(int width, int height)
+		{
+			ImageFloat img = Benchmark::TestImageGray(width, height);
+			Image<bool> res(width, height);
+
+			for (int j = 0; j < height; j++)
+				for (int i = 0; i < width; i++)
+					res(i, j) = img(i, j) > 150.0f;
+
+			return res;
+		}
+
+		Image<float> GaussKernel(float sigma)
+		{
+			int rad = Filter::GaussHalo(sigma);
+			GaussFunction gf(sigma);
+
+			Image<float> k(2 * rad + 1, 2 * rad + 1);
+			float s = 0.0f;
+
+			for (int j = 0; j < k.Height(); j++)
+				for (int i = 0; i < k.Width(); i++)
+					s += k(i, j) = gf((float)(i - rad)) * gf((float)(j - rad));
+
+			for (int j = 0; j < k.Height(); j++)
+				for (int i = 0; i < k.Width(); i++)
+					k(i, j) /= s;
+
+			return k;
+		}
+
+		// The model is loaded at the first use and shared by the cases of all sizes, null if it cannot be loaded
+		template <typename T>
+		class SharedModel
+		{
+			struct State
+			{
+				std::unique_ptr<T> model;
+				bool loaded = false;
+			};
+
+			std::shared_ptr<State> state;
+			std::function<T*()> load;
+
+		public:
+			explicit SharedModel(std::function<T*()> load)
+				: state(std::make_shared<State>()), load(load) {}
+
+			T* Get() const
+			{
+				if (!state->loaded)
+				{
+					state->model.reset(load());
+					state->loaded = true;
+				}
+
+				return state->model.get();
+			}
+		};
+
+		// Nearest rank of the sorted times
+		float Percentile(const std::vector<float> &sorted, float p)
+		{
+			size_t rank = (size_t)ceil(p * sorted.size());
+			return sorted[(std::max)(rank, (size_t)1) - 1];
+		}
+	}
+
+	ImageFloatColor Benchmark::TestImage(int width, int height)
+	{
+		ImageFloatColor res(width, height);
+
+		for (int j = 0; j < height; j++)
+			for (int i = 0; i < width; i++)
+			{
+				float texture = 40.0f * sinf(i * 0.21f) * cosf(j * 0.17f);
+				float edge = ((i / 37 + j / 29) % 2) ? 60.0f : -60.0f;
+				float disc = (i - width / 2) * (i - width / 2) + (j - height / 2) * (j - height / 2) < width * height / 16 ? 30.0f : 0.0f;
+
+				PixelFloatRGBA p;
+				p.r = (std::min)((std::max)(128.0f + texture + edge + disc, 0.0f), 255.0f);
+				p.g = (std::min)((std::max)(128.0f + 0.5f * texture - edge + disc, 0.0f), 255.0f);
+				p.b = (std::min)((std::max)(128.0f - texture + 0.5f * edge, 0.0f), 255.0f);
+				p.a = 255.0f;
+				res(i, j) = p;
+			}
+
+		return res;
+	}
+
+	ImageFloat Benchmark::TestImageGray(int width, int height)
+	{
+		return ImageFloat(TestImage(width, height).Convert<float>());
+	}
+
+	SIResampling* Benchmark::LoadSI(SIResampling::Mode mode, const std::wstring &filename)
+	{
+		std::unique_ptr<SIResampling> sir(new SIResampling(mode));
+
+		if (ModelFile::IsModelFile(filename.c_str()))
+		{
+			ModelFile file(filename.c_str());
+			return file && sir->LoadModel(file) ? sir.release() : nullptr;
+		}
+
+		std::ifstream fs(filename, std::ios::in | std::ios::binary);
+		if (fs.fail())
+			return nullptr;
+
+		std::vector<char> bin((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+		return sir->LoadCoefficientData(bin.data(), bin.size()) ? sir.release() : nullptr;
+	}
+
+	Benchmark::Settings::Settings()
+		: sizes({ 256, 1024 }), threads({ 1, 0 }), warmup(2), repeats(10)
+	{
+	}
+
+	void Benchmark::Add(const std::string &name, Case prepare)
+	{
+		cases.push_back(std::make_pair(name, prepare));
+	}
+
+	void Benchmark::AddStandardCases(const std::wstring &models)
+	{
+		std::wstring dir = models.empty() || models.back() == L'\\' || models.back() == L'/' ? models : models + L"\\";
+
+		Add("gauss", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+			auto dst = std::make_shared<ImageFloat>(width, height);
+			return [src, dst]() { Filter::Gauss(*src, *dst, 2.0f); };
+		});
+
+		Add("canny", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+			return [src]() { BasicCanny<float> canny(*src, 1.0f); };
+		});
+
+		Add("canny-half", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+			return [src]() { CannyHalf canny(*src, 1.0f); };
+		});
+
+		Add("edt", [](int width, int height) -> std::function<void()>
+		{
+			auto mask = std::make_shared<Image<bool>>(TestMask(width, height));
+			auto dst = std::make_shared<Image<int>>(width, height);
+			return [mask, dst]() { EDT::Simple(*mask, *dst); };
+		});
+
+		Add("objectdetection", [](int width, int height) -> std::function<void()>
+		{
+			auto mask = std::make_shared<Image<bool>>(TestMask(width, height));
+			return [mask]() { ObjectDetection od(*mask, true); };
+		});
+
+		// A rotation by 5 degrees about the centre, a near-identity map
+		const struct { const char *name; Interp interp; } remap_modes[] =
+		{
+			{ "remap-bilinear", Interp::Bilinear },
+			{ "remap-bicubic", Interp::Bicubic },
+			{ "remap-lanczos3", Interp::Lanczos3 },
+		};
+
+		for (auto &remap : remap_modes)
+		{
+			Interp interp = remap.interp;
+
+			Add(remap.name, [interp](int width, int height) -> std::function<void()>
+			{
+				auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+				auto mapx = std::make_shared<ImageFloat>(width, height), mapy = std::make_shared<ImageFloat>(width, height);
+				auto dst = std::make_shared<ImageFloat>(width, height);
+				const float c = cosf(0.087f), s = sinf(0.087f);
+
+				for (int j = 0; j < height; j++)
+					for (int i = 0; i < width; i++)
+					{
+						float dx = i - width * 0.5f, dy = j - height * 0.5f;
+						(*mapx)(i, j) = width * 0.5f + c * dx - s * dy;
+						(*mapy)(i, j) = height * 0.5f + s * dx + c * dy;
+					}
+
+				return [src, mapx, mapy, dst, interp]() { Remap(*src, *mapx, *mapy, *dst, interp); };
+			});
+		}
+
+		for (auto precision : { EDRPrecision::Float, EDRPrecision::Half })
+		{
+			Add(precision == EDRPrecision::Half ? "edrfast-half" : "edrfast", [precision](int width, int height) -> std::function<void()>
+			{
+				auto src = std::make_shared<PlanarImage<float, 3>>(TestImage(width, height));
+				auto dst = std::make_shared<PlanarImage<float, 3>>(width * 2, height * 2);
+				return [src, dst, precision]() { EDR_Resampling_x2(*src, *dst, precision); };
+			});
+		}
+
+		// The interleaved colour path, for the comparison with the planar one of "edrfast"
+		Add("edrfast-interleaved", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloatColor>(TestImage(width, height));
+			auto dst = std::make_shared<ImageFloatColor>(width * 2, height * 2);
+			return [src, dst]() { EDR_Resampling_x2(*src, *dst); };
+		});
+
+		SharedModel<EDRVector> edr([]() { return new EDRVector(); });
+
+		for (auto precision : { EDRVector::Precision::Float, EDRVector::Precision::Fixed16 })
+		{
+			Add(precision == EDRVector::Precision::Fixed16 ? "edrvector-fixed" : "edrvector", [edr, precision](int width, int height) -> std::function<void()>
+			{
+				EDRVector *model = edr.Get();
+				auto src = std::make_shared<ImageByteColor>(TestImage(width, height).Convert<PixelByteRGBA>());
+				return [model, src, precision]() { model->Perform(*src, precision); };
+			});
+		}
+
+		const struct { const char *name; SIResampling::Mode mode; bool deblur; } si_modes[] =
+		{
+			{ "si1", SIResampling::Mode::SI1, false },
+			{ "si2", SIResampling::Mode::SI2, false },
+			{ "si3", SIResampling::Mode::SI3, false },
+			{ "si3deblur", SIResampling::Mode::SI3Deblur, true },
+		};
+
+		for (auto &si : si_modes)
+		{
+			std::string name = si.name;
+			std::wstring filename = dir + std::wstring(name.begin(), name.end()) + L".bin";
+			SIResampling::Mode mode = si.mode;
+			bool deblur = si.deblur;
+
+			SharedModel<SIResampling> sir([mode, filename]() { return LoadSI(mode, filename); });
+
+			for (auto precision : { SIResampling::Precision::Float, SIResampling::Precision::Fixed16 })
+			{
+				Add(precision == SIResampling::Precision::Fixed16 ? name + "-fixed" : name, [sir, precision, deblur](int width, int height) -> std::function<void()>
+				{
+					SIResampling *model = sir.Get();
+					if (model == nullptr)
+						return nullptr;
+
+					auto src = std::make_shared<ImageByteColor>(TestImage(width, height).Convert<PixelByteRGBA>());
+
+					if (deblur)
+						return [model, src, precision]() { model->PerformDeblur(*src, precision); };
+					else
+						return [model, src, precision]() { model->Perform(*src, precision); };
+				});
+			}
+		}
+
+		std::wstring srcnn_file = dir + L"srcnn.bin";
+		SharedModel<SRCNN> srcnn([srcnn_file]()
+		{
+			std::wstring filename = srcnn_file;
+			SRCNN *res = new SRCNN(&filename[0]);
+
+			if (!*res)
+			{
+				delete res;
+				return (SRCNN*)nullptr;
+			}
+
+			return res;
+		});
+
+		for (auto precision : { SRCNN::Precision::Float, SRCNN::Precision::Half })
+		{
+			Add(precision == SRCNN::Precision::Half ? "srcnn-half" : "srcnn", [srcnn, precision](int width, int height) -> std::function<void()>
+			{
+				SRCNN *model = srcnn.Get();
+				if (model == nullptr)
+					return nullptr;
+
+				auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+				auto dst = std::make_shared<ImageFloat>(width * 2, height * 2);
+				return [model, src, dst, precision]() { model->Resample_x2_915(*src, *dst, false, precision); };
+			});
+		}
+
+		// The settings of the 'warp' operation with -sigma 2
+		Add("meowarping", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloatColor>(TestImage(width, height));
+
+			return [src]()
+			{
+				MeowWarping mw;
+				mw.SetEdgeDetectionSigma(1.0f);
+				mw.SetWarpingPower(1.0f);
+				mw.SetWarpingSigma(2.0f);
+				mw.Warp2D(*src);
+			};
+		});
+
+		Add("deblurtv", [](int width, int height) -> std::function<void()>
+		{
+			auto src = std::make_shared<ImageFloat>(TestImageGray(width, height));
+			auto dst = std::make_shared<ImageFloat>(width, height);
+			auto kernel = std::make_shared<Image<float>>(GaussKernel(1.0f));
+			return [src, dst, kernel]() { DeblurTV::AnyKernel(*src, *dst, *kernel, 0.01f); };
+		});
+
+		// The candidate is the blurred reference
+		const char *metric_names[] = { "metrics-psnr", "metrics-ssim", "metrics-msssim", "metrics-graderr" };
+
+		for (int m = 0; m < 4; m++)
+		{
+			Add(metric_names[m], [m](int width, int height) -> std::function<void()>
+			{
+				auto ref = std::make_shared<ImageFloat>(TestImageGray(width, height));
+				auto cand = std::make_shared<ImageFloat>(width, height);
+				Filter::Gauss(*ref, *cand, 1.0f);
+
+				switch (m)
+				{
+				case 0: return [ref, cand]() { Metrics::PSNR(*ref, *cand); };
+				case 1: return [ref, cand]() { Metrics::SSIM(*ref, *cand, 1.5f); };
+				case 2: return [ref, cand]() { Metrics::MSSSIM(*ref, *cand, 1.5f); };
+				default: return [ref, cand]() { Metrics::GradientError(*ref, *cand); };
+				}
+			});
+		}
+	}
+
+	/* The input of a size is prepared once for all thread counts. The thread counts are capped by the number of
+	* processors, a count that comes out the same as a previous one is not measured again */
+	std::vector<Benchmark::Result> Benchmark::Run(const Settings &settings, std::function<void(const Result&)> progress) const
+	{
+		check(settings.repeats > 0 && settings.warmup >= 0);
+
+		std::vector<Result> results;
+
+		for (auto &c : cases)
+		{
+			if (!settings.filter.empty() && c.first.find(settings.filter) == std::string::npos)
+				continue;
+
+			for (int size : settings.sizes)
+			{
+				std::function<void()> func = c.second(size, size);
+				std::vector<int> measured;
+
+				if (!func)
+					continue;
+
+				for (int threads : settings.threads)
+				{
+					Parallel::SetThreadCount(threads);
+					int actual = Parallel::ThreadCount();
+
+					if (std::find(measured.begin(), measured.end(), actual) != measured.end())
+						continue;
+
+					measured.push_back(actual);
+
+					for (int i = 0; i < settings.warmup; i++)
+						func();
+
+					std::vector<float> times;
+
+					for (int i = 0; i < settings.repeats; i++)
+					{
+						auto start = Clock::now();
+						func();
+						times.push_back(std::chrono::duration<float>(Clock::now() - start).count());
+					}
+
+					std::sort(times.begin(), times.end());
+
+					Result res;
+					res.name = c.first;
+					res.width = res.height = size;
+					res.threads = actual;
+					res.median = Percentile(times, 0.5f);
+					res.p95 = Percentile(times, 0.95f);
+					res.megapixels_per_second = res.median > 0.0f ? (double)size * size * 1e-6 / res.median : 0.0;
+
+					results.push_back(res);
+
+					if (progress)
+						progress(res);
+				}
+			}
+		}
+
+		Parallel::SetThreadCount(0);
+
+		return results;
+	}
+
+	void Benchmark::WriteJSON(const std::vector<Result> &results, const char *isa, FILE *f)
+	{
+		fprintf(f, "{\n  \"isa\": \"%s\",\n  \"results\": [\n", isa);
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			auto &r = results[i];
+
+			fprintf(f, "    { \"name\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"mpix_per_s\": %.3f }%s\n",
+				r.name.c_str(), r.width, r.height, r.threads, r.median * 1e3f, r.p95 * 1e3f, r.megapixels_per_second, i + 1 < results.size() ? "," : "");
+		}
+
+		fprintf(f, "  ]\n}\n");
+	}
+
+	// Only the layout of WriteJSON is understood, one result per line
+	bool Benchmark::ReadJSON(const wchar_t *filename, std::vector<Result> &results)
+	{
+		FILE *f = _wfopen(filename, L"r");
+		if (f == nullptr)
+			return false;
+
+		char line[1024], name[256];
+		size_t count = results.size();
+
+		while (fgets(line, sizeof(line), f))
+		{
+			Result r;
+
+			if (sscanf(line, " { \"name\": \"%255[^\"]\", \"width\": %d, \"height\": %d, \"threads\": %d, \"median_ms\": %f, \"p95_ms\": %f, \"mpix_per_s\": %lf",
+				name, &r.width, &r.height, &r.threads, &r.median, &r.p95, &r.megapixels_per_second) != 7)
+				continue;
+
+			r.name = name;
+			r.median *= 1e-3f;
+			r.p95 *= 1e-3f;
+			results.push_back(r);
+		}
+
+		fclose(f);
+		return results.size() > count;
+	}
+
+	int Benchmark::Compare(const std::vector<Result> &results, const std::vector<Result> &baseline, float tolerance, FILE *f)
+	{
+		int regressions = 0;
+
+		for (auto &r : results)
+		{
+			auto it = std::find_if(baseline.begin(), baseline.end(), [&r](const Result &b)
+			{
+				return b.name == r.name && b.width == r.width && b.height == r.height && b.threads == r.threads;
+			});
+
+			if (it == baseline.end())
+			{
+				fprintf(f, "  %-16s %5dx%-5d %2d threads: %9.3f ms, not in the baseline\n", r.name.c_str(), r.width, r.height, r.threads, r.median * 1e3f);
+				continue;
+			}
+
+			float ratio = it->median > 0.0f ? r.median / it->median : 1.0f;
+			bool regression = ratio > 1.0f + tolerance;
+
+			if (regression)
+				regressions++;
+
+			fprintf(f, "  %-16s %5dx%-5d %2d threads: %9.3f ms, baseline %9.3f ms, x%.2f%s\n", r.name.c_str(), r.width, r.height, r.threads,
+				r.median * 1e3f, it->median * 1e3f, ratio, regression ? "  REGRESSION" : "");
+		}
+
+		return regressions;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <iplib/image/core.h>
+#include <resampling/si_resampling.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ip
+{
+	/* Times named cases over a grid of image sizes and thread counts (see Parallel::SetThreadCount). Every
+	* measurement prepares its input once, runs the case 'warmup' times untimed and then 'repeats' times,
+	* and reports the median and the 95th percentile of the runs. The throughput is in the source megapixels
+	* per second at the median time.
+	*
+	* The results are written as JSON, one result per line, and can be read back as a baseline: Compare
+	* matches the results by name, size and thread count */
+	class Benchmark
+	{
+	public:
+		/* Prepares the input of the given size and returns the timed call, or an empty function when the case
+		* cannot run (a model file is missing). The call must be repeatable on the same input */
+		typedef std::function<std::function<void()>(int width, int height)> Case;
+
+		struct Settings
+		{
+			std::vector<int> sizes, threads;
+			int warmup, repeats;
+
+			// Runs only the cases containing it in the name, all cases if empty
+			std::string filter;
+
+			Settings();
+		};
+
+		struct Result
+		{
+			std::string name;
+			int width, height, threads;
+
+			// In seconds
+			float median, p95;
+			double megapixels_per_second;
+		};
+
+		void Add(const std::string &name, Case prepare);
+
+		// Every algorithm of the library, the models are looked up in 'models' (srcnn.bin, si1.bin, ...)
+		void AddStandardCases(const std::wstring &models);
+
+		// 'progress' receives every result as soon as it is measured
+		std::vector<Result> Run(const Settings &settings, std::function<void(const Result&)> progress = nullptr) const;
+
+		// The input of the cases: smooth gradients, texture and sharp edges, so every method takes all its paths
+		static ImageFloatColor TestImage(int width, int height);
+		static ImageFloat TestImageGray(int width, int height);
+
+		// Loads a model file or the coefficient data written by 'train', null if the file cannot be loaded
+		static SIResampling* LoadSI(SIResampling::Mode mode, const std::wstring &filename);
+
+		static void WriteJSON(const std::vector<Result> &results, const char *isa, FILE *f);
+
+		// Reads a file written by WriteJSON, false if it cannot be opened or holds no results
+		static bool ReadJSON(const wchar_t *filename, std::vector<Result> &results);
+
+		/* Prints the ratio of the median times for every result found in the baseline, returns the number of
+		* the results slower than the baseline by more than 'tolerance' (0.1 = 10%) */
+		static int Compare(const std::vector<Result> &results, const std::vector<Result> &baseline, float tolerance, FILE *f);
+
+	private:
+		std::vector<std::pair<std::string, Case>> cases;
+	};
+}
@@ -0,0 +1,871 @@
+#include "verification.h"
+#include "benchmark.h"
+#include <iplib/image/core.h>
+#include <iplib/image/canny.h>
+#include <iplib/image/region.h>
+#include <iplib/image/interpolation.h>
+#include <iplib/image/filter/filter.hpp>
+#include <iplib/image/metrics/metrics.h>
+#include <iplib/math/quadratic_optimization.h>
+#include <resampling/edrfast.h>
+#include <resampling/edrvector.h>
+#include <resampling/srcnn.h>
+#include <misc/cpudispatch.h>
+#include <pipeline/pipeline.h>
+#include <algorithm>
+#include <memory>
+#include <math.h>
+#include <random>
+#include <string.h>
+
+namespace ip
+{
+	namespace
+	{
+		typedef std::mt19937 Random;
+
+		// The random pixels are generated component by component
+		template <typename PixelType> struct ComponentOf { typedef byte type; };
+		template <> struct ComponentOf<float> { typedef float type; };
+		template <> struct ComponentOf<PixelFloatRGB> { typedef float type; };
+		template <> struct ComponentOf<PixelFloatRGBA> { typedef float type; };
+
+		// Any bit pattern, including the half-precision infinities and NaNs
+		void Fill(byte *p, size_t n, float, float, Random &rnd)
+		{
+			for (size_t i = 0; i < n; i++)
+				p[i] = (byte)rnd();
+		}
+
+		/* A quarter of the values are halfway between the integers, where the roundings differ, and a quarter are
+		* scaled down to the half-precision subnormals */
+		void Fill(float *p, size_t n, float low, float high, Random &rnd)
+		{
+			std::uniform_real_distribution<float> dist(low, high);
+
+			for (size_t i = 0; i < n; i++)
+			{
+				float x = dist(rnd);
+
+				switch (rnd() % 4)
+				{
+				case 0: p[i] = floorf(x) + 0.5f; break;
+				case 1: p[i] = x * 1e-6f; break;
+				default: p[i] = x;
+				}
+			}
+		}
+
+		/* The vectorized internal::ConvertRow against the generic cast, bit for bit: random rows of every length up to
+		* 300 pixels at four source offsets. 'low' and 'high' bound the float components, the casts to byte of the
+		* values outside 0..255 are undefined */
+		template <typename SourcePixelType, typename DestinationPixelType>
+		Verification::Check ConvertRowCheck(float low, float high)
+		{
+			return [low, high](std::string &details)
+			{
+				typedef typename ComponentOf<SourcePixelType>::type Component;
+				const int max_length = 300, offsets = 4;
+
+				Random rnd(1);
+				std::vector<SourcePixelType> src(max_length + offsets);
+				std::vector<DestinationPixelType> dst(max_length), ref(max_length);
+				int rows = 0, mismatches = 0;
+
+				for (int n = 0; n <= max_length; n++)
+					for (int offset = 0; offset < offsets; offset++)
+					{
+						Fill((Component*)src.data(), src.size() * sizeof(SourcePixelType) / sizeof(Component), low, high, rnd);
+
+						internal::ConvertRow(src.data() + offset, dst.data(), n);
+						internal::ConvertRow<SourcePixelType, DestinationPixelType>(src.data() + offset, ref.data(), n);
+
+						rows++;
+
+						if (memcmp(dst.data(), ref.data(), n * sizeof(DestinationPixelType)) != 0)
+							mismatches++;
+					}
+
+				details = std::to_string(rows) + " rows, " + std::to_string(mismatches) + " mismatches";
+				return mismatches == 0 ? Verification::Status::Passed : Verification::Status::Failed;
+			};
+		}
+
+		// The odd sizes leave partial vectors at the ends of the rows
+		const int Sizes[][2] = { { 64, 48 }, { 257, 131 } };
+
+		// The largest difference between the B, G, R channels of the interleaved and the planar image
+		float MaxDifference(const ImageFloatColor &a, const PlanarImage<float, 3> &b)
+		{
+			float res = 0.0f;
+
+			for (int j = 0; j < a.Height(); j++)
+				for (int i = 0; i < a.Width(); i++)
+				{
+					PixelFloatRGBA p = a(i, j);
+
+					res = (std::max)(res, fabsf(p.b - b.Plane(0)(i, j)));
+					res = (std::max)(res, fabsf(p.g - b.Plane(1)(i, j)));
+					res = (std::max)(res, fabsf(p.r - b.Plane(2)(i, j)));
+				}
+
+			return res;
+		}
+
+		/* Split and Merge (the vectorized transposes of float RGBA and byte RGBA) against the per-pixel channel
+		* access, bit for bit. The float image is stretched past 0..255, so Merge to bytes clamps and rounds like f2b */
+		Verification::Status CheckSplitMerge(std::string &details)
+		{
+			int mismatches = 0;
+			details.clear();
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloatColor src = Benchmark::TestImage(w, h);
+
+				for (int j = 0; j < h; j++)
+					for (int i = 0; i < w; i++)
+					{
+						PixelFloatRGBA &p = src(i, j);
+						p.b = p.b * 1.25f - 32.0f + 0.5f * (i % 2);
+						p.g = p.g * 1.25f - 32.0f;
+						p.r = p.r * 1.25f - 32.0f;
+					}
+
+				PlanarImage<float, 3> planes(w, h);
+				Split(src, planes);
+
+				ImageByteColor bytes(w, h);
+				Merge(planes, bytes);
+
+				PlanarImage<float, 3> byte_planes(w, h);
+				Split(bytes, byte_planes);
+
+				for (int j = 0; j < h; j++)
+					for (int i = 0; i < w; i++)
+					{
+						PixelFloatRGBA p = src(i, j);
+						PixelByteRGBA q = bytes(i, j);
+						float channels[3] = { p.b, p.g, p.r };
+						byte byte_channels[3] = { q.b, q.g, q.r };
+
+						for (int c = 0; c < 3; c++)
+						{
+							if (memcmp(&planes.Plane(c)(i, j), &channels[c], sizeof(float)) != 0 || byte_channels[c] != f2b(channels[c]) ||
+								byte_planes.Plane(c)(i, j) != (float)byte_channels[c])
+								mismatches++;
+						}
+					}
+			}
+
+			details = std::to_string(mismatches) + " mismatches";
+			return mismatches == 0 ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		/* EDR of the planar image against the interleaved colour path: both take the weights from the luminance, the
+		* planar path filters each channel with the grayscale steps, so only the order of the float operations differs */
+		Verification::Status CheckPlanarEDR(std::string &details)
+		{
+			const float bound = 1e-3f;
+			float diff = 0.0f;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloatColor src = Benchmark::TestImage(w, h), dst(w * 2, h * 2);
+				PlanarImage<float, 3> planar_src(src), planar_dst(w * 2, h * 2);
+
+				EDR_Resampling_x2(src, dst);
+				EDR_Resampling_x2(planar_src, planar_dst);
+
+				diff = (std::max)(diff, MaxDifference(dst, planar_dst));
+			}
+
+			char buf[64];
+			sprintf(buf, "max difference %g, bound %g", diff, bound);
+			details = buf;
+
+			return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		// The half-precision modes against Float, the lowest PSNR over the sizes
+		const float MinHalfPSNR = 60.0f;
+
+		Verification::Status HalfPSNRResult(float psnr, std::string &details)
+		{
+			char buf[64];
+			sprintf(buf, "PSNR %.1f dB, bound %.0f dB", psnr, MinHalfPSNR);
+			details = buf;
+
+			return psnr >= MinHalfPSNR ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		Verification::Status CheckHalfEDRGray(std::string &details)
+		{
+			float psnr = INFINITY;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloat src = Benchmark::TestImageGray(w, h), dst(w * 2, h * 2), half_dst(w * 2, h * 2);
+
+				EDR_Resampling_x2(src, dst, EDRPrecision::Float);
+				EDR_Resampling_x2(src, half_dst, EDRPrecision::Half);
+
+				psnr = (std::min)(psnr, Metrics::PSNR(dst, half_dst));
+			}
+
+			return HalfPSNRResult(psnr, details);
+		}
+
+		Verification::Status CheckHalfEDRColor(std::string &details)
+		{
+			float psnr = INFINITY;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloatColor src = Benchmark::TestImage(w, h), dst(w * 2, h * 2), half_dst(w * 2, h * 2);
+
+				EDR_Resampling_x2(src, dst, EDRPrecision::Float);
+				EDR_Resampling_x2(src, half_dst, EDRPrecision::Half);
+
+				psnr = (std::min)(psnr, Metrics::PSNR(PlanarImage<float, 3>(dst), PlanarImage<float, 3>(half_dst)));
+			}
+
+			return HalfPSNRResult(psnr, details);
+		}
+
+		Verification::Status CheckHalfEDRPlanar(std::string &details)
+		{
+			float psnr = INFINITY;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				PlanarImage<float, 3> src(Benchmark::TestImage(w, h)), dst(w * 2, h * 2), half_dst(w * 2, h * 2);
+
+				EDR_Resampling_x2(src, dst, EDRPrecision::Float);
+				EDR_Resampling_x2(src, half_dst, EDRPrecision::Half);
+
+				psnr = (std::min)(psnr, Metrics::PSNR(dst, half_dst));
+			}
+
+			return HalfPSNRResult(psnr, details);
+		}
+
+		Verification::Check HalfSRCNNCheck(const std::wstring &filename)
+		{
+			return [filename](std::string &details)
+			{
+				std::wstring name = filename;
+				SRCNN srcnn(&name[0]);
+
+				if (!srcnn)
+				{
+					details = "no model";
+					return Verification::Status::Skipped;
+				}
+
+				float psnr = INFINITY;
+
+				for (auto &size : Sizes)
+				{
+					int w = size[0], h = size[1];
+					ImageFloat src = Benchmark::TestImageGray(w, h), dst(w * 2, h * 2), half_dst(w * 2, h * 2);
+
+					srcnn.Resample_x2_915(src, dst, false, SRCNN::Precision::Float);
+					srcnn.Resample_x2_915(src, half_dst, false, SRCNN::Precision::Half);
+
+					psnr = (std::min)(psnr, Metrics::PSNR(dst, half_dst));
+				}
+
+				return HalfPSNRResult(psnr, details);
+			};
+		}
+
+		/* The edge pixels (non-zero after the suppression) found by only one of Canny and CannyHalf, out of all edge pixels.
+		* The half-precision magnitudes tie or swap where the neighbours along the gradient are within their rounding, so
+		* the suppression keeps a different pixel of some edges */
+		Verification::Status CheckHalfCanny(std::string &details)
+		{
+			const float bound = 0.05f;
+			int edges = 0, differ = 0;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloat src = Benchmark::TestImageGray(w, h);
+				Canny canny(src, 1.0f);
+				CannyHalf canny_half(src, 1.0f);
+
+				for (int j = 0; j < h; j++)
+					for (int i = 0; i < w; i++)
+					{
+						bool edge = canny.pixel(i, j) > 0.0f, half_edge = canny_half.pixel(i, j) > 0.0f;
+
+						edges += edge || half_edge;
+						differ += edge != half_edge;
+					}
+			}
+
+			float ratio = edges > 0 ? (float)differ / edges : 0.0f;
+
+			char buf[96];
+			sprintf(buf, "%d of %d edge pixels differ (%.2f%%), bound %.0f%%", differ, edges, ratio * 100.0f, bound * 100.0f);
+			details = buf;
+
+			return ratio <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		// Small enough for the odd sizes to have partial tiles and tiles away from every border
+		const int CheckTileSize = 24;
+
+		/* ProcessTiled against the whole-image run of func on the grayscale test images: the largest difference and the
+		* number of the pixels that are not bit-identical */
+		template <class Func>
+		void CompareTiled(int halo, int scale, const Func &func, float &diff, int &mismatches)
+		{
+			diff = 0.0f;
+			mismatches = 0;
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0], h = size[1];
+				ImageFloat src = Benchmark::TestImageGray(w, h), dst(w * scale, h * scale), tiled(w * scale, h * scale);
+
+				func(src, dst);
+				ProcessTiled(src, tiled, CheckTileSize, halo, scale, func);
+
+				for (int j = 0; j < dst.Height(); j++)
+					for (int i = 0; i < dst.Width(); i++)
+					{
+						diff = (std::max)(diff, fabsf(dst(i, j) - tiled(i, j)));
+						mismatches += memcmp(&dst(i, j), &tiled(i, j), sizeof(float)) != 0;
+					}
+			}
+		}
+
+		// The filters with a declared halo are bit-exact by tiles
+		template <class Func>
+		Verification::Check TiledExactCheck(int halo, Func func)
+		{
+			return [halo, func](std::string &details)
+			{
+				float diff;
+				int mismatches;
+				CompareTiled(halo, 1, func, diff, mismatches);
+
+				details = std::to_string(mismatches) + " mismatches";
+				return mismatches == 0 ? Verification::Status::Passed : Verification::Status::Failed;
+			};
+		}
+
+		/* EDR by tiles at EDR_Halo: a tile sums the same samples, but the vector and the scalar tails of the rows fall
+		* on other pixels than in the whole image, so the order of the float operations differs */
+		Verification::Status CheckTiledEDR(std::string &details)
+		{
+			const float bound = 1e-3f;
+			float diff;
+			int mismatches;
+
+			CompareTiled(EDR_Halo, 2, [](const ImageFloat &src, ImageFloat &dst) { EDR_Resampling_x2(src, dst); }, diff, mismatches);
+
+			char buf[64];
+			sprintf(buf, "max difference %g, bound %g", diff, bound);
+			details = buf;
+
+			return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		/* A fused group of Pipeline (gaussblur, then EDR, by tiles with the halo of both) against the stages run one after
+		* another on the whole image. The source is larger than Pipeline::TileSize, so there are several tiles */
+		Verification::Status CheckTiledPipeline(std::string &details)
+		{
+			const float bound = 1e-3f, sigma = 1.0f;
+			float diff = 0.0f;
+
+			Pipeline pipeline(L"gaussblur:sigma=1 | resample:method=edr");
+			check(pipeline.GroupCount() == 1);
+
+			for (auto &size : Sizes)
+			{
+				int w = size[0] * 2, h = size[1] * 2;
+				PlanarImage<float, 3> src(Benchmark::TestImage(w, h)), blurred(w, h), dst(w * 2, h * 2);
+
+				Filter::Gauss(src, blurred, sigma);
+				EDR_Resampling_x2(blurred, dst);
+
+				PlanarImage<float, 3> fused = pipeline.Run(src);
+
+				for (int c = 0; c < 3; c++)
+					for (int j = 0; j < dst.Height(); j++)
+						for (int i = 0; i < dst.Width(); i++)
+							diff = (std::max)(diff, fabsf(dst.Plane(c)(i, j) - fused.Plane(c)(i, j)));
+			}
+
+			char buf[64];
+			sprintf(buf, "max difference %g, bound %g", diff, bound);
+			details = buf;
+
+			return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		/* QuadraticOptimization (the blocked rank-k updates, Merge and the LDL^T solve) against the normal equations summed
+		* sample by sample and solved by Matrix::GaussSolve, the largest difference of the coefficients relative to the
+		* largest coefficient. The vector lengths are those of EDRVector, SI-2 and SI-3, the sample counts are not
+		* multiples of BlockSize, so the pending samples of both merged optimizers are taken too */
+		Verification::Status CheckQuadraticSolve(std::string &details)
+		{
+			const double bound = 1e-8;
+			double diff = 0.0;
+
+			for (int len : { 6, 25, 49 })
+			{
+				Random rnd(len);
+				std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+				std::vector<float> coefficients(len), q(len);
+
+				for (auto &c : coefficients)
+					c = dist(rnd);
+
+				QuadraticOptimization first, second;
+				Matrix<double> a = Matrix<double>::Zero(len, len), b = Matrix<double>::Zero(len, 1);
+				const int count = 40 * len + 7;
+
+				for (int n = 0; n < count; n++)
+				{
+					// Neighbouring pixels are correlated, so are the components here
+					float base = dist(rnd), v = 0.01f * dist(rnd);
+
+					for (int k = 0; k < len; k++)
+					{
+						q[k] = 0.5f * base + dist(rnd);
+						v += q[k] * coefficients[k];
+					}
+
+					(n % 3 ? first : second).AddData(q.data(), len, v);
+
+					for (int j = 0; j < len; j++)
+					{
+						for (int k = 0; k < len; k++)
+							a(j, k) += (double)q[j] * q[k];
+
+						b(j, 0) += (double)q[j] * v;
+					}
+				}
+
+				first.Merge(second);
+
+				std::vector<double> x(len);
+				Matrix<double> ref = a.GaussSolve(b);
+
+				if (!first.CalcOptimizedCoefficients(x.data()))
+				{
+					details = "no solution for the length " + std::to_string(len);
+					return Verification::Status::Failed;
+				}
+
+				double largest = 0.0, largest_diff = 0.0;
+
+				for (int k = 0; k < len; k++)
+				{
+					largest = (std::max)(largest, fabs(ref(k, 0)));
+					largest_diff = (std::max)(largest_diff, fabs(x[k] - ref(k, 0)));
+				}
+
+				diff = (std::max)(diff, largest_diff / largest);
+			}
+
+			char buf[64];
+			sprintf(buf, "max relative difference %g, bound %g", diff, bound);
+			details = buf;
+
+			return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+		}
+
+		/* The maps of Remap: a rotation by 5 degrees about the centre with a ripple, so the phases vary and some
+		* coordinates fall outside the source. 'margin' > 0 clamps them to [margin, size - 1 - margin], otherwise every
+		* 97th coordinate is NaN */
+		void RemapMaps(int width, int height, int margin, ImageFloat &mapx, ImageFloat &mapy)
+		{
+			const float c = cosf(0.087f), s = sinf(0.087f);
+
+			for (int j = 0; j < height; j++)
+				for (int i = 0; i < width; i++)
+				{
+					float dx = i - width * 0.5f, dy = j - height * 0.5f;
+					float x = width * 0.5f + c * dx - s * dy + 1.5f * sinf(j * 0.13f);
+					float y = height * 0.5f + s * dx + c * dy + 1.5f * cosf(i * 0.11f);
+
+					if (margin > 0)
+					{
+						x = (std::min)((std::max)(x, (float)margin), (float)(width - 1 - margin));
+						y = (std::min)((std::max)(y, (float)margin), (float)(height - 1 - margin));
+					}
+					else if ((j * width + i) % 97 == 0)
+						((j + i) % 2 ? x : y) = NAN;
+
+					mapx(i, j) = x;
+					mapy(i, j) = y;
+				}
+		}
+
+		// Lanczos3 with the exact weights at the border-replicated source, the reference of Remap
+		float Lanczos3(const ImageFloat &src, float x, float y)
+		{
+			auto kernel = [](float t)
+			{
+				const float pi = 3.14159265358979f;
+				return fabsf(t) < 1e-6f ? 1.0f : fabsf(t) >= 3.0f ? 0.0f : 3.0f * sinf(pi * t) * sinf(pi * t / 3.0f) / (pi * pi * t * t);
+			};
+
+			x = x >= 0.0f ? (std::min)(x, (float)(src.Width() - 1)) : 0.0f;
+			y = y >= 0.0f ? (std::min)(y, (float)(src.Height() - 1)) : 0.0f;
+
+			int ix = (int)x, iy = (int)y;
+			float wx[6], wy[6], sx = 0.0f, sy = 0.0f;
+
+			for (int k = 0; k < 6; k++)
+			{
+				sx += wx[k] = kernel(x - ix + 2 - k);
+				sy += wy[k] = kernel(y - iy + 2 - k);
+			}
+
+			float res = 0.0f;
+
+			for (int m = 0; m < 6; m++)
+				for (int k = 0; k < 6; k++)
+				{
+					int px = (std::min)((std::max)(ix - 2 + k, 0), src.Width() - 1);
+					int py = (std::min)((std::max)(iy - 2 + m, 0), src.Height() - 1);
+					res += src(px, py) * wx[k] * wy[m];
+				}
+
+			return res / (sx * sy);
+		}
+
+		/* Remap against the scalar sampling of every pixel on the grayscale test images, the largest difference. Bicubic
+		* (whose scalar version falls back to Bilinear near the borders) takes the coordinates at least 2 pixels from the
+		* borders. The weight tables round the subpixel phase to 1/256,
+		* so the tabled filters differ by up to 1/512 of the slope of the interpolated image in each direction */
+		Verification::Check RemapCheck(Interp interp, float bound)
+		{
+			return [interp, bound](std::string &details)
+			{
+				float diff = 0.0f;
+
+				for (auto &size : Sizes)
+				{
+					int w = size[0], h = size[1];
+					ImageFloat src = Benchmark::TestImageGray(w, h), mapx(w, h), mapy(w, h), dst(w, h);
+
+					RemapMaps(w, h, interp == Interp::Bicubic ? 2 : 0, mapx, mapy);
+					Remap(src, mapx, mapy, dst, interp);
+
+					for (int j = 0; j < h; j++)
+						for (int i = 0; i < w; i++)
+						{
+							float x = mapx(i, j), y = mapy(i, j), ref;
+
+							switch (interp)
+							{
+							case Interp::Bilinear:
+								ref = Bilinear(src, x >= 0.0f ? x : 0.0f, y >= 0.0f ? y : 0.0f);
+								break;
+
+							case Interp::Bicubic:
+								ref = Bicubic(src, x, y);
+								break;
+
+							default:
+								ref = Lanczos3(src, x, y);
+							}
+
+							diff = (std::max)(diff, fabsf(dst(i, j) - ref));
+						}
+				}
+
+				char buf[64];
+				sprintf(buf, "max difference %g, bound %g", diff, bound);
+				details = buf;
+
+				return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+			};
+		}
+
+		// Upscales (or deblurs) with the kernel set selected at its creation, empty if the model cannot be loaded
+		typedef std::function<std::function<ImageByteColor(const ImageByteColor&)>()> CreateResampler;
+
+		/* The kernel sets of all the instruction sets the processor supports against SSE4.1 (see SetCpuIsa), the
+		* largest difference of the B, G, R channels. Only the AVX2 and AVX-512 sets fuse the multiplications and the
+		* additions, so the float paths may round a sample to the neighbouring grey level */
+		Verification::Check CrossIsaCheck(CreateResampler create)
+		{
+			return [create](std::string &details)
+			{
+				const int bound = 1;
+				CpuIsa selected = GetCpuIsa();
+				std::vector<ImageByteColor> reference;
+				std::string isas;
+				int diff = 0;
+
+				for (CpuIsa isa : { CpuIsa::SSE41, CpuIsa::AVX2, CpuIsa::AVX512 })
+				{
+					if (isa > DetectCpuIsa())
+						break;
+
+					SetCpuIsa(isa);
+					auto perform = create();
+
+					if (!perform)
+					{
+						SetCpuIsa(selected);
+						details = "no model";
+						return Verification::Status::Skipped;
+					}
+
+					isas += (isas.empty() ? "" : ", ") + std::string(CpuIsaName(isa));
+
+					for (size_t k = 0; k < sizeof(Sizes) / sizeof(Sizes[0]); k++)
+					{
+						ImageByteColor src(Benchmark::TestImage(Sizes[k][0], Sizes[k][1]).Convert<PixelByteRGBA>());
+						ImageByteColor dst = perform(src);
+
+						if (reference.size() <= k)
+						{
+							reference.push_back(ImageByteColor());
+							reference.back().swap(dst);
+							continue;
+						}
+
+						const ImageByteColor &ref = reference[k];
+
+						for (int j = 0; j < ref.Height(); j++)
+							for (int i = 0; i < ref.Width(); i++)
+							{
+								PixelByteRGBA p = ref(i, j), q = dst(i, j);
+								diff = (std::max)({ diff, abs(p.b - q.b), abs(p.g - q.g), abs(p.r - q.r) });
+							}
+					}
+				}
+
+				SetCpuIsa(selected);
+				details = isas + ": max difference " + std::to_string(diff) + ", bound " + std::to_string(bound);
+
+				return diff <= bound ? Verification::Status::Passed : Verification::Status::Failed;
+			};
+		}
+
+		// Upscales (or deblurs) in Float or Fixed16, empty if the model cannot be loaded
+		typedef std::function<std::function<ImageByteColor(const ImageByteColor&, bool)>()> CreatePrecisionResampler;
+
+		/* Fixed16 against Float (see PerformFixed of the kernels), the largest difference of the B, G, R channels and the
+		* share of the channels beyond the bound. The bound in Y, U, V grows at most 2.048 times in B, G, R (the row of G
+		* in VectorFloatColor::ToByte) and both results round to bytes. The weights and the classes are taken from the
+		* rounded samples, so some pixels may go beyond */
+		Verification::Check FixedCheck(CreatePrecisionResampler create, float yuv_bound, float max_share)
+		{
+			return [create, yuv_bound, max_share](std::string &details)
+			{
+				auto perform = create();
+
+				if (!perform)
+				{
+					details = "no model";
+					return Verification::Status::Skipped;
+				}
+
+				const int bound = (int)ceilf(yuv_bound * 2.048f);
+				int diff = 0, beyond = 0, total = 0;
+
+				for (auto &size : Sizes)
+				{
+					ImageByteColor src(Benchmark::TestImage(size[0], size[1]).Convert<PixelByteRGBA>());
+					ImageByteColor ref = perform(src, false), dst = perform(src, true);
+
+					for (int j = 0; j < ref.Height(); j++)
+						for (int i = 0; i < ref.Width(); i++)
+						{
+							PixelByteRGBA p = ref(i, j), q = dst(i, j);
+
+							for (int d : { abs(p.b - q.b), abs(p.g - q.g), abs(p.r - q.r) })
+							{
+								diff = (std::max)(diff, d);
+								beyond += d > bound;
+								total++;
+							}
+						}
+				}
+
+				float share = (float)beyond / total;
+
+				char buf[128];
+				sprintf(buf, "max difference %d, %.3f%% beyond %d, bound %.2f%%", diff, share * 100.0f, bound, max_share * 100.0f);
+				details = buf;
+
+				return share <= max_share ? Verification::Status::Passed : Verification::Status::Failed;
+			};
+		}
+	}
+
+	void Verification::Add(const std::string &name, Check check)
+	{
+		checks.push_back(std::make_pair(name, check));
+	}
+
+	void Verification::AddStandardChecks(const std::wstring &models)
+	{
+		// Every overload of internal::ConvertRow (convert.h)
+		Add("convert-byte-float", ConvertRowCheck<byte, float>(0.0f, 256.0f));
+		Add("convert-float-byte", ConvertRowCheck<float, byte>(0.0f, 256.0f));
+		Add("convert-float-half", ConvertRowCheck<float, PixelHalf>(-70000.0f, 70000.0f));
+		Add("convert-half-float", ConvertRowCheck<PixelHalf, float>(0.0f, 0.0f));
+
+		Add("convert-rgb-float", ConvertRowCheck<PixelByteRGB, float>(0.0f, 0.0f));
+		Add("convert-rgb-byte", ConvertRowCheck<PixelByteRGB, byte>(0.0f, 0.0f));
+		Add("convert-rgba-float", ConvertRowCheck<PixelByteRGBA, float>(0.0f, 0.0f));
+		Add("convert-rgba-byte", ConvertRowCheck<PixelByteRGBA, byte>(0.0f, 0.0f));
+		Add("convert-floatrgba-float", ConvertRowCheck<PixelFloatRGBA, float>(-100.0f, 400.0f));
+
+		Add("convert-byte-rgb", ConvertRowCheck<byte, PixelByteRGB>(0.0f, 0.0f));
+		Add("convert-byte-rgba", ConvertRowCheck<byte, PixelByteRGBA>(0.0f, 0.0f));
+		Add("convert-float-rgb", ConvertRowCheck<float, PixelByteRGB>(0.0f, 256.0f));
+		Add("convert-float-floatrgba", ConvertRowCheck<float, PixelFloatRGBA>(-100.0f, 400.0f));
+
+		Add("convert-rgb-rgba", ConvertRowCheck<PixelByteRGB, PixelByteRGBA>(0.0f, 0.0f));
+		Add("convert-rgba-rgb", ConvertRowCheck<PixelByteRGBA, PixelByteRGB>(0.0f, 0.0f));
+		Add("convert-floatrgb-floatrgba", ConvertRowCheck<PixelFloatRGB, PixelFloatRGBA>(-100.0f, 400.0f));
+		Add("convert-floatrgba-floatrgb", ConvertRowCheck<PixelFloatRGBA, PixelFloatRGB>(-100.0f, 400.0f));
+
+		Add("convert-rgb-floatrgb", ConvertRowCheck<PixelByteRGB, PixelFloatRGB>(0.0f, 0.0f));
+		Add("convert-rgb-floatrgba", ConvertRowCheck<PixelByteRGB, PixelFloatRGBA>(0.0f, 0.0f));
+		Add("convert-rgba-floatrgba", ConvertRowCheck<PixelByteRGBA, PixelFloatRGBA>(0.0f, 0.0f));
+		Add("convert-floatrgb-rgb", ConvertRowCheck<PixelFloatRGB, PixelByteRGB>(-100.0f, 400.0f));
+		Add("convert-floatrgba-rgb", ConvertRowCheck<PixelFloatRGBA, PixelByteRGB>(-100.0f, 400.0f));
+		Add("convert-floatrgba-rgba", ConvertRowCheck<PixelFloatRGBA, PixelByteRGBA>(-100.0f, 400.0f));
+
+		// PlanarImage against the interleaved images (planarimage.h)
+		Add("planar-split-merge", CheckSplitMerge);
+		Add("planar-edr", CheckPlanarEDR);
+
+		// The half-precision modes (EDRPrecision::Half, SRCNN::Precision::Half, CannyHalf)
+		std::wstring dir = models.empty() || models.back() == L'\\' || models.back() == L'/' ? models : models + L"\\";
+
+		Add("half-edr-gray", CheckHalfEDRGray);
+		Add("half-edr-color", CheckHalfEDRColor);
+		Add("half-edr-planar", CheckHalfEDRPlanar);
+		Add("half-srcnn", HalfSRCNNCheck(dir + L"srcnn.bin"));
+		Add("half-canny", CheckHalfCanny);
+
+		// ProcessTiled (region.h) against the whole image, the tiles run the algorithms nested in Parallel
+		const float sigma = 1.5f;
+
+		Add("tiled-gauss", TiledExactCheck(Filter::GaussHalo(sigma), [sigma](const ImageFloat &src, ImageFloat &dst) { Filter::Gauss(src, dst, sigma); }));
+		Add("tiled-canny", TiledExactCheck(Canny::Halo(sigma), [sigma](const ImageFloat &src, ImageFloat &dst) { Canny(src, sigma).CopyTo(dst); }));
+		Add("tiled-edr", CheckTiledEDR);
+		Add("tiled-pipeline", CheckTiledPipeline);
+
+		// The least squares solver of the learning (quadratic_optimization.h) against GaussSolve
+		Add("solve-quadratic", CheckQuadraticSolve);
+
+		// Remap (interpolation.h) against Bilinear, Bicubic and the exact Lanczos3
+		Add("remap-bilinear", RemapCheck(Interp::Bilinear, 1e-3f));
+		Add("remap-bicubic", RemapCheck(Interp::Bicubic, 1.0f));
+		Add("remap-lanczos3", RemapCheck(Interp::Lanczos3, 1.0f));
+
+		// The kernel sets of the instruction sets (kernels_sse41.cpp, kernels_avx2.cpp, kernels_avx512.cpp) against each other
+		for (auto precision : { EDRVector::Precision::Float, EDRVector::Precision::Fixed16 })
+		{
+			Add(precision == EDRVector::Precision::Fixed16 ? "isa-edrvector-fixed" : "isa-edrvector", CrossIsaCheck([precision]()
+			{
+				auto edr = std::make_shared<EDRVector>();
+				return [edr, precision](const ImageByteColor &src) { return edr->Perform(src, precision); };
+			}));
+		}
+
+		// Fixed16 against Float, the bound of the default kernels (see EDRVectorKernels::PerformFixed)
+		Add("fixed-edrvector", FixedCheck([]()
+		{
+			auto edr = std::make_shared<EDRVector>();
+			return [edr](const ImageByteColor &src, bool fixed) { return edr->Perform(src, fixed ? EDRVector::Precision::Fixed16 : EDRVector::Precision::Float); };
+		}, 2.3f, 0.01f));
+
+		const struct { const char *name; SIResampling::Mode mode; bool deblur; int radius; } si_modes[] =
+		{
+			{ "si1", SIResampling::Mode::SI1, false, 1 },
+			{ "si2", SIResampling::Mode::SI2, false, 2 },
+			{ "si3", SIResampling::Mode::SI3, false, 3 },
+			{ "si3deblur", SIResampling::Mode::SI3Deblur, true, 3 },
+		};
+
+		for (auto &si : si_modes)
+		{
+			std::string name = si.name;
+			std::wstring filename = dir + std::wstring(name.begin(), name.end()) + L".bin";
+			SIResampling::Mode mode = si.mode;
+			bool deblur = si.deblur;
+			int taps = (2 * si.radius + 1) * (2 * si.radius + 1);
+
+			for (auto precision : { SIResampling::Precision::Float, SIResampling::Precision::Fixed16 })
+			{
+				Add("isa-" + name + (precision == SIResampling::Precision::Fixed16 ? "-fixed" : ""), CrossIsaCheck([mode, filename, deblur, precision]()
+				{
+					std::shared_ptr<SIResampling> sir(Benchmark::LoadSI(mode, filename));
+					std::function<ImageByteColor(const ImageByteColor&)> res;
+
+					if (sir)
+					{
+						res = [sir, deblur, precision](const ImageByteColor &src)
+						{
+							return deblur ? sir->PerformDeblur(src, precision) : sir->Perform(src, precision);
+						};
+					}
+
+					return res;
+				}));
+			}
+
+			// Fixed16 against Float, the bound of SIKernels::PerformFixed for the kernels with sum(|k|) up to 8
+			Add("fixed-" + name, FixedCheck([mode, filename, deblur]()
+			{
+				std::shared_ptr<SIResampling> sir(Benchmark::LoadSI(mode, filename));
+				std::function<ImageByteColor(const ImageByteColor&, bool)> res;
+
+				if (sir)
+				{
+					res = [sir, deblur](const ImageByteColor &src, bool fixed)
+					{
+						auto precision = fixed ? SIResampling::Precision::Fixed16 : SIResampling::Precision::Float;
+						return deblur ? sir->PerformDeblur(src, precision) : sir->Perform(src, precision);
+					};
+				}
+
+				return res;
+			}, 8.0f / 32 + taps * 255.0f / 8192, 0.01f));
+		}
+	}
+
+	std::vector<Verification::Result> Verification::Run(const std::string &filter, std::function<void(const Result&)> progress) const
+	{
+		std::vector<Result> results;
+
+		for (auto &c : checks)
+		{
+			if (!filter.empty() && c.first.find(filter) == std::string::npos)
+				continue;
+
+			Result res;
+			res.name = c.first;
+			res.status = c.second(res.details);
+
+			results.push_back(res);
+
+			if (progress)
+				progress(res);
+		}
+
+		return results;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ip
+{
+	/* Compares the optimized paths of the library with their reference paths on generated inputs. Every check reports
+	* what it measured (the number of mismatches, the largest difference, the PSNR) and whether it is within the bound
+	* the path documents, so the claims about the results can be rechecked on any build and instruction set (see
+	* SetCpuIsa). The speed is measured by Benchmark */
+	class Verification
+	{
+	public:
+		enum class Status
+		{
+			Passed,
+			Failed,
+			Skipped		// The check cannot run (a model file is missing)
+		};
+
+		// Describes the measurement in 'details'
+		typedef std::function<Status(std::string &details)> Check;
+
+		struct Result
+		{
+			std::string name;
+			Status status;
+			std::string details;
+		};
+
+		void Add(const std::string &name, Check check);
+
+		// The checks of the library, the models are looked up in 'models' (srcnn.bin, si1.bin, ...)
+		void AddStandardChecks(const std::wstring &models);
+
+		// Runs only the checks containing 'filter' in the name, all checks if it is empty
+		std::vector<Result> Run(const std::string &filter, std::function<void(const Result&)> progress = nullptr) const;
+
+	private:
+		std::vector<std::pair<std::string, Check>> checks;
+	};
+}
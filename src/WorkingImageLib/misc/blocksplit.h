@@ -4,15 +4,16 @@
 #include <iplib/common.h>
 #include "padding.h"
 #include <iplib/parallel.h>
+#include <algorithm>
 
-namespace ip
+namespace ip { inline namespace IP_SIMD_NAMESPACE
 {
 	enum class BlockSplitPaddingMode
 	{
 		Duplicate
 	};
 
-#ifdef LEGACY
+#if defined(LEGACY)
 	enum class BlockSplitLayout
 	{
 		NotSet,
@@ -20,6 +21,16 @@ namespace ip
 		Layout2x2,
 		Layout1x4,
 	};
+#elif defined(AVX512)
+	enum class BlockSplitLayout
+	{
+		NotSet,
+		Layout16x1,
+		Layout8x2,
+		Layout4x4,
+		Layout2x8,
+		Layout1x16
+	};
 #else
 	enum class BlockSplitLayout
 	{
@@ -60,12 +71,35 @@ namespace ip
 
 		inline BlockSplitLayout GetSplitLayout() const;
 
+		// Block layout of a source image and the size of the padded vector image Split produces from it
+		struct Geometry
+		{
+			int HorzBlocks, VertBlocks;
+			int BlockWidth, BlockHeight;
+			int Width, Height;
+		};
+
+		inline Geometry GetGeometry(int SrcWidth, int SrcHeight, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
+
+		template <typename PixelType>
+		class RowReader;
+
+		typedef RowReader<VectorFloatColor> Reader;
+		typedef RowReader<VectorShortColor> FixedReader;
+
+		class Writer;
+
 		inline VectorImageFloat Split(const ImageFloat &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
 		inline VectorImageFloatColor Split(const ImageFloatColor &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
 		inline VectorImageFloatColor Split(const ImageByteColor &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
 
+		// 16-bit fixed-point version of Split, see VectorShortColor
+		inline VectorImageShortColor SplitFixed(const ImageByteColor &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
+
 		inline ImageFloatColor Gather(const VectorImageFloatColor &src) const;
-		inline ImageByteColor Gather(const Image<VectorByte> &src) const;
+
+		// The result is cropped to Width x Height if set, the pixels outside are not written
+		inline ImageByteColor Gather(const Image<VectorByte> &src, int Width = 0, int Height = 0) const;
 
 	private:
 		BlockSplitConfiguration inputPadding, outputPadding;
@@ -75,15 +109,14 @@ namespace ip
 		template <int HorzBlocks, int VertBlocks>
 		inline VectorImageFloatColor PerformSplit(const ImageFloatColor &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
 
-		template <int HorzBlocks, int VertBlocks>
-		inline VectorImageFloatColor PerformSplit(const ImageByteColor &src, int ManualBlockWidth = 0, int ManualBlockHeight = 0) const;
+		// Converts the row y of the padded vector image reading the source directly, the padding is made by clamping the coordinates.
+		// PixelType is either VectorFloatColor or VectorShortColor
+		template <typename PixelType>
+		inline void SplitRow(const ImageByteColor &src, const Geometry &g, int y, PixelType *dst) const;
 
 		template <int HorzBlocks, int VertBlocks>
 		inline ImageFloatColor PerformGather(const VectorImageFloatColor &src) const;
 
-		template <int HorzBlocks, int VertBlocks>
-		inline ImageByteColor PerformGather(const Image<VectorByte> &src) const;
-
 		template <typename PixelType, class SourceImageType, class DestinationImageType>
 		inline void Expand(const ImageReadable<PixelType, SourceImageType> &src, ImageWritable<PixelType, DestinationImageType> &dst) const;
 
@@ -92,6 +125,74 @@ namespace ip
 
 		template <typename PixelType, int HorzBlocks, int VertBlocks, int BlockIndex>
 		class SplitReader;
+
+#ifdef AVX512
+		// Byte offsets of the blocks from the pixel of the first block, lane k holds the block k
+		template <int HorzBlocks, int VertBlocks, typename PixelType>
+		inline static __m512i BlockOffsets(const Image<PixelType> &img, int BlockWidth, int BlockHeight);
+
+		// Coordinates of the block origins, lane k holds the block k
+		template <int HorzBlocks, int VertBlocks>
+		inline static void BlockOrigins(int BlockWidth, int BlockHeight, __m512i &x, __m512i &y);
+#endif
+	};
+
+	// ==================================================================================================
+
+	/* Streaming split: the rows of the padded vector image are converted from the source on demand into a ring of
+	* Rows rows, so a worker holds a window of the vector image instead of the whole one. Not thread-safe, every worker
+	* needs its own reader */
+	template <typename PixelType>
+	class BlockSplit::RowReader
+	{
+	public:
+		inline RowReader(const BlockSplit &split, const ImageByteColor &src, int Rows);
+
+		int Width() const { return g.Width; }
+		int Height() const { return g.Height; }
+
+		// Makes the rows first..last available, last - first should be less than Rows. The windows are expected to move down
+		inline void Prepare(int first, int last);
+
+		const PixelType &operator()(int x, int y) const
+		{
+			dbgcheck(y >= first && y <= last);
+			return *rows.pixeladdr(x, y & mask);
+		}
+
+	private:
+		const BlockSplit &split;
+		const ImageByteColor &src;
+		Geometry g;
+
+		Image<PixelType> rows;
+		int mask;
+		int first = 0, last = -1;
+
+		inline static int RingSize(int Rows);
+	};
+
+	/* Streaming gather: the vector pixels are written straight into the destination image instead of a Image<VectorByte>.
+	* The coordinates are those of the vector image of Width x Height including the output padding. The pixels inside
+	* the padding and the lanes falling outside the destination are dropped. Different pixels may be stored in parallel */
+	class BlockSplit::Writer
+	{
+	public:
+		inline Writer(const BlockSplit &split, ImageByteColor &dst, int Width, int Height);
+
+		inline void Store(int x, int y, VectorByte value) const;
+
+	private:
+		char *base;
+		int stride;
+		int DstWidth, DstHeight;
+		int left, top, BlockWidth, BlockHeight;
+
+#ifdef AVX512
+		__m512i x0, y0, offsets;
+#else
+		int x0[VectorFloat::size], y0[VectorFloat::size];
+#endif
 	};
 
 	// ==================================================================================================
@@ -103,7 +204,7 @@ namespace ip
 	{
 	public:
 
-#ifdef LEGACY
+#if defined(LEGACY)
 		static void ToVector(ScalarPixelType v0, ScalarPixelType v1, ScalarPixelType v2, ScalarPixelType v3, VectorPixelType &dst)
 		{
 			die("Invalid call");
@@ -113,6 +214,16 @@ namespace ip
 		{
 			die("Invalid call");
 		}
+#elif defined(AVX512)
+		static void ToVector(const ScalarPixelType (&v)[16], VectorPixelType &dst)
+		{
+			die("Invalid call");
+		}
+
+		static void FromVector(const VectorPixelType &src, ScalarPixelType (&v)[16])
+		{
+			die("Invalid call");
+		}
 #else
 		static void ToVector(ScalarPixelType v0, ScalarPixelType v1, ScalarPixelType v2, ScalarPixelType v3, ScalarPixelType v4, ScalarPixelType v5, ScalarPixelType v6, ScalarPixelType v7, VectorPixelType &dst)
 		{
@@ -130,7 +241,7 @@ namespace ip
 	struct BlockSplit::Helper<float, VectorFloat>
 	{
 	public:
-#ifdef LEGACY
+#if defined(LEGACY)
 		static void ToVector(float v0, float v1, float v2, float v3, VectorFloat &dst)
 		{
 			dst = float4(v0, v1, v2, v3);
@@ -143,6 +254,16 @@ namespace ip
 			v2 = src.get_value().m128_f32[2];
 			v3 = src.get_value().m128_f32[3];
 		}
+#elif defined(AVX512)
+		static void ToVector(const float (&v)[16], VectorFloat &dst)
+		{
+			dst = float16::loadu(v);
+		}
+
+		static void FromVector(const VectorFloat &src, float (&v)[16])
+		{
+			_mm512_storeu_ps(v, src.get_value());
+		}
 #else
 		static void ToVector(float v0, float v1, float v2, float v3, float v4, float v5, float v6, float v7, VectorFloat &dst)
 		{
@@ -163,6 +284,33 @@ namespace ip
 #endif
 	};
 
+#ifdef AVX512
+
+	template <int HorzBlocks, int VertBlocks, typename PixelType>
+	__m512i BlockSplit::BlockOffsets(const Image<PixelType> &img, int BlockWidth, int BlockHeight)
+	{
+		__m512i x, y;
+		BlockOrigins<HorzBlocks, VertBlocks>(BlockWidth, BlockHeight, x, y);
+
+		return _mm512_add_epi32(_mm512_mullo_epi32(x, _mm512_set1_epi32((int)sizeof(PixelType))),
+			_mm512_mullo_epi32(y, _mm512_set1_epi32((int)img.Data().stride)));
+	}
+
+	template <int HorzBlocks, int VertBlocks>
+	void BlockSplit::BlockOrigins(int BlockWidth, int BlockHeight, __m512i &x, __m512i &y)
+	{
+		static_assert(HorzBlocks * VertBlocks == 16, "The number of blocks should be equal to 16");
+
+		const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		const __m512i row = _mm512_srli_epi32(lanes, HorzBlocks == 16 ? 4 : HorzBlocks == 8 ? 3 : HorzBlocks == 4 ? 2 : HorzBlocks == 2 ? 1 : 0);
+		const __m512i column = _mm512_and_si512(lanes, _mm512_set1_epi32(HorzBlocks - 1));
+
+		x = _mm512_mullo_epi32(column, _mm512_set1_epi32(BlockWidth));
+		y = _mm512_mullo_epi32(row, _mm512_set1_epi32(BlockHeight));
+	}
+
+#endif
+
 #pragma endregion
 
 	// ==================================================================================================
@@ -190,7 +338,7 @@ namespace ip
 
 	void BlockSplit::ComputeSplitLayout(int Width, int Height)
 	{
-#ifdef LEGACY
+#if defined(LEGACY)
 		int p1 = Width * 4 + Height;
 		int p2 = Width * 2 + Height * 2;
 		int p4 = Width + Height * 4;
@@ -207,6 +355,33 @@ namespace ip
 		{
 			layout = BlockSplitLayout::Layout1x4;
 		}
+#elif defined(AVX512)
+		int p1 = Width * 16 + Height;
+		int p2 = Width * 8 + Height * 2;
+		int p4 = Width * 4 + Height * 4;
+		int p8 = Width * 2 + Height * 8;
+		int p16 = Width + Height * 16;
+
+		if (p1 < p2)
+		{
+			layout = BlockSplitLayout::Layout16x1;
+		}
+		else if (p2 < p4)
+		{
+			layout = BlockSplitLayout::Layout8x2;
+		}
+		else if (p4 < p8)
+		{
+			layout = BlockSplitLayout::Layout4x4;
+		}
+		else if (p8 < p16)
+		{
+			layout = BlockSplitLayout::Layout2x8;
+		}
+		else
+		{
+			layout = BlockSplitLayout::Layout1x16;
+		}
 #else
 		int p1 = Width * 8 + Height;
 		int p2 = Width * 4 + Height * 2;
@@ -233,48 +408,84 @@ namespace ip
 	}
 
 
-	VectorImageFloat BlockSplit::Split(const ImageFloat &src, int ManualBlockWidth, int ManualBlockHeight) const
+	BlockSplit::Geometry BlockSplit::GetGeometry(int SrcWidth, int SrcHeight, int ManualBlockWidth, int ManualBlockHeight) const
 	{
-		die("Not implemented");
-	}
+		Geometry g;
 
-	VectorImageFloatColor BlockSplit::Split(const ImageFloatColor &src, int ManualBlockWidth, int ManualBlockHeight) const
-	{
 		switch (layout)
 		{
-#ifdef LEGACY
+#if defined(LEGACY)
 		case BlockSplitLayout::Layout1x4:
-			return PerformSplit<1, 4>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 1;
+			break;
 
 		case BlockSplitLayout::Layout2x2:
-			return PerformSplit<2, 2>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 2;
+			break;
 
 		case BlockSplitLayout::Layout4x1:
-			return PerformSplit<4, 1>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 4;
+			break;
+#elif defined(AVX512)
+		case BlockSplitLayout::Layout1x16:
+			g.HorzBlocks = 1;
+			break;
+
+		case BlockSplitLayout::Layout2x8:
+			g.HorzBlocks = 2;
+			break;
+
+		case BlockSplitLayout::Layout4x4:
+			g.HorzBlocks = 4;
+			break;
+
+		case BlockSplitLayout::Layout8x2:
+			g.HorzBlocks = 8;
+			break;
+
+		case BlockSplitLayout::Layout16x1:
+			g.HorzBlocks = 16;
+			break;
 #else
 		case BlockSplitLayout::Layout1x8:
-			return PerformSplit<1, 8>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 1;
+			break;
 
 		case BlockSplitLayout::Layout2x4:
-			return PerformSplit<2, 4>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 2;
+			break;
 
 		case BlockSplitLayout::Layout4x2:
-			return PerformSplit<4, 2>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 4;
+			break;
 
 		case BlockSplitLayout::Layout8x1:
-			return PerformSplit<8, 1>(src, ManualBlockWidth, ManualBlockHeight);
+			g.HorzBlocks = 8;
+			break;
 #endif
-
 		default:
 			die("Invalid BlockSplitLayout value");
 		}
+
+		g.VertBlocks = VectorFloat::size / g.HorzBlocks;
+		g.BlockWidth = ManualBlockWidth == 0 ? (SrcWidth + g.HorzBlocks - 1) / g.HorzBlocks : ManualBlockWidth;
+		g.BlockHeight = ManualBlockHeight == 0 ? (SrcHeight + g.VertBlocks - 1) / g.VertBlocks : ManualBlockHeight;
+		g.Width = g.BlockWidth + inputPadding.paddingLeft + inputPadding.paddingRight;
+		g.Height = g.BlockHeight + inputPadding.paddingTop + inputPadding.paddingBottom;
+
+		return g;
 	}
 
-	VectorImageFloatColor BlockSplit::Split(const ImageByteColor &src, int ManualBlockWidth, int ManualBlockHeight) const
+	VectorImageFloat BlockSplit::Split(const ImageFloat &src, int ManualBlockWidth, int ManualBlockHeight) const
+	{
+		die("Not implemented");
+	}
+
+	VectorImageFloatColor BlockSplit::Split(const ImageFloatColor &src, int ManualBlockWidth, int ManualBlockHeight) const
 	{
-#ifdef LEGACY
 		switch (layout)
 		{
+#if defined(LEGACY)
 		case BlockSplitLayout::Layout1x4:
 			return PerformSplit<1, 4>(src, ManualBlockWidth, ManualBlockHeight);
 
@@ -283,9 +494,22 @@ namespace ip
 
 		case BlockSplitLayout::Layout4x1:
 			return PerformSplit<4, 1>(src, ManualBlockWidth, ManualBlockHeight);
+#elif defined(AVX512)
+		case BlockSplitLayout::Layout1x16:
+			return PerformSplit<1, 16>(src, ManualBlockWidth, ManualBlockHeight);
+
+		case BlockSplitLayout::Layout2x8:
+			return PerformSplit<2, 8>(src, ManualBlockWidth, ManualBlockHeight);
+
+		case BlockSplitLayout::Layout4x4:
+			return PerformSplit<4, 4>(src, ManualBlockWidth, ManualBlockHeight);
+
+		case BlockSplitLayout::Layout8x2:
+			return PerformSplit<8, 2>(src, ManualBlockWidth, ManualBlockHeight);
+
+		case BlockSplitLayout::Layout16x1:
+			return PerformSplit<16, 1>(src, ManualBlockWidth, ManualBlockHeight);
 #else
-		switch (layout)
-		{
 		case BlockSplitLayout::Layout1x8:
 			return PerformSplit<1, 8>(src, ManualBlockWidth, ManualBlockHeight);
 
@@ -298,11 +522,25 @@ namespace ip
 		case BlockSplitLayout::Layout8x1:
 			return PerformSplit<8, 1>(src, ManualBlockWidth, ManualBlockHeight);
 #endif
+
 		default:
 			die("Invalid BlockSplitLayout value");
 		}
 	}
 
+	VectorImageFloatColor BlockSplit::Split(const ImageByteColor &src, int ManualBlockWidth, int ManualBlockHeight) const
+	{
+		Geometry g = GetGeometry(src.Width(), src.Height(), ManualBlockWidth, ManualBlockHeight);
+		VectorImageFloatColor res(g.Width, g.Height);
+
+		Parallel::For(0, res.Height(), [this, &src, &g, &res](int j)
+		{
+			SplitRow(src, g, j, &res(0, j));
+		});
+
+		return res;
+	}
+
 	template <typename PixelType, class SourceImageType, class DestinationImageType>
 	void BlockSplit::Expand(const ImageReadable<PixelType, SourceImageType> &src, ImageWritable<PixelType, DestinationImageType> &dst) const
 	{
@@ -355,11 +593,7 @@ namespace ip
 	template <int HorzBlocks, int VertBlocks>
 	VectorImageFloatColor BlockSplit::PerformSplit(const ImageFloatColor &src, int ManualBlockWidth, int ManualBlockHeight) const
 	{
-#ifdef LEGACY
-		static_assert(HorzBlocks * VertBlocks == 4, "The number of blocks should be equal to 4");
-#else
-		static_assert(HorzBlocks * VertBlocks == 8, "The number of blocks should be equal to 8");
-#endif
+		static_assert(HorzBlocks * VertBlocks == VectorFloat::size, "The number of blocks should be equal to the vector size");
 		int BlockWidth = ManualBlockWidth == 0 ? (src.Width() + HorzBlocks - 1) / HorzBlocks : ManualBlockWidth;
 		int BlockHeight = ManualBlockHeight == 0 ? (src.Height() + VertBlocks - 1) / VertBlocks : ManualBlockHeight;
 
@@ -373,13 +607,20 @@ namespace ip
 		{
 			for (int i = 0; i < res.Width(); i++)
 			{
-#ifdef LEGACY
+#if defined(LEGACY)
 				Helper<PixelFloatRGBA, VectorFloatColor>::ToVector(
 					tmp(i, j),
 					tmp(i + BlockWidth * (1 % HorzBlocks), j + BlockHeight * (1 / HorzBlocks)),
 					tmp(i + BlockWidth * (2 % HorzBlocks), j + BlockHeight * (2 / HorzBlocks)),
 					tmp(i + BlockWidth * (3 % HorzBlocks), j + BlockHeight * (3 / HorzBlocks)),
 					res(i, j));
+#elif defined(AVX512)
+				PixelFloatRGBA v[16];
+
+				for (int k = 0; k < 16; k++)
+					v[k] = tmp(i + BlockWidth * (k % HorzBlocks), j + BlockHeight * (k / HorzBlocks));
+
+				Helper<PixelFloatRGBA, VectorFloatColor>::ToVector(v, res(i, j));
 #else
 				Helper<PixelFloatRGBA, VectorFloatColor>::ToVector(
 					tmp(i, j),
@@ -398,15 +639,22 @@ namespace ip
 		return res;
 	}
 
-	template <int HorzBlocks, int VertBlocks>
-	VectorImageFloatColor BlockSplit::PerformSplit(const ImageByteColor &src, int ManualBlockWidth, int ManualBlockHeight) const
+	VectorImageShortColor BlockSplit::SplitFixed(const ImageByteColor &src, int ManualBlockWidth, int ManualBlockHeight) const
 	{
-#ifdef LEGACY
-		static_assert(HorzBlocks * VertBlocks == 4, "The number of blocks should be equal to 4");
-#else
-		static_assert(HorzBlocks * VertBlocks == 8, "The number of blocks should be equal to 8");
-#endif
+		Geometry g = GetGeometry(src.Width(), src.Height(), ManualBlockWidth, ManualBlockHeight);
+		VectorImageShortColor res(g.Width, g.Height);
 
+		Parallel::For(0, res.Height(), [this, &src, &g, &res](int j)
+		{
+			SplitRow(src, g, j, &res(0, j));
+		});
+
+		return res;
+	}
+
+	template <typename PixelType>
+	void BlockSplit::SplitRow(const ImageByteColor &src, const Geometry &g, int y, PixelType *dst) const
+	{
 		static const VectorFloat YR(0.299f);
 		static const VectorFloat YG(0.587f);
 		static const VectorFloat YB(0.114f);
@@ -419,83 +667,81 @@ namespace ip
 		static const VectorFloat UG(-0.418f);
 		static const VectorFloat UB(-0.0813f);
 
-		int BlockWidth = ManualBlockWidth == 0 ? (src.Width() + HorzBlocks - 1) / HorzBlocks : ManualBlockWidth;
-		int BlockHeight = ManualBlockHeight == 0 ? (src.Height() + VertBlocks - 1) / VertBlocks : ManualBlockHeight;
+		const char *base = (const char*)src.pixeladdr(0, 0);
+		int stride = (int)src.Data().stride;
+		int MaxX = src.Width() - 1;
+		int MaxY = src.Height() - 1;
 
-		ImageByteColor tmp(BlockWidth * HorzBlocks + inputPadding.paddingLeft + inputPadding.paddingRight, BlockHeight * VertBlocks + inputPadding.paddingTop + inputPadding.paddingBottom);
+		// Byte offset of the source row and the source column of the first pixel, lane k holds the block k
+		alignas(64) int rows[VectorFloat::size];
+		alignas(64) int columns[VectorFloat::size];
 
-		Expand(src, tmp);
-
-		VectorImageFloatColor res(BlockWidth + inputPadding.paddingLeft + inputPadding.paddingRight, BlockHeight + inputPadding.paddingTop + inputPadding.paddingBottom);
-
-		Parallel::For(0, res.Height(), [BlockWidth, BlockHeight, &tmp, &res](int j)
+		for (int k = 0; k < VectorFloat::size; k++)
 		{
-			for (int i = 0; i < res.Width(); i++)
-			{
-				float4 v0 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (0 % HorzBlocks), j + BlockHeight * (0 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
-
-				float4 v1 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (1 % HorzBlocks), j + BlockHeight * (1 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+			rows[k] = std::min(std::max(y + g.BlockHeight * (k / g.HorzBlocks) - inputPadding.paddingTop, 0), MaxY) * stride;
+			columns[k] = g.BlockWidth * (k % g.HorzBlocks) - inputPadding.paddingLeft;
+		}
 
-				float4 v2 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (2 % HorzBlocks), j + BlockHeight * (2 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+#if defined(LEGACY)
+		const __m128i M255 = _mm_set1_epi32(0xFF);
 
-				float4 v3 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (3 % HorzBlocks), j + BlockHeight * (3 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+		for (int i = 0; i < g.Width; i++)
+		{
+			alignas(16) int pixels[4];
 
-#ifndef LEGACY
-				float4 v4 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (4 % HorzBlocks), j + BlockHeight * (4 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+			for (int k = 0; k < 4; k++)
+				pixels[k] = *(const int*)(base + rows[k] + std::min(std::max(i + columns[k], 0), MaxX) * (int)sizeof(PixelByteRGBA));
 
-				float4 v5 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (5 % HorzBlocks), j + BlockHeight * (5 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+			__m128i bgra = _mm_load_si128((const __m128i*)pixels);
 
-				float4 v6 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (6 % HorzBlocks), j + BlockHeight * (6 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
+			float4 b = int4(_mm_and_si128(bgra, M255)).convert_f32();
+			float4 gr = int4(_mm_and_si128(_mm_srli_epi32(bgra, 8), M255)).convert_f32();
+			float4 r = int4(_mm_and_si128(_mm_srli_epi32(bgra, 16), M255)).convert_f32();
 
-				float4 v7 = float4::load_single(tmp.pixeladdr(i + BlockWidth * (7 % HorzBlocks), j + BlockHeight * (7 / HorzBlocks)))
-					.cast_byte16().convert_u32().convert_f32();
-#endif
+			dst[i] = PixelType(VectorFloatColor(r * YR + gr * YG + b * YB, r * UR + gr * UG + b * UB, r * VR + gr * VG + b * VB));
+		}
+#elif defined(AVX512)
+		const __m512i M255 = _mm512_set1_epi32(0xFF);
+		const __m512i maxx = _mm512_set1_epi32(MaxX);
+		const __m512i row = _mm512_load_si512(rows);
+		const __m512i column = _mm512_load_si512(columns);
 
-				float4 bg02 = v0.unpack_lo(v2);
-				float4 ra02 = v0.unpack_hi(v2);
-				float4 bg13 = v1.unpack_lo(v3);
-				float4 ra13 = v1.unpack_hi(v3);
+		for (int i = 0; i < g.Width; i++)
+		{
+			__m512i x = _mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(column, _mm512_set1_epi32(i)), _mm512_setzero_si512()), maxx);
+			__m512i bgra = _mm512_i32gather_epi32(_mm512_add_epi32(row, _mm512_slli_epi32(x, 2)), base, 1);
 
-				float4 b0123 = bg02.unpack_lo(bg13);
-				float4 g0123 = bg02.unpack_hi(bg13);
-				float4 r0123 = ra02.unpack_lo(ra13);
+			float16 b = int16(_mm512_and_si512(bgra, M255)).convert_f32();
+			float16 gr = int16(_mm512_and_si512(_mm512_srli_epi32(bgra, 8), M255)).convert_f32();
+			float16 r = int16(_mm512_and_si512(_mm512_srli_epi32(bgra, 16), M255)).convert_f32();
 
-#ifndef LEGACY
-				float4 bg46 = v4.unpack_lo(v6);
-				float4 ra46 = v4.unpack_hi(v6);
-				float4 bg57 = v5.unpack_lo(v7);
-				float4 ra57 = v5.unpack_hi(v7);
+			dst[i] = PixelType(VectorFloatColor(r * YR + gr * YG + b * YB, r * UR + gr * UG + b * UB, r * VR + gr * VG + b * VB));
+		}
+#else
+		const __m256i M255 = _mm256_set1_epi32(0xFF);
+		const __m256i maxx = _mm256_set1_epi32(MaxX);
+		const __m256i row = _mm256_load_si256((const __m256i*)rows);
+		const __m256i column = _mm256_load_si256((const __m256i*)columns);
 
-				float4 b4567 = bg46.unpack_lo(bg57);
-				float4 g4567 = bg46.unpack_hi(bg57);
-				float4 r4567 = ra46.unpack_lo(ra57);
+		for (int i = 0; i < g.Width; i++)
+		{
+			__m256i x = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(column, _mm256_set1_epi32(i)), _mm256_setzero_si256()), maxx);
+			__m256i bgra = _mm256_i32gather_epi32((const int*)base, _mm256_add_epi32(row, _mm256_slli_epi32(x, 2)), 1);
 
-				float8 b = float8(b0123, b4567);
-				float8 g = float8(g0123, g4567);
-				float8 r = float8(r0123, r4567);
+			float8 b = int8(_mm256_and_si256(bgra, M255)).convert_f32();
+			float8 gr = int8(_mm256_and_si256(_mm256_srli_epi32(bgra, 8), M255)).convert_f32();
+			float8 r = int8(_mm256_and_si256(_mm256_srli_epi32(bgra, 16), M255)).convert_f32();
 
-				res(i, j) = VectorFloatColor(r * YR + g * YG + b * YB, r * UR + g * UG + b * UB, r * VR + g * VG + b * VB);
-#else
-				res(i, j) = VectorFloatColor(r0123 * YR + g0123 * YG + b0123 * YB, r0123 * UR + g0123 * UG + b0123 * UB, r0123 * VR + g0123 * VG + b0123 * VB);
+			dst[i] = PixelType(VectorFloatColor(r * YR + gr * YG + b * YB, r * UR + gr * UG + b * UB, r * VR + gr * VG + b * VB));
+		}
 #endif
-			}
-		});
-
-		return res;
 	}
 
 	ImageFloatColor BlockSplit::Gather(const VectorImageFloatColor &src) const
 	{
 		switch (layout)
 		{
-#ifdef LEGACY
+#if defined(LEGACY)
 		case BlockSplitLayout::Layout1x4:
 			return PerformGather<1, 4>(src);
 
@@ -504,6 +750,21 @@ namespace ip
 
 		case BlockSplitLayout::Layout4x1:
 			return PerformGather<4, 1>(src);
+#elif defined(AVX512)
+		case BlockSplitLayout::Layout1x16:
+			return PerformGather<1, 16>(src);
+
+		case BlockSplitLayout::Layout2x8:
+			return PerformGather<2, 8>(src);
+
+		case BlockSplitLayout::Layout4x4:
+			return PerformGather<4, 4>(src);
+
+		case BlockSplitLayout::Layout8x2:
+			return PerformGather<8, 2>(src);
+
+		case BlockSplitLayout::Layout16x1:
+			return PerformGather<16, 1>(src);
 #else
 		case BlockSplitLayout::Layout1x8:
 			return PerformGather<1, 8>(src);
@@ -522,50 +783,53 @@ namespace ip
 		}
 	}
 
-	ImageByteColor BlockSplit::Gather(const Image<VectorByte> &src) const
+	ImageByteColor BlockSplit::Gather(const Image<VectorByte> &src, int Width, int Height) const
 	{
-		switch (layout)
+		if (Width == 0 || Height == 0)
 		{
-#ifdef LEGACY
-		case BlockSplitLayout::Layout1x4:
-			return PerformGather<1, 4>(src);
-
-		case BlockSplitLayout::Layout2x2:
-			return PerformGather<2, 2>(src);
-
-		case BlockSplitLayout::Layout4x1:
-			return PerformGather<4, 1>(src);
-#else
-		case BlockSplitLayout::Layout1x8:
-			return PerformGather<1, 8>(src);
+			Geometry g = GetGeometry(0, 0);
+			Width = (src.Width() - outputPadding.paddingLeft - outputPadding.paddingRight) * g.HorzBlocks;
+			Height = (src.Height() - outputPadding.paddingTop - outputPadding.paddingBottom) * g.VertBlocks;
+		}
 
-		case BlockSplitLayout::Layout2x4:
-			return PerformGather<2, 4>(src);
+		ImageByteColor res(Width, Height);
+		Writer writer(*this, res, src.Width(), src.Height());
 
-		case BlockSplitLayout::Layout4x2:
-			return PerformGather<4, 2>(src);
+		Parallel::For(outputPadding.paddingTop, src.Height() - outputPadding.paddingBottom, [this, &src, &writer](int j)
+		{
+			for (int i = outputPadding.paddingLeft; i < src.Width() - outputPadding.paddingRight; i++)
+				writer.Store(i, j, src(i, j));
+		});
 
-		case BlockSplitLayout::Layout8x1:
-			return PerformGather<8, 1>(src);
-#endif
-		default:
-			die("Invalid BlockSplitLayout value");
-		}
+		return res;
 	}
 
 	template <int HorzBlocks, int VertBlocks>
 	ImageFloatColor BlockSplit::PerformGather(const VectorImageFloatColor &src) const
 	{
-#ifdef LEGACY
-		static_assert(HorzBlocks * VertBlocks == 4, "The number of blocks should be equal to 4");
-#else
-		static_assert(HorzBlocks * VertBlocks == 8, "The number of blocks should be equal to 8");
-#endif
+		static_assert(HorzBlocks * VertBlocks == VectorFloat::size, "The number of blocks should be equal to the vector size");
 		int BlockWidth = src.Width() - outputPadding.paddingLeft - outputPadding.paddingRight;
 		int BlockHeight = src.Height() - outputPadding.paddingTop - outputPadding.paddingBottom;
 
 		ImageFloatColor res(BlockWidth * HorzBlocks, BlockHeight * VertBlocks);
 
+#ifdef AVX512
+		__m512i offsets = BlockOffsets<HorzBlocks, VertBlocks>(res, BlockWidth, BlockHeight);
+
+		Parallel::For(0, BlockHeight, [this, &src, &res, offsets, BlockWidth](int j)
+		{
+			for (int i = 0; i < BlockWidth; i++)
+			{
+				const VectorFloatColor &c = src(i + outputPadding.paddingLeft, j + outputPadding.paddingTop);
+				float *dst = (float*)res.pixeladdr(i, j);
+
+				_mm512_i32scatter_ps(dst, offsets, c.y.get_value(), 1);
+				_mm512_i32scatter_ps(dst + 1, offsets, c.u.get_value(), 1);
+				_mm512_i32scatter_ps(dst + 2, offsets, c.v.get_value(), 1);
+				_mm512_i32scatter_ps(dst + 3, offsets, _mm512_setzero_ps(), 1);
+			}
+		});
+#else
 		Parallel::For(0, BlockHeight, [this, &src, &res, BlockWidth, BlockHeight](int j)
 		{
 			for (int i = 0; i < BlockWidth; i += 2)
@@ -622,43 +886,107 @@ namespace ip
 #endif
 			}
 		});
+#endif
 
 		return res;
 	}
 
-	template <int HorzBlocks, int VertBlocks>
-	ImageByteColor BlockSplit::PerformGather(const Image<VectorByte> &src) const
+	// ==================================================================================================
+
+	template <typename PixelType>
+	BlockSplit::RowReader<PixelType>::RowReader(const BlockSplit &split, const ImageByteColor &src, int Rows)
+		: split(split), src(src), g(split.GetGeometry(src.Width(), src.Height())), rows(g.Width, RingSize(Rows)), mask(rows.Height() - 1)
 	{
-#ifdef LEGACY
-		static_assert(HorzBlocks * VertBlocks == 4, "The number of blocks should be equal to 4");
+	}
+
+	template <typename PixelType>
+	int BlockSplit::RowReader<PixelType>::RingSize(int Rows)
+	{
+		int size = 1;
+
+		while (size < Rows)
+			size *= 2;
+
+		return size;
+	}
+
+	template <typename PixelType>
+	void BlockSplit::RowReader<PixelType>::Prepare(int first, int last)
+	{
+		dbgcheck(first >= 0 && last < g.Height && last - first <= mask);
+
+		// The rows are kept when the new window overlaps or continues the cached one
+		if (first < this->first || first > this->last + 1)
+		{
+			this->first = first;
+			this->last = first - 1;
+		}
+
+		for (int j = this->last + 1; j <= last; j++)
+			split.SplitRow(src, g, j, &rows(0, j & mask));
+
+		this->last = std::max(this->last, last);
+		this->first = std::max(this->first, this->last - mask);
+	}
+
+	// ==================================================================================================
+
+	BlockSplit::Writer::Writer(const BlockSplit &split, ImageByteColor &dst, int Width, int Height)
+		: base((char*)dst.pixeladdr(0, 0)), stride((int)dst.Data().stride), DstWidth(dst.Width()), DstHeight(dst.Height()),
+		left(split.outputPadding.paddingLeft), top(split.outputPadding.paddingTop),
+		BlockWidth(Width - split.outputPadding.paddingLeft - split.outputPadding.paddingRight),
+		BlockHeight(Height - split.outputPadding.paddingTop - split.outputPadding.paddingBottom)
+	{
+		Geometry g = split.GetGeometry(0, 0);
+		check(DstWidth <= BlockWidth * g.HorzBlocks && DstHeight <= BlockHeight * g.VertBlocks);
+
+#ifdef AVX512
+		alignas(64) int x[16], y[16];
+
+		for (int k = 0; k < 16; k++)
+		{
+			x[k] = BlockWidth * (k % g.HorzBlocks);
+			y[k] = BlockHeight * (k / g.HorzBlocks);
+		}
+
+		x0 = _mm512_load_si512(x);
+		y0 = _mm512_load_si512(y);
+		offsets = _mm512_add_epi32(_mm512_slli_epi32(x0, 2), _mm512_mullo_epi32(y0, _mm512_set1_epi32(stride)));
 #else
-		static_assert(HorzBlocks * VertBlocks == 8, "The number of blocks should be equal to 8");
+		for (int k = 0; k < VectorFloat::size; k++)
+		{
+			x0[k] = BlockWidth * (k % g.HorzBlocks);
+			y0[k] = BlockHeight * (k / g.HorzBlocks);
+		}
 #endif
-		int BlockWidth = src.Width() - outputPadding.paddingLeft - outputPadding.paddingRight;
-		int BlockHeight = src.Height() - outputPadding.paddingTop - outputPadding.paddingBottom;
+	}
 
-		ImageByteColor res(BlockWidth * HorzBlocks, BlockHeight * VertBlocks);
+	void BlockSplit::Writer::Store(int x, int y, VectorByte value) const
+	{
+		x -= left;
+		y -= top;
 
-		Parallel::For(0, BlockHeight, [this, &src, &res, BlockWidth, BlockHeight](int j)
-			// for (int j = 0; j < BlockHeight; j++)
+		if (x < 0 || y < 0 || x >= BlockWidth || y >= BlockHeight)
+			return;
+
+#ifdef AVX512
+		// The blocks crossing the right or the bottom edge are written under the lane mask
+		__mmask16 rows = _mm512_cmplt_epi32_mask(_mm512_add_epi32(y0, _mm512_set1_epi32(y)), _mm512_set1_epi32(DstHeight));
+		__mmask16 mask = _mm512_mask_cmplt_epi32_mask(rows, _mm512_add_epi32(x0, _mm512_set1_epi32(x)), _mm512_set1_epi32(DstWidth));
+		__m512i index = _mm512_add_epi32(offsets, _mm512_set1_epi32(y * stride + x * (int)sizeof(PixelByteRGBA)));
+
+		_mm512_mask_i32scatter_epi32(base, mask, index, value.get_value(), 1);
+#else
+		const PixelByteRGBA *c = (const PixelByteRGBA*)&value;
+
+		for (int k = 0; k < VectorFloat::size; k++)
 		{
-			for (int i = 0; i < BlockWidth; i++)
-			{
-				PixelByteRGBA *c = (PixelByteRGBA*)src.pixeladdr(i + outputPadding.paddingLeft, j + outputPadding.paddingTop);
-
-				res(i + BlockWidth * (0 % HorzBlocks), j + BlockHeight * (0 / HorzBlocks)) = c[0];
-				res(i + BlockWidth * (1 % HorzBlocks), j + BlockHeight * (1 / HorzBlocks)) = c[1];
-				res(i + BlockWidth * (2 % HorzBlocks), j + BlockHeight * (2 / HorzBlocks)) = c[2];
-				res(i + BlockWidth * (3 % HorzBlocks), j + BlockHeight * (3 / HorzBlocks)) = c[3];
-#ifndef LEGACY
-				res(i + BlockWidth * (4 % HorzBlocks), j + BlockHeight * (4 / HorzBlocks)) = c[4];
-				res(i + BlockWidth * (5 % HorzBlocks), j + BlockHeight * (5 / HorzBlocks)) = c[5];
-				res(i + BlockWidth * (6 % HorzBlocks), j + BlockHeight * (6 / HorzBlocks)) = c[6];
-				res(i + BlockWidth * (7 % HorzBlocks), j + BlockHeight * (7 / HorzBlocks)) = c[7];
-#endif
-			}
-		});
+			int xx = x + x0[k];
+			int yy = y + y0[k];
 
-		return res;
+			if (xx < DstWidth && yy < DstHeight)
+				((PixelByteRGBA*)(base + yy * stride))[xx] = c[k];
+		}
+#endif
 	}
-}
+} }
@@ -0,0 +1,112 @@
+#include "cpudispatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <initializer_list>
+#include <intrin.h>
+
+namespace ip
+{
+	static std::atomic_int selected_isa(-1);
+
+	CpuIsa DetectCpuIsa()
+	{
+		int info[4];
+
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+
+		__cpuid(info, 1);
+		int ecx1 = info[2];
+
+		bool sse41 = (ecx1 & (1 << 19)) != 0;
+		bool osxsave = (ecx1 & (1 << 27)) != 0;
+		bool avx = (ecx1 & (1 << 28)) != 0;
+		bool fma = (ecx1 & (1 << 12)) != 0;
+		bool f16c = (ecx1 & (1 << 29)) != 0;
+
+		check(sse41);
+
+		// The OS must save the YMM state (bits 1, 2) and, for AVX-512, the opmask and ZMM state (bits 5, 6, 7)
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+
+		// AVX is the minimum of the program, see cpudispatch.h
+		check(avx && (xcr0 & 0x06) == 0x06);
+
+		if (!avx || !fma || !f16c || max_leaf < 7)
+			return CpuIsa::SSE41;
+
+		__cpuidex(info, 7, 0);
+		int ebx7 = info[1];
+
+		bool avx2 = (ebx7 & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+		bool avx512 = (ebx7 & (1 << 16)) != 0 && (ebx7 & (1 << 17)) != 0 && (ebx7 & (1 << 30)) != 0 && (ebx7 & (1u << 31)) != 0 &&
+			(xcr0 & 0xE6) == 0xE6;
+
+		if (avx2 && avx512)
+			return CpuIsa::AVX512;
+
+		if (avx2)
+			return CpuIsa::AVX2;
+
+		return CpuIsa::SSE41;
+	}
+
+	CpuIsa GetCpuIsa()
+	{
+		int isa = selected_isa;
+
+		if (isa < 0)
+		{
+			CpuIsa detected = DetectCpuIsa(), requested;
+			const char *env = getenv("IP_CPU_ISA");
+
+			if (env != nullptr && ParseCpuIsa(env, requested) && requested < detected)
+				detected = requested;
+
+			isa = (int)detected;
+			selected_isa = isa;
+		}
+
+		return (CpuIsa)isa;
+	}
+
+	bool SetCpuIsa(CpuIsa isa)
+	{
+		if (isa > DetectCpuIsa())
+			return false;
+
+		selected_isa = (int)isa;
+		return true;
+	}
+
+	const char *CpuIsaName(CpuIsa isa)
+	{
+		switch (isa)
+		{
+		case CpuIsa::AVX512:
+			return "avx512";
+
+		case CpuIsa::AVX2:
+			return "avx2";
+
+		default:
+			return "sse41";
+		}
+	}
+
+	bool ParseCpuIsa(const char *name, CpuIsa &isa)
+	{
+		for (CpuIsa value : { CpuIsa::SSE41, CpuIsa::AVX2, CpuIsa::AVX512 })
+		{
+			if (_stricmp(name, CpuIsaName(value)) == 0)
+			{
+				isa = value;
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <iplib/common.h>
+
+namespace ip
+{
+	/* The vector kernels are compiled once per instruction set (kernels_sse41.cpp, kernels_avx2.cpp, kernels_avx512.cpp),
+	* every build lives in its own namespace selected by IP_SIMD_NAMESPACE, see simd.h.
+	* The public classes create the kernel set of GetCpuIsa().
+	*
+	* All the files of a configuration are compiled with the same /arch (Optimizations.props), the kernels of the
+	* higher instruction sets come from the intrinsics only. So the inline code of iplib the kernel files share with
+	* the rest of the program is the same in every file, whichever copy the linker keeps.
+	*
+	* AVX is the minimum: iplib uses the AVX intrinsics in every configuration and most are built with /arch:AVX,
+	* DetectCpuIsa stops the program on a processor without it. The SSE4.1 kernels serve the processors with AVX but
+	* without AVX2, FMA or F16C */
+	enum class CpuIsa
+	{
+		SSE41,
+		AVX2,		// AVX2, FMA and F16C
+		AVX512		// AVX-512 F, BW, DQ and VL
+	};
+
+	// The best instruction set supported by both the processor and the OS
+	CpuIsa DetectCpuIsa();
+
+	// The detected instruction set unless overridden by SetCpuIsa or IP_CPU_ISA environment variable (sse41, avx2, avx512)
+	CpuIsa GetCpuIsa();
+
+	// Override for benchmarking, fails if the instruction set is not supported. Affects the objects created afterwards
+	bool SetCpuIsa(CpuIsa isa);
+
+	const char *CpuIsaName(CpuIsa isa);
+	bool ParseCpuIsa(const char *name, CpuIsa &isa);
+
+	template <typename T>
+	T Dispatch(T sse41, T avx2, T avx512)
+	{
+		switch (GetCpuIsa())
+		{
+		case CpuIsa::AVX512:
+			return avx512;
+
+		case CpuIsa::AVX2:
+			return avx2;
+
+		default:
+			return sse41;
+		}
+	}
+}
@@ -0,0 +1,376 @@
+#include "modelfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <mutex>
+
+#include <Windows.h>
+
+namespace ip
+{
+	const char ModelFile::Magic[8] = { 'I', 'P', 'M', 'O', 'D', 'E', 'L', '\0' };
+
+	static uint64_t ModelChecksum(const uint8_t *data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	static uint64_t ElementCount(const ModelTensorDescriptor &desc)
+	{
+		uint64_t count = 1;
+
+		for (uint32_t i = 0; i < desc.rank; i++)
+			count *= desc.dims[i];
+
+		return count;
+	}
+
+	static size_t ElementSize(ModelDataType type)
+	{
+		return type == ModelDataType::Float16 ? 2 : 4;
+	}
+
+	// ==================================================================================================
+
+	class ModelFile::Mapping
+	{
+	public:
+		~Mapping();
+
+		bool Open(const wchar_t *filename, bool verify);
+		const float *Expand(int index);
+
+		const uint8_t *base = nullptr;
+		const ModelTensorDescriptor *tensors = nullptr;
+		int count = 0;
+
+	private:
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE map = nullptr;
+
+		// Float16 tensors converted on demand, by the tensor index
+		std::mutex lock;
+		std::vector<float*> expanded;
+	};
+
+	ModelFile::Mapping::~Mapping()
+	{
+		for (float *p : expanded)
+			_aligned_free(p);
+
+		if (base != nullptr)
+			UnmapViewOfFile(base);
+
+		if (map != nullptr)
+			CloseHandle(map);
+
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+
+	bool ModelFile::Mapping::Open(const wchar_t *filename, bool verify)
+	{
+		file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || (uint64_t)file_size.QuadPart < sizeof(ModelFileHeader))
+			return false;
+
+		map = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (map == nullptr)
+			return false;
+
+		base = (const uint8_t*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+		if (base == nullptr)
+			return false;
+
+		uint64_t size = (uint64_t)file_size.QuadPart;
+		const ModelFileHeader *header = (const ModelFileHeader*)base;
+
+		if (memcmp(header->magic, ModelFile::Magic, sizeof(header->magic)) != 0 || header->version != ModelFile::Version ||
+			header->byte_order != ModelFile::ByteOrder || header->file_size != size ||
+			sizeof(ModelFileHeader) + (uint64_t)header->tensor_count * sizeof(ModelTensorDescriptor) > size)
+			return false;
+
+		tensors = (const ModelTensorDescriptor*)(base + sizeof(ModelFileHeader));
+		count = (int)header->tensor_count;
+
+		for (int i = 0; i < count; i++)
+		{
+			const ModelTensorDescriptor &desc = tensors[i];
+
+			if (memchr(desc.name, 0, sizeof(desc.name)) == nullptr || desc.rank > 4 ||
+				(desc.type != ModelDataType::Float32 && desc.type != ModelDataType::Float16) ||
+				desc.offset % ModelFile::Alignment != 0 || desc.offset > size || desc.size > size - desc.offset ||
+				ElementCount(desc) * ElementSize(desc.type) != desc.size)
+				return false;
+
+			if (verify && ModelChecksum(base + desc.offset, (size_t)desc.size) != desc.checksum)
+				return false;
+		}
+
+		expanded.resize(count, nullptr);
+		return true;
+	}
+
+	const float *ModelFile::Mapping::Expand(int index)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (expanded[index] == nullptr)
+		{
+			size_t n = (size_t)ElementCount(tensors[index]);
+			const uint16_t *src = (const uint16_t*)(base + tensors[index].offset);
+			float *dst = (float*)_aligned_malloc((n > 0 ? n : 1) * sizeof(float), ModelFile::Alignment);
+
+			for (size_t i = 0; i < n; i++)
+				dst[i] = HalfToFloat(src[i]);
+
+			expanded[index] = dst;
+		}
+
+		return expanded[index];
+	}
+
+	// ==================================================================================================
+
+	ModelFile::ModelFile(const wchar_t *filename, bool verify)
+	{
+		std::shared_ptr<Mapping> m = std::make_shared<Mapping>();
+
+		if (m->Open(filename, verify))
+			mapping = m;
+	}
+
+	ModelFile::operator bool() const
+	{
+		return (bool)mapping;
+	}
+
+	bool ModelFile::IsModelFile(const wchar_t *filename)
+	{
+		FILE *F = _wfopen(filename, L"rb");
+		if (F == nullptr)
+			return false;
+
+		char magic[sizeof(Magic)];
+		bool res = fread(magic, 1, sizeof(magic), F) == sizeof(magic) && memcmp(magic, Magic, sizeof(magic)) == 0;
+
+		fclose(F);
+		return res;
+	}
+
+	int ModelFile::TensorCount() const
+	{
+		return mapping ? mapping->count : 0;
+	}
+
+	const ModelTensorDescriptor &ModelFile::Descriptor(int index) const
+	{
+		check(mapping && index >= 0 && index < mapping->count);
+		return mapping->tensors[index];
+	}
+
+	const ModelTensorDescriptor *ModelFile::Find(const char *name) const
+	{
+		for (int i = 0; i < TensorCount(); i++)
+			if (strcmp(mapping->tensors[i].name, name) == 0)
+				return &mapping->tensors[i];
+
+		return nullptr;
+	}
+
+	const float *ModelFile::Tensor(const char *name, size_t count) const
+	{
+		const ModelTensorDescriptor *desc = Find(name);
+
+		if (desc == nullptr || ElementCount(*desc) != count)
+			return nullptr;
+
+		if (desc->type == ModelDataType::Float16)
+			return mapping->Expand((int)(desc - mapping->tensors));
+
+		return (const float*)(mapping->base + desc->offset);
+	}
+
+	// ==================================================================================================
+
+	void ModelFileWriter::Add(const char *name, const float *data, std::initializer_list<uint32_t> dims, ModelDataType type)
+	{
+		check(strlen(name) < sizeof(ModelTensorDescriptor::name));
+		check(dims.size() > 0 && dims.size() <= 4);
+
+		Entry entry;
+		memset(&entry.desc, 0, sizeof(entry.desc));
+		strcpy(entry.desc.name, name);
+		entry.desc.type = type;
+		entry.desc.rank = (uint32_t)dims.size();
+
+		int k = 0;
+		for (uint32_t d : dims)
+			entry.desc.dims[k++] = d;
+
+		size_t n = (size_t)ElementCount(entry.desc);
+		entry.payload.resize(n * ElementSize(type));
+
+		if (type == ModelDataType::Float16)
+		{
+			uint16_t *dst = (uint16_t*)entry.payload.data();
+
+			for (size_t i = 0; i < n; i++)
+				dst[i] = FloatToHalf(data[i]);
+		}
+		else if (n > 0)
+		{
+			memcpy(entry.payload.data(), data, n * sizeof(float));
+		}
+
+		entry.desc.size = entry.payload.size();
+		entry.desc.checksum = ModelChecksum(entry.payload.data(), entry.payload.size());
+
+		entries.push_back(std::move(entry));
+	}
+
+	bool ModelFileWriter::Save(const wchar_t *filename) const
+	{
+		auto align = [](uint64_t offset) { return (offset + ModelFile::Alignment - 1) / ModelFile::Alignment * ModelFile::Alignment; };
+
+		std::vector<ModelTensorDescriptor> tensors;
+		uint64_t offset = align(sizeof(ModelFileHeader) + entries.size() * sizeof(ModelTensorDescriptor));
+
+		for (auto &entry : entries)
+		{
+			tensors.push_back(entry.desc);
+			tensors.back().offset = offset;
+			offset = align(offset + entry.desc.size);
+		}
+
+		ModelFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, ModelFile::Magic, sizeof(header.magic));
+		header.version = ModelFile::Version;
+		header.byte_order = ModelFile::ByteOrder;
+		header.tensor_count = (uint32_t)entries.size();
+		header.file_size = offset;
+
+		FILE *F = _wfopen(filename, L"wb");
+		if (F == nullptr)
+			return false;
+
+		static const uint8_t zeros[ModelFile::Alignment] = {};
+		uint64_t pos = 0;
+
+		auto write = [F, &pos](const void *data, size_t size)
+		{
+			pos += size;
+			return size == 0 || fwrite(data, 1, size, F) == size;
+		};
+
+		bool res = write(&header, sizeof(header)) && write(tensors.data(), tensors.size() * sizeof(ModelTensorDescriptor));
+
+		for (size_t i = 0; res && i < entries.size(); i++)
+		{
+			res = write(zeros, (size_t)(tensors[i].offset - pos)) && write(entries[i].payload.data(), entries[i].payload.size());
+		}
+
+		res = res && write(zeros, (size_t)(offset - pos));
+
+		return fclose(F) == 0 && res;
+	}
+
+	// ==================================================================================================
+
+	uint16_t FloatToHalf(float value)
+	{
+		uint32_t x;
+		memcpy(&x, &value, sizeof(x));
+
+		uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+		uint32_t abs = x & 0x7FFFFFFF;
+
+		// Infinity and NaN
+		if (abs >= 0x7F800000)
+			return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+
+		// Rounds to infinity
+		if (abs >= 0x477FF000)
+			return sign | 0x7C00;
+
+		// Subnormal half or zero
+		if (abs < 0x38800000)
+		{
+			if (abs <= 0x33000000)
+				return sign;
+
+			uint32_t e = abs >> 23;
+			uint32_t m = (abs & 0x7FFFFF) | 0x800000;
+			uint32_t shift = 126 - e;
+			uint32_t r = m >> shift, rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+
+			if (rem > half || (rem == half && (r & 1)))
+				r++;
+
+			return sign | (uint16_t)r;
+		}
+
+		// Rebias the exponent and round to nearest even
+		uint32_t r = abs - 0x38000000;
+		uint32_t h = r >> 13, rem = r & 0x1FFF;
+
+		if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+			h++;
+
+		return sign | (uint16_t)h;
+	}
+
+	float HalfToFloat(uint16_t value)
+	{
+		uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+		uint32_t e = (value >> 10) & 0x1F;
+		uint32_t m = value & 0x3FF;
+		uint32_t x;
+
+		if (e == 0)
+		{
+			if (m == 0)
+			{
+				x = sign;
+			}
+			else
+			{
+				e = 113;
+
+				while ((m & 0x400) == 0)
+				{
+					m <<= 1;
+					e--;
+				}
+
+				x = sign | (e << 23) | ((m & 0x3FF) << 13);
+			}
+		}
+		else if (e == 31)
+		{
+			x = sign | 0x7F800000 | (m << 13);
+		}
+		else
+		{
+			x = sign | ((e + 112) << 23) | (m << 13);
+		}
+
+		float res;
+		memcpy(&res, &x, sizeof(res));
+		return res;
+	}
+}
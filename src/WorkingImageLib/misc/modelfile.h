@@ -0,0 +1,101 @@
+#pragma once
+
+#include <iplib/common.h>
+#include <stdint.h>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace ip
+{
+	/* Model file layout (little-endian):
+	*   ModelFileHeader
+	*   ModelTensorDescriptor[tensor_count]
+	*   payloads, each one starts at a multiple of ModelFile::Alignment
+	* The checksum of a tensor is 64-bit FNV-1a of its payload */
+
+	enum class ModelDataType : uint32_t { Float32 = 0, Float16 = 1 };
+
+	struct ModelFileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t tensor_count;
+		uint32_t reserved;
+		uint64_t file_size;
+	};
+
+	struct ModelTensorDescriptor
+	{
+		char name[32];
+		ModelDataType type;
+		uint32_t rank;
+		uint32_t dims[4];
+		uint64_t offset;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	static_assert(sizeof(ModelFileHeader) == 32, "Invalid ModelFileHeader layout");
+	static_assert(sizeof(ModelTensorDescriptor) == 80, "Invalid ModelTensorDescriptor layout");
+
+	// ==================================================================================================
+
+	/* Read-only view of a model file. The file is mapped to the memory, so all processes using the same model share
+	* one copy in the page cache, and the Float32 tensors are used in place. The copies of ModelFile share the mapping,
+	* the objects using the tensors keep a copy to hold it */
+	class ModelFile
+	{
+	public:
+		static const char Magic[8];
+		static const uint32_t Version = 1;
+		static const uint32_t ByteOrder = 0x01020304;
+		static const int Alignment = 64;
+
+		ModelFile() = default;
+
+		// Full verification reads the whole file, which defeats the lazy loading of the pages
+		explicit ModelFile(const wchar_t *filename, bool verify = false);
+
+		operator bool() const;
+
+		// Check the header only, so the legacy raw coefficient files can be told apart
+		static bool IsModelFile(const wchar_t *filename);
+
+		int TensorCount() const;
+		const ModelTensorDescriptor &Descriptor(int index) const;
+		const ModelTensorDescriptor *Find(const char *name) const;
+
+		/* Returns the tensor with exactly count elements, or nullptr. The Float16 tensors are expanded on the first
+		* request into an aligned buffer owned by the mapping */
+		const float *Tensor(const char *name, size_t count) const;
+
+	private:
+		class Mapping;
+		std::shared_ptr<Mapping> mapping;
+	};
+
+	// ==================================================================================================
+
+	class ModelFileWriter
+	{
+	public:
+		void Add(const char *name, const float *data, std::initializer_list<uint32_t> dims, ModelDataType type = ModelDataType::Float32);
+		bool Save(const wchar_t *filename) const;
+
+	private:
+		struct Entry
+		{
+			ModelTensorDescriptor desc;
+			std::vector<uint8_t> payload;
+		};
+
+		std::vector<Entry> entries;
+	};
+
+	// ==================================================================================================
+
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+}
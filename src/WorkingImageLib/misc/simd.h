@@ -8,28 +8,61 @@
 
 // #include <zmmintrin.h>
 
-namespace ip
+// Every instruction set build of the vector code gets its own namespace, see cpudispatch.h
+#ifndef IP_SIMD_NAMESPACE
+#	if defined(LEGACY)
+#		define IP_SIMD_NAMESPACE sse41
+#	elif defined(AVX512)
+#		define IP_SIMD_NAMESPACE avx512
+#	else
+#		define IP_SIMD_NAMESPACE avx2
+#	endif
+#endif
+
+namespace ip { inline namespace IP_SIMD_NAMESPACE
 {	
 	class float4;	// __m128 type equivalent
 	class byte16;	// __m128i type equivalent
 	class int4;		// __m128i type equivalent
+	class short4;	// lower half of __m128i, 64-bit storage
 
 #ifndef LEGACY
 
 	class float8;	// __m256 type equivalent
 	class byte32;	// __m256i type equivalent
 	class int8;		// __m256i type equivalent
+	class short8;	// __m128i type equivalent
+	class half8;	// 8 half-precision values, 128-bit storage
 
 #endif
 
-#ifdef LEGACY
+#ifdef AVX512
+
+	class float16;	// __m512 type equivalent
+	class byte64;	// __m512i type equivalent
+	class int16;	// __m512i type equivalent
+	class short16;	// __m256i type equivalent
+	class half16;	// 16 half-precision values, 256-bit storage
+
+#endif
+
+#if defined(LEGACY)
 	typedef float4 VectorFloat;
 	typedef byte16 VectorByte;
 	typedef int4 VectorInt;
+	typedef short4 VectorShort;
+#elif defined(AVX512)
+	typedef float16 VectorFloat;
+	typedef byte64 VectorByte;
+	typedef int16 VectorInt;
+	typedef short16 VectorShort;
+	typedef half16 VectorHalf;
 #else
 	typedef float8 VectorFloat;
 	typedef byte32 VectorByte;
 	typedef int8 VectorInt;
+	typedef short8 VectorShort;
+	typedef half8 VectorHalf;
 #endif
 
 	// ==================================================================================================
@@ -137,7 +170,7 @@ namespace ip
 
 		inline static float4 broadcast(const void *mem)
 		{
-			return float4(_mm_broadcast_ss(static_cast<const float*>(mem)));
+			return float4(_mm_load1_ps(static_cast<const float*>(mem)));
 		}
 
 		inline void store(void *mem)
@@ -178,12 +211,12 @@ namespace ip
 
 		inline float4 compare_gt_ord_ns(float4 other) const
 		{
-			return float4(_mm_cmp_ps(value, other.value, _CMP_GE_OQ));
+			return float4(_mm_cmpge_ps(value, other.value));
 		}
 
 		inline float4 compare_lt_ord_ns(float4 other) const
 		{
-			return float4(_mm_cmp_ps(value, other.value, _CMP_LT_OQ));
+			return float4(_mm_cmplt_ps(value, other.value));
 		}
 
 		// -------------------------------------------------------------------------
@@ -244,7 +277,7 @@ namespace ip
 
 		inline static float8 loadu(const void *mem)
 		{
-			return float8(_mm256_load_ps(static_cast<const float*>(mem)));
+			return float8(_mm256_loadu_ps(static_cast<const float*>(mem)));
 		}
 
 		inline static float8 broadcast(const void *mem)
@@ -262,6 +295,17 @@ namespace ip
 			_mm256_stream_ps(static_cast<float*>(mem), value);
 		}
 
+		// 8 PixelHalf values (F16C), no alignment required
+		inline static float8 load_half(const void *mem)
+		{
+			return float8(_mm256_cvtph_ps(_mm_loadu_si128(static_cast<const __m128i*>(mem))));
+		}
+
+		inline void store_half(void *mem) const
+		{
+			_mm_storeu_si128(static_cast<__m128i*>(mem), _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+		}
+
 		// ------------------------------------------------------------------------------------------
 
 		inline float4 lower() const
@@ -385,6 +429,193 @@ namespace ip
 		inline int8 cast_int8() const;
 	};
 
+#endif
+
+	// ==================================================================================================
+
+#ifdef AVX512
+
+	/* Requires AVX-512 F and DQ. The comparisons return the lane masks as vectors, so the code shared with
+	* the narrower builds works unchanged, blend converts them back to a mask register */
+	class float16
+	{
+		__m512 value;
+
+	public:
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float16() = default;
+
+		inline float16(float value)
+			: value(_mm512_set1_ps(value)) {}
+
+		inline float16(__m512 value)
+			: value(value) {}
+
+		inline float16(float8 lower, float8 upper)
+			: value(_mm512_insertf32x8(_mm512_castps256_ps512(lower.get_value()), upper.get_value(), 1)) {}
+
+		static constexpr int size = 16;
+
+		// ------------------------------------------------------------------------------------------
+
+		inline static float16 zero()
+		{
+			return float16(_mm512_setzero_ps());
+		}
+
+		inline static float16 load(const void *mem)
+		{
+			return float16(_mm512_load_ps(mem));
+		}
+
+		inline static float16 loadu(const void *mem)
+		{
+			return float16(_mm512_loadu_ps(mem));
+		}
+
+		inline static float16 broadcast(const void *mem)
+		{
+			return float16(_mm512_set1_ps(*static_cast<const float*>(mem)));
+		}
+
+		inline void store(void *mem)
+		{
+			_mm512_store_ps(mem, value);
+		}
+
+		inline void stream(void *mem)
+		{
+			_mm512_stream_ps(static_cast<float*>(mem), value);
+		}
+
+		// 16 PixelHalf values, no alignment required
+		inline static float16 load_half(const void *mem)
+		{
+			return float16(_mm512_cvtph_ps(_mm256_loadu_si256(static_cast<const __m256i*>(mem))));
+		}
+
+		inline void store_half(void *mem) const
+		{
+			_mm256_storeu_si256(static_cast<__m256i*>(mem), _mm512_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float8 lower() const
+		{
+			return float8(_mm512_castps512_ps256(value));
+		}
+
+		inline float8 upper() const
+		{
+			return float8(_mm512_extractf32x8_ps(value, 1));
+		}
+
+		inline float16 operator + (float16 right) const
+		{
+			return float16(_mm512_add_ps(value, right.value));
+		}
+
+		inline float16 operator - (float16 right) const
+		{
+			return float16(_mm512_sub_ps(value, right.value));
+		}
+
+		inline float16 operator * (float16 right) const
+		{
+			return float16(_mm512_mul_ps(value, right.value));
+		}
+
+		inline float16 operator / (float16 right) const
+		{
+			return float16(_mm512_div_ps(value, right.value));
+		}
+
+		inline float16 operator & (float16 right) const
+		{
+			return float16(_mm512_and_ps(value, right.value));
+		}
+
+		inline __m512 get_value() const
+		{
+			return value;
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float16 abs() const
+		{
+			return float16(_mm512_abs_ps(value));
+		}
+
+		inline float16 op_max(float16 other) const
+		{
+			return float16(_mm512_max_ps(value, other.value));
+		}
+
+		inline float16 op_min(float16 other) const
+		{
+			return float16(_mm512_min_ps(value, other.value));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float get(const int index) const
+		{
+			return value.m512_f32[index];
+		}
+
+		inline void set(const int index, float v)
+		{
+			value.m512_f32[index] = v;
+		}
+
+		inline float16 unpack_lo(float16 other) const
+		{
+			return float16(_mm512_unpacklo_ps(value, other.value));
+		}
+
+		inline float16 unpack_hi(float16 other) const
+		{
+			return float16(_mm512_unpackhi_ps(value, other.value));
+		}
+
+		template <int rule>
+		inline float16 shuffle(float16 other) const
+		{
+			return float16(_mm512_shuffle_ps(value, other.value, rule));
+		}
+
+		inline float16 blend(float16 other, float16 mask) const
+		{
+			return float16(_mm512_mask_blend_ps(_mm512_movepi32_mask(_mm512_castps_si512(mask.value)), value, other.value));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float16 compare_gt_ord_ns(float16 other) const
+		{
+			return from_mask(_mm512_cmp_ps_mask(value, other.value, _CMP_GE_OQ));
+		}
+
+		inline float16 compare_lt_ord_ns(float16 other) const
+		{
+			return from_mask(_mm512_cmp_ps_mask(value, other.value, _CMP_LT_OQ));
+		}
+
+		inline static float16 from_mask(__mmask16 mask)
+		{
+			return float16(_mm512_castsi512_ps(_mm512_movm_epi32(mask)));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline int16 conv_i32() const;
+		inline int16 cast_int16() const;
+	};
+
 #endif
 
 	// ==================================================================================================
@@ -427,6 +658,28 @@ namespace ip
 		}
 	};
 
+#endif
+
+	// ==================================================================================================
+
+#ifdef AVX512
+
+	class byte64
+	{
+		__m512i value;
+
+	public:
+		inline byte64() = default;
+
+		inline byte64(__m512i value)
+			: value(value) {}
+
+		inline __m512i get_value() const
+		{
+			return value;
+		}
+	};
+
 #endif
 
 	// ==================================================================================================
@@ -459,6 +712,19 @@ namespace ip
 		{
 			return float4(_mm_cvtepi32_ps(value));
 		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline int4 operator + (int4 other) const
+		{
+			return int4(_mm_add_epi32(value, other.value));
+		}
+
+		// Arithmetic shift rounding to nearest
+		inline int4 shift_round(int count) const
+		{
+			return int4(_mm_srai_epi32(_mm_add_epi32(value, _mm_set1_epi32(1 << (count - 1))), count));
+		}
 	};
 
 	// ==================================================================================================
@@ -515,9 +781,413 @@ namespace ip
 		{
 			return int8(_mm256_castps_si256(_mm256_and_ps(_mm256_castsi256_ps(value), _mm256_castsi256_ps(other.value))));
 		}
+
+		inline int8 operator + (int8 other) const
+		{
+			return int8(_mm256_add_epi32(value, other.value));
+		}
+
+		// Arithmetic shift rounding to nearest
+		inline int8 shift_round(int count) const
+		{
+			return int8(_mm256_srai_epi32(_mm256_add_epi32(value, _mm256_set1_epi32(1 << (count - 1))), count));
+		}
+	};
+
+#endif
+
+	// ==================================================================================================
+
+#ifdef AVX512
+
+	class int16
+	{
+		__m512i value;
+
+	public:
+		inline int16() = default;
+
+		inline int16(__m512i value)
+			: value(value) {}
+
+		inline int16(int value)
+			: value(_mm512_set1_epi32(value)) {}
+
+		inline __m512i get_value() const
+		{
+			return value;
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline int get(const int index) const
+		{
+			return value.m512i_i32[index];
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline float16 convert_f32() const
+		{
+			return float16(_mm512_cvtepi32_ps(value));
+		}
+
+		inline float16 cast_float16() const
+		{
+			return float16(_mm512_castsi512_ps(value));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline int16 blend(int16 other, float16 mask) const
+		{
+			return int16(_mm512_mask_blend_epi32(_mm512_movepi32_mask(_mm512_castps_si512(mask.get_value())), value, other.value));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline int16 operator & (int16 other) const
+		{
+			return int16(_mm512_and_si512(value, other.value));
+		}
+
+		inline int16 operator + (int16 other) const
+		{
+			return int16(_mm512_add_epi32(value, other.value));
+		}
+
+		// Arithmetic shift rounding to nearest
+		inline int16 shift_round(int count) const
+		{
+			return int16(_mm512_srai_epi32(_mm512_add_epi32(value, _mm512_set1_epi32(1 << (count - 1))), count));
+		}
+	};
+
+#endif
+
+	// ==================================================================================================
+
+	/* Vectors of 16-bit integers with the lane count of VectorFloat, used by the fixed-point paths. The additions
+	* saturate. madd multiplies two vectors by a pair of coefficients and adds the products in 32 bits (pmaddwd) */
+	class short4
+	{
+		long long value;
+
+		inline __m128i load() const
+		{
+			return _mm_loadl_epi64((const __m128i*)&value);
+		}
+
+	public:
+		inline short4() = default;
+
+		inline short4(__m128i value)
+		{
+			_mm_storel_epi64((__m128i*)&this->value, value);
+		}
+
+		inline short4(short value)
+			: short4(_mm_set1_epi16(value)) {}
+
+		inline __m128i get_value() const
+		{
+			return load();
+		}
+
+		inline static short4 zero()
+		{
+			return short4(_mm_setzero_si128());
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short get(const int index) const
+		{
+			return ((const short*)&value)[index];
+		}
+
+		inline float4 convert_f32() const
+		{
+			return float4(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(load())));
+		}
+
+		// Saturates the values out of the 16-bit range
+		inline static short4 pack(int4 value)
+		{
+			return short4(_mm_packs_epi32(value.get_value(), value.get_value()));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short4 operator + (short4 other) const
+		{
+			return short4(_mm_adds_epi16(load(), other.load()));
+		}
+
+		inline short4 operator - (short4 other) const
+		{
+			return short4(_mm_subs_epi16(load(), other.load()));
+		}
+
+		inline short4 operator >> (int count) const
+		{
+			return short4(_mm_srai_epi16(load(), count));
+		}
+
+		inline short4 abs() const
+		{
+			return short4(_mm_abs_epi16(load()));
+		}
+
+		// (this * other + 2^14) >> 15
+		inline short4 mul_hrs(short4 other) const
+		{
+			return short4(_mm_mulhrs_epi16(load(), other.load()));
+		}
+
+		inline static int4 madd(short4 a, short4 b, short ka, short kb)
+		{
+			__m128i k = _mm_set1_epi32(((int)kb << 16) | (unsigned short)ka);
+			return int4(_mm_madd_epi16(_mm_unpacklo_epi16(a.load(), b.load()), k));
+		}
+	};
+
+	// ==================================================================================================
+
+#ifndef LEGACY
+
+	class short8
+	{
+		__m128i value;
+
+	public:
+		inline short8() = default;
+
+		inline short8(__m128i value)
+			: value(value) {}
+
+		inline short8(short value)
+			: value(_mm_set1_epi16(value)) {}
+
+		inline __m128i get_value() const
+		{
+			return value;
+		}
+
+		inline static short8 zero()
+		{
+			return short8(_mm_setzero_si128());
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short get(const int index) const
+		{
+			return ((const short*)&value)[index];
+		}
+
+		inline float8 convert_f32() const
+		{
+			return float8(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(value)));
+		}
+
+		// Saturates the values out of the 16-bit range
+		inline static short8 pack(int8 value)
+		{
+			return short8(_mm_packs_epi32(_mm256_castsi256_si128(value.get_value()), _mm256_extracti128_si256(value.get_value(), 1)));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short8 operator + (short8 other) const
+		{
+			return short8(_mm_adds_epi16(value, other.value));
+		}
+
+		inline short8 operator - (short8 other) const
+		{
+			return short8(_mm_subs_epi16(value, other.value));
+		}
+
+		inline short8 operator >> (int count) const
+		{
+			return short8(_mm_srai_epi16(value, count));
+		}
+
+		inline short8 abs() const
+		{
+			return short8(_mm_abs_epi16(value));
+		}
+
+		// (this * other + 2^14) >> 15
+		inline short8 mul_hrs(short8 other) const
+		{
+			return short8(_mm_mulhrs_epi16(value, other.value));
+		}
+
+		inline static int8 madd(short8 a, short8 b, short ka, short kb)
+		{
+			__m128i k = _mm_set1_epi32(((int)kb << 16) | (unsigned short)ka);
+			__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a.value, b.value), k);
+			__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a.value, b.value), k);
+
+			return int8(_mm256_set_m128i(hi, lo));
+		}
+	};
+
+#endif
+
+	// ==================================================================================================
+
+#ifdef AVX512
+
+	class short16
+	{
+		__m256i value;
+
+	public:
+		inline short16() = default;
+
+		inline short16(__m256i value)
+			: value(value) {}
+
+		inline short16(short value)
+			: value(_mm256_set1_epi16(value)) {}
+
+		inline __m256i get_value() const
+		{
+			return value;
+		}
+
+		inline static short16 zero()
+		{
+			return short16(_mm256_setzero_si256());
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short get(const int index) const
+		{
+			return ((const short*)&value)[index];
+		}
+
+		inline float16 convert_f32() const
+		{
+			return float16(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(value)));
+		}
+
+		// Saturates the values out of the 16-bit range
+		inline static short16 pack(int16 value)
+		{
+			return short16(_mm512_cvtsepi32_epi16(value.get_value()));
+		}
+
+		// ------------------------------------------------------------------------------------------
+
+		inline short16 operator + (short16 other) const
+		{
+			return short16(_mm256_adds_epi16(value, other.value));
+		}
+
+		inline short16 operator - (short16 other) const
+		{
+			return short16(_mm256_subs_epi16(value, other.value));
+		}
+
+		inline short16 operator >> (int count) const
+		{
+			return short16(_mm256_srai_epi16(value, count));
+		}
+
+		inline short16 abs() const
+		{
+			return short16(_mm256_abs_epi16(value));
+		}
+
+		// (this * other + 2^14) >> 15
+		inline short16 mul_hrs(short16 other) const
+		{
+			return short16(_mm256_mulhrs_epi16(value, other.value));
+		}
+
+		inline static int16 madd(short16 a, short16 b, short ka, short kb)
+		{
+			__m256i k = _mm256_set1_epi32(((int)kb << 16) | (unsigned short)ka);
+
+			// The unpacks work within 128-bit lanes: lo holds the lanes 0-3, 8-11 and hi holds 4-7, 12-15
+			__m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a.value, b.value), k);
+			__m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a.value, b.value), k);
+			__m512i res = _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+
+			return int16(_mm512_shuffle_i64x2(res, res, _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+	};
+
+#endif
+
+	// ==================================================================================================
+
+	/* Half-precision storage with the lane count of VectorFloat, for the bandwidth-bound intermediate planes.
+	* The values are converted to float for the arithmetic, rounding to nearest even on the way back.
+	* The SSE4.1 build has no F16C and no half vectors, the callers keep the float path there */
+#ifndef LEGACY
+
+	class half8
+	{
+		__m128i value;
+
+	public:
+		inline half8() = default;
+
+		inline half8(__m128i value)
+			: value(value) {}
+
+		inline explicit half8(float8 value)
+			: value(_mm256_cvtps_ph(value.get_value(), _MM_FROUND_TO_NEAREST_INT)) {}
+
+		inline __m128i get_value() const
+		{
+			return value;
+		}
+
+		inline float8 convert_f32() const
+		{
+			return float8(_mm256_cvtph_ps(value));
+		}
+	};
+
+#endif
+
+	// ==================================================================================================
+
+#ifdef AVX512
+
+	class half16
+	{
+		__m256i value;
+
+	public:
+		inline half16() = default;
+
+		inline half16(__m256i value)
+			: value(value) {}
+
+		inline explicit half16(float16 value)
+			: value(_mm512_cvtps_ph(value.get_value(), _MM_FROUND_TO_NEAREST_INT)) {}
+
+		inline __m256i get_value() const
+		{
+			return value;
+		}
+
+		inline float16 convert_f32() const
+		{
+			return float16(_mm512_cvtph_ps(value));
+		}
 	};
 
 #endif
+
 	// ==================================================================================================
 
 #ifndef LEGACY
@@ -564,4 +1234,18 @@ namespace ip
 
 #endif
 
-}
+#ifdef AVX512
+
+	inline int16 float16::conv_i32() const
+	{
+		return int16(_mm512_cvtps_epi32(value));
+	}
+
+	inline int16 float16::cast_int16() const
+	{
+		return int16(_mm512_castps_si512(value));
+	}
+
+#endif
+
+} }
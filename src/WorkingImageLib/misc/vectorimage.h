@@ -3,7 +3,7 @@
 #include <iplib/image/core.h>
 #include "simd.h"
 
-namespace ip
+namespace ip { inline namespace IP_SIMD_NAMESPACE
 {
 
 	struct VectorFloatColor
@@ -29,8 +29,32 @@ namespace ip
 		VectorFloat a;
 	};
 
+	/* YUV in 16-bit fixed point with FractionBits fractional bits, half the size of VectorFloatColor. The values keep
+	* the scale of VectorFloatColor: y is 0..255 * 16, the additions saturate */
+	struct VectorShortColor
+	{
+		static constexpr int FractionBits = 4;
+
+		VectorShort y;
+		VectorShort u;
+		VectorShort v;
+
+		inline VectorShortColor() = default;
+		inline VectorShortColor(VectorShort y, VectorShort u, VectorShort v);
+
+		// Rounds to the nearest fixed-point value
+		inline explicit VectorShortColor(const VectorFloatColor &value);
+
+		inline VectorShortColor operator + (const VectorShortColor &right) const;
+
+		inline VectorFloatColor ToFloat() const;
+		inline VectorByte ToByte() const;
+	};
+
 	typedef Image<VectorFloat> VectorImageFloat;
 	typedef Image<VectorFloatColor> VectorImageFloatColor;
+	typedef Image<VectorShort> VectorImageShort;
+	typedef Image<VectorShortColor> VectorImageShortColor;
 
 	// ==================================================================================================
 
@@ -59,7 +83,7 @@ namespace ip
 
 	inline VectorByte VectorFloatColor::ToByte() const
 	{
-#ifdef LEGACY
+#if defined(LEGACY)
 		static const __m128 ZERO = _mm_setzero_ps();
 		static const __m128 M255 = _mm_set_ps1(255.0f);
 
@@ -92,6 +116,34 @@ namespace ip
 		__m128i bgra0123 = _mm_packus_epi16(bgra01, bgra23);
 
 		return byte16(bgra0123);
+#elif defined(AVX512)
+		static const __m512 YRU = _mm512_set1_ps(1.402f);
+		static const __m512 YBV = _mm512_set1_ps(1.772f);
+		static const __m512 YGU = _mm512_set1_ps(-0.714f);
+		static const __m512 YGV = _mm512_set1_ps(-0.334f);
+
+		float16 b = y + float16(YBV) * v;
+		float16 g = y + float16(YGU) * u + float16(YGV) * v;
+		float16 r = y + float16(YRU) * u;
+
+		// The negative values are clamped here, the values above 255 by the saturating down-conversion
+		__m512i zero = _mm512_setzero_si512();
+
+		__m128i vb = _mm512_cvtusepi32_epi8(_mm512_max_epi32(_mm512_cvtps_epi32(b.get_value()), zero));
+		__m128i vg = _mm512_cvtusepi32_epi8(_mm512_max_epi32(_mm512_cvtps_epi32(g.get_value()), zero));
+		__m128i vr = _mm512_cvtusepi32_epi8(_mm512_max_epi32(_mm512_cvtps_epi32(r.get_value()), zero));
+
+		__m128i bg0_7 = _mm_unpacklo_epi8(vb, vg);
+		__m128i bg8_15 = _mm_unpackhi_epi8(vb, vg);
+		__m128i ra0_7 = _mm_unpacklo_epi8(vr, _mm_setzero_si128());
+		__m128i ra8_15 = _mm_unpackhi_epi8(vr, _mm_setzero_si128());
+
+		__m512i bgra = _mm512_castsi128_si512(_mm_unpacklo_epi16(bg0_7, ra0_7));
+		bgra = _mm512_inserti32x4(bgra, _mm_unpackhi_epi16(bg0_7, ra0_7), 1);
+		bgra = _mm512_inserti32x4(bgra, _mm_unpacklo_epi16(bg8_15, ra8_15), 2);
+		bgra = _mm512_inserti32x4(bgra, _mm_unpackhi_epi16(bg8_15, ra8_15), 3);
+
+		return byte64(bgra);
 #else
 		static const __m256 ZERO = _mm256_setzero_ps();
 		static const __m256 M255 = _mm256_set1_ps(255.0f);
@@ -132,4 +184,35 @@ namespace ip
 	}
 
 	// ==================================================================================================
-}
\ No newline at end of file
+
+	inline VectorShortColor::VectorShortColor(VectorShort y, VectorShort u, VectorShort v)
+		: y(y), u(u), v(v) {}
+
+	inline VectorShortColor::VectorShortColor(const VectorFloatColor &value)
+	{
+		static const VectorFloat SCALE((float)(1 << FractionBits));
+
+		y = VectorShort::pack((value.y * SCALE).conv_i32());
+		u = VectorShort::pack((value.u * SCALE).conv_i32());
+		v = VectorShort::pack((value.v * SCALE).conv_i32());
+	}
+
+	inline VectorShortColor VectorShortColor::operator + (const VectorShortColor &right) const
+	{
+		return VectorShortColor(y + right.y, u + right.u, v + right.v);
+	}
+
+	inline VectorFloatColor VectorShortColor::ToFloat() const
+	{
+		static const VectorFloat SCALE(1.0f / (1 << FractionBits));
+
+		return VectorFloatColor(y.convert_f32() * SCALE, u.convert_f32() * SCALE, v.convert_f32() * SCALE);
+	}
+
+	inline VectorByte VectorShortColor::ToByte() const
+	{
+		return ToFloat().ToByte();
+	}
+
+	// ==================================================================================================
+} }
\ No newline at end of file
@@ -0,0 +1,803 @@
+#include "pipeline.h"
+#include <iplib/image/region.h>
+#include <iplib/image/filter/filter.hpp>
+#include <iplib/image/deblur/deblurtv.h>
+#include <iplib/math/gauss_function.h>
+#include <resampling/edrfast.h>
+#include <resampling/edrvector.h>
+#include <resampling/srcnn.h>
+#include <resampling/si_resampling.h>
+#include <warping/meowarping.hpp>
+#include <misc/modelfile.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+namespace ip
+{
+	// ==================================================================================================
+	//                                          Stage interface
+	// ==================================================================================================
+
+	class Pipeline::Stage
+	{
+	public:
+		virtual ~Stage() {}
+
+		virtual const char *Name() const = 0;
+
+		// Output size factor
+		virtual int Scale() const { return 1; }
+
+		// Source pixels around a region the stage reads to compute it, -1 for the global stages
+		virtual int Halo() const { return -1; }
+
+		/* The pointwise stages process a row chunk of the planes B, G, R in place with ApplyRow,
+		* the others process a whole image with Process, dst is Scale() times larger than src */
+		virtual bool Pointwise() const { return false; }
+		virtual void ApplyRow(float *const *rows, int n) const {}
+		virtual void Process(const ImageType &src, ImageType &dst) const {}
+	};
+
+	namespace
+	{
+		typedef Pipeline::ImageType ImageType;
+
+		// Parameters of a stage, "name=value,name=value". Every parameter must be taken by the stage
+		class StageParameters
+		{
+			std::vector<std::pair<std::wstring, std::wstring>> values;
+			std::vector<bool> used;
+			std::wstring stage;
+
+			const std::wstring *Find(const wchar_t *name)
+			{
+				for (size_t i = 0; i < values.size(); i++)
+					if (values[i].first == name)
+					{
+						used[i] = true;
+						return &values[i].second;
+					}
+
+				return nullptr;
+			}
+
+		public:
+			std::wstring error;
+
+			StageParameters(const std::wstring &stage, const std::wstring &text)
+				: stage(stage)
+			{
+				for (size_t pos = 0; pos < text.size();)
+				{
+					size_t next = text.find(L',', pos);
+					if (next == std::wstring::npos)
+						next = text.size();
+
+					std::wstring item = text.substr(pos, next - pos);
+					size_t eq = item.find(L'=');
+
+					if (eq == std::wstring::npos || eq == 0)
+						error = L"Invalid parameter '" + item + L"' of " + stage;
+					else
+						values.push_back(std::make_pair(item.substr(0, eq), item.substr(eq + 1)));
+
+					pos = next + 1;
+				}
+
+				used.assign(values.size(), false);
+			}
+
+			float Float(const wchar_t *name, float default_value, float low, float high)
+			{
+				const std::wstring *value = Find(name);
+				if (value == nullptr)
+					return default_value;
+
+				wchar_t *end;
+				float res = wcstof(value->c_str(), &end);
+
+				if (value->empty() || *end != 0 || !(res >= low && res <= high))
+				{
+					error = L"Invalid value of " + stage + L":" + name;
+					return default_value;
+				}
+
+				return res;
+			}
+
+			std::wstring String(const wchar_t *name, const wchar_t *default_value)
+			{
+				const std::wstring *value = Find(name);
+				return value != nullptr ? *value : std::wstring(default_value);
+			}
+
+			bool Flag(const wchar_t *name)
+			{
+				const std::wstring *value = Find(name);
+				if (value == nullptr)
+					return false;
+
+				if (*value != L"0" && *value != L"1")
+					error = L"Invalid value of " + stage + L":" + name;
+
+				return *value == L"1";
+			}
+
+			// false if a parameter was not valid or not known to the stage
+			bool Finish()
+			{
+				for (size_t i = 0; i < values.size() && error.empty(); i++)
+					if (!used[i])
+						error = L"Unknown parameter " + stage + L":" + values[i].first;
+
+				return error.empty();
+			}
+		};
+
+		// ==================================================================================================
+		//                                          Local stages
+		// ==================================================================================================
+
+		class GaussStage : public Pipeline::Stage
+		{
+			float sigma;
+
+		public:
+			GaussStage(float sigma)
+				: sigma(sigma) {}
+
+			const char *Name() const { return "gaussblur"; }
+			int Halo() const { return Filter::GaussHalo(sigma); }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				Filter::Gauss(src, dst, sigma);
+			}
+		};
+
+		class EDRStage : public Pipeline::Stage
+		{
+			EDRPrecision precision;
+
+		public:
+			EDRStage(EDRPrecision precision)
+				: precision(precision) {}
+
+			const char *Name() const { return "resample"; }
+			int Scale() const { return 2; }
+			int Halo() const { return EDR_Halo; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				EDR_Resampling_x2(src, dst, precision);
+			}
+		};
+
+		class LevelsStage : public Pipeline::Stage
+		{
+			float gain, offset;
+
+		public:
+			LevelsStage(float gain, float offset)
+				: gain(gain), offset(offset) {}
+
+			const char *Name() const { return "levels"; }
+			int Halo() const { return 0; }
+			bool Pointwise() const { return true; }
+
+			void ApplyRow(float *const *rows, int n) const
+			{
+				for (int c = 0; c < 3; c++)
+					for (int i = 0; i < n; i++)
+						rows[c][i] = rows[c][i] * gain + offset;
+			}
+		};
+
+		class ClampStage : public Pipeline::Stage
+		{
+			float low, high;
+
+		public:
+			ClampStage(float low, float high)
+				: low(low), high(high) {}
+
+			const char *Name() const { return "clamp"; }
+			int Halo() const { return 0; }
+			bool Pointwise() const { return true; }
+
+			void ApplyRow(float *const *rows, int n) const
+			{
+				for (int c = 0; c < 3; c++)
+					for (int i = 0; i < n; i++)
+						rows[c][i] = (std::min)((std::max)(rows[c][i], low), high);
+			}
+		};
+
+		class GrayStage : public Pipeline::Stage
+		{
+		public:
+			const char *Name() const { return "gray"; }
+			int Halo() const { return 0; }
+			bool Pointwise() const { return true; }
+
+			void ApplyRow(float *const *rows, int n) const
+			{
+				for (int i = 0; i < n; i++)
+				{
+					float y = rows[2][i] * 0.299f + rows[1][i] * 0.587f + rows[0][i] * 0.114f;
+					rows[0][i] = rows[1][i] = rows[2][i] = y;
+				}
+			}
+		};
+
+		// ==================================================================================================
+		//                                          Global stages
+		// ==================================================================================================
+
+		// The same sequence of the samples as 'gaussblur -noise'
+		class NoiseStage : public Pipeline::Stage
+		{
+			float stddev;
+
+		public:
+			NoiseStage(float stddev)
+				: stddev(stddev) {}
+
+			const char *Name() const { return "noise"; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				std::default_random_engine random;
+				std::normal_distribution<float> nd(0.0f, stddev);
+
+				for (int j = 0; j < src.Height(); j++)
+				{
+					const float *b = src.Plane(0).pixeladdr(0, j), *g = src.Plane(1).pixeladdr(0, j), *r = src.Plane(2).pixeladdr(0, j);
+					float *db = dst.Plane(0).pixeladdr(0, j), *dg = dst.Plane(1).pixeladdr(0, j), *dr = dst.Plane(2).pixeladdr(0, j);
+
+					for (int i = 0; i < src.Width(); i++)
+					{
+						dr[i] = r[i] + nd(random);
+						dg[i] = g[i] + nd(random);
+						db[i] = b[i] + nd(random);
+					}
+				}
+			}
+		};
+
+		// DeblurTV normalises its step over the whole image, it has no finite radius
+		class DeblurStage : public Pipeline::Stage
+		{
+			Image<float> kernel;
+			float alpha;
+
+		public:
+			DeblurStage(float sigma, float alpha)
+				: alpha(alpha)
+			{
+				int rad = Filter::GaussHalo(sigma);
+				GaussFunction gf(sigma);
+
+				Image<float> k(2 * rad + 1, 2 * rad + 1);
+				float s = 0.0f;
+
+				for (int j = 0; j < k.Height(); j++)
+					for (int i = 0; i < k.Width(); i++)
+						s += k(i, j) = gf((float)(i - rad)) * gf((float)(j - rad));
+
+				for (int j = 0; j < k.Height(); j++)
+					for (int i = 0; i < k.Width(); i++)
+						k(i, j) /= s;
+
+				kernel.swap(k);
+			}
+
+			const char *Name() const { return "deblur"; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				for (int c = 0; c < 3; c++)
+					DeblurTV::AnyKernel(src.Plane(c), dst.Plane(c), kernel, alpha);
+			}
+		};
+
+		class WarpStage : public Pipeline::Stage
+		{
+			float sigma, power;
+
+		public:
+			WarpStage(float sigma, float power)
+				: sigma(sigma), power(power) {}
+
+			const char *Name() const { return "warp"; }
+
+			// The same settings as the 'warp' operation
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				ImageFloatColor4 img(src.Width(), src.Height());
+				Merge(src, img);
+
+				MeowWarping mw;
+				mw.SetEdgeDetectionSigma(sigma * 0.5f);
+				mw.SetWarpingPower(power);
+				mw.SetWarpingSigma(sigma);
+
+				Split(mw.Warp2D(img), dst);
+			}
+		};
+
+		// SRCNN is a grayscale network, every channel is resampled separately
+		class SRCNNStage : public Pipeline::Stage
+		{
+			std::unique_ptr<SRCNN> srcnn;
+			SRCNN::Precision precision;
+			bool half_shift;
+
+		public:
+			SRCNNStage(std::wstring model, SRCNN::Precision precision, bool half_shift)
+				: srcnn(new SRCNN(model.empty() ? nullptr : &model[0])), precision(precision), half_shift(half_shift) {}
+
+			bool Loaded() const { return *srcnn; }
+
+			const char *Name() const { return "resample"; }
+			int Scale() const { return 2; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				for (int c = 0; c < 3; c++)
+					srcnn->Resample_x2_915(src.Plane(c), dst.Plane(c), half_shift, precision);
+			}
+		};
+
+		// EDRVector and SI process 8-bit images, the stage quantizes its input
+		class EDRVectorStage : public Pipeline::Stage
+		{
+			std::unique_ptr<EDRVector> edr;
+			EDRVector::Precision precision;
+
+		public:
+			EDRVectorStage(EDRVector::Precision precision)
+				: edr(new EDRVector()), precision(precision) {}
+
+			bool Load(const std::wstring &model)
+			{
+				ModelFile file(model.c_str());
+				return file && edr->LoadModel(file);
+			}
+
+			const char *Name() const { return "resample"; }
+			int Scale() const { return 2; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				ImageByteColor lr(src.Width(), src.Height());
+				Merge(src, lr);
+				Split(edr->Perform(lr, precision), dst);
+			}
+		};
+
+		class SIStage : public Pipeline::Stage
+		{
+			std::unique_ptr<SIResampling> sir;
+			SIResampling::Precision precision;
+			bool deblur;
+
+		public:
+			SIStage(SIResampling::Mode mode, SIResampling::Precision precision, bool deblur)
+				: sir(new SIResampling(mode)), precision(precision), deblur(deblur) {}
+
+			// Both the model files and the legacy raw coefficient files are accepted
+			bool Load(const std::wstring &model)
+			{
+				if (ModelFile::IsModelFile(model.c_str()))
+				{
+					ModelFile file(model.c_str());
+					return file && sir->LoadModel(file);
+				}
+
+				std::ifstream fs(model, std::ios::in | std::ios::binary);
+				if (fs.fail())
+					return false;
+
+				std::vector<char> bin((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+				return sir->LoadCoefficientData(bin.data(), bin.size());
+			}
+
+			const char *Name() const { return deblur ? "deblur" : "resample"; }
+			int Scale() const { return deblur ? 1 : 2; }
+
+			void Process(const ImageType &src, ImageType &dst) const
+			{
+				ImageByteColor lr(src.Width(), src.Height());
+				Merge(src, lr);
+				Split(deblur ? sir->PerformDeblur(lr, precision) : sir->Perform(lr, precision), dst);
+			}
+		};
+
+		// ==================================================================================================
+		//                                              Parser
+		// ==================================================================================================
+
+		std::wstring Trim(const std::wstring &s)
+		{
+			size_t first = s.find_first_not_of(L" \t");
+			if (first == std::wstring::npos)
+				return std::wstring();
+
+			return s.substr(first, s.find_last_not_of(L" \t") - first + 1);
+		}
+
+		Pipeline::Stage *CreateResampleStage(StageParameters &params, std::wstring &error)
+		{
+			std::wstring method = params.String(L"method", L"edr");
+			std::wstring model = params.String(L"model", L"");
+			std::wstring precision = params.String(L"precision", L"float");
+
+			if (method == L"edr")
+			{
+				if (precision != L"float" && precision != L"half")
+					error = L"resample:method=edr supports precision=float or half";
+
+				if (!params.Finish() || !error.empty())
+					return nullptr;
+
+				return new EDRStage(precision == L"half" ? EDRPrecision::Half : EDRPrecision::Float);
+			}
+
+			if (method == L"srcnn")
+			{
+				bool half_shift = params.Flag(L"halfshift");
+
+				if (precision != L"float" && precision != L"half")
+					error = L"resample:method=srcnn supports precision=float or half";
+
+				if (!params.Finish() || !error.empty())
+					return nullptr;
+
+				std::unique_ptr<SRCNNStage> stage(new SRCNNStage(model, precision == L"half" ? SRCNN::Precision::Half : SRCNN::Precision::Float, half_shift));
+
+				if (!stage->Loaded())
+				{
+					error = L"Cannot load the SRCNN model";
+					return nullptr;
+				}
+
+				return stage.release();
+			}
+
+			if (precision != L"float" && precision != L"fixed")
+				error = L"resample:method=" + method + L" supports precision=float or fixed";
+
+			if (method == L"edrvector")
+			{
+				if (!params.Finish() || !error.empty())
+					return nullptr;
+
+				std::unique_ptr<EDRVectorStage> stage(new EDRVectorStage(precision == L"fixed" ? EDRVector::Precision::Fixed16 : EDRVector::Precision::Float));
+
+				if (!model.empty() && !stage->Load(model))
+				{
+					error = L"Invalid model file " + model;
+					return nullptr;
+				}
+
+				return stage.release();
+			}
+
+			static const struct { const wchar_t *name; SIResampling::Mode mode; bool deblur; } si_methods[] =
+			{
+				{ L"si1", SIResampling::Mode::SI1, false },
+				{ L"si2", SIResampling::Mode::SI2, false },
+				{ L"si3", SIResampling::Mode::SI3, false },
+				{ L"si1deblur", SIResampling::Mode::SI1Deblur, true },
+				{ L"si2deblur", SIResampling::Mode::SI2Deblur, true },
+				{ L"si3deblur", SIResampling::Mode::SI3Deblur, true },
+			};
+
+			for (auto &si : si_methods)
+			{
+				if (method != si.name)
+					continue;
+
+				if (!params.Finish() || !error.empty())
+					return nullptr;
+
+				std::unique_ptr<SIStage> stage(new SIStage(si.mode, precision == L"fixed" ? SIResampling::Precision::Fixed16 : SIResampling::Precision::Float, si.deblur));
+
+				if (model.empty())
+					model = method + L".bin";
+
+				if (!stage->Load(model))
+				{
+					error = L"Invalid model file " + model;
+					return nullptr;
+				}
+
+				return stage.release();
+			}
+
+			error = L"Unknown resampling method " + method;
+			return nullptr;
+		}
+
+		Pipeline::Stage *CreateStage(const std::wstring &name, StageParameters &params, std::wstring &error)
+		{
+			Pipeline::Stage *res = nullptr;
+
+			if (name == L"gaussblur")
+				res = new GaussStage(params.Float(L"sigma", 1.0f, 0.01f, 100.0f));
+			else if (name == L"noise")
+				res = new NoiseStage(params.Float(L"stddev", 1.0f, 0.01f, 10000.0f));
+			else if (name == L"deblur")
+			{
+				float sigma = params.Float(L"sigma", 1.0f, 0.1f, 20.0f);
+				res = new DeblurStage(sigma, params.Float(L"alpha", 0.01f, 0.0f, 100.0f));
+			}
+			else if (name == L"warp")
+			{
+				float sigma = params.Float(L"sigma", 2.0f, 0.01f, 100.0f);
+				res = new WarpStage(sigma, params.Float(L"power", 1.0f, 0.01f, 100.0f));
+			}
+			else if (name == L"levels")
+			{
+				float gain = params.Float(L"gain", 1.0f, -100.0f, 100.0f);
+				res = new LevelsStage(gain, params.Float(L"offset", 0.0f, -10000.0f, 10000.0f));
+			}
+			else if (name == L"clamp")
+			{
+				float low = params.Float(L"min", 0.0f, -10000.0f, 10000.0f);
+				res = new ClampStage(low, params.Float(L"max", 255.0f, -10000.0f, 10000.0f));
+			}
+			else if (name == L"gray")
+				res = new GrayStage();
+			else if (name == L"resample")
+				return CreateResampleStage(params, error);
+			else
+			{
+				error = L"Unknown stage " + name;
+				return nullptr;
+			}
+
+			if (!params.Finish())
+			{
+				delete res;
+				return nullptr;
+			}
+
+			return res;
+		}
+	}
+
+	// ==================================================================================================
+	//                                             Pipeline
+	// ==================================================================================================
+
+	Pipeline::Pipeline(const wchar_t *description)
+	{
+		std::wstring text = description;
+
+		for (size_t pos = 0; pos <= text.size() && error.empty();)
+		{
+			size_t next = text.find(L'|', pos);
+			if (next == std::wstring::npos)
+				next = text.size();
+
+			std::wstring item = Trim(text.substr(pos, next - pos));
+			size_t colon = item.find(L':');
+
+			std::wstring name = Trim(item.substr(0, colon));
+			StageParameters params(name, colon != std::wstring::npos ? item.substr(colon + 1) : std::wstring());
+
+			if (name.empty())
+				error = L"Empty stage in the pipeline";
+			else
+			{
+				Stage *stage = CreateStage(name, params, error);
+
+				if (stage != nullptr)
+					stages.emplace_back(stage);
+				else if (error.empty())
+					error = params.error;
+			}
+
+			pos = next + 1;
+		}
+
+		if (!error.empty())
+			stages.clear();
+		else
+			Schedule();
+	}
+
+	Pipeline::~Pipeline() {}
+
+	Pipeline::operator bool() const
+	{
+		return !stages.empty();
+	}
+
+	const std::wstring &Pipeline::Error() const
+	{
+		return error;
+	}
+
+	int Pipeline::Scale() const
+	{
+		int res = 1;
+		for (auto &stage : stages)
+			res *= stage->Scale();
+
+		return res;
+	}
+
+	int Pipeline::GroupCount() const
+	{
+		return (int)groups.size();
+	}
+
+	std::string Pipeline::GroupDescription(int group) const
+	{
+		const Group &g = groups[group];
+		std::string res;
+
+		for (int i = g.first; i < g.last; i++)
+		{
+			if (i != g.first)
+				res += " > ";
+
+			res += stages[i]->Name();
+		}
+
+		if (g.fused)
+			res += " (fused, halo " + std::to_string(g.halo) + ")";
+
+		return res;
+	}
+
+	/* A group is a global stage or a run of the local stages. A run with two or more non-pointwise stages is fused,
+	* its halo is accumulated from the last stage back: a stage needs its own halo plus the halo of the rest
+	* of the run divided by its scale */
+	void Pipeline::Schedule()
+	{
+		int n = (int)stages.size();
+
+		for (int i = 0; i < n;)
+		{
+			int j = i + 1;
+
+			if (stages[i]->Halo() >= 0)
+				while (j < n && stages[j]->Halo() >= 0)
+					j++;
+
+			Group g;
+			g.first = i;
+			g.last = j;
+			g.halo = 0;
+			g.scale = 1;
+
+			int filters = 0;
+
+			for (int k = j - 1; k >= i; k--)
+			{
+				int scale = stages[k]->Scale();
+				g.halo = (std::max)(stages[k]->Halo(), 0) + (g.halo + scale - 1) / scale;
+				g.scale *= scale;
+
+				if (!stages[k]->Pointwise())
+					filters++;
+			}
+
+			g.fused = filters >= 2;
+			groups.push_back(g);
+
+			i = j;
+		}
+	}
+
+	// Copies src to dst (unless it is the same image) and applies the pointwise stages first..last - 1 in one pass
+	void Pipeline::ApplyPointwise(int first, int last, const ImageType &src, ImageType &dst) const
+	{
+		internal::ForEachRowChunk(src.Width(), src.Height(), [this, first, last, &src, &dst](int x, int y, int n)
+		{
+			float *rows[3];
+
+			for (int c = 0; c < 3; c++)
+			{
+				rows[c] = dst.Plane(c).pixeladdr(x, y);
+
+				if (&src != &dst)
+				{
+					const float *in = src.Plane(c).pixeladdr(x, y);
+					std::copy(in, in + n, rows[c]);
+				}
+			}
+
+			for (int k = first; k < last; k++)
+				stages[k]->ApplyRow(rows, n);
+		});
+	}
+
+	/* Runs the stages first..last - 1, dst has the size of the result. The intermediate images alternate between
+	* two buffers, the runs of the pointwise stages work in place on them */
+	void Pipeline::Execute(int first, int last, const ImageType &src, ImageType &dst) const
+	{
+		ImageType buffers[2];
+		ImageType *owned = nullptr;
+		const ImageType *cur = &src;
+		int next = 0;
+
+		for (int i = first; i < last;)
+		{
+			bool pointwise = stages[i]->Pointwise();
+			int j = i + 1;
+
+			if (pointwise)
+				while (j < last && stages[j]->Pointwise())
+					j++;
+
+			ImageType *out = &dst;
+
+			if (j < last)
+			{
+				if (pointwise && owned != nullptr)
+					out = owned;
+				else
+				{
+					int scale = stages[i]->Scale();
+					ImageType tmp(cur->Width() * scale, cur->Height() * scale);
+
+					buffers[next].swap(tmp);
+					out = &buffers[next];
+					next ^= 1;
+				}
+			}
+
+			if (pointwise)
+				ApplyPointwise(i, j, *cur, *out);
+			else
+				stages[i]->Process(*cur, *out);
+
+			cur = owned = out;
+			i = j;
+		}
+	}
+
+	Pipeline::ImageType Pipeline::Run(const ImageType &src, std::vector<float> *group_times) const
+	{
+		check(*this);
+
+		if (group_times != nullptr)
+			group_times->clear();
+
+		ImageType cur;
+		const ImageType *in = &src;
+
+		for (auto &g : groups)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			ImageType res(in->Width() * g.scale, in->Height() * g.scale);
+
+			if (g.fused)
+			{
+				ProcessTiled(*in, res, TileSize, g.halo, g.scale, [this, &g](const ImageType &tile, ImageType &out)
+				{
+					Execute(g.first, g.last, tile, out);
+				});
+			}
+			else
+				Execute(g.first, g.last, *in, res);
+
+			// The source of the group is released here, unless it is src
+			cur.swap(res);
+			in = &cur;
+
+			if (group_times != nullptr)
+				group_times->push_back(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		return cur;
+	}
+}
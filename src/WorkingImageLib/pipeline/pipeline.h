@@ -0,0 +1,73 @@
+#pragma once
+
+#include <iplib/image/core.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ip
+{
+	/* Chain of processing stages over a colour image kept in float planes, described by a string like
+	*     gaussblur:sigma=1 | resample:method=edr | warp:sigma=2
+	* The intermediate images are never quantized, the caller converts the result once.
+	*
+	* The stages are scheduled in groups. A run of consecutive local stages (the ones with a finite radius, see
+	* region.h) is fused: the image is processed by tiles in parallel and every tile goes through the whole run
+	* with the halo of the run, so the intermediate images of the run exist only at the tile size and stay in the
+	* cache. The stages of a tile run serially on its thread (their Parallel calls are nested, see Parallel::Nested). The pointwise stages of a run are applied to a row chunk one after another in a single pass, in place
+	* when the source is an intermediate image. The global stages (warping, deblurring, the learned resamplers)
+	* process the whole image. The full-size intermediates are released as soon as the next group has run, so
+	* with an ImagePool the following images reuse their buffers.
+	*
+	* The models are loaded once by the constructor, one Pipeline can process any number of images */
+	class Pipeline
+	{
+	public:
+		typedef PlanarImage<float, 3> ImageType;
+
+		// Source pixels of a fused group per tile side
+		static const int TileSize = 128;
+
+		class Stage;
+
+		explicit Pipeline(const wchar_t *description);
+		~Pipeline();
+
+		Pipeline(const Pipeline&) = delete;
+		Pipeline &operator =(const Pipeline&) = delete;
+
+		// false if the description cannot be parsed or a model cannot be loaded, Error() tells why
+		operator bool() const;
+		const std::wstring &Error() const;
+
+		// Size factor of the whole chain (2 for each resample stage)
+		int Scale() const;
+
+		int GroupCount() const;
+
+		// Like "gaussblur > resample (fused, halo 9)"
+		std::string GroupDescription(int group) const;
+
+		/* Runs all stages. The values are in range 0..255 but not clamped between the stages.
+		* group_times receives the execution time of every group in seconds */
+		ImageType Run(const ImageType &src, std::vector<float> *group_times = nullptr) const;
+
+	private:
+		struct Group
+		{
+			int first, last;
+			bool fused;
+
+			// Halo and scale of the whole group, in the pixels of its source
+			int halo, scale;
+		};
+
+		std::vector<std::unique_ptr<Stage>> stages;
+		std::vector<Group> groups;
+		std::wstring error;
+
+		void Schedule();
+		void Execute(int first, int last, const ImageType &src, ImageType &dst) const;
+		void ApplyPointwise(int first, int last, const ImageType &src, ImageType &dst) const;
+	};
+}
@@ -0,0 +1,266 @@
+#include "pipelinebatch.h"
+#include <iplib/image/io/imageio.h>
+#include <iplib/image/io/textio.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <math.h>
+#include <mutex>
+#include <thread>
+
+namespace ip
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		float Seconds(Clock::time_point start, Clock::time_point stop)
+		{
+			return std::chrono::duration<float>(stop - start).count();
+		}
+	}
+
+	PipelineBatch::PipelineBatch(const Pipeline &pipeline)
+		: pipeline(pipeline)
+	{
+		check(pipeline);
+	}
+
+	void PipelineBatch::AddJob(const std::wstring &input, const std::wstring &output)
+	{
+		jobs.push_back(std::make_pair(input, output));
+	}
+
+	size_t PipelineBatch::JobCount() const
+	{
+		return jobs.size();
+	}
+
+	/* The I/O threads save the processed images first, so the memory is released before the next image is loaded.
+	* A job goes waiting -> loading -> loaded -> processing -> processed -> saving, in_memory counts the jobs from
+	* loading to saving */
+	std::vector<PipelineBatch::Result> PipelineBatch::Run(int io_threads, int concurrency) const
+	{
+		check(io_threads > 0 && concurrency > 0);
+
+		struct Job
+		{
+			Pipeline::ImageType image;
+			Clock::time_point start;
+		};
+
+		size_t count = jobs.size();
+		std::vector<Result> results(count);
+		std::vector<Job> state(count);
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<size_t> loaded, processed;
+		size_t next_load = 0, loading = 0, in_memory = 0, finished = 0;
+		const size_t max_in_memory = 2 * (size_t)concurrency;
+
+		auto io = [&]()
+		{
+			for (;;)
+			{
+				size_t index;
+				bool save;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [&] { return !processed.empty() || (next_load < count && in_memory < max_in_memory) || finished == count; });
+
+					if (!processed.empty())
+					{
+						index = processed.front();
+						processed.pop_front();
+						save = true;
+					}
+					else if (next_load < count && in_memory < max_in_memory)
+					{
+						index = next_load++;
+						loading++;
+						in_memory++;
+						save = false;
+					}
+					else
+						return;
+				}
+
+				Job &job = state[index];
+				Result &res = results[index];
+
+				if (save)
+				{
+					auto start = Clock::now();
+
+					ImageByteColor img(job.image.Width(), job.image.Height());
+					Merge(job.image, img);
+
+					Pipeline::ImageType empty;
+					job.image.swap(empty);
+
+					res.ok = ImageIO::ToFile(img, res.output.c_str());
+
+					auto stop = Clock::now();
+					res.save = Seconds(start, stop);
+					res.latency = Seconds(job.start, stop);
+
+					std::lock_guard<std::mutex> lock(mutex);
+					in_memory--;
+					finished++;
+				}
+				else
+				{
+					job.start = Clock::now();
+
+					ImageFloatColor img = ImageIO::FromFile<PixelFloatRGBA>(res.input.c_str());
+					res.ok = img;
+
+					if (img)
+					{
+						Pipeline::ImageType planes(img);
+						job.image.swap(planes);
+					}
+
+					auto stop = Clock::now();
+					res.load = Seconds(job.start, stop);
+
+					std::lock_guard<std::mutex> lock(mutex);
+					loading--;
+
+					if (res.ok)
+						loaded.push_back(index);
+					else
+					{
+						res.latency = res.load;
+						in_memory--;
+						finished++;
+					}
+				}
+
+				cv.notify_all();
+			}
+		};
+
+		auto compute = [&]()
+		{
+			for (;;)
+			{
+				size_t index;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv.wait(lock, [&] { return !loaded.empty() || (next_load == count && loading == 0); });
+
+					if (loaded.empty())
+						return;
+
+					index = loaded.front();
+					loaded.pop_front();
+				}
+
+				Job &job = state[index];
+				Result &res = results[index];
+
+				auto start = Clock::now();
+
+				Pipeline::ImageType dst = pipeline.Run(job.image);
+				job.image.swap(dst);
+
+				res.process = Seconds(start, Clock::now());
+				res.width = job.image.Width();
+				res.height = job.image.Height();
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					processed.push_back(index);
+				}
+
+				cv.notify_all();
+			}
+		};
+
+		for (size_t i = 0; i < count; i++)
+		{
+			results[i].input = jobs[i].first;
+			results[i].output = jobs[i].second;
+			results[i].ok = false;
+			results[i].width = results[i].height = 0;
+			results[i].load = results[i].process = results[i].save = results[i].latency = 0.0f;
+		}
+
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < io_threads; i++)
+			threads.emplace_back(io);
+
+		for (int i = 0; i < concurrency; i++)
+			threads.emplace_back(compute);
+
+		for (auto &thread : threads)
+			thread.join();
+
+		return results;
+	}
+
+	PipelineBatch::Summary PipelineBatch::Summarize(const std::vector<Result> &results, float seconds)
+	{
+		Summary res;
+		std::vector<float> latency;
+		double pixels = 0.0;
+
+		res.images = (int)results.size();
+		res.failed = 0;
+		res.seconds = seconds;
+
+		for (auto &r : results)
+		{
+			if (!r.ok)
+			{
+				res.failed++;
+				continue;
+			}
+
+			latency.push_back(r.latency);
+			pixels += (double)r.width * r.height;
+		}
+
+		res.images_per_second = seconds > 0.0f ? (res.images - res.failed) / seconds : 0.0;
+		res.megapixels_per_second = seconds > 0.0f ? pixels * 1e-6 / seconds : 0.0;
+
+		std::sort(latency.begin(), latency.end());
+
+		// Nearest rank
+		auto percentile = [&latency](float p)
+		{
+			if (latency.empty())
+				return 0.0f;
+
+			size_t rank = (size_t)ceil(p * latency.size());
+			return latency[(std::max)(rank, (size_t)1) - 1];
+		};
+
+		res.p50 = percentile(0.5f);
+		res.p90 = percentile(0.9f);
+		res.p99 = percentile(0.99f);
+		res.max = percentile(1.0f);
+
+		return res;
+	}
+
+	void PipelineBatch::WriteCSV(const std::vector<Result> &results, FILE *f)
+	{
+		fprintf(f, "input,output,status,width,height,load_ms,process_ms,save_ms,latency_ms\n");
+
+		for (auto &r : results)
+		{
+			WriteQuoted(r.input, f);
+			fputc(',', f);
+			WriteQuoted(r.output, f);
+			fprintf(f, ",%s,%d,%d,%.3f,%.3f,%.3f,%.3f\n", r.ok ? "ok" : "error", r.width, r.height,
+				r.load * 1e3f, r.process * 1e3f, r.save * 1e3f, r.latency * 1e3f);
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pipeline.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace ip
+{
+	/* Runs one Pipeline over a list of (input, output) files in a single process, so GDI+, the thread pool and
+	* the models are set up once. The images are decoded and encoded by I/O threads while the compute threads run
+	* the pipeline, at most 'concurrency' images are processed at once and at most 2 * concurrency images are in
+	* memory between loading and saving. The outputs are written as PNG */
+	class PipelineBatch
+	{
+	public:
+		struct Result
+		{
+			std::wstring input, output;
+
+			// false if the input cannot be loaded or the output cannot be written, the size is 0 in the first case
+			bool ok;
+
+			// Size of the output
+			int width, height;
+
+			// In seconds. The latency is from the start of loading to the end of saving, including the waiting
+			float load, process, save, latency;
+		};
+
+		struct Summary
+		{
+			int images, failed;
+			float seconds;
+			double images_per_second, megapixels_per_second;
+
+			// Percentiles of the latency over the successful images, in seconds
+			float p50, p90, p99, max;
+		};
+
+		explicit PipelineBatch(const Pipeline &pipeline);
+
+		void AddJob(const std::wstring &input, const std::wstring &output);
+		size_t JobCount() const;
+
+		// Results in the order the jobs were added
+		std::vector<Result> Run(int io_threads = 2, int concurrency = 2) const;
+
+		static Summary Summarize(const std::vector<Result> &results, float seconds);
+
+		static void WriteCSV(const std::vector<Result> &results, FILE *f);
+
+	private:
+		const Pipeline &pipeline;
+		std::vector<std::pair<std::wstring, std::wstring>> jobs;
+	};
+}
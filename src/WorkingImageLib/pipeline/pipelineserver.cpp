@@ -0,0 +1,415 @@
+#include "pipelineserver.h"
+#include <iplib/image/io/imageio.h>
+#include <iplib/image/io/textio.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace ip
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		float Milliseconds(Clock::time_point start, Clock::time_point stop)
+		{
+			return std::chrono::duration<float, std::milli>(stop - start).count();
+		}
+
+		// false at the end of the input, the line ending (\n or \r\n) is removed
+		bool ReadLine(FILE *f, std::string &line)
+		{
+			line.clear();
+
+			int c;
+			while ((c = getc(f)) != EOF && c != '\n')
+				line.push_back((char)c);
+
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			return c != EOF || !line.empty();
+		}
+
+		std::vector<std::string> SplitFields(const std::string &line)
+		{
+			std::vector<std::string> res;
+			size_t start = 0;
+
+			for (;;)
+			{
+				size_t tab = line.find('\t', start);
+				res.push_back(line.substr(start, tab - start));
+
+				if (tab == std::string::npos)
+					return res;
+
+				start = tab + 1;
+			}
+		}
+
+		bool ParseInt(const std::string &str, int &value)
+		{
+			char *end;
+			long v = strtol(str.c_str(), &end, 10);
+
+			if (str.empty() || *end != '\0' || v < 0 || v > 65536)
+				return false;
+
+			value = (int)v;
+			return true;
+		}
+
+		// Reads and drops 'size' bytes, false at the end of the input
+		bool Skip(FILE *f, long long size)
+		{
+			char buf[65536];
+
+			while (size > 0)
+			{
+				size_t n = fread(buf, 1, (size_t)(std::min)(size, (long long)sizeof(buf)), f);
+				if (n == 0)
+					return false;
+
+				size -= n;
+			}
+
+			return true;
+		}
+
+		// Views the raw buffer of a job as an image of the matching pixel type
+		template <typename PixelType, typename Func>
+		void WithRawImage(byte *data, int width, int height, Func func)
+		{
+			CustomBitmapImage<PixelType> img;
+			img.Init(data, width, height, width * sizeof(PixelType));
+			func(img);
+		}
+	}
+
+	struct PipelineServer::Job
+	{
+		std::string id;
+		const Pipeline *pipeline;
+
+		// File job
+		std::wstring input, output;
+
+		// Raw job, channels is 0 for a file job
+		int width, height, channels;
+		std::vector<byte> data;
+
+		Clock::time_point received;
+	};
+
+	PipelineServer::PipelineServer(FILE *in, FILE *out)
+		: in(in), out(out), served(0), failed(0), batches(0), pixels(0)
+	{
+	}
+
+	PipelineServer::~PipelineServer()
+	{
+	}
+
+	bool PipelineServer::Load(const std::wstring &name, const std::wstring &stages, std::wstring &error)
+	{
+		// The queued jobs refer to the pipelines, so a name is never redefined
+		if (pipelines.count(name))
+		{
+			error = L"Pipeline " + name + L" is already defined";
+			return false;
+		}
+
+		std::unique_ptr<Pipeline> pipeline(new Pipeline(stages.c_str()));
+
+		if (!*pipeline)
+		{
+			error = pipeline->Error();
+			return false;
+		}
+
+		pipelines[name] = std::move(pipeline);
+		return true;
+	}
+
+	void PipelineServer::Respond(const std::string &line, const void *payload, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(out_sync);
+
+		fwrite(line.c_str(), 1, line.size(), out);
+		fputc('\n', out);
+
+		if (size != 0)
+			fwrite(payload, 1, size, out);
+
+		fflush(out);
+	}
+
+	void PipelineServer::Execute(Job &job, int batch_size)
+	{
+		auto start = Clock::now();
+		Pipeline::ImageType src;
+
+		if (job.channels == 0)
+		{
+			ImageFloatColor img = ImageIO::FromFile<PixelFloatRGBA>(job.input.c_str());
+
+			if (!img)
+			{
+				failed++;
+				Respond("error\t" + job.id + "\tCannot open " + ToUTF8(job.input));
+				return;
+			}
+
+			Pipeline::ImageType planes(img);
+			src.swap(planes);
+		}
+		else
+		{
+			Pipeline::ImageType planes(job.width, job.height);
+
+			if (job.channels == 3)
+				WithRawImage<PixelByteRGB>(job.data.data(), job.width, job.height, [&planes](const CustomBitmapImage<PixelByteRGB> &img) { Split(img, planes); });
+			else
+				WithRawImage<PixelByteRGBA>(job.data.data(), job.width, job.height, [&planes](const CustomBitmapImage<PixelByteRGBA> &img) { Split(img, planes); });
+
+			src.swap(planes);
+			std::vector<byte>().swap(job.data);
+		}
+
+		auto loaded = Clock::now();
+
+		Pipeline::ImageType dst = job.pipeline->Run(src);
+
+		auto processed = Clock::now();
+
+		int width = dst.Width(), height = dst.Height();
+		std::vector<byte> result;
+
+		if (job.channels == 0)
+		{
+			ImageByteColor img(width, height);
+			Merge(dst, img);
+
+			if (!ImageIO::ToFile(img, job.output.c_str()))
+			{
+				failed++;
+				Respond("error\t" + job.id + "\tCannot write " + ToUTF8(job.output));
+				return;
+			}
+		}
+		else
+		{
+			result.resize((size_t)width * height * job.channels);
+
+			if (job.channels == 3)
+				WithRawImage<PixelByteRGB>(result.data(), width, height, [&dst](CustomBitmapImage<PixelByteRGB> &img) { Merge(dst, img); });
+			else
+			{
+				WithRawImage<PixelByteRGBA>(result.data(), width, height, [&dst](CustomBitmapImage<PixelByteRGBA> &img) { Merge(dst, img); });
+
+				for (size_t i = 3; i < result.size(); i += 4)
+					result[i] = 255;
+			}
+		}
+
+		auto stop = Clock::now();
+
+		char buf[256];
+		sprintf(buf, "\t%d\t%d\t%d\t%d\tqueue_ms=%.3f\tprocess_ms=%.3f\tio_ms=%.3f\ttotal_ms=%.3f\tbatch=%d", width, height,
+			job.channels, (int)result.size(), Milliseconds(job.received, start), Milliseconds(loaded, processed),
+			Milliseconds(start, loaded) + Milliseconds(processed, stop), Milliseconds(job.received, stop), batch_size);
+
+		served++;
+		pixels += (long long)width * height;
+
+		Respond("done\t" + job.id + buf, result.data(), result.size());
+	}
+
+	/* The calling thread reads the requests and queues the jobs, a dispatcher thread takes everything queued at
+	* once and runs it as a batch. The small jobs of a batch run on threads of their own rather than in a Parallel
+	* body, so the Parallel calls of the pipelines and of the image I/O are not nested and use the whole pool */
+	int PipelineServer::Serve()
+	{
+		std::mutex queue_sync;
+		std::condition_variable queue_var;
+		std::deque<std::unique_ptr<Job>> queue;
+		bool finished = false;
+
+		std::thread dispatcher([&]()
+		{
+			for (;;)
+			{
+				std::deque<std::unique_ptr<Job>> batch;
+
+				{
+					std::unique_lock<std::mutex> lock(queue_sync);
+					queue_var.wait(lock, [&] { return !queue.empty() || finished; });
+
+					if (queue.empty())
+						return;
+
+					batch.swap(queue);
+				}
+
+				batches++;
+
+				std::vector<Job*> small_jobs, large_jobs;
+
+				for (auto &job : batch)
+				{
+					bool is_large = job->channels != 0 && (long long)job->width * job->height > SmallJobPixels;
+					(is_large ? large_jobs : small_jobs).push_back(job.get());
+				}
+
+				int small_count = (int)small_jobs.size();
+				std::atomic_int next(0);
+				std::vector<std::thread> threads;
+
+				for (int t = 0; t < (std::min)(small_count, Parallel::ThreadCount()); t++)
+				{
+					threads.emplace_back([&small_jobs, &next, small_count, this]()
+					{
+						for (int i = next++; i < small_count; i = next++)
+							Execute(*small_jobs[i], small_count);
+					});
+				}
+
+				for (auto &thread : threads)
+					thread.join();
+
+				for (Job *job : large_jobs)
+					Execute(*job, 1);
+			}
+		});
+
+		Respond("ready");
+
+		std::string line;
+
+		while (ReadLine(in, line))
+		{
+			if (line.empty())
+				continue;
+
+			std::vector<std::string> fields = SplitFields(line);
+			const std::string &request = fields[0];
+
+			if (request == "quit")
+				break;
+
+			if (request == "stats")
+			{
+				char buf[256];
+				sprintf(buf, "stats\tjobs=%d\tfailed=%d\tbatches=%d\tmegapixels=%.3f", served.load(), failed.load(),
+					batches.load(), pixels.load() * 1e-6);
+				Respond(buf);
+				continue;
+			}
+
+			if (request == "load")
+			{
+				if (fields.size() != 3)
+				{
+					Respond("error\t-\tExpected: load <name> <stages>");
+					continue;
+				}
+
+				std::wstring error;
+
+				if (Load(FromUTF8(fields[1]), FromUTF8(fields[2]), error))
+					Respond("loaded\t" + fields[1]);
+				else
+					Respond("error\t" + fields[1] + "\t" + ToUTF8(error));
+
+				continue;
+			}
+
+			std::unique_ptr<Job> job(new Job);
+			job->received = Clock::now();
+			job->channels = job->width = job->height = 0;
+
+			if (request == "run")
+			{
+				if (fields.size() != 5)
+				{
+					Respond("error\t-\tExpected: run <id> <name> <input> <output>");
+					continue;
+				}
+
+				job->input = FromUTF8(fields[3]);
+				job->output = FromUTF8(fields[4]);
+			}
+			else if (request == "raw")
+			{
+				if (fields.size() != 6 || !ParseInt(fields[3], job->width) || !ParseInt(fields[4], job->height) ||
+					!ParseInt(fields[5], job->channels) || job->width == 0 || job->height == 0 ||
+					(job->channels != 3 && job->channels != 4))
+				{
+					Respond("error\t-\tMalformed raw request, closing");
+					break;
+				}
+
+				if ((long long)job->width * job->height > MaxRawPixels)
+				{
+					failed++;
+
+					if (!Skip(in, (long long)job->width * job->height * job->channels))
+					{
+						Respond("error\t" + fields[1] + "\tIncomplete raw data, closing");
+						break;
+					}
+
+					Respond("error\t" + fields[1] + "\tThe raw image is larger than " + std::to_string(MaxRawPixels) + " pixels");
+					continue;
+				}
+
+				job->data.resize((size_t)job->width * job->height * job->channels);
+
+				if (fread(job->data.data(), 1, job->data.size(), in) != job->data.size())
+				{
+					Respond("error\t" + fields[1] + "\tIncomplete raw data, closing");
+					break;
+				}
+			}
+			else
+			{
+				Respond("error\t-\tUnknown request " + request);
+				continue;
+			}
+
+			job->id = fields[1];
+
+			auto it = pipelines.find(FromUTF8(fields[2]));
+
+			if (it == pipelines.end())
+			{
+				failed++;
+				Respond("error\t" + job->id + "\tUnknown pipeline " + fields[2]);
+				continue;
+			}
+
+			job->pipeline = it->second.get();
+
+			{
+				std::lock_guard<std::mutex> lock(queue_sync);
+				queue.push_back(std::move(job));
+			}
+
+			queue_var.notify_one();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(queue_sync);
+			finished = true;
+		}
+
+		queue_var.notify_one();
+		dispatcher.join();
+
+		return served;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "pipeline.h"
+#include <stdio.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ip
+{
+	/* Serves pipeline jobs over a pair of streams (stdin / stdout of the 'serve' operation), so the process start-up
+	* and the model loading are paid once. The protocol is line-delimited, the fields are separated by tabs:
+	*
+	*   load <name> <stages>                          define a pipeline (see Pipeline), its models are loaded now
+	*   run <id> <name> <input> <output>              process an image file, the output is PNG
+	*   raw <id> <name> <width> <height> <channels>   the line is followed by width * height * channels bytes,
+	*                                                 rows top-down, 3 (B, G, R) or 4 (B, G, R, A) channels
+	*   stats
+	*   quit                                          finish the queued jobs and exit, as the end of the input does
+	*
+	* The server answers 'ready' once, then
+	*
+	*   loaded <name>
+	*   done <id> <width> <height> <channels> <bytes> queue_ms=.. process_ms=.. io_ms=.. total_ms=.. batch=..
+	*   error <id or name> <message>
+	*   stats jobs=.. failed=.. batches=.. megapixels=..
+	*
+	* 'done' of a raw job is followed by the result in the format of the request, <bytes> long (the alpha channel
+	* is not processed and returns as 255), a file job has 0 channels and 0 bytes. batch is the number of the jobs
+	* run together with this one. The jobs run concurrently, so their answers come in the order of completion.
+	*
+	* The jobs queued while the previous batch runs form the next batch: the file jobs and the raw jobs up to
+	* SmallJobPixels run together on up to Parallel::ThreadCount() threads, one job per thread at a time, the larger
+	* ones run one by one. All of them use Parallel inside. A malformed raw header ends the session since the payload cannot be skipped, the payload of
+	* an image over MaxRawPixels is skipped unread */
+	class PipelineServer
+	{
+	public:
+		static const int SmallJobPixels = 1 << 18;
+
+		// The largest raw image accepted, 8K UHD
+		static const int MaxRawPixels = 7680 * 4320;
+
+		PipelineServer(FILE *in, FILE *out);
+		~PipelineServer();
+
+		// Defines a pipeline before serving, false if the description is invalid
+		bool Load(const std::wstring &name, const std::wstring &stages, std::wstring &error);
+
+		// Reads the requests until 'quit' or the end of the input, returns the number of the jobs served
+		int Serve();
+
+	private:
+		struct Job;
+
+		FILE *in, *out;
+		std::mutex out_sync;
+		std::map<std::wstring, std::unique_ptr<Pipeline>> pipelines;
+
+		std::atomic_int served, failed, batches;
+		std::atomic<long long> pixels;
+
+		void Execute(Job &job, int batch_size);
+		void Respond(const std::string &line, const void *payload = nullptr, size_t size = 0);
+	};
+}
@@ -2,6 +2,7 @@
 
 #include <iplib/common.h>
 #include <iplib/parallel.h>
+#include <misc/cpudispatch.h>
 #include <math.h>
 #include <immintrin.h>
 
@@ -12,6 +13,31 @@ namespace ip
 	const float kernel2[6] = { -0.03016f, -0.04952f, -0.05838f, 0.04283f, 0.45204f, 0.25095f };
 	const float WeightThreshold = 1.25f;
 
+	// Vector access to the planes: 8 floats or PixelHalf values, 2 PixelFloatRGBA or PixelHalfRGBA pixels
+	inline __m256 Load(const float *p) { return _mm256_load_ps(p); }
+	inline __m256 LoadU(const float *p) { return _mm256_loadu_ps(p); }
+	inline void Store(float *p, __m256 v) { _mm256_store_ps(p, v); }
+	inline void StoreU(float *p, __m256 v) { _mm256_storeu_ps(p, v); }
+
+	inline __m256 Load(const PixelFloatRGBA *p) { return _mm256_load_ps((const float*)p); }
+	inline __m256 LoadU(const PixelFloatRGBA *p) { return _mm256_loadu_ps((const float*)p); }
+	inline void Store(PixelFloatRGBA *p, __m256 v) { _mm256_store_ps((float*)p, v); }
+	inline void StoreU(PixelFloatRGBA *p, __m256 v) { _mm256_storeu_ps((float*)p, v); }
+
+	// The half-precision planes are converted by F16C, the rows of 8 halves are not 32-byte aligned
+	inline __m256 LoadU(const PixelHalf *p) { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p)); }
+	inline __m256 Load(const PixelHalf *p) { return LoadU(p); }
+	inline void StoreU(PixelHalf *p, __m256 v) { _mm_storeu_si128((__m128i*)p, _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT)); }
+	inline void Store(PixelHalf *p, __m256 v) { StoreU(p, v); }
+
+	inline __m256 LoadU(const PixelHalfRGBA *p) { return LoadU((const PixelHalf*)p); }
+	inline __m256 Load(const PixelHalfRGBA *p) { return LoadU((const PixelHalf*)p); }
+	inline void StoreU(PixelHalfRGBA *p, __m256 v) { StoreU((PixelHalf*)p, v); }
+	inline void Store(PixelHalfRGBA *p, __m256 v) { StoreU((PixelHalf*)p, v); }
+
+	/* PlaneType and ColorPlaneType are the storage of the interpolated planes r00..r11 and c00..c11, float and
+	* PixelFloatRGBA or PixelHalf and PixelHalfRGBA. The derivatives and the weights are accumulated in float */
+	template <typename PlaneType = float, typename ColorPlaneType = PixelFloatRGBA>
 	class EDRFast
 	{
 		int Width, Height;
@@ -22,8 +48,8 @@ namespace ip
 
 		// Image<float> 
 
-		Image<float> r00, r10, r01, r11;
-		ImageFloatColor c00, c10, c01, c11;
+		Image<PlaneType> r00, r10, r01, r11;
+		Image<ColorPlaneType> c00, c10, c01, c11;
 
 	public:
 		EDRFast(int srcWidth, int srcHeight)
@@ -39,16 +65,32 @@ namespace ip
 			, r10(srcWidth, srcHeight)
 			, r01(srcWidth, srcHeight)
 			, r11(srcWidth, srcHeight)
-			, c00(srcWidth, srcHeight)
-			, c01(srcWidth, srcHeight)
-			, c10(srcWidth, srcHeight)
-			, c11(srcWidth, srcHeight)
 		{
-			// No nothing
+			// The colour images are allocated by the colour Perform
 		}
 
 	private:
-		void DerivativeDiag1(const Image<float> &src, Image<float> &dst)
+		static void Allocate(Image<ColorPlaneType> &img, int Width, int Height)
+		{
+			if (!img)
+			{
+				Image<ColorPlaneType> tmp(Width, Height);
+				img.swap(tmp);
+			}
+		}
+
+		// Image::swap moves the other image into this one, so a real exchange goes through an empty image
+		template <typename T>
+		static void Exchange(Image<T> &a, Image<T> &b)
+		{
+			Image<T> tmp;
+			tmp.swap(a);
+			a.swap(b);
+			b.swap(tmp);
+		}
+
+		template <typename T>
+		void DerivativeDiag1(const Image<T> &src, Image<float> &dst)
 		{
 			Parallel::For(0, Height - 1, [&src, &dst, this](int j)
 			{
@@ -58,11 +100,11 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 s11 = _mm256_loadu_ps(src.pixeladdr(i + 1, j + 1));
-					__m256 s00 = _mm256_load_ps(src.pixeladdr(i, j));
+					__m256 s11 = LoadU(src.pixeladdr(i + 1, j + 1));
+					__m256 s00 = Load(src.pixeladdr(i, j));
 					__m256 diff = _mm256_sub_ps(s11, s00);
 					__m256 res = _mm256_and_ps(diff, SIGNMASK);
-					_mm256_store_ps(dst.pixeladdr(i, j), res);
+					Store(dst.pixeladdr(i, j), res);
 				}
 
 				for (int i = Width8; i < src.Width() - 1; i++)
@@ -72,7 +114,8 @@ namespace ip
 			});
 		}
 
-		void DerivativeDiag2(const Image<float> &src, Image<float> &dst)
+		template <typename T>
+		void DerivativeDiag2(const Image<T> &src, Image<float> &dst)
 		{
 			Parallel::For(0, Height - 1, [&src, &dst, this](int j)
 			{
@@ -82,11 +125,11 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 s11 = _mm256_loadu_ps(src.pixeladdr(i + 1, j));
-					__m256 s00 = _mm256_load_ps(src.pixeladdr(i, j + 1));
+					__m256 s11 = LoadU(src.pixeladdr(i + 1, j));
+					__m256 s00 = Load(src.pixeladdr(i, j + 1));
 					__m256 diff = _mm256_sub_ps(s11, s00);
 					__m256 res = _mm256_and_ps(diff, SIGNMASK);
-					_mm256_store_ps(dst.pixeladdr(i, j), res);
+					Store(dst.pixeladdr(i, j), res);
 				}
 
 				for (int i = Width8; i < src.Width() - 1; i++)
@@ -104,15 +147,15 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v00 = _mm256_load_ps(src.pixeladdr(i, j));
-					__m256 v10 = _mm256_load_ps(src.pixeladdr(i + 1, j));
-					__m256 v20 = _mm256_load_ps(src.pixeladdr(i + 2, j));
-					__m256 v01 = _mm256_load_ps(src.pixeladdr(i, j + 1));
-					__m256 v11 = _mm256_load_ps(src.pixeladdr(i + 1, j + 1));
-					__m256 v21 = _mm256_load_ps(src.pixeladdr(i + 2, j + 1));
-					__m256 v02 = _mm256_load_ps(src.pixeladdr(i, j + 2));
-					__m256 v12 = _mm256_load_ps(src.pixeladdr(i + 1, j + 2));
-					__m256 v22 = _mm256_load_ps(src.pixeladdr(i + 2, j + 2));
+					__m256 v00 = Load(src.pixeladdr(i, j));
+					__m256 v10 = Load(src.pixeladdr(i + 1, j));
+					__m256 v20 = Load(src.pixeladdr(i + 2, j));
+					__m256 v01 = Load(src.pixeladdr(i, j + 1));
+					__m256 v11 = Load(src.pixeladdr(i + 1, j + 1));
+					__m256 v21 = Load(src.pixeladdr(i + 2, j + 1));
+					__m256 v02 = Load(src.pixeladdr(i, j + 2));
+					__m256 v12 = Load(src.pixeladdr(i + 1, j + 2));
+					__m256 v22 = Load(src.pixeladdr(i + 2, j + 2));
 
 					__m256 s0 = _mm256_add_ps(_mm256_add_ps(v00, v10), v20);
 					__m256 s1 = _mm256_add_ps(_mm256_add_ps(v01, v11), v21);
@@ -120,7 +163,7 @@ namespace ip
 
 					__m256 res = _mm256_add_ps(_mm256_add_ps(s0, s1), s2);
 
-					_mm256_store_ps(dst.pixeladdr(i, j), res);
+					Store(dst.pixeladdr(i, j), res);
 				}
 
 				for (int i = Width8; i < Width - 3; i++)
@@ -179,7 +222,7 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					_mm256_store_ps(w.pixeladdr(i, j), CalcWeightsFast(_mm256_load_ps(p.pixeladdr(i, j)), _mm256_load_ps(q.pixeladdr(i, j))));
+					Store(w.pixeladdr(i, j), CalcWeightsFast(Load(p.pixeladdr(i, j)), Load(q.pixeladdr(i, j))));
 				}
 
 				for (int i = Width8; i < p.Width(); i++)
@@ -191,7 +234,8 @@ namespace ip
 			});
 		}
 
-		void CalcWeights1(const Image<float> &src)
+		template <typename T>
+		void CalcWeights1(const Image<T> &src)
 		{
 			DerivativeDiag1(src, tmp);
 			Average3x3(tmp, pw1);
@@ -208,39 +252,39 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v0 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i, j)), _mm256_loadu_ps(src.pixeladdr(i + 4, j))),
-						                      _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i, j + 4)), _mm256_loadu_ps(src.pixeladdr(i + 4, j + 4))));
+					__m256 v0 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i, j)), LoadU(src.pixeladdr(i + 4, j))),
+						                      _mm256_add_ps(LoadU(src.pixeladdr(i, j + 4)), LoadU(src.pixeladdr(i + 4, j + 4))));
 
 					__m256 res = _mm256_mul_ps(v0, _mm256_broadcast_ss(&kernel0[0]));
 
-					__m256 v1a = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j)), _mm256_loadu_ps(src.pixeladdr(i + 3, j))),
-						                       _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 4, j + 1))));
+					__m256 v1a = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 1, j)), LoadU(src.pixeladdr(i + 3, j))),
+						                       _mm256_add_ps(LoadU(src.pixeladdr(i, j + 1)), LoadU(src.pixeladdr(i + 4, j + 1))));
 
-					__m256 v1b = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i, j + 3)), _mm256_loadu_ps(src.pixeladdr(i + 4, j + 3))),
-						                       _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j + 4)), _mm256_loadu_ps(src.pixeladdr(i + 3, j + 4))));
+					__m256 v1b = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i, j + 3)), LoadU(src.pixeladdr(i + 4, j + 3))),
+						                       _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 4)), LoadU(src.pixeladdr(i + 3, j + 4))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_add_ps(v1a, v1b), _mm256_broadcast_ss(&kernel0[1])));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 2, j)), _mm256_loadu_ps(src.pixeladdr(i, j + 2))),
-						                      _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 4, j + 2)), _mm256_loadu_ps(src.pixeladdr(i + 2, j + 4))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 2, j)), LoadU(src.pixeladdr(i, j + 2))),
+						                      _mm256_add_ps(LoadU(src.pixeladdr(i + 4, j + 2)), LoadU(src.pixeladdr(i + 2, j + 4))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v2, _mm256_broadcast_ss(&kernel0[2])));
 
-					__m256 v3 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 3, j + 1))),
-						                      _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j + 3)), _mm256_loadu_ps(src.pixeladdr(i + 3, j + 3))));
+					__m256 v3 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 1)), LoadU(src.pixeladdr(i + 3, j + 1))),
+						                      _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 3)), LoadU(src.pixeladdr(i + 3, j + 3))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v3, _mm256_broadcast_ss(&kernel0[3])));
 
-					__m256 v4 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 1, j + 2))),
-					                          _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 3, j + 2)), _mm256_loadu_ps(src.pixeladdr(i + 2, j + 3))));
+					__m256 v4 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 2, j + 1)), LoadU(src.pixeladdr(i + 1, j + 2))),
+					                          _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 2)), LoadU(src.pixeladdr(i + 2, j + 3))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v4, _mm256_broadcast_ss(&kernel0[4])));
 
-					__m256 v5 = _mm256_loadu_ps(src.pixeladdr(i + 2, j + 2));
+					__m256 v5 = LoadU(src.pixeladdr(i + 2, j + 2));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v5, _mm256_broadcast_ss(&kernel0[5])));
 
-					_mm256_storeu_ps(r00.pixeladdr(i + 2, j + 2), res);
+					StoreU(r00.pixeladdr(i + 2, j + 2), res);
 				}
 
 				for (int i = Width8; i < src.Width() - 4; i++)
@@ -258,7 +302,8 @@ namespace ip
 			});
 		}
 
-		static void ToGrayScale(const ImageFloatColor &src, Image<float> &dst)
+		template <typename SourcePixelType, typename T>
+		static void ToGrayScale(const Image<SourcePixelType> &src, Image<T> &dst)
 		{
 			Parallel::For(0, src.Height(), [&src, &dst](int j)
 			{
@@ -270,10 +315,10 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 bgra0bgra1 = _mm256_load_ps((const float*)src.pixeladdr(i, j));
-					__m256 bgra2bgra3 = _mm256_load_ps((const float*)src.pixeladdr(i + 2, j));
-					__m256 bgra4bgra5 = _mm256_load_ps((const float*)src.pixeladdr(i + 4, j));
-					__m256 bgra6bgra7 = _mm256_load_ps((const float*)src.pixeladdr(i + 6, j));
+					__m256 bgra0bgra1 = Load(src.pixeladdr(i, j));
+					__m256 bgra2bgra3 = Load(src.pixeladdr(i + 2, j));
+					__m256 bgra4bgra5 = Load(src.pixeladdr(i + 4, j));
+					__m256 bgra6bgra7 = Load(src.pixeladdr(i + 6, j));
 
 					__m256 b02g02b13g13 = _mm256_unpacklo_ps(bgra0bgra1, bgra2bgra3);
 					__m256 r02a02r13a13 = _mm256_unpackhi_ps(bgra0bgra1, bgra2bgra3);
@@ -289,17 +334,46 @@ namespace ip
 					__m256 s0123xxxx = _mm256_unpacklo_ps(s0246s1357, _mm256_castps128_ps256(_mm256_extractf128_ps(s0246s1357, 1)));
 					__m256 s4567xxxx = _mm256_unpackhi_ps(s0246s1357, _mm256_castps128_ps256(_mm256_extractf128_ps(s0246s1357, 1)));
 
-					_mm256_store_ps(dst.pixeladdr(i, j), _mm256_insertf128_ps(s0123xxxx, _mm256_castps256_ps128(s4567xxxx), 1));
+					Store(dst.pixeladdr(i, j), _mm256_insertf128_ps(s0123xxxx, _mm256_castps256_ps128(s4567xxxx), 1));
 				}
 
 				for (int i = Width8; i < src.Width(); i++)
 				{
-					dst(i, j) = src(i, j).ToGray();
+					dst(i, j) = PixelFloatRGBA(src(i, j)).ToGray();
 				}
 			});
 
 		}
 
+		template <typename T>
+		static void ToGrayScale(const Image<T> (&src)[3], Image<T> &dst)
+		{
+			Parallel::For(0, src[0].Height(), [&src, &dst](int j)
+			{
+				int Width8 = src[0].Width() / 8 * 8;
+
+				static const __m256 BLUE = _mm256_set1_ps(0.114f);
+				static const __m256 GREEN = _mm256_set1_ps(0.587f);
+				static const __m256 RED = _mm256_set1_ps(0.299f);
+
+				const T *b = src[0].pixeladdr(0, j);
+				const T *g = src[1].pixeladdr(0, j);
+				const T *r = src[2].pixeladdr(0, j);
+				T *s = dst.pixeladdr(0, j);
+
+				for (int i = 0; i < Width8; i += 8)
+				{
+					__m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Load(b + i), BLUE), _mm256_mul_ps(Load(g + i), GREEN)), _mm256_mul_ps(Load(r + i), RED));
+					Store(s + i, v);
+				}
+
+				for (int i = Width8; i < src[0].Width(); i++)
+				{
+					s[i] = 0.299f * r[i] + 0.587f * g[i] + 0.114f * b[i];
+				}
+			});
+		}
+
 		void Step00(const ImageFloatColor &src)
 		{
 			Parallel::For(0, Height - 4, [&src, this](int j)
@@ -308,34 +382,34 @@ namespace ip
 
 				for (int i = 0; i < Width2; i += 2)
 				{
-					__m256 v0 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 4, j))),
-						_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i, j + 4)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 4, j + 4))));
+					__m256 v0 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i, j)), LoadU(src.pixeladdr(i + 4, j))),
+						_mm256_add_ps(LoadU(src.pixeladdr(i, j + 4)), LoadU(src.pixeladdr(i + 4, j + 4))));
 
 					__m256 res = _mm256_mul_ps(v0, _mm256_broadcast_ss(&kernel0[0]));
 
-					__m256 v1a = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j))), _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 4, j + 1))));
+					__m256 v1a = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 1, j)), LoadU(src.pixeladdr(i + 3, j))), _mm256_add_ps(LoadU(src.pixeladdr(i, j + 1)), LoadU(src.pixeladdr(i + 4, j + 1))));
 
-					__m256 v1b = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i, j + 3)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 4, j + 3))), _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 4)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 4))));
+					__m256 v1b = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i, j + 3)), LoadU(src.pixeladdr(i + 4, j + 3))), _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 4)), LoadU(src.pixeladdr(i + 3, j + 4))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_add_ps(v1a, v1b), _mm256_broadcast_ss(&kernel0[1])));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i, j + 2))), _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 4, j + 2)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 4))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 2, j)), LoadU(src.pixeladdr(i, j + 2))), _mm256_add_ps(LoadU(src.pixeladdr(i + 4, j + 2)), LoadU(src.pixeladdr(i + 2, j + 4))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v2, _mm256_broadcast_ss(&kernel0[2])));
 
-					__m256 v3 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 1))), _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 3)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 3))));
+					__m256 v3 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 1)), LoadU(src.pixeladdr(i + 3, j + 1))), _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 3)), LoadU(src.pixeladdr(i + 3, j + 3))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v3, _mm256_broadcast_ss(&kernel0[3])));
 
-					__m256 v4 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 2))), _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 2)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 3))));
+					__m256 v4 = _mm256_add_ps(_mm256_add_ps(LoadU(src.pixeladdr(i + 2, j + 1)), LoadU(src.pixeladdr(i + 1, j + 2))), _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 2)), LoadU(src.pixeladdr(i + 2, j + 3))));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v4, _mm256_broadcast_ss(&kernel0[4])));
 
-					__m256 v5 = _mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 2));
+					__m256 v5 = LoadU(src.pixeladdr(i + 2, j + 2));
 
 					res = _mm256_add_ps(res, _mm256_mul_ps(v5, _mm256_broadcast_ss(&kernel0[5])));
 
-					_mm256_storeu_ps((float*)c00.pixeladdr(i + 2, j + 2), res);
+					StoreU(c00.pixeladdr(i + 2, j + 2), res);
 				}
 
 				for (int i = Width2; i < src.Width() - 4; i++)
@@ -365,13 +439,13 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 w = _mm256_load_ps(w1.pixeladdr(i, j));
+					__m256 w = Load(w1.pixeladdr(i, j));
 					__m256 dw = _mm256_sub_ps(ONES, w);
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i, j)), _mm256_loadu_ps(src.pixeladdr(i + 3, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 3, j)), _mm256_loadu_ps(src.pixeladdr(i, j + 3)));
+					__m256 v0 = _mm256_add_ps(LoadU(src.pixeladdr(i, j)), LoadU(src.pixeladdr(i + 3, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j)), LoadU(src.pixeladdr(i, j + 3)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel1[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel1[3]));
@@ -379,12 +453,12 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1a = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j)), _mm256_loadu_ps(src.pixeladdr(i, j + 1)));
-					__m256 v1b = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 3, j + 2)), _mm256_loadu_ps(src.pixeladdr(i + 2, j + 3)));
+					__m256 v1a = _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j)), LoadU(src.pixeladdr(i, j + 1)));
+					__m256 v1b = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 2)), LoadU(src.pixeladdr(i + 2, j + 3)));
 					__m256 v1 = _mm256_add_ps(v1a, v1b);
 
-					__m256 v2a = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 2, j)), _mm256_loadu_ps(src.pixeladdr(i, j + 2)));
-					__m256 v2b = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 3, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 1, j + 3)));
+					__m256 v2a = _mm256_add_ps(LoadU(src.pixeladdr(i + 2, j)), LoadU(src.pixeladdr(i, j + 2)));
+					__m256 v2b = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 1)), LoadU(src.pixeladdr(i + 1, j + 3)));
 					__m256 v2 = _mm256_add_ps(v2a, v2b);
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel1[1]));
@@ -393,14 +467,14 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 2, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps(src.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps(src.pixeladdr(i + 1, j + 2)));
+					__m256 v4 = _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 1)), LoadU(src.pixeladdr(i + 2, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(src.pixeladdr(i + 2, j + 1)), LoadU(src.pixeladdr(i + 1, j + 2)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel1[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel1[5]));
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps(r11.pixeladdr(i + 1, j + 1), res);
+					StoreU(r11.pixeladdr(i + 1, j + 1), res);
 				}
 
 				for (int i = Width8; i < src.Width() - 3; i++)
@@ -442,8 +516,8 @@ namespace ip
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i, j + 3)));
+					__m256 v0 = _mm256_add_ps(LoadU(src.pixeladdr(i, j)), LoadU(src.pixeladdr(i + 3, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j)), LoadU(src.pixeladdr(i, j + 3)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel1[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel1[3]));
@@ -451,12 +525,12 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1a = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i, j + 1)));
-					__m256 v1b = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 2)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 3)));
+					__m256 v1a = _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j)), LoadU(src.pixeladdr(i, j + 1)));
+					__m256 v1b = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 2)), LoadU(src.pixeladdr(i + 2, j + 3)));
 					__m256 v1 = _mm256_add_ps(v1a, v1b);
 
-					__m256 v2a = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j)), _mm256_loadu_ps((const float*)src.pixeladdr(i, j + 2)));
-					__m256 v2b = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 3, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 3)));
+					__m256 v2a = _mm256_add_ps(LoadU(src.pixeladdr(i + 2, j)), LoadU(src.pixeladdr(i, j + 2)));
+					__m256 v2b = _mm256_add_ps(LoadU(src.pixeladdr(i + 3, j + 1)), LoadU(src.pixeladdr(i + 1, j + 3)));
 					__m256 v2 = _mm256_add_ps(v2a, v2b);
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel1[1]));
@@ -465,14 +539,14 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps((const float*)src.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps((const float*)src.pixeladdr(i + 1, j + 2)));
+					__m256 v4 = _mm256_add_ps(LoadU(src.pixeladdr(i + 1, j + 1)), LoadU(src.pixeladdr(i + 2, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(src.pixeladdr(i + 2, j + 1)), LoadU(src.pixeladdr(i + 1, j + 2)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel1[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel1[5]));
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps((float*)c11.pixeladdr(i + 1, j + 1), res);
+					StoreU(c11.pixeladdr(i + 1, j + 1), res);
 				}
 
 				for (int i = Width2; i < src.Width() - 3; i++)
@@ -501,7 +575,8 @@ namespace ip
 			ToGrayScale(c11, r11);
 		}
 
-		void DerivativeHorizontal(const Image<float> &src, Image<float> &dst)
+		template <typename T>
+		void DerivativeHorizontal(const Image<T> &src, Image<float> &dst)
 		{
 			Parallel::For(0, Height, [&src, &dst, this](int j)
 			{
@@ -511,11 +586,11 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 s11 = _mm256_loadu_ps(src.pixeladdr(i + 1, j));
-					__m256 s00 = _mm256_load_ps(src.pixeladdr(i, j));
+					__m256 s11 = LoadU(src.pixeladdr(i + 1, j));
+					__m256 s00 = Load(src.pixeladdr(i, j));
 					__m256 diff = _mm256_sub_ps(s11, s00);
 					__m256 res = _mm256_and_ps(diff, SIGNMASK);
-					_mm256_store_ps(dst.pixeladdr(i, j), res);
+					Store(dst.pixeladdr(i, j), res);
 				}
 
 				for (int i = 0; i < Width - 1; i++)
@@ -525,7 +600,8 @@ namespace ip
 			});
 		}
 
-		void DerivativeVertical(const Image<float> &src, Image<float> &dst)
+		template <typename T>
+		void DerivativeVertical(const Image<T> &src, Image<float> &dst)
 		{
 			Parallel::For(0, Height - 1, [&src, &dst, this](int j)
 			{
@@ -535,11 +611,11 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 s11 = _mm256_load_ps(src.pixeladdr(i, j + 1));
-					__m256 s00 = _mm256_load_ps(src.pixeladdr(i, j));
+					__m256 s11 = Load(src.pixeladdr(i, j + 1));
+					__m256 s00 = Load(src.pixeladdr(i, j));
 					__m256 diff = _mm256_sub_ps(s11, s00);
 					__m256 res = _mm256_and_ps(diff, SIGNMASK);
-					_mm256_store_ps(dst.pixeladdr(i, j), res);
+					Store(dst.pixeladdr(i, j), res);
 				}
 
 				for (int i = 0; i < Width; i++)
@@ -558,16 +634,16 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v1 = _mm256_add_ps(_mm256_loadu_ps(tmp.pixeladdr(i + 1, j)), _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					_mm256_storeu_ps(pw1.pixeladdr(i + 1, j + 1), v1);
-
-					__m256 v2 = _mm256_add_ps(_mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 2)));
-					_mm256_storeu_ps(pw2.pixeladdr(i + 2, j + 1), v2);
+					__m256 v1 = _mm256_add_ps(LoadU(tmp.pixeladdr(i + 1, j)), LoadU(tmp.pixeladdr(i, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					StoreU(pw1.pixeladdr(i + 1, j + 1), v1);
+
+					__m256 v2 = _mm256_add_ps(LoadU(tmp.pixeladdr(i + 1, j + 1)), LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 2, j + 2)));
+					StoreU(pw2.pixeladdr(i + 2, j + 1), v2);
 				}
 
 				for (int i = Width8; i < Width - 2; i++)
@@ -586,20 +662,20 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v1 = _mm256_loadu_ps(pw1.pixeladdr(i + 1, j + 1));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i, j)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					_mm256_storeu_ps(pw1.pixeladdr(i + 1, j + 1), v1);
-
-					__m256 v2 = _mm256_loadu_ps(pw2.pixeladdr(i + 2, j + 1));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					_mm256_storeu_ps(pw2.pixeladdr(i + 2, j + 1), v2);
+					__m256 v1 = LoadU(pw1.pixeladdr(i + 1, j + 1));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i, j)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					StoreU(pw1.pixeladdr(i + 1, j + 1), v1);
+
+					__m256 v2 = LoadU(pw2.pixeladdr(i + 2, j + 1));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					StoreU(pw2.pixeladdr(i + 2, j + 1), v2);
 				}
 
 				for (int i = Width8; i < Width - 2; i++)
@@ -618,16 +694,16 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v1 = _mm256_add_ps(_mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 2)));
-					_mm256_storeu_ps(qw1.pixeladdr(i + 1, j + 2), v1);
-
-					__m256 v2 = _mm256_add_ps(_mm256_loadu_ps(tmp.pixeladdr(i + 1, j)), _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					_mm256_storeu_ps(qw2.pixeladdr(i + 1, j + 1), v2);
+					__m256 v1 = _mm256_add_ps(LoadU(tmp.pixeladdr(i + 1, j + 1)), LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 2, j + 2)));
+					StoreU(qw1.pixeladdr(i + 1, j + 2), v1);
+
+					__m256 v2 = _mm256_add_ps(LoadU(tmp.pixeladdr(i + 1, j)), LoadU(tmp.pixeladdr(i, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					StoreU(qw2.pixeladdr(i + 1, j + 1), v2);
 				}
 
 				for (int i = Width8; i < Width - 2; i++)
@@ -646,20 +722,20 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v1 = _mm256_loadu_ps(qw1.pixeladdr(i + 1, j + 2));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 2, j + 2)));
-					v1 = _mm256_add_ps(v1, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 2)));
-					_mm256_storeu_ps(qw1.pixeladdr(i + 1, j + 2), v1);
-
-					__m256 v2 = _mm256_loadu_ps(qw2.pixeladdr(i + 1, j + 1));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i, j)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i, j + 1)));
-					v2 = _mm256_add_ps(v2, _mm256_loadu_ps(tmp.pixeladdr(i + 1, j + 1)));
-					_mm256_storeu_ps(qw2.pixeladdr(i + 1, j + 1), v2);
+					__m256 v1 = LoadU(qw1.pixeladdr(i + 1, j + 2));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 2, j + 1)));
+					v1 = _mm256_add_ps(v1, LoadU(tmp.pixeladdr(i + 1, j + 2)));
+					StoreU(qw1.pixeladdr(i + 1, j + 2), v1);
+
+					__m256 v2 = LoadU(qw2.pixeladdr(i + 1, j + 1));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i, j)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i, j + 1)));
+					v2 = _mm256_add_ps(v2, LoadU(tmp.pixeladdr(i + 1, j + 1)));
+					StoreU(qw2.pixeladdr(i + 1, j + 1), v2);
 				}
 
 				for (int i = Width8; i < Width - 2; i++)
@@ -678,7 +754,7 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					_mm256_store_ps(w1.pixeladdr(i + 1, j), CalcWeightsFast(_mm256_load_ps(pw1.pixeladdr(i + 1, j)), _mm256_load_ps(qw1.pixeladdr(i + 1, j))));
+					Store(w1.pixeladdr(i + 1, j), CalcWeightsFast(Load(pw1.pixeladdr(i + 1, j)), Load(qw1.pixeladdr(i + 1, j))));
 				}
 
 				for (int i = Width8; i < Width - 2; i++)
@@ -695,7 +771,7 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					_mm256_store_ps(w2.pixeladdr(i + 2, j), CalcWeightsFast(_mm256_load_ps(pw2.pixeladdr(i + 2, j)), _mm256_load_ps(qw2.pixeladdr(i + 2, j))));
+					Store(w2.pixeladdr(i + 2, j), CalcWeightsFast(Load(pw2.pixeladdr(i + 2, j)), Load(qw2.pixeladdr(i + 2, j))));
 				}
 
 				for (int i = Width8; i < Width - 3; i++)
@@ -734,13 +810,13 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 w = _mm256_load_ps(w1.pixeladdr(i + 1, j + 2));
+					__m256 w = Load(w1.pixeladdr(i + 1, j + 2));
 					__m256 dw = _mm256_sub_ps(ONES, w);
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i + 1, j)), _mm256_loadu_ps(r11.pixeladdr(i + 1, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i, j + 2)), _mm256_loadu_ps(r00.pixeladdr(i + 3, j + 2)));
+					__m256 v0 = _mm256_add_ps(LoadU(r11.pixeladdr(i + 1, j)), LoadU(r11.pixeladdr(i + 1, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(r00.pixeladdr(i, j + 2)), LoadU(r00.pixeladdr(i + 3, j + 2)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel2[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel2[3]));
@@ -749,11 +825,11 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(r00.pixeladdr(i + 2, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 1, j + 3)), _mm256_loadu_ps(r00.pixeladdr(i + 2, j + 3))));
+					__m256 v1 = _mm256_add_ps(_mm256_add_ps(LoadU(r00.pixeladdr(i + 1, j + 1)), LoadU(r00.pixeladdr(i + 2, j + 1))),
+						_mm256_add_ps(LoadU(r00.pixeladdr(i + 1, j + 3)), LoadU(r00.pixeladdr(i + 2, j + 3))));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i, j + 1)), _mm256_loadu_ps(r11.pixeladdr(i + 2, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i, j + 2)), _mm256_loadu_ps(r11.pixeladdr(i + 2, j + 2))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(r11.pixeladdr(i, j + 1)), LoadU(r11.pixeladdr(i + 2, j + 1))),
+						_mm256_add_ps(LoadU(r11.pixeladdr(i, j + 2)), LoadU(r11.pixeladdr(i + 2, j + 2))));
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel2[1]));
 					__m256 s2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v2, w), _mm256_mul_ps(v1, dw)), _mm256_broadcast_ss(&kernel2[2]));
@@ -762,15 +838,15 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(r11.pixeladdr(i + 1, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps(r00.pixeladdr(i + 2, j + 2)));
+					__m256 v4 = _mm256_add_ps(LoadU(r11.pixeladdr(i + 1, j + 1)), LoadU(r11.pixeladdr(i + 1, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(r00.pixeladdr(i + 1, j + 2)), LoadU(r00.pixeladdr(i + 2, j + 2)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel2[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel2[5]));
 
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps(r10.pixeladdr(i + 1, j + 2), res);
+					StoreU(r10.pixeladdr(i + 1, j + 2), res);
 				}
 
 				for (int i = Width8; i < Width - 3; i++)
@@ -803,13 +879,13 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 w = _mm256_load_ps(w2.pixeladdr(i + 2, j + 1));
+					__m256 w = Load(w2.pixeladdr(i + 2, j + 1));
 					__m256 dw = _mm256_sub_ps(ONES, w);
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 2, j)), _mm256_loadu_ps(r00.pixeladdr(i + 2, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i, j + 1)), _mm256_loadu_ps(r11.pixeladdr(i + 3, j + 1)));
+					__m256 v0 = _mm256_add_ps(LoadU(r00.pixeladdr(i + 2, j)), LoadU(r00.pixeladdr(i + 2, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(r11.pixeladdr(i, j + 1)), LoadU(r11.pixeladdr(i + 3, j + 1)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel2[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel2[3]));
@@ -818,11 +894,11 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i + 1, j)), _mm256_loadu_ps(r11.pixeladdr(i + 2, j))),
-						_mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps(r11.pixeladdr(i + 2, j + 2))));
+					__m256 v1 = _mm256_add_ps(_mm256_add_ps(LoadU(r11.pixeladdr(i + 1, j)), LoadU(r11.pixeladdr(i + 2, j))),
+						_mm256_add_ps(LoadU(r11.pixeladdr(i + 1, j + 2)), LoadU(r11.pixeladdr(i + 2, j + 2))));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(r00.pixeladdr(i + 3, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps(r00.pixeladdr(i + 3, j + 2))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(r00.pixeladdr(i + 1, j + 1)), LoadU(r00.pixeladdr(i + 3, j + 1))),
+						_mm256_add_ps(LoadU(r00.pixeladdr(i + 1, j + 2)), LoadU(r00.pixeladdr(i + 3, j + 2))));
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel2[1]));
 					__m256 s2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v2, w), _mm256_mul_ps(v1, dw)), _mm256_broadcast_ss(&kernel2[2]));
@@ -831,15 +907,15 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps(r00.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps(r00.pixeladdr(i + 2, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps(r11.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps(r11.pixeladdr(i + 2, j + 1)));
+					__m256 v4 = _mm256_add_ps(LoadU(r00.pixeladdr(i + 2, j + 1)), LoadU(r00.pixeladdr(i + 2, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(r11.pixeladdr(i + 1, j + 1)), LoadU(r11.pixeladdr(i + 2, j + 1)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel2[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel2[5]));
 
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps(r01.pixeladdr(i + 2, j + 1), res);
+					StoreU(r01.pixeladdr(i + 2, j + 1), res);
 				}
 
 				for (int i = Width8; i < Width - 3; i++)
@@ -880,8 +956,8 @@ namespace ip
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i, j + 2)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 3, j + 2)));
+					__m256 v0 = _mm256_add_ps(LoadU(c11.pixeladdr(i + 1, j)), LoadU(c11.pixeladdr(i + 1, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(c00.pixeladdr(i, j + 2)), LoadU(c00.pixeladdr(i + 3, j + 2)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel2[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel2[3]));
@@ -890,11 +966,11 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 1, j + 3)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 3))));
+					__m256 v1 = _mm256_add_ps(_mm256_add_ps(LoadU(c00.pixeladdr(i + 1, j + 1)), LoadU(c00.pixeladdr(i + 2, j + 1))),
+						_mm256_add_ps(LoadU(c00.pixeladdr(i + 1, j + 3)), LoadU(c00.pixeladdr(i + 2, j + 3))));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i, j + 1)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 2, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i, j + 2)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 2, j + 2))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(c11.pixeladdr(i, j + 1)), LoadU(c11.pixeladdr(i + 2, j + 1))),
+						_mm256_add_ps(LoadU(c11.pixeladdr(i, j + 2)), LoadU(c11.pixeladdr(i + 2, j + 2))));
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel2[1]));
 					__m256 s2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v2, w), _mm256_mul_ps(v1, dw)), _mm256_broadcast_ss(&kernel2[2]));
@@ -903,15 +979,15 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 2)));
+					__m256 v4 = _mm256_add_ps(LoadU(c11.pixeladdr(i + 1, j + 1)), LoadU(c11.pixeladdr(i + 1, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(c00.pixeladdr(i + 1, j + 2)), LoadU(c00.pixeladdr(i + 2, j + 2)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel2[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel2[5]));
 
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps((float*)c10.pixeladdr(i + 1, j + 2), res);
+					StoreU(c10.pixeladdr(i + 1, j + 2), res);
 				}
 
 				for (int i = Width8; i < Width - 3; i++)
@@ -949,8 +1025,8 @@ namespace ip
 
 					// 0, 3
 
-					__m256 v0 = _mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 3)));
-					__m256 v3 = _mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i, j + 1)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 3, j + 1)));
+					__m256 v0 = _mm256_add_ps(LoadU(c00.pixeladdr(i + 2, j)), LoadU(c00.pixeladdr(i + 2, j + 3)));
+					__m256 v3 = _mm256_add_ps(LoadU(c11.pixeladdr(i, j + 1)), LoadU(c11.pixeladdr(i + 3, j + 1)));
 
 					__m256 s0 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v0, w), _mm256_mul_ps(v3, dw)), _mm256_broadcast_ss(&kernel2[0]));
 					__m256 s3 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v3, w), _mm256_mul_ps(v0, dw)), _mm256_broadcast_ss(&kernel2[3]));
@@ -959,11 +1035,11 @@ namespace ip
 
 					// 1, 2
 
-					__m256 v1 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 2, j))),
-						_mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 2, j + 2))));
+					__m256 v1 = _mm256_add_ps(_mm256_add_ps(LoadU(c11.pixeladdr(i + 1, j)), LoadU(c11.pixeladdr(i + 2, j))),
+						_mm256_add_ps(LoadU(c11.pixeladdr(i + 1, j + 2)), LoadU(c11.pixeladdr(i + 2, j + 2))));
 
-					__m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 3, j + 1))),
-						_mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 1, j + 2)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 3, j + 2))));
+					__m256 v2 = _mm256_add_ps(_mm256_add_ps(LoadU(c00.pixeladdr(i + 1, j + 1)), LoadU(c00.pixeladdr(i + 3, j + 1))),
+						_mm256_add_ps(LoadU(c00.pixeladdr(i + 1, j + 2)), LoadU(c00.pixeladdr(i + 3, j + 2))));
 
 					__m256 s1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v1, w), _mm256_mul_ps(v2, dw)), _mm256_broadcast_ss(&kernel2[1]));
 					__m256 s2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v2, w), _mm256_mul_ps(v1, dw)), _mm256_broadcast_ss(&kernel2[2]));
@@ -972,15 +1048,15 @@ namespace ip
 
 					// 4, 5
 
-					__m256 v4 = _mm256_add_ps(_mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 1)), _mm256_loadu_ps((const float*)c00.pixeladdr(i + 2, j + 2)));
-					__m256 v5 = _mm256_add_ps(_mm256_loadu_ps((const float*)c11.pixeladdr(i + 1, j + 1)), _mm256_loadu_ps((const float*)c11.pixeladdr(i + 2, j + 1)));
+					__m256 v4 = _mm256_add_ps(LoadU(c00.pixeladdr(i + 2, j + 1)), LoadU(c00.pixeladdr(i + 2, j + 2)));
+					__m256 v5 = _mm256_add_ps(LoadU(c11.pixeladdr(i + 1, j + 1)), LoadU(c11.pixeladdr(i + 2, j + 1)));
 
 					__m256 s4 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v4, w), _mm256_mul_ps(v5, dw)), _mm256_broadcast_ss(&kernel2[4]));
 					__m256 s5 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(v5, w), _mm256_mul_ps(v4, dw)), _mm256_broadcast_ss(&kernel2[5]));
 
 					res = _mm256_add_ps(res, _mm256_add_ps(s4, s5));
 
-					_mm256_storeu_ps((float*)c01.pixeladdr(i + 2, j + 1), res);
+					StoreU(c01.pixeladdr(i + 2, j + 1), res);
 
 				}
 
@@ -1015,22 +1091,22 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 8)
 				{
-					__m256 v00 = _mm256_load_ps(r00.pixeladdr(i, j));
-					__m256 v10 = _mm256_load_ps(r10.pixeladdr(i, j));
-					__m256 v01 = _mm256_load_ps(r01.pixeladdr(i, j));
-					__m256 v11 = _mm256_load_ps(r11.pixeladdr(i, j));
+					__m256 v00 = Load(r00.pixeladdr(i, j));
+					__m256 v10 = Load(r10.pixeladdr(i, j));
+					__m256 v01 = Load(r01.pixeladdr(i, j));
+					__m256 v11 = Load(r11.pixeladdr(i, j));
 
 					__m256 p0 = _mm256_unpacklo_ps(v00, v10);
 					__m256 p1 = _mm256_unpackhi_ps(v00, v10);
 
-					_mm256_store_ps(dst.pixeladdr(2 * i, 2 * j), _mm256_permute2f128_ps(p0, p1, 0x20));
-					_mm256_store_ps(dst.pixeladdr(2 * i + 8, 2 * j), _mm256_permute2f128_ps(p0, p1, 0x31));
+					Store(dst.pixeladdr(2 * i, 2 * j), _mm256_permute2f128_ps(p0, p1, 0x20));
+					Store(dst.pixeladdr(2 * i + 8, 2 * j), _mm256_permute2f128_ps(p0, p1, 0x31));
 
 					__m256 q0 = _mm256_unpacklo_ps(v01, v11);
 					__m256 q1 = _mm256_unpackhi_ps(v01, v11);
 
-					_mm256_store_ps(dst.pixeladdr(2 * i, 2 * j + 1), _mm256_permute2f128_ps(q0, q1, 0x20));
-					_mm256_store_ps(dst.pixeladdr(2 * i + 8, 2 * j + 1), _mm256_permute2f128_ps(q0, q1, 0x31));
+					Store(dst.pixeladdr(2 * i, 2 * j + 1), _mm256_permute2f128_ps(q0, q1, 0x20));
+					Store(dst.pixeladdr(2 * i + 8, 2 * j + 1), _mm256_permute2f128_ps(q0, q1, 0x31));
 
 				}
 
@@ -1052,16 +1128,16 @@ namespace ip
 
 				for (int i = 0; i < Width8; i += 2)
 				{
-					__m256 v00 = _mm256_load_ps((const float*)c00.pixeladdr(i, j));
-					__m256 v10 = _mm256_load_ps((const float*)c10.pixeladdr(i, j));
-					__m256 v01 = _mm256_load_ps((const float*)c01.pixeladdr(i, j));
-					__m256 v11 = _mm256_load_ps((const float*)c11.pixeladdr(i, j));
+					__m256 v00 = Load(c00.pixeladdr(i, j));
+					__m256 v10 = Load(c10.pixeladdr(i, j));
+					__m256 v01 = Load(c01.pixeladdr(i, j));
+					__m256 v11 = Load(c11.pixeladdr(i, j));
 
-					_mm256_store_ps((float*)dst.pixeladdr(2 * i, 2 * j), _mm256_permute2f128_ps(v00, v10, 0x20));
-					_mm256_store_ps((float*)dst.pixeladdr(2 * i + 2, 2 * j), _mm256_permute2f128_ps(v00, v10, 0x31));
+					Store(dst.pixeladdr(2 * i, 2 * j), _mm256_permute2f128_ps(v00, v10, 0x20));
+					Store(dst.pixeladdr(2 * i + 2, 2 * j), _mm256_permute2f128_ps(v00, v10, 0x31));
 
-					_mm256_store_ps((float*)dst.pixeladdr(2 * i, 2 * j + 1), _mm256_permute2f128_ps(v01, v11, 0x20));
-					_mm256_store_ps((float*)dst.pixeladdr(2 * i + 2, 2 * j + 1), _mm256_permute2f128_ps(v01, v11, 0x31));
+					Store(dst.pixeladdr(2 * i, 2 * j + 1), _mm256_permute2f128_ps(v01, v11, 0x20));
+					Store(dst.pixeladdr(2 * i + 2, 2 * j + 1), _mm256_permute2f128_ps(v01, v11, 0x31));
 
 				}
 
@@ -1130,7 +1206,7 @@ namespace ip
 				r01(Width - 1, j) = (src(Width - 1, j) + src(Width - 1, j + 1)) * 0.5f;
 
 				r10(0, j) = (src(0, j) + src(1, j)) * 0.5f;
-				r10(Width - 2, j) = (src(Width - 2, j) + src(Width - 11, j)) * 0.5f;
+				r10(Width - 2, j) = (src(Width - 2, j) + src(Width - 1, j)) * 0.5f;
 				r10(Width - 1, j) = src(Width - 1, j);
 
 				r11(0, j) = (r01(0, j) + r01(1, j)) * 0.5f;
@@ -1194,7 +1270,7 @@ namespace ip
 				c01(Width - 1, j) = (src(Width - 1, j) + src(Width - 1, j + 1)) * 0.5f;
 
 				c10(0, j) = (src(0, j) + src(1, j)) * 0.5f;
-				c10(Width - 2, j) = (src(Width - 2, j) + src(Width - 11, j)) * 0.5f;
+				c10(Width - 2, j) = (src(Width - 2, j) + src(Width - 1, j)) * 0.5f;
 				c10(Width - 1, j) = src(Width - 1, j);
 
 				c11(0, j) = (c01(0, j) + c01(1, j)) * 0.5f;
@@ -1203,7 +1279,7 @@ namespace ip
 			}
 		}
 
-		float& pixel (int x, int y)
+		PlaneType& pixel (int x, int y)
 		{
 			if ((y % 2) == 0)
 				if ((x % 2) == 0)
@@ -1281,6 +1357,11 @@ namespace ip
 			check(src.Width() == Width && src.Height() == Height);
 			check(dst.Width() == Width * 2 && dst.Height() == Height * 2);
 
+			Allocate(c00, Width, Height);
+			Allocate(c10, Width, Height);
+			Allocate(c01, Width, Height);
+			Allocate(c11, Width, Height);
+
 			InitBorders(src);
 
 			Step00(src);
@@ -1293,19 +1374,90 @@ namespace ip
 
 			MakeResult(dst);
 		}
+
+		/* Same steps as for the interleaved colour image, but each channel goes through the grayscale kernels,
+		* exchanged into r00..r11 in turn. The weights are calculated from the luminance, as above */
+		void Perform(const PlanarImage<float, 3> &src, PlanarImage<float, 3> &dst)
+		{
+			check(src.Width() == Width && src.Height() == Height);
+			check(dst.Width() == Width * 2 && dst.Height() == Height * 2);
+
+			Image<PlaneType> p00[3], p10[3], p01[3], p11[3];
+
+			for (int c = 0; c < 3; c++)
+			{
+				Image<PlaneType> i00(Width, Height), i10(Width, Height), i01(Width, Height), i11(Width, Height);
+				p00[c].swap(i00);
+				p10[c].swap(i10);
+				p01[c].swap(i01);
+				p11[c].swap(i11);
+			}
+
+			auto exchange = [&](int c)
+			{
+				Exchange(r00, p00[c]);
+				Exchange(r10, p10[c]);
+				Exchange(r01, p01[c]);
+				Exchange(r11, p11[c]);
+			};
+
+			for (int c = 0; c < 3; c++)
+			{
+				exchange(c);
+				InitBorders(src.Plane(c));
+				Step00(src.Plane(c));
+				exchange(c);
+			}
+
+			ToGrayScale(p00, r00);
+			CalcWeights1(r00);
+
+			for (int c = 0; c < 3; c++)
+			{
+				exchange(c);
+				Step11(src.Plane(c));
+				exchange(c);
+			}
+
+			ToGrayScale(p11, r11);
+			CalcWeights2();
+
+			for (int c = 0; c < 3; c++)
+			{
+				exchange(c);
+				Step2();
+				MakeResult(dst.Plane(c));
+				exchange(c);
+			}
+		}
 	};
 
 	// ==============================================================================
 
-	bool EDR_Resampling_x2(const ip::Image<float> &src, ip::Image<float> &dst)
+	// The half-precision planes need F16C, which comes with the AVX2 kernel set
+	template <class SourceImageType, class DestinationImageType>
+	static bool PerformEDR(const SourceImageType &src, DestinationImageType &dst, EDRPrecision precision)
 	{
-		EDRFast(src.Width(), src.Height()).Perform(src, dst);
+		if (precision == EDRPrecision::Half && GetCpuIsa() >= CpuIsa::AVX2)
+			EDRFast<PixelHalf, PixelHalfRGBA>(src.Width(), src.Height()).Perform(src, dst);
+		else
+			EDRFast<>(src.Width(), src.Height()).Perform(src, dst);
+
 		return true;
 	}
 
-	bool EDR_Resampling_x2(const ip::ImageFloatColor &src, ip::ImageFloatColor &dst)
+	bool EDR_Resampling_x2(const ip::Image<float> &src, ip::Image<float> &dst, EDRPrecision precision)
 	{
-		EDRFast(src.Width(), src.Height()).Perform(src, dst);
-		return true;
+		return PerformEDR(src, dst, precision);
+	}
+
+	bool EDR_Resampling_x2(const ip::ImageFloatColor &src, ip::ImageFloatColor &dst, EDRPrecision precision)
+	{
+		return PerformEDR(src, dst, precision);
+	}
+
+	bool EDR_Resampling_x2(const ip::PlanarImage<float, 3> &src, ip::PlanarImage<float, 3> &dst, EDRPrecision precision)
+	{
+		return PerformEDR(src, dst, precision);
 	}
 }
@@ -4,6 +4,14 @@
 
 namespace ip
 {
-	bool EDR_Resampling_x2(const ip::Image<float> &src, ip::Image<float> &dst);
-	bool EDR_Resampling_x2(const ip::ImageFloatColor &src, ip::ImageFloatColor &dst);
+	/* Half keeps the interpolated planes in FP16 (PixelHalf) and halves their memory traffic, the weights and
+	* the kernel sums stay in float. Needs F16C, Float is used on the processors without AVX2 */
+	enum class EDRPrecision { Float, Half };
+
+	// Source pixels around a region that EDR_Resampling_x2 reads to compute it, the halo for ProcessRegion
+	const int EDR_Halo = 4;
+
+	bool EDR_Resampling_x2(const ip::Image<float> &src, ip::Image<float> &dst, EDRPrecision precision = EDRPrecision::Float);
+	bool EDR_Resampling_x2(const ip::ImageFloatColor &src, ip::ImageFloatColor &dst, EDRPrecision precision = EDRPrecision::Float);
+	bool EDR_Resampling_x2(const ip::PlanarImage<float, 3> &src, ip::PlanarImage<float, 3> &dst, EDRPrecision precision = EDRPrecision::Float);
 }
\ No newline at end of file
@@ -1,28 +1,42 @@
 #pragma once
 
-#include <misc/vectorimage.h>
+#include <iplib/image/core.h>
+#include <misc/modelfile.h>
 
 namespace ip
 {
 	// Required padding: 3 pixels left/top amd 4 pixels right/bottom
 	class EDRVector
 	{
+	public:
+		// Kernel set for one instruction set, see misc/cpudispatch.h
 		class Impl;
 
-		Impl *impl;
+		/* Fixed16 keeps the planes in 16-bit fixed point and the kernels in Q12 and moves half the data of Float.
+		* The kernels with a coefficient of 8 or more in magnitude, or with the absolute sum of 16 or more, do not fit
+		* the 32-bit sums, Float is used then. See PerformFixed for the error bound */
+		enum class Precision { Float, Fixed16 };
 
-	public:
 		EDRVector();
 		~EDRVector();
 
-		ImageByteColor Perform(const ImageByteColor &lr);
+		// The kernels are few, so they are copied from the model
+		bool LoadModel(const ModelFile &model);
+		void SaveModel(ModelFileWriter &writer, ModelDataType type = ModelDataType::Float32) const;
+
+		/* The raw kernels written by 'train -method edr' (EDResampling::Kernels), the anisotropic kernels are not used.
+		* false if the data is not of that size */
+		bool LoadCoefficientData(void *buffer, size_t buffer_length);
 
-		void Perform(const VectorImageFloatColor &padded_lr, Image<VectorByte> &dst);
-		
-		void LearnStep1(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &hr);
+		ImageByteColor Perform(const ImageByteColor &lr, Precision precision = Precision::Float);
+
+		void LearnStep1(const ImageByteColor &lr, const ImageByteColor &hr);
 		void UpdateCoefficientsStep1();
 
-		void LearnStep2(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &hr);
+		void LearnStep2(const ImageByteColor &lr, const ImageByteColor &hr);
 		void UpdateCoefficientsStep2();
+
+	private:
+		Impl *impl;
 	};
-}
\ No newline at end of file
+}
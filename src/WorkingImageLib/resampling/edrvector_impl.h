@@ -0,0 +1,24 @@
+#pragma once
+
+#include "edrvector.h"
+
+namespace ip
+{
+	class EDRVector::Impl
+	{
+	public:
+		virtual ~Impl() {}
+
+		virtual ImageByteColor Perform(const ImageByteColor &lr, Precision precision) = 0;
+
+		virtual void LearnStep1(const ImageByteColor &lr, const ImageByteColor &hr) = 0;
+		virtual void UpdateCoefficientsStep1() = 0;
+
+		virtual void LearnStep2(const ImageByteColor &lr, const ImageByteColor &hr) = 0;
+		virtual void UpdateCoefficientsStep2() = 0;
+
+		virtual bool LoadCoefficientData(void *buffer, size_t buffer_length) = 0;
+		virtual bool LoadModel(const ModelFile &model) = 0;
+		virtual void SaveModel(ModelFileWriter &writer, ModelDataType type) const = 0;
+	};
+}
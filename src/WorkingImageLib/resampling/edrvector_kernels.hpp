@@ -0,0 +1,822 @@
+#include "edrvector_impl.h"
+
+#include <iplib/math/quadratic_optimization.h>
+#include <iplib/image/resampling/edresampling.h>
+#include <misc/blocksplit.h>
+#include <iplib/parallel.h>
+#include <atomic>
+#include <mutex>
+#include <math.h>
+#include <string.h>
+
+ #include <Windows.h>
+
+namespace ip { inline namespace IP_SIMD_NAMESPACE
+{
+	class EDRVectorKernels
+		: public EDRVector::Impl
+	{
+	public:
+		ImageByteColor Perform(const ImageByteColor &lr, EDRVector::Precision precision) override final;
+
+		// The result is written straight into the destination of res, no Image<VectorByte> is built
+		void Perform(const VectorImageFloatColor &padded_lr, const BlockSplit::Writer &res);
+
+		// The kernels in Q12, kernel1s and kernel2s are kernel1 and kernel2 with the mirrored terms swapped
+		struct FixedKernels
+		{
+			short kernel0[6], kernel1[6], kernel1s[6], kernel2[6], kernel2s[6];
+		};
+
+		/* Fixed-point version of Perform, the planes are VectorShortColor. The samples are rounded to 1/16, the kernels
+		* to 1/4096 and the weights to 1/32768. Against Perform the first two steps differ by at most
+		* sum(n[t] |k[t]|) / 32 + sum(n[t]) * 255 / 8192 + 1/32 in every of Y, U, V, where n[t] is the number of the samples
+		* summed for the term t, plus 1/32 for the weighted step 1. Step 2 adds its own error to that of its sources weighted
+		* by sum(n[t] |k[t]|). The default kernels give at most 0.9 for the first two steps and 2.3 for the third one, not
+		* counting the weights, which are computed from the rounded differences */
+		void PerformFixed(const VectorImageShortColor &padded_lr, const FixedKernels &kernels, const BlockSplit::Writer &res);
+
+		/* False when a kernel does not fit: a coefficient should be below 8 in magnitude to fit Q12 and, as the samples are
+		* below 2^15, the absolute sum should be below 16 to fit the 32-bit sums */
+		bool QuantizeKernels(FixedKernels &res) const;
+
+		void LearnStep1(const ImageByteColor &lr, const ImageByteColor &hr) override final;
+		void UpdateCoefficientsStep1() override final;
+
+		void LearnStep2(const ImageByteColor &lr, const ImageByteColor &hr) override final;
+		void UpdateCoefficientsStep2() override final;
+
+		bool LoadCoefficientData(void *buffer, size_t buffer_length) override final;
+		bool LoadModel(const ModelFile &model) override final;
+		void SaveModel(ModelFileWriter &writer, ModelDataType type) const override final;
+
+	private:
+		float kernel0[6] = { -0.00063f, -0.00180f, 0.02694f, 0.01716f, -0.15097f, 1.45306f };
+		float kernel1[6] = { 0.03297f, -0.04665f, -0.04484f, -0.05382f, 0.12650f, 0.58139f };
+		float kernel2[6] = { -0.03016f, -0.04952f, -0.05838f, 0.04283f, 0.45204f, 0.25095f };
+		float WeightThreshold = 1.25f;
+
+		QuadraticOptimization opt0, opt1, opt2;
+
+		const static VectorFloat REDQ, GREENQ, BLUEQ, ONE;
+		const static VectorFloat SIGNMASK;
+
+		// The input padding is 3 pixels left/top and 4 pixels right/bottom, the output padding is twice as large
+		static const int PaddingLeftTop = 3, PaddingRightBottom = 4;
+
+		// The learning samples are taken at least this number of pixels away from the edges of the high resolution image
+		static const int LearningMargin = 8;
+
+		class Accumulator;
+		class SampleMask;
+
+	private:
+
+		// res may be null when only dst is needed
+		void ProcessStep0(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &dst, const BlockSplit::Writer *res);
+		void ProcessStep1(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &dst, const BlockSplit::Writer *res);
+		void ProcessStep2(VectorImageFloatColor &dst, const BlockSplit::Writer &res);
+
+		static void CalcDirectionsStep1(const VectorImageFloatColor &padded_lr, VectorImageFloat &dir1, VectorImageFloat &dir2);
+		static void CalcDirectionsStep2(const VectorImageFloatColor &dst, VectorImageFloat &dir1, VectorImageFloat &dir2);
+
+		static void ConfigureSplit(BlockSplit &bs, int Width, int Height);
+
+		// The reference image split the same way as the 2x vector image, so ref(x, y) corresponds to dst(x, y)
+		static VectorImageFloatColor SplitReference(const BlockSplit &bs, const VectorImageFloatColor &padded_lr, const ImageByteColor &hr);
+
+		void ProcessStep0Fixed(const VectorImageShortColor &padded_lr, VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res);
+		void ProcessStep1Fixed(const VectorImageShortColor &padded_lr, VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res);
+		void ProcessStep2Fixed(const VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res);
+
+		// The fractional bits of the quantized kernels
+		static const int KernelBits = 12;
+
+		// Sum of v[t] * k[t] rounded to VectorShortColor::FractionBits
+		inline static VectorShort DotFixed(const VectorShort (&v)[6], const short (&k)[6]);
+		inline static VectorShortColor DotFixed(const VectorShortColor (&v)[6], const short (&k)[6]);
+
+		// w * dot(v, k) + (1 - w) * dot(v, ks) with w in Q15, the form of the weighted steps
+		inline static VectorShortColor BlendFixed(const VectorShortColor (&v)[6], const short (&k)[6], const short (&ks)[6], VectorShort w);
+
+		// The weights in Q15, p and q are the sums of the direction images holding the differences at 1/8
+		inline static VectorShort CalcWeightsFixed(VectorShort p, VectorShort q);
+
+		inline static VectorFloat CalcWeights(VectorFloat p, VectorFloat q);
+
+		inline static VectorFloat abs(VectorFloat value);
+		inline static VectorFloat AverageNormal3x3(const VectorImageFloat &img, int x, int y);
+		inline static VectorFloat AverageAbnormal3x3_dir1(const VectorImageFloatColor &img, int x, int y);
+		inline static VectorFloat AverageDiag3x3(const VectorImageFloat &img, int x, int y);
+		inline static VectorShort AverageNormal3x3(const VectorImageShort &img, int x, int y);
+		inline static VectorShort AverageDiag3x3(const VectorImageShort &img, int x, int y);
+	};
+
+	// ==================================================================================================
+
+	/* Normal equations of a kernel of 6 coefficients. Every lane sums the samples of its own block, the float sums are
+	* moved to the double totals by Flush after each row, so the precision does not depend on the image size */
+	class EDRVectorKernels::Accumulator
+	{
+	public:
+		static const int N = 6;
+
+		Accumulator()
+		{
+			Reset();
+			memset(A, 0, sizeof(A));
+			memset(B, 0, sizeof(B));
+		}
+
+		// The lanes outside mask are skipped
+		void Add(const VectorFloat (&q)[N], VectorFloat v, VectorFloat mask)
+		{
+			VectorFloat m[N];
+
+			for (int p = 0; p < N; p++)
+				m[p] = q[p] & mask;
+
+			for (int p = 0; p < N; p++)
+			{
+				for (int r = p; r < N; r++)
+					a[p * N + r] = a[p * N + r] + m[p] * m[r];
+
+				b[p] = b[p] + m[p] * v;
+			}
+
+			count = count + (ONE & mask);
+		}
+
+		void Flush()
+		{
+			for (int k = 0; k < VectorFloat::size; k++)
+			{
+				for (int p = 0; p < N; p++)
+				{
+					for (int r = p; r < N; r++)
+						A[p * N + r] += a[p * N + r].get(k);
+
+					B[p] += b[p].get(k);
+				}
+
+				total += (int)count.get(k);
+			}
+
+			Reset();
+		}
+
+		void AddTo(QuadraticOptimization &opt) const
+		{
+			if (total > 0)
+				opt.AddNormalEquations(A, B, N, total);
+		}
+
+	private:
+		VectorFloat a[N * N], b[N], count;
+		double A[N * N], B[N];
+		int total = 0;
+
+		void Reset()
+		{
+			for (int p = 0; p < N * N; p++)
+				a[p] = VectorFloat::zero();
+
+			for (int p = 0; p < N; p++)
+				b[p] = VectorFloat::zero();
+
+			count = VectorFloat::zero();
+		}
+	};
+
+	/* Selects the lanes of a pixel of the 2x vector image whose high resolution pixel lies inside Width x Height at least
+	* Margin pixels away from the edges. The pixels of the output padding are never selected, they repeat the neighbour blocks */
+	class EDRVectorKernels::SampleMask
+	{
+	public:
+		SampleMask(const BlockSplit::Geometry &g, int Width, int Height, int Margin)
+			: BlockWidth(g.BlockWidth * 2), BlockHeight(g.BlockHeight * 2),
+			left((float)(Margin - 1)), top((float)(Margin - 1)), right((float)(Width - Margin)), bottom((float)(Height - Margin))
+		{
+			float x[VectorFloat::size], y[VectorFloat::size];
+
+			for (int k = 0; k < VectorFloat::size; k++)
+			{
+				x[k] = (float)(BlockWidth * (k % g.HorzBlocks) - PaddingLeftTop * 2);
+				y[k] = (float)(BlockHeight * (k / g.HorzBlocks) - PaddingLeftTop * 2);
+			}
+
+			x0 = VectorFloat::loadu(x);
+			y0 = VectorFloat::loadu(y);
+		}
+
+		VectorFloat operator()(int x, int y) const
+		{
+			if (x < PaddingLeftTop * 2 || y < PaddingLeftTop * 2 || x >= PaddingLeftTop * 2 + BlockWidth || y >= PaddingLeftTop * 2 + BlockHeight)
+				return VectorFloat::zero();
+
+			VectorFloat hx = x0 + VectorFloat((float)x);
+			VectorFloat hy = y0 + VectorFloat((float)y);
+
+			return hx.compare_gt_ord_ns(left) & hx.compare_lt_ord_ns(right) & hy.compare_gt_ord_ns(top) & hy.compare_lt_ord_ns(bottom);
+		}
+
+	private:
+		int BlockWidth, BlockHeight;
+		VectorFloat left, top, right, bottom;
+		VectorFloat x0, y0;
+	};
+
+	// ==================================================================================================
+
+	const VectorFloat EDRVectorKernels::REDQ(0.299f);
+	const VectorFloat EDRVectorKernels::GREENQ(0.587f);
+	const VectorFloat EDRVectorKernels::BLUEQ(0.114f);
+	const VectorFloat EDRVectorKernels::ONE(1.0f);
+#if defined(LEGACY)
+	const VectorFloat EDRVectorKernels::SIGNMASK(_mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+#elif defined(AVX512)
+	const VectorFloat EDRVectorKernels::SIGNMASK(_mm512_castsi512_ps(_mm512_set1_epi32(0x7FFFFFFF)));
+#else
+	const VectorFloat EDRVectorKernels::SIGNMASK(_mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)));
+#endif
+
+	void EDRVectorKernels::Perform(const VectorImageFloatColor &padded_lr, const BlockSplit::Writer &res)
+	{
+		VectorImageFloatColor dst(padded_lr.Width() * 2, padded_lr.Height() * 2);
+
+		ProcessStep0(padded_lr, dst, &res);
+		ProcessStep1(padded_lr, dst, &res);
+		ProcessStep2(dst, res);
+	}
+
+	void EDRVectorKernels::ConfigureSplit(BlockSplit &bs, int Width, int Height)
+	{
+		bs.SetInputPadding(BlockSplitConfiguration(PaddingLeftTop, PaddingLeftTop, PaddingRightBottom, PaddingRightBottom), BlockSplitPaddingMode::Duplicate);
+		bs.SetOutputPadding(BlockSplitConfiguration(PaddingLeftTop * 2, PaddingLeftTop * 2, PaddingRightBottom * 2, PaddingRightBottom * 2));
+		bs.ComputeSplitLayout(Width, Height);
+	}
+
+	VectorImageFloatColor EDRVectorKernels::SplitReference(const BlockSplit &bs, const VectorImageFloatColor &padded_lr, const ImageByteColor &hr)
+	{
+		BlockSplit hs;
+		hs.SetInputPadding(BlockSplitConfiguration(PaddingLeftTop * 2, PaddingLeftTop * 2, PaddingRightBottom * 2, PaddingRightBottom * 2), BlockSplitPaddingMode::Duplicate);
+		hs.SetSplitLayout(bs.GetSplitLayout());
+
+		return hs.Split(hr, (padded_lr.Width() - PaddingLeftTop - PaddingRightBottom) * 2, (padded_lr.Height() - PaddingLeftTop - PaddingRightBottom) * 2);
+	}
+
+	/* The samples are the luma of the terms weighted by kernel0 and kernel1 against the luma of the reference. The 8 or
+	* 16 blocks of the vector image are accumulated at once, see Accumulator */
+	void EDRVectorKernels::LearnStep1(const ImageByteColor &lr, const ImageByteColor &hr)
+	{
+		check(hr.Width() >= lr.Width() * 2 && hr.Height() >= lr.Height() * 2);
+
+		BlockSplit bs;
+		ConfigureSplit(bs, lr.Width(), lr.Height());
+
+		VectorImageFloatColor padded_lr = bs.Split(lr);
+		VectorImageFloatColor ref = SplitReference(bs, padded_lr, hr);
+		SampleMask mask(bs.GetGeometry(lr.Width(), lr.Height()), lr.Width() * 2, lr.Height() * 2, LearningMargin);
+
+		std::mutex lock;
+
+		Parallel::For([&padded_lr, &ref, &mask, &lock, this](std::atomic_int &counter)
+		{
+			Accumulator acc;
+
+			for (int j = counter++; j < padded_lr.Height() - 2; j = counter++)
+			{
+				for (int i = 2; i < padded_lr.Width() - 2; i++)
+				{
+					VectorFloat q[6] =
+					{
+						padded_lr(i - 2, j - 2).y + padded_lr(i + 2, j - 2).y + padded_lr(i - 2, j + 2).y + padded_lr(i + 2, j + 2).y,
+						padded_lr(i - 1, j - 2).y + padded_lr(i + 1, j - 2).y + padded_lr(i - 2, j - 1).y + padded_lr(i + 2, j - 1).y +
+							padded_lr(i - 2, j + 1).y + padded_lr(i + 2, j + 1).y + padded_lr(i - 1, j + 2).y + padded_lr(i + 1, j + 2).y,
+						padded_lr(i, j - 2).y + padded_lr(i - 2, j).y + padded_lr(i + 2, j).y + padded_lr(i, j + 2).y,
+						padded_lr(i - 1, j - 1).y + padded_lr(i + 1, j - 1).y + padded_lr(i - 1, j + 1).y + padded_lr(i + 1, j + 1).y,
+						padded_lr(i, j - 1).y + padded_lr(i - 1, j).y + padded_lr(i + 1, j).y + padded_lr(i, j + 1).y,
+						padded_lr(i, j).y
+					};
+
+					acc.Add(q, ref(i * 2, j * 2).y, mask(i * 2, j * 2));
+				}
+
+				acc.Flush();
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			acc.AddTo(opt0);
+		}, 2);
+
+		VectorImageFloat dir1(padded_lr.Width() - 1, padded_lr.Height() - 1);
+		VectorImageFloat dir2(padded_lr.Width() - 1, padded_lr.Height() - 1);
+		CalcDirectionsStep1(padded_lr, dir1, dir2);
+
+		Parallel::For([&padded_lr, &ref, &mask, &dir1, &dir2, &lock, this](std::atomic_int &counter)
+		{
+			Accumulator acc;
+
+			for (int j = counter++; j < padded_lr.Height() - 3; j = counter++)
+			{
+				for (int i = 0; i < padded_lr.Width() - 3; i++)
+				{
+					VectorFloat w = CalcWeights(AverageNormal3x3(dir1, i + 1, j + 1), AverageNormal3x3(dir2, i + 1, j + 1));
+					VectorFloat dw = ONE - w;
+
+					VectorFloat v0 = padded_lr(i, j).y + padded_lr(i + 3, j + 3).y;
+					VectorFloat v1 = padded_lr(i + 1, j).y + padded_lr(i, j + 1).y + padded_lr(i + 3, j + 2).y + padded_lr(i + 2, j + 3).y;
+					VectorFloat v2 = padded_lr(i + 2, j).y + padded_lr(i, j + 2).y + padded_lr(i + 3, j + 1).y + padded_lr(i + 1, j + 3).y;
+					VectorFloat v3 = padded_lr(i + 3, j).y + padded_lr(i, j + 3).y;
+					VectorFloat v4 = padded_lr(i + 1, j + 1).y + padded_lr(i + 2, j + 2).y;
+					VectorFloat v5 = padded_lr(i + 1, j + 2).y + padded_lr(i + 2, j + 1).y;
+
+					VectorFloat q[6] = { v0 * w + v3 * dw, v1 * w + v2 * dw, v2 * w + v1 * dw, v3 * w + v0 * dw, v4 * w + v5 * dw, v5 * w + v4 * dw };
+
+					acc.Add(q, ref(i * 2 + 3, j * 2 + 3).y, mask(i * 2 + 3, j * 2 + 3));
+				}
+
+				acc.Flush();
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			acc.AddTo(opt1);
+		});
+	}
+
+	void EDRVectorKernels::UpdateCoefficientsStep1()
+	{
+		opt0.CalcOptimizedCoefficients(kernel0);
+		opt1.CalcOptimizedCoefficients(kernel1);
+	}
+
+	// The pixels of the first two steps are interpolated with the current kernel0 and kernel1
+	void EDRVectorKernels::LearnStep2(const ImageByteColor &lr, const ImageByteColor &hr)
+	{
+		check(hr.Width() >= lr.Width() * 2 && hr.Height() >= lr.Height() * 2);
+
+		BlockSplit bs;
+		ConfigureSplit(bs, lr.Width(), lr.Height());
+
+		VectorImageFloatColor padded_lr = bs.Split(lr);
+		VectorImageFloatColor ref = SplitReference(bs, padded_lr, hr);
+		SampleMask mask(bs.GetGeometry(lr.Width(), lr.Height()), lr.Width() * 2, lr.Height() * 2, LearningMargin);
+
+		VectorImageFloatColor dst(padded_lr.Width() * 2, padded_lr.Height() * 2);
+		ProcessStep0(padded_lr, dst, nullptr);
+		ProcessStep1(padded_lr, dst, nullptr);
+
+		VectorImageFloat dir1(dst.Width() - 9, dst.Height() - 9);
+		VectorImageFloat dir2(dst.Width() - 9, dst.Height() - 9);
+		CalcDirectionsStep2(dst, dir1, dir2);
+
+		std::mutex lock;
+
+		Parallel::For([&dst, &ref, &mask, &dir1, &dir2, &lock, this](std::atomic_int &counter)
+		{
+			Accumulator acc;
+
+			for (int j = counter++; j < dst.Height() - 8; j = counter++)
+			{
+				for (int i = 7 - (j % 2); i < dst.Width() - 8; i += 2)
+				{
+					VectorFloat w = CalcWeights(AverageDiag3x3(dir1, i - 4, j - 4), AverageDiag3x3(dir2, i - 4, j - 4));
+					VectorFloat dw = ONE - w;
+
+					VectorFloat v0 = dst(i, j - 3).y + dst(i, j + 3).y;
+					VectorFloat v1 = dst(i - 1, j - 2).y + dst(i + 1, j - 2).y + dst(i - 1, j + 2).y + dst(i + 1, j + 2).y;
+					VectorFloat v2 = dst(i - 2, j - 1).y + dst(i + 2, j - 1).y + dst(i - 2, j + 1).y + dst(i + 2, j + 1).y;
+					VectorFloat v3 = dst(i - 3, j).y + dst(i + 3, j).y;
+					VectorFloat v4 = dst(i, j - 1).y + dst(i, j + 1).y;
+					VectorFloat v5 = dst(i - 1, j).y + dst(i + 1, j).y;
+
+					VectorFloat q[6] = { v0 * w + v3 * dw, v1 * w + v2 * dw, v2 * w + v1 * dw, v3 * w + v0 * dw, v4 * w + v5 * dw, v5 * w + v4 * dw };
+
+					acc.Add(q, ref(i, j).y, mask(i, j));
+				}
+
+				acc.Flush();
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			acc.AddTo(opt2);
+		}, 6);
+	}
+
+	void EDRVectorKernels::UpdateCoefficientsStep2()
+	{
+		opt2.CalcOptimizedCoefficients(kernel2);
+	}
+
+	void EDRVectorKernels::ProcessStep0(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &dst, const BlockSplit::Writer *res)
+	{
+		Parallel::For(2, padded_lr.Height() - 2, [&padded_lr, &dst, &res, this](int j)
+		{
+			for (int i = 2; i < padded_lr.Width() - 2; i++)
+			{
+				VectorFloatColor v0 = padded_lr(i - 2, j - 2) + padded_lr(i + 2, j - 2) + padded_lr(i - 2, j + 2) + padded_lr(i + 2, j + 2);
+				VectorFloatColor v1 = padded_lr(i - 1, j - 2) + padded_lr(i + 1, j - 2) + padded_lr(i - 2, j - 1) + padded_lr(i + 2, j - 1) +
+					padded_lr(i - 2, j + 1) + padded_lr(i + 2, j + 1) + padded_lr(i - 1, j + 2) + padded_lr(i + 1, j + 2);
+				VectorFloatColor v2 = padded_lr(i, j - 2) + padded_lr(i - 2, j) + padded_lr(i + 2, j) + padded_lr(i, j + 2);
+				VectorFloatColor v3 = padded_lr(i - 1, j - 1) + padded_lr(i + 1, j - 1) + padded_lr(i - 1, j + 1) + padded_lr(i + 1, j + 1);
+				VectorFloatColor v4 = padded_lr(i, j - 1) + padded_lr(i - 1, j) + padded_lr(i + 1, j) + padded_lr(i, j + 1);
+				VectorFloatColor v5 = padded_lr(i, j);
+
+				VectorFloatColor c = v0 * kernel0[0] + v1 * kernel0[1] + v2 * kernel0[2] + v3 * kernel0[3] + v4 * kernel0[4] + v5 * kernel0[5];
+
+				dst(i * 2, j * 2) = c;
+
+				if (res != nullptr)
+					res->Store(i * 2, j * 2, c.ToByte());
+			}
+		});
+	}
+
+	VectorFloat EDRVectorKernels::AverageNormal3x3(const VectorImageFloat &img, int x, int y)
+	{
+		return img(x - 1, y - 1) + img(x, y - 1) + img(x + 1, y - 1) + img(x - 1, y) + img(x, y) + img(x + 1, y) + img(x - 1, y + 1) + img(x, y + 1) + img(x + 1, y + 1);
+	}
+
+	VectorFloat EDRVectorKernels::AverageDiag3x3(const VectorImageFloat &img, int x, int y)
+	{
+		return img(x, y - 2) + img(x - 1, y - 1) + img(x + 1, y - 1) + img(x - 2, y) + img(x, y) + img(x + 2, y) + img(x - 1, y + 1) + img(x + 1, y + 1) + img(x, y + 2);
+	}
+
+	VectorShort EDRVectorKernels::AverageNormal3x3(const VectorImageShort &img, int x, int y)
+	{
+		return img(x - 1, y - 1) + img(x, y - 1) + img(x + 1, y - 1) + img(x - 1, y) + img(x, y) + img(x + 1, y) + img(x - 1, y + 1) + img(x, y + 1) + img(x + 1, y + 1);
+	}
+
+	VectorShort EDRVectorKernels::AverageDiag3x3(const VectorImageShort &img, int x, int y)
+	{
+		return img(x, y - 2) + img(x - 1, y - 1) + img(x + 1, y - 1) + img(x - 2, y) + img(x, y) + img(x + 2, y) + img(x - 1, y + 1) + img(x + 1, y + 1) + img(x, y + 2);
+	}
+
+	void EDRVectorKernels::CalcDirectionsStep1(const VectorImageFloatColor &padded_lr, VectorImageFloat &dir1, VectorImageFloat &dir2)
+	{
+		Parallel::For(1, padded_lr.Height(), [&padded_lr, &dir1, &dir2](int j)
+		{
+			for (int i = 1; i < padded_lr.Width(); i++)
+			{
+				dir1(i - 1, j - 1) = abs(padded_lr(i, j).y - padded_lr(i - 1, j - 1).y);
+				dir2(i - 1, j - 1) = abs(padded_lr(i - 1, j).y - padded_lr(i, j - 1).y);
+			}
+		});
+	}
+
+	void EDRVectorKernels::ProcessStep1(const VectorImageFloatColor &padded_lr, VectorImageFloatColor &dst, const BlockSplit::Writer *res)
+	{
+		VectorImageFloat dir1(padded_lr.Width() - 1, padded_lr.Height() - 1);
+		VectorImageFloat dir2(padded_lr.Width() - 1, padded_lr.Height() - 1);
+		CalcDirectionsStep1(padded_lr, dir1, dir2);
+
+		Parallel::For(0, padded_lr.Height() - 3, [&padded_lr, &dst, &dir1, &dir2, &res, this](int j)
+		{
+			for (int i = 0; i < padded_lr.Width() - 3; i++)
+			{
+				// VectorFloat w = CalcWeights(AverageAbnormal3x3_dir1(padded_lr, i + 1, j + 1), AverageNormal3x3(dir2, i + 1, j + 1));
+				VectorFloat w = CalcWeights(AverageNormal3x3(dir1, i + 1, j + 1), AverageNormal3x3(dir2, i + 1, j + 1));
+				// VectorFloat w = CalcWeights(p1(i, j), p2(i, j));
+				VectorFloat dw = ONE - w;
+
+				VectorFloatColor v0 = padded_lr(i, j) + padded_lr(i + 3, j + 3);
+				VectorFloatColor v3 = padded_lr(i + 3, j) + padded_lr(i, j + 3);
+
+				VectorFloatColor res0 = (v0 * w + v3 * dw) * kernel1[0] + (v3 * w + v0 * dw) * kernel1[3];
+
+				VectorFloatColor v1 = padded_lr(i + 1, j) + padded_lr(i, j + 1) + padded_lr(i + 3, j + 2) + padded_lr(i + 2, j + 3);
+				VectorFloatColor v2 = padded_lr(i + 2, j) + padded_lr(i, j + 2) + padded_lr(i + 3, j + 1) + padded_lr(i + 1, j + 3);
+
+				VectorFloatColor res1 = (v1 * w + v2 * dw) * kernel1[1] + (v2 * w + v1 * dw) * kernel1[2];
+
+				VectorFloatColor v4 = padded_lr(i + 1, j + 1) + padded_lr(i + 2, j + 2);
+				VectorFloatColor v5 = padded_lr(i + 1, j + 2) + padded_lr(i + 2, j + 1);
+
+				VectorFloatColor res2 = (v4 * w + v5 * dw) * kernel1[4] + (v5 * w + v4 * dw) * kernel1[5];
+
+				VectorFloatColor c = res0 + res1 + res2;
+
+				dst(i * 2 + 3, j * 2 + 3) = c;
+
+				if (res != nullptr)
+					res->Store(i * 2 + 3, j * 2 + 3, c.ToByte());
+			}
+		});
+	}
+
+	void EDRVectorKernels::CalcDirectionsStep2(const VectorImageFloatColor &dst, VectorImageFloat &dir1, VectorImageFloat &dir2)
+	{
+		Parallel::For(4, dst.Height() - 5, [&dst, &dir1, &dir2](int j)
+		{
+			for (int i = 5 - (j % 2); i < dst.Width() - 5; i += 2)
+			{
+				dir1(i - 4, j - 4) = abs(dst(i + 1, j).y - dst(i - 1, j).y);
+				dir2(i - 4, j - 4) = abs(dst(i, j + 1).y - dst(i, j - 1).y);
+			}
+		});
+	}
+
+	void EDRVectorKernels::ProcessStep2(VectorImageFloatColor &dst, const BlockSplit::Writer &res)
+	{
+		VectorImageFloat dir1(dst.Width() - 9, dst.Height() - 9);
+		VectorImageFloat dir2(dst.Width() - 9, dst.Height() - 9);
+		CalcDirectionsStep2(dst, dir1, dir2);
+
+		Parallel::For(6, dst.Height() - 8, [&dst, &dir1, &dir2, &res, this](int j)
+		{
+			for (int i = 7 - (j % 2); i < dst.Width() - 8; i += 2)
+			{
+				VectorFloat w = CalcWeights(AverageDiag3x3(dir1, i - 4, j - 4), AverageDiag3x3(dir2, i - 4, j - 4));
+				VectorFloat dw = ONE - w;
+
+				VectorFloatColor v0 = dst(i, j - 3) + dst(i, j + 3);
+				VectorFloatColor v3 = dst(i - 3, j) + dst(i + 3, j);
+
+				VectorFloatColor res0 = (v0 * w + v3 * dw) * kernel2[0] + (v3 * w + v0 * dw) * kernel2[3];
+
+				VectorFloatColor v1 = dst(i - 1, j - 2) + dst(i + 1, j - 2) + dst(i - 1, j + 2) + dst(i + 1, j + 2);
+				VectorFloatColor v2 = dst(i - 2, j - 1) + dst(i + 2, j - 1) + dst(i - 2, j + 1) + dst(i + 2, j + 1);
+
+				VectorFloatColor res1 = (v1 * w + v2 * dw) * kernel2[1] + (v2 * w + v1 * dw) * kernel2[2];
+
+				VectorFloatColor v4 = dst(i, j - 1) + dst(i, j + 1);
+				VectorFloatColor v5 = dst(i - 1, j) + dst(i + 1, j);
+
+				VectorFloatColor res2 = (v4 * w + v5 * dw) * kernel2[4] + (v5 * w + v4 * dw) * kernel2[5];
+
+				VectorFloatColor c = res0 + res1 + res2;
+
+				// dst(i, j) = res;
+				res.Store(i, j, c.ToByte());
+			}
+		});
+	}
+
+	// ==================================================================================================
+
+	bool EDRVectorKernels::QuantizeKernels(FixedKernels &res) const
+	{
+		const float *src[3] = { kernel0, kernel1, kernel2 };
+		short *dst[3] = { res.kernel0, res.kernel1, res.kernel2 };
+
+		for (int n = 0; n < 3; n++)
+		{
+			float sum = 0.0f;
+
+			for (int t = 0; t < 6; t++)
+			{
+				float k = src[n][t] * (1 << KernelBits);
+
+				if (!(fabsf(k) < 32767.0f))
+					return false;
+
+				sum += fabsf(src[n][t]);
+				dst[n][t] = (short)lrintf(k);
+			}
+
+			if (!(sum < 16.0f))
+				return false;
+		}
+
+		static const int Mirror[6] = { 3, 2, 1, 0, 5, 4 };
+
+		for (int t = 0; t < 6; t++)
+		{
+			res.kernel1s[t] = res.kernel1[Mirror[t]];
+			res.kernel2s[t] = res.kernel2[Mirror[t]];
+		}
+
+		return true;
+	}
+
+	VectorShort EDRVectorKernels::DotFixed(const VectorShort (&v)[6], const short (&k)[6])
+	{
+		VectorInt sum = VectorShort::madd(v[0], v[1], k[0], k[1]) + VectorShort::madd(v[2], v[3], k[2], k[3]) + VectorShort::madd(v[4], v[5], k[4], k[5]);
+
+		return VectorShort::pack(sum.shift_round(KernelBits));
+	}
+
+	VectorShortColor EDRVectorKernels::DotFixed(const VectorShortColor (&v)[6], const short (&k)[6])
+	{
+		VectorShort y[6] = { v[0].y, v[1].y, v[2].y, v[3].y, v[4].y, v[5].y };
+		VectorShort u[6] = { v[0].u, v[1].u, v[2].u, v[3].u, v[4].u, v[5].u };
+		VectorShort w[6] = { v[0].v, v[1].v, v[2].v, v[3].v, v[4].v, v[5].v };
+
+		return VectorShortColor(DotFixed(y, k), DotFixed(u, k), DotFixed(w, k));
+	}
+
+	VectorShortColor EDRVectorKernels::BlendFixed(const VectorShortColor (&v)[6], const short (&k)[6], const short (&ks)[6], VectorShort w)
+	{
+		VectorShortColor a = DotFixed(v, k);
+		VectorShortColor b = DotFixed(v, ks);
+
+		return VectorShortColor(b.y + (a.y - b.y).mul_hrs(w), b.u + (a.u - b.u).mul_hrs(w), b.v + (a.v - b.v).mul_hrs(w));
+	}
+
+	VectorShort EDRVectorKernels::CalcWeightsFixed(VectorShort p, VectorShort q)
+	{
+		static const VectorFloat SCALE(1.0f / (1 << (VectorShortColor::FractionBits - 1)));
+		static const VectorFloat Q15(32767.0f);
+
+		return VectorShort::pack((CalcWeights(p.convert_f32() * SCALE, q.convert_f32() * SCALE) * Q15).conv_i32());
+	}
+
+	void EDRVectorKernels::PerformFixed(const VectorImageShortColor &padded_lr, const FixedKernels &kernels, const BlockSplit::Writer &res)
+	{
+		VectorImageShortColor dst(padded_lr.Width() * 2, padded_lr.Height() * 2);
+
+		ProcessStep0Fixed(padded_lr, dst, kernels, res);
+		ProcessStep1Fixed(padded_lr, dst, kernels, res);
+		ProcessStep2Fixed(dst, kernels, res);
+	}
+
+	void EDRVectorKernels::ProcessStep0Fixed(const VectorImageShortColor &padded_lr, VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res)
+	{
+		Parallel::For(2, padded_lr.Height() - 2, [&padded_lr, &dst, &kernels, &res](int j)
+		{
+			for (int i = 2; i < padded_lr.Width() - 2; i++)
+			{
+				VectorShortColor v[6] =
+				{
+					padded_lr(i - 2, j - 2) + padded_lr(i + 2, j - 2) + padded_lr(i - 2, j + 2) + padded_lr(i + 2, j + 2),
+					padded_lr(i - 1, j - 2) + padded_lr(i + 1, j - 2) + padded_lr(i - 2, j - 1) + padded_lr(i + 2, j - 1) +
+						padded_lr(i - 2, j + 1) + padded_lr(i + 2, j + 1) + padded_lr(i - 1, j + 2) + padded_lr(i + 1, j + 2),
+					padded_lr(i, j - 2) + padded_lr(i - 2, j) + padded_lr(i + 2, j) + padded_lr(i, j + 2),
+					padded_lr(i - 1, j - 1) + padded_lr(i + 1, j - 1) + padded_lr(i - 1, j + 1) + padded_lr(i + 1, j + 1),
+					padded_lr(i, j - 1) + padded_lr(i - 1, j) + padded_lr(i + 1, j) + padded_lr(i, j + 1),
+					padded_lr(i, j)
+				};
+
+				VectorShortColor c = DotFixed(v, kernels.kernel0);
+
+				dst(i * 2, j * 2) = c;
+				res.Store(i * 2, j * 2, c.ToByte());
+			}
+		});
+	}
+
+	void EDRVectorKernels::ProcessStep1Fixed(const VectorImageShortColor &padded_lr, VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res)
+	{
+		// The differences are kept at 1/8, so the sums of 9 fit 16 bits
+		VectorImageShort dir1(padded_lr.Width() - 1, padded_lr.Height() - 1);
+		VectorImageShort dir2(padded_lr.Width() - 1, padded_lr.Height() - 1);
+
+		Parallel::For(1, padded_lr.Height(), [&padded_lr, &dir1, &dir2](int j)
+		{
+			for (int i = 1; i < padded_lr.Width(); i++)
+			{
+				dir1(i - 1, j - 1) = (padded_lr(i, j).y - padded_lr(i - 1, j - 1).y).abs() >> 1;
+				dir2(i - 1, j - 1) = (padded_lr(i - 1, j).y - padded_lr(i, j - 1).y).abs() >> 1;
+			}
+		});
+
+		Parallel::For(0, padded_lr.Height() - 3, [&padded_lr, &dst, &dir1, &dir2, &kernels, &res](int j)
+		{
+			for (int i = 0; i < padded_lr.Width() - 3; i++)
+			{
+				VectorShort w = CalcWeightsFixed(AverageNormal3x3(dir1, i + 1, j + 1), AverageNormal3x3(dir2, i + 1, j + 1));
+
+				VectorShortColor v[6] =
+				{
+					padded_lr(i, j) + padded_lr(i + 3, j + 3),
+					padded_lr(i + 1, j) + padded_lr(i, j + 1) + padded_lr(i + 3, j + 2) + padded_lr(i + 2, j + 3),
+					padded_lr(i + 2, j) + padded_lr(i, j + 2) + padded_lr(i + 3, j + 1) + padded_lr(i + 1, j + 3),
+					padded_lr(i + 3, j) + padded_lr(i, j + 3),
+					padded_lr(i + 1, j + 1) + padded_lr(i + 2, j + 2),
+					padded_lr(i + 1, j + 2) + padded_lr(i + 2, j + 1)
+				};
+
+				VectorShortColor c = BlendFixed(v, kernels.kernel1, kernels.kernel1s, w);
+
+				dst(i * 2 + 3, j * 2 + 3) = c;
+				res.Store(i * 2 + 3, j * 2 + 3, c.ToByte());
+			}
+		});
+	}
+
+	void EDRVectorKernels::ProcessStep2Fixed(const VectorImageShortColor &dst, const FixedKernels &kernels, const BlockSplit::Writer &res)
+	{
+		VectorImageShort dir1(dst.Width() - 9, dst.Height() - 9);
+		VectorImageShort dir2(dst.Width() - 9, dst.Height() - 9);
+
+		Parallel::For(4, dst.Height() - 5, [&dst, &dir1, &dir2](int j)
+		{
+			for (int i = 5 - (j % 2); i < dst.Width() - 5; i += 2)
+			{
+				dir1(i - 4, j - 4) = (dst(i + 1, j).y - dst(i - 1, j).y).abs() >> 1;
+				dir2(i - 4, j - 4) = (dst(i, j + 1).y - dst(i, j - 1).y).abs() >> 1;
+			}
+		});
+
+		Parallel::For(6, dst.Height() - 8, [&dst, &dir1, &dir2, &kernels, &res](int j)
+		{
+			for (int i = 7 - (j % 2); i < dst.Width() - 8; i += 2)
+			{
+				VectorShort w = CalcWeightsFixed(AverageDiag3x3(dir1, i - 4, j - 4), AverageDiag3x3(dir2, i - 4, j - 4));
+
+				VectorShortColor v[6] =
+				{
+					dst(i, j - 3) + dst(i, j + 3),
+					dst(i - 1, j - 2) + dst(i + 1, j - 2) + dst(i - 1, j + 2) + dst(i + 1, j + 2),
+					dst(i - 2, j - 1) + dst(i + 2, j - 1) + dst(i - 2, j + 1) + dst(i + 2, j + 1),
+					dst(i - 3, j) + dst(i + 3, j),
+					dst(i, j - 1) + dst(i, j + 1),
+					dst(i - 1, j) + dst(i + 1, j)
+				};
+
+				res.Store(i, j, BlendFixed(v, kernels.kernel2, kernels.kernel2s, w).ToByte());
+			}
+		});
+	}
+
+	// ==================================================================================================
+
+	bool EDRVectorKernels::LoadCoefficientData(void *buffer, size_t buffer_length)
+	{
+		if (buffer_length != sizeof(EDResampling::Kernels))
+			return false;
+
+		const EDResampling::Kernels *kernels = (const EDResampling::Kernels*)buffer;
+
+		memcpy(kernel0, kernels->kernel0, sizeof(kernel0));
+		memcpy(kernel1, kernels->kernel1, sizeof(kernel1));
+		memcpy(kernel2, kernels->kernel2, sizeof(kernel2));
+
+		return true;
+	}
+
+	bool EDRVectorKernels::LoadModel(const ModelFile &model)
+	{
+		const float *k0 = model.Tensor("edrvector.kernel0", 6);
+		const float *k1 = model.Tensor("edrvector.kernel1", 6);
+		const float *k2 = model.Tensor("edrvector.kernel2", 6);
+		const float *threshold = model.Tensor("edrvector.threshold", 1);
+
+		if (k0 == nullptr || k1 == nullptr || k2 == nullptr || threshold == nullptr)
+			return false;
+
+		memcpy(kernel0, k0, sizeof(kernel0));
+		memcpy(kernel1, k1, sizeof(kernel1));
+		memcpy(kernel2, k2, sizeof(kernel2));
+		WeightThreshold = *threshold;
+
+		return true;
+	}
+
+	void EDRVectorKernels::SaveModel(ModelFileWriter &writer, ModelDataType type) const
+	{
+		writer.Add("edrvector.kernel0", kernel0, { 6 }, type);
+		writer.Add("edrvector.kernel1", kernel1, { 6 }, type);
+		writer.Add("edrvector.kernel2", kernel2, { 6 }, type);
+		writer.Add("edrvector.threshold", &WeightThreshold, { 1 }, type);
+	}
+
+	inline VectorFloat EDRVectorKernels::CalcWeights(VectorFloat p, VectorFloat q)
+	{
+		VectorFloat p2 = p * p;
+		VectorFloat q2 = q * q;
+		VectorFloat p6 = p2 * p2 * p2 + ONE;
+		VectorFloat q6 = q2 * q2 * q2 + ONE;
+		return p6 / (p6 + q6);
+	}
+
+	inline VectorFloat EDRVectorKernels::abs(VectorFloat value)
+	{
+		return value & SIGNMASK;
+	}
+
+	// ==================================================================================================
+
+	ImageByteColor EDRVectorKernels::Perform(const ImageByteColor &lr, EDRVector::Precision precision)
+	{
+		BlockSplit bs;
+		ConfigureSplit(bs, lr.Width(), lr.Height());
+
+		FixedKernels kernels;
+		bool fixed = precision == EDRVector::Precision::Fixed16 && QuantizeKernels(kernels);
+
+		ImageByteColor res(lr.Width() * 2, lr.Height() * 2);
+
+		if (fixed)
+		{
+			VectorImageShortColor src = bs.SplitFixed(lr);
+
+			PerformFixed(src, kernels, BlockSplit::Writer(bs, res, src.Width() * 2, src.Height() * 2));
+		}
+		else
+		{
+			VectorImageFloatColor src = bs.Split(lr);
+
+			Perform(src, BlockSplit::Writer(bs, res, src.Width() * 2, src.Height() * 2));
+		}
+
+		return res;
+	}
+
+	EDRVector::Impl *CreateEDRVector()
+	{
+		return new EDRVectorKernels();
+	}
+
+	// ==================================================================================================
+} }
\ No newline at end of file
@@ -0,0 +1,8 @@
+// AVX2 build of the vector kernels, selected at run time, see misc/cpudispatch.h
+
+#undef LEGACY
+#define IP_SIMD_NAMESPACE avx2
+
+#include "edrvector_kernels.hpp"
+#include "si_resampling_kernels.hpp"
+#include "srcnn_kernels.hpp"
@@ -0,0 +1,9 @@
+// AVX-512 build of the vector kernels, selected at run time, see misc/cpudispatch.h
+
+#undef LEGACY
+#define AVX512
+#define IP_SIMD_NAMESPACE avx512
+
+#include "edrvector_kernels.hpp"
+#include "si_resampling_kernels.hpp"
+#include "srcnn_kernels.hpp"
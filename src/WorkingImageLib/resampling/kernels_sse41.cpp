@@ -0,0 +1,10 @@
+// SSE4.1 build of the vector kernels, selected at run time, see misc/cpudispatch.h
+
+#ifndef LEGACY
+#define LEGACY
+#endif
+#define IP_SIMD_NAMESPACE sse41
+
+#include "edrvector_kernels.hpp"
+#include "si_resampling_kernels.hpp"
+#include "srcnn_kernels.hpp"
@@ -1,32 +1,68 @@
 #pragma once
 
 #include <iplib/image/core.h>
-#include <misc/vectorimage.h>
+#include <misc/modelfile.h>
+#include <functional>
 
 namespace ip
 {
 	class SIResampling
 	{
-		class Impl;
-		
-		Impl *impl;
-
 	public:
+		// Kernel set for one instruction set, see misc/cpudispatch.h
+		class Impl;
 
 		enum class Mode	{ SI1, SI2, SI3, SI1Deblur, SI2Deblur, SI3Deblur };
 
+		/* Fixed16 keeps the samples in 16-bit fixed point and the kernels in Q12 and moves half the data of Float.
+		* The kernels with a coefficient of 8 or more in magnitude, or with the absolute sum of 128 or more, do not fit
+		* the 32-bit sums, the model is processed in Float then. See PerformFixed for the error bound */
+		enum class Precision { Float, Fixed16 };
+
+		static const int ClassCount = 625;
+
+		struct LearningProgress
+		{
+			enum class Stage { Accumulation, Solving };
+
+			Stage stage;
+
+			// The number of the learning images added so far
+			int images;
+
+			// The number of the classes solved so far (Solving stage only)
+			int solved;
+
+			// The number of the samples per class
+			int min, aver, max;
+		};
+
+		// Called after every learning image and after every class is solved. The calls are serialized,
+		// but may come from the worker threads
+		typedef std::function<void(const LearningProgress &progress)> LearningCallback;
+
 		SIResampling(Mode mode);
 		SIResampling(Mode mode, void *coefficient_data, size_t coefficient_data_size);
 		~SIResampling();
 
-		ImageByteColor Perform(const ImageByteColor &lr);
-		ImageByteColor PerformDeblur(const ImageByteColor &lr);
+		ImageByteColor Perform(const ImageByteColor &lr, Precision precision = Precision::Float);
+		ImageByteColor PerformDeblur(const ImageByteColor &lr, Precision precision = Precision::Float);
 
 		void AddLearningImage(const ImageByteColor &lr, const ImageByteColor &hr);
 		void AddLearningImageDeblur(const ImageByteColor &lr, const ImageByteColor &hr);
 		void PerformLearning();
-		void GetLearningStats(int &min, int &aver, int &max);
+		void SetLearningCallback(LearningCallback callback);
 
 		size_t SaveCoefficientData(void *buffer, size_t buffer_length);
+
+		// false if the data is not of the size SaveCoefficientData writes for the mode
+		bool LoadCoefficientData(void *buffer, size_t buffer_length);
+
+		// The kernels are used directly from the mapped file, the object keeps the mapping alive
+		bool LoadModel(const ModelFile &model);
+		bool SaveModel(const wchar_t *filename, ModelDataType type = ModelDataType::Float32);
+
+	private:
+		Impl *impl;
 	};
 }
\ No newline at end of file
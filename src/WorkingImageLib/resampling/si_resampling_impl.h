@@ -0,0 +1,25 @@
+#pragma once
+
+#include "si_resampling.h"
+
+namespace ip
+{
+	class SIResampling::Impl
+	{
+	public:
+		virtual ~Impl() {}
+
+		virtual ImageByteColor Perform(const ImageByteColor &lr, Precision precision) = 0;
+		virtual ImageByteColor PerformDeblur(const ImageByteColor &lr, Precision precision) = 0;
+
+		virtual void AddLearningImage(const ImageByteColor &lr, const ImageByteColor &hr) = 0;
+		virtual void AddLearningImageDeblur(const ImageByteColor &lr, const ImageByteColor &hr) = 0;
+		virtual void PerformLearning() = 0;
+		virtual void SetLearningCallback(LearningCallback callback) = 0;
+
+		virtual size_t SaveCoefficientData(void *buffer, size_t buffer_length) = 0;
+		virtual bool LoadCoefficientData(void *buffer, size_t buffer_length) = 0;
+		virtual bool LoadModel(const ModelFile &model) = 0;
+		virtual void SaveModel(ModelFileWriter &writer, ModelDataType type) = 0;
+	};
+}
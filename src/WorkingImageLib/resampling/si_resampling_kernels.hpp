@@ -0,0 +1,718 @@
+#include "si_resampling_impl.h"
+#include <iplib/math/quadratic_optimization.h>
+#include <misc/blocksplit.h>
+#include <misc/modelfile.h>
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+namespace ip { inline namespace IP_SIMD_NAMESPACE
+{
+	class SIKernels
+		: public SIResampling::Impl
+	{
+	public:
+		template <int R, int Q> class SIBase;
+		template <int R> class SIResamplingBase;
+		template <int R> class SIDeblurBase;
+
+	public:
+		ImageByteColor Perform(const ImageByteColor &lr, SIResampling::Precision precision) override final;
+		ImageByteColor PerformDeblur(const ImageByteColor &lr, SIResampling::Precision precision) override final;
+		void AddLearningImage(const ImageByteColor &lr, const ImageByteColor &hr) override final;
+		void AddLearningImageDeblur(const ImageByteColor &lr, const ImageByteColor &hr) override final;
+		void SetLearningCallback(SIResampling::LearningCallback callback) override final;
+
+		// The result is written straight into hr, the vector image of lr is never built as a whole
+		virtual void Perform(const BlockSplit &bs, const ImageByteColor &lr, ImageByteColor &hr) = 0;
+		/* Fixed-point version of Perform. The samples are rounded to 1/16 and the kernels to 1/4096, so every of Y, U, V
+		* differs from Perform by at most sum(|k|) / 32 + (2R + 1)^2 * 255 / 8192 before the rounding to bytes. A pixel
+		* whose gradient lies within the rounding of a class threshold may take the kernel of the neighbour class */
+		virtual void PerformFixed(const BlockSplit &bs, const ImageByteColor &lr, ImageByteColor &hr) = 0;
+		virtual void AddLearningImage(const VectorImageFloatColor &lr, const VectorImageFloatColor &hr) = 0;
+		virtual int GetPadding() const = 0;
+
+		// False when the kernels do not fit the fixed-point path
+		virtual bool FixedAvailable() const = 0;
+
+		// The source is either a vector image, a BlockSplit::Reader or a BlockSplit::FixedReader
+		template <class Source>
+		static VectorFloat GetBlockIndex(const Source &img, int x, int y);
+
+		template <class Source>
+		static VectorInt GetDirectionalIndex(const Source &img, int x, int y);
+
+		static VectorFloat Luma(const VectorFloatColor &value) { return value.y; }
+		inline static VectorFloat Luma(const VectorShortColor &value);
+
+		/* Calls f(reader, j) for every row j of the result. The workers take bands of BandHeight rows and convert the
+		* 2R + 1 source rows the kernel needs into their own readers */
+		template <class Reader = BlockSplit::Reader, class F>
+		static void ForEachRow(const BlockSplit &bs, const ImageByteColor &lr, int R, F f);
+
+		// The fractional bits of the quantized kernels
+		static constexpr int KernelBits = 12;
+
+		static constexpr int BandHeight = 32;
+
+		SIResampling::LearningCallback callback;
+		int images = 0;
+
+		// Not thread-safe, the workers call it under callback_lock
+		void ReportProgress(SIResampling::LearningProgress::Stage stage, int solved);
+
+	protected:
+
+		std::vector<std::unique_ptr<QuadraticOptimization[]>> opt;
+
+		std::mutex callback_lock;
+
+		void InitLearning(int Q);
+	};
+
+	template <class Source>
+	VectorFloat SIKernels::GetBlockIndex(const Source &img, int x, int y)
+	{
+		static const VectorFloat THR(15.0f * 15.0f);
+		static const VectorFloat ONE(1), TWO(2), THREE(3), FOUR(4);
+		static const VectorFloat SQ2(0.70710678118654752440084436210485f);
+
+		VectorFloat p00 = Luma(img(x, y)), p10 = Luma(img(x + 1, y)), p01 = Luma(img(x, y + 1)), p11 = Luma(img(x + 1, y + 1));
+
+		VectorFloat dx = p00 + p01 - p10 - p11;
+		VectorFloat dy = p00 + p10 - p01 - p11;
+		VectorFloat g = dx * dx + dy * dy;
+		VectorFloat gt_mask = g.compare_gt_ord_ns(THR);
+
+		VectorFloat v1 = dy.abs();
+		VectorFloat v2 = (dx - dy).abs() * SQ2;
+		VectorFloat v3 = dx.abs();
+		VectorFloat v4 = (dx + dy).abs() * SQ2;
+
+		VectorFloat cmp12 = v1.compare_lt_ord_ns(v2);	// (v1 < v2) ? -1 : 0
+		VectorFloat max12 = v1.blend(v2, cmp12);
+		VectorFloat res12 = ONE.blend(TWO, cmp12);
+
+		VectorFloat cmp34 = v3.compare_lt_ord_ns(v4);	// (v3 < v4) ? -1 : 0
+		VectorFloat max34 = v3.blend(v4, cmp34);
+		VectorFloat res34 = THREE.blend(FOUR, cmp34);
+
+		VectorFloat cmp1234 = max12.compare_lt_ord_ns(max34);
+		VectorFloat max1234 = max12.blend(max34, cmp1234);
+		VectorFloat res1234 = res12.blend(res34, cmp1234);
+
+		return gt_mask & res1234;
+	}
+
+	template <class Source>
+	VectorInt SIKernels::GetDirectionalIndex(const Source &img, int x, int y)
+	{
+		static const VectorFloat FIVE(5.0f);
+
+		VectorFloat i0 = GetBlockIndex(img, x - 1, y - 1);
+		VectorFloat i1 = GetBlockIndex(img, x, y - 1);
+		VectorFloat i2 = GetBlockIndex(img, x - 1, y);
+		VectorFloat i3 = GetBlockIndex(img, x, y);
+
+		return (((i3 * FIVE + i2) * FIVE + i1) * FIVE + i0).conv_i32();
+	}
+
+	VectorFloat SIKernels::Luma(const VectorShortColor &value)
+	{
+		static const VectorFloat SCALE(1.0f / (1 << VectorShortColor::FractionBits));
+
+		return value.y.convert_f32() * SCALE;
+	}
+
+	template <class Reader, class F>
+	void SIKernels::ForEachRow(const BlockSplit &bs, const ImageByteColor &lr, int R, F f)
+	{
+		int Height = bs.GetGeometry(lr.Width(), lr.Height()).Height - 2 * R;
+
+		Parallel::For([&bs, &lr, &f, R, Height](std::atomic_int &counter)
+		{
+			Reader reader(bs, lr, 2 * R + 1);
+
+			for (int band = counter++; band * BandHeight < Height; band = counter++)
+			{
+				for (int j = band * BandHeight; j < std::min(Height, (band + 1) * BandHeight); j++)
+				{
+					reader.Prepare(j, j + 2 * R);
+					f(reader, j);
+				}
+			}
+		});
+	}
+
+	void SIKernels::InitLearning(int Q)
+	{
+		if (opt.size() > 0)
+			return;
+
+		for (int i = 0; i < Q; i++)
+			opt.emplace_back(std::make_unique<QuadraticOptimization[]>(625));
+	}
+
+	void SIKernels::ReportProgress(SIResampling::LearningProgress::Stage stage, int solved)
+	{
+		if (!callback || opt.empty())
+			return;
+
+		SIResampling::LearningProgress progress;
+		progress.stage = stage;
+		progress.images = images;
+		progress.solved = solved;
+		progress.min = progress.max = progress.aver = opt[0][0].Count();
+
+		for (int i = 1; i < 625; i++)
+		{
+			int N = opt[0][i].Count();
+			if (N < progress.min)
+				progress.min = N;
+			if (N > progress.max)
+				progress.max = N;
+			progress.aver += N;
+		}
+
+		progress.aver /= 625;
+
+		callback(progress);
+	}
+
+	// ==================================================================================================
+
+	template <int R, int Q>
+	class SIKernels::SIBase
+		: public SIKernels
+	{
+	protected:
+		static constexpr int R2 = 2 * R + 1;
+		float kernels[625][Q][R2 * R2];
+
+		// Points either to kernels or to the tensor of the mapped model file
+		const float (*active)[Q][R2 * R2] = kernels;
+		ModelFile model;
+
+		/* The kernels of active in Q12, transposed to the column-major order and padded with zeros to Taps. Rebuilt
+		* whenever active changes, empty when a kernel does not fit */
+		static constexpr int Taps = (R2 * R2 + 7) / 8 * 8;
+		std::vector<short> fixed;
+
+		/* The taps of one vector pixel transposed, so that the taps of lane k of channel c are contiguous in values[c][k].
+		* The order is column-major: moving to the next pixel of the row shifts out the first column */
+		struct LaneTaps
+		{
+			alignas(16) short values[3][VectorFloat::size][Taps];
+		};
+
+		/* The samples are below 2^12 in magnitude (VectorShortColor), so the sum of a kernel fits 32 bits when its
+		* coefficients are below 8 and their absolute sum is below 128 */
+		void QuantizeKernels()
+		{
+			fixed.assign(625 * Q * Taps, 0);
+
+			for (int i = 0; i < 625; i++)
+			{
+				for (int n = 0; n < Q; n++)
+				{
+					float sum = 0.0f;
+
+					for (int p = 0; p < R2 * R2; p++)
+					{
+						float k = active[i][n][p] * (1 << KernelBits);
+
+						if (!(fabsf(k) < 32767.0f))
+						{
+							fixed.clear();
+							return;
+						}
+
+						fixed[(i * Q + n) * Taps + (p % R2) * R2 + p / R2] = (short)lrintf(k);
+						sum += fabsf(active[i][n][p]);
+					}
+
+					if (!(sum < 128.0f))
+					{
+						fixed.clear();
+						return;
+					}
+				}
+			}
+		}
+
+		// Unless i is 0, taps should hold the taps of the pixel i - 1 of the same row
+		static void LoadTaps(const BlockSplit::FixedReader &lr, int i, int j, LaneTaps &taps)
+		{
+			int first = R2 - 1;
+
+			if (i == 0)
+			{
+				first = 0;
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+					for (int k = 0; k < VectorFloat::size; k++)
+						memmove(taps.values[c][k], taps.values[c][k] + R2, (R2 * R2 - R2) * sizeof(short));
+			}
+
+			for (int ii = first; ii < R2; ii++)
+			{
+				for (int jj = 0; jj < R2; jj++)
+				{
+					const VectorShortColor &x = lr(i + ii, j + jj);
+					int p = ii * R2 + jj;
+
+					for (int k = 0; k < VectorFloat::size; k++)
+					{
+						taps.values[0][k][p] = x.y.get(k);
+						taps.values[1][k][p] = x.u.get(k);
+						taps.values[2][k][p] = x.v.get(k);
+					}
+				}
+			}
+		}
+
+		static int Dot(const short *taps, const short *kernel)
+		{
+			__m128i sum = _mm_setzero_si128();
+
+			for (int p = 0; p < Taps; p += 8)
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_load_si128((const __m128i*)(taps + p)), _mm_loadu_si128((const __m128i*)(kernel + p))));
+
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			return _mm_cvtsi128_si32(sum);
+		}
+
+		// Lane k of the result is the kernel n of the class indices[k] applied to the taps of lane k
+		VectorFloatColor DotFixed(const LaneTaps &taps, VectorInt indices, int n) const
+		{
+			static const float SCALE = 1.0f / (1 << (VectorShortColor::FractionBits + KernelBits));
+
+			VectorFloatColor res;
+
+			for (int k = 0; k < VectorFloat::size; k++)
+			{
+				const short *kernel = &fixed[(indices.get(k) * Q + n) * Taps];
+
+				res.y.set(k, Dot(taps.values[0][k], kernel) * SCALE);
+				res.u.set(k, Dot(taps.values[1][k], kernel) * SCALE);
+				res.v.set(k, Dot(taps.values[2][k], kernel) * SCALE);
+			}
+
+			return res;
+		}
+
+	public:
+
+		bool FixedAvailable() const override final
+		{
+			return !fixed.empty();
+		}
+
+		size_t SaveCoefficientData(void *buffer, size_t buffer_length) override final
+		{
+			if (buffer_length < sizeof(kernels))
+				return sizeof(kernels);
+
+			memcpy(buffer, active, sizeof(kernels));
+
+			return sizeof(kernels);
+		}
+
+		bool LoadCoefficientData(void *buffer, size_t buffer_length) override final
+		{
+			if (buffer_length != sizeof(kernels))
+				return false;
+
+			memcpy(kernels, buffer, sizeof(kernels));
+
+			active = kernels;
+			model = ModelFile();
+			QuantizeKernels();
+			return true;
+		}
+
+		bool LoadModel(const ModelFile &model) override final
+		{
+			const float *data = model.Tensor("si.kernels", 625 * Q * R2 * R2);
+			if (data == nullptr)
+				return false;
+
+			active = (const float (*)[Q][R2 * R2])data;
+			this->model = model;
+			QuantizeKernels();
+			return true;
+		}
+
+		void SaveModel(ModelFileWriter &writer, ModelDataType type) override final
+		{
+			writer.Add("si.kernels", &active[0][0][0], { 625, Q, R2 * R2 }, type);
+		}
+
+		int GetPadding() const override
+		{
+			return R;
+		}
+
+		void PerformLearning() override final
+		{
+			check(opt.size() == Q);
+
+			int solved = 0;
+
+			Parallel::For(0, 625, [this, &solved](int i)
+			{
+				for (int j = 0; j < Q; j++)
+					opt[j][i].CalcOptimizedCoefficients(kernels[i][j]);
+
+				// The counter is updated under the lock, so the reported values grow monotonically
+				std::lock_guard<std::mutex> lock(this->callback_lock);
+				this->ReportProgress(SIResampling::LearningProgress::Stage::Solving, ++solved);
+			});
+
+			active = kernels;
+			model = ModelFile();
+			QuantizeKernels();
+		}
+
+	protected:
+		/* Adds the learning samples of the pixels at least 3 pixels away from the borders of lr to the optimizers in the
+		* raster order, so the result does not depend on the scheduling of the workers. The classes are found in parallel
+		* by rows, the samples are sorted by the class and every class is accumulated by one worker. sample(i, j, k,
+		* kernel, values) fills the taps and the Q values of lane k of the pixel (i, j) */
+		template <class Sample>
+		void AddSamples(const VectorImageFloatColor &lr, const Sample &sample)
+		{
+			const int border = 3, lanes = VectorFloat::size;
+			int width = lr.Width() - border * 2, height = lr.Height() - border * 2;
+
+			if (width <= 0 || height <= 0)
+				return;
+
+			std::vector<int> classes((size_t)width * height * lanes);
+
+			Parallel::For(0, height, [&lr, &classes, width](int y)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					VectorInt indices = GetDirectionalIndex(lr, x + border, y + border);
+
+					for (int k = 0; k < lanes; k++)
+						classes[((size_t)y * width + x) * lanes + k] = indices.get(k);
+				}
+			});
+
+			// Counting sort, the samples of a class keep the raster order
+			std::vector<size_t> offsets(626, 0);
+
+			for (int c : classes)
+				offsets[c + 1]++;
+
+			for (int c = 0; c < 625; c++)
+				offsets[c + 1] += offsets[c];
+
+			std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+			std::vector<int> order(classes.size());
+
+			for (size_t n = 0; n < classes.size(); n++)
+				order[next[classes[n]]++] = (int)n;
+
+			Parallel::For(0, 625, [this, &sample, &offsets, &order, width](int idx)
+			{
+				float kernel[R2 * R2], values[Q];
+
+				for (size_t n = offsets[idx]; n < offsets[idx + 1]; n++)
+				{
+					int pixel = order[n] / lanes;
+					sample(pixel % width + border, pixel / width + border, order[n] % lanes, kernel, values);
+
+					for (int q = 0; q < Q; q++)
+						opt[q][idx].AddData(kernel, R2 * R2, values[q]);
+				}
+			});
+		}
+	};
+
+	// ==================================================================================================
+
+	template <int R>
+	class SIKernels::SIResamplingBase
+		: public SIKernels::SIBase<R, 4>
+	{
+		static constexpr int R2 = SIKernels::SIBase<R, 4>::R2;
+
+		void Perform(const BlockSplit &bs, const ImageByteColor &src, ImageByteColor &dst) override final
+		{
+			BlockSplit::Geometry g = bs.GetGeometry(src.Width(), src.Height());
+			BlockSplit::Writer hr(bs, dst, (g.Width - 2 * R) * 2, (g.Height - 2 * R) * 2);
+
+			this->ForEachRow(bs, src, R, [&hr, this](const BlockSplit::Reader &lr, int j)
+			{
+				for (int i = 0; i < lr.Width() - 2 * R; i++)
+				{
+					VectorInt indices = GetDirectionalIndex(lr, i + R, j + R);
+
+					VectorFloatColor x[R2 * R2];
+					for (int jj = 0; jj < R2; jj++)
+						for (int ii = 0; ii < R2; ii++)
+							x[jj * R2 + ii] = lr(i + ii, j + jj);
+
+					VectorFloatColor z[4];
+
+					for (int n = 0; n < 4; n++)
+					{
+						for (int k = 0; k < VectorFloat::size; k++)
+						{
+							float y = 0.0f, u = 0.0f, v = 0.0f;
+							int idx = indices.get(k);
+
+							for (int p = 0; p < R2 * R2; p++)
+							{
+								y += this->active[idx][n][p] * x[p].y.get(k);
+								u += this->active[idx][n][p] * x[p].u.get(k);
+								v += this->active[idx][n][p] * x[p].v.get(k);
+							}
+
+							z[n].y.set(k, y);
+							z[n].u.set(k, u);
+							z[n].v.set(k, v);
+						}
+					}
+
+					hr.Store(i * 2, j * 2, z[0].ToByte());
+					hr.Store(i * 2 + 1, j * 2, z[1].ToByte());
+					hr.Store(i * 2, j * 2 + 1, z[2].ToByte());
+					hr.Store(i * 2 + 1, j * 2 + 1, z[3].ToByte());
+				}
+			});
+		}
+
+		void PerformFixed(const BlockSplit &bs, const ImageByteColor &src, ImageByteColor &dst) override final
+		{
+			BlockSplit::Geometry g = bs.GetGeometry(src.Width(), src.Height());
+			BlockSplit::Writer hr(bs, dst, (g.Width - 2 * R) * 2, (g.Height - 2 * R) * 2);
+
+			this->template ForEachRow<BlockSplit::FixedReader>(bs, src, R, [&hr, this](const BlockSplit::FixedReader &lr, int j)
+			{
+				typename SIKernels::SIBase<R, 4>::LaneTaps taps = {};
+
+				for (int i = 0; i < lr.Width() - 2 * R; i++)
+				{
+					VectorInt indices = GetDirectionalIndex(lr, i + R, j + R);
+					this->LoadTaps(lr, i, j, taps);
+
+					hr.Store(i * 2, j * 2, this->DotFixed(taps, indices, 0).ToByte());
+					hr.Store(i * 2 + 1, j * 2, this->DotFixed(taps, indices, 1).ToByte());
+					hr.Store(i * 2, j * 2 + 1, this->DotFixed(taps, indices, 2).ToByte());
+					hr.Store(i * 2 + 1, j * 2 + 1, this->DotFixed(taps, indices, 3).ToByte());
+				}
+			});
+		}
+
+		void AddLearningImage(const VectorImageFloatColor &lr, const VectorImageFloatColor &hr) override final
+		{
+			this->InitLearning(4);
+
+			this->AddSamples(lr, [&lr, &hr](int i, int j, int k, float *kernel, float *values)
+			{
+				for (int jj = 0; jj < R2; jj++)
+					for (int ii = 0; ii < R2; ii++)
+						kernel[jj * R2 + ii] = lr(i + ii - R, j + jj - R).y.get(k);
+
+				values[0] = hr(2 * i, 2 * j).y.get(k);
+				values[1] = hr(2 * i + 1, 2 * j).y.get(k);
+				values[2] = hr(2 * i, 2 * j + 1).y.get(k);
+				values[3] = hr(2 * i + 1, 2 * j + 1).y.get(k);
+			});
+		}
+	};
+
+	// ==================================================================================================
+
+	template <int R>
+	class SIKernels::SIDeblurBase
+		: public SIKernels::SIBase<R, 1>
+	{
+		static constexpr int R2 = SIKernels::SIBase<R, 1>::R2;
+
+		void Perform(const BlockSplit &bs, const ImageByteColor &src, ImageByteColor &dst) override final
+		{
+			BlockSplit::Geometry g = bs.GetGeometry(src.Width(), src.Height());
+			BlockSplit::Writer hr(bs, dst, g.Width - 2 * R, g.Height - 2 * R);
+
+			this->ForEachRow(bs, src, R, [&hr, this](const BlockSplit::Reader &lr, int j)
+			{
+				for (int i = 0; i < lr.Width() - 2 * R; i++)
+				{
+					VectorInt indices = GetDirectionalIndex(lr, i + R, j + R);
+
+					VectorFloatColor x[R2 * R2];
+					for (int jj = 0; jj < R2; jj++)
+						for (int ii = 0; ii < R2; ii++)
+							x[jj * R2 + ii] = lr(i + ii, j + jj);
+
+					VectorFloatColor z;
+
+					for (int k = 0; k < VectorFloat::size; k++)
+					{
+						float y = 0.0f, u = 0.0f, v = 0.0f;
+						int idx = indices.get(k);
+
+						for (int p = 0; p < R2 * R2; p++)
+						{
+							y += this->active[idx][0][p] * x[p].y.get(k);
+							u += this->active[idx][0][p] * x[p].u.get(k);
+							v += this->active[idx][0][p] * x[p].v.get(k);
+						}
+
+						z.y.set(k, y);
+						z.u.set(k, u);
+						z.v.set(k, v);
+					}
+
+					hr.Store(i, j, z.ToByte());
+				}
+			});
+		}
+
+		void PerformFixed(const BlockSplit &bs, const ImageByteColor &src, ImageByteColor &dst) override final
+		{
+			BlockSplit::Geometry g = bs.GetGeometry(src.Width(), src.Height());
+			BlockSplit::Writer hr(bs, dst, g.Width - 2 * R, g.Height - 2 * R);
+
+			this->template ForEachRow<BlockSplit::FixedReader>(bs, src, R, [&hr, this](const BlockSplit::FixedReader &lr, int j)
+			{
+				typename SIKernels::SIBase<R, 1>::LaneTaps taps = {};
+
+				for (int i = 0; i < lr.Width() - 2 * R; i++)
+				{
+					VectorInt indices = GetDirectionalIndex(lr, i + R, j + R);
+					this->LoadTaps(lr, i, j, taps);
+
+					hr.Store(i, j, this->DotFixed(taps, indices, 0).ToByte());
+				}
+			});
+		}
+
+		void AddLearningImage(const VectorImageFloatColor &lr, const VectorImageFloatColor &hr) override final
+		{
+			this->InitLearning(1);
+
+			this->AddSamples(lr, [&lr, &hr](int i, int j, int k, float *kernel, float *values)
+			{
+				for (int jj = 0; jj < R2; jj++)
+					for (int ii = 0; ii < R2; ii++)
+						kernel[jj * R2 + ii] = lr(i + ii - R, j + jj - R).y.get(k);
+
+				values[0] = hr(i, j).y.get(k);
+			});
+		}
+	};
+
+	// ==================================================================================================
+
+	ImageByteColor SIKernels::Perform(const ImageByteColor &lr, SIResampling::Precision precision)
+	{
+		BlockSplit bs;
+		bs.SetInputPadding(BlockSplitConfiguration(GetPadding()), BlockSplitPaddingMode::Duplicate);
+		bs.ComputeSplitLayout(lr.Width(), lr.Height());
+
+		ImageByteColor hr(lr.Width() * 2, lr.Height() * 2);
+
+		if (precision == SIResampling::Precision::Fixed16 && FixedAvailable())
+			PerformFixed(bs, lr, hr);
+		else
+			Perform(bs, lr, hr);
+
+		return hr;
+	}
+
+	ImageByteColor SIKernels::PerformDeblur(const ImageByteColor &lr, SIResampling::Precision precision)
+	{
+		BlockSplit bs;
+		bs.SetInputPadding(BlockSplitConfiguration(GetPadding()), BlockSplitPaddingMode::Duplicate);
+		bs.ComputeSplitLayout(lr.Width(), lr.Height());
+
+		ImageByteColor hr(lr.Width(), lr.Height());
+
+		if (precision == SIResampling::Precision::Fixed16 && FixedAvailable())
+			PerformFixed(bs, lr, hr);
+		else
+			Perform(bs, lr, hr);
+
+		return hr;
+	}
+
+	void SIKernels::AddLearningImage(const ImageByteColor &lr, const ImageByteColor &hr)
+	{
+		check(lr.Width() * 2 == hr.Width() && lr.Height() * 2 == hr.Height());
+
+		BlockSplit bs;
+		bs.ComputeSplitLayout(lr.Width(), lr.Height());
+
+		VectorImageFloatColor vlr = bs.Split(lr);
+		VectorImageFloatColor vhr = bs.Split(hr, vlr.Width() * 2, vlr.Height() * 2);
+
+		AddLearningImage(vlr, vhr);
+
+		images++;
+		ReportProgress(SIResampling::LearningProgress::Stage::Accumulation, 0);
+	}
+
+	void SIKernels::AddLearningImageDeblur(const ImageByteColor &lr, const ImageByteColor &hr)
+	{
+		check(lr.Width() == hr.Width() && lr.Height() == hr.Height());
+
+		BlockSplit bs;
+		bs.ComputeSplitLayout(lr.Width(), lr.Height());
+
+		VectorImageFloatColor vlr = bs.Split(lr);
+		VectorImageFloatColor vhr = bs.Split(hr, vlr.Width(), vlr.Height());
+
+		AddLearningImage(vlr, vhr);
+
+		images++;
+		ReportProgress(SIResampling::LearningProgress::Stage::Accumulation, 0);
+	}
+
+	void SIKernels::SetLearningCallback(SIResampling::LearningCallback callback)
+	{
+		this->callback = callback;
+	}
+
+	// ==================================================================================================
+
+	SIResampling::Impl *CreateSIResampling(SIResampling::Mode mode)
+	{
+		switch (mode)
+		{
+		case SIResampling::Mode::SI1:
+			return new SIKernels::SIResamplingBase<1>();
+
+		case SIResampling::Mode::SI2:
+			return new SIKernels::SIResamplingBase<2>();
+
+		case SIResampling::Mode::SI3:
+			return new SIKernels::SIResamplingBase<3>();
+
+		case SIResampling::Mode::SI1Deblur:
+			return new SIKernels::SIDeblurBase<1>();
+
+		case SIResampling::Mode::SI2Deblur:
+			return new SIKernels::SIDeblurBase<2>();
+
+		case SIResampling::Mode::SI3Deblur:
+			return new SIKernels::SIDeblurBase<3>();
+
+		default:
+			die("Invalid mode");
+			return nullptr;
+		}
+	}
+} }
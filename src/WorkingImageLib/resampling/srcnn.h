@@ -1,21 +1,29 @@
 #pragma once
 
 #include <iplib/image/core.h>
+#include <misc/modelfile.h>
 #include <memory>
 
 namespace ip
 {
-	class SRCNN_Resampling;
-
 	class SRCNN
 	{
 	public:
+		// Kernel set for one instruction set, see misc/cpudispatch.h
+		class Impl;
+
+		/* Half keeps the 32-channel output of the second layer in FP16, the convolutions accumulate in float.
+		* The layer is the largest buffer of the network, so this halves the memory traffic of the third layer.
+		* The SSE4.1 build has no F16C, Float is used there */
+		enum class Precision { Float, Half };
+
 		SRCNN(wchar_t *filename = nullptr);
 		operator bool() const;
-		bool Resample_x2_915(const ip::Image<float> &src, ip::Image<float> &dst, bool half_shift);
+		bool SaveModel(const wchar_t *filename, ModelDataType type = ModelDataType::Float32) const;
+		bool Resample_x2_915(const ip::Image<float> &src, ip::Image<float> &dst, bool half_shift, Precision precision = Precision::Float);
 		~SRCNN();
 
 	private:
-		SRCNN_Resampling *impl;
+		Impl *impl;
 	};
 }
\ No newline at end of file
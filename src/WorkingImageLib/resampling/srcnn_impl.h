@@ -0,0 +1,19 @@
+#pragma once
+
+#include "srcnn.h"
+
+namespace ip
+{
+	class SRCNN::Impl
+	{
+	public:
+		virtual ~Impl() {}
+
+		// Both the model files and the legacy raw coefficient files are accepted
+		virtual bool LoadData(const wchar_t *filename) = 0;
+		virtual bool LoadModel(const ModelFile &model) = 0;
+		virtual void SaveModel(ModelFileWriter &writer, ModelDataType type) const = 0;
+
+		virtual void Process(const ip::Image<float> &src, ip::Image<float> &dst, bool half_shift, Precision precision) = 0;
+	};
+}
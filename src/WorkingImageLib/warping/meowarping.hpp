@@ -51,7 +51,7 @@ namespace ip
 		}
 	};
 
-	MeowWarping::MeowWarping()
+	inline MeowWarping::MeowWarping()
 		: edge_detector_sigma(2.0f)
 		, warping_sigma(2.0f)
 		, warping_power(1.0f)